@@ -7,7 +7,15 @@
 # Definir constantes para el header Multiboot
 .set ALIGN,    1<<0                  # Alinear módulos cargados en límites de página
 .set MEMINFO,  1<<1                  # Proporcionar mapa de memoria
-.set FLAGS,    ALIGN | MEMINFO       # Campo de flags Multiboot
+# Con make VIDEO=ANCHOxALTO se pide además un modo gráfico de 32 bits: el
+# cargador (GRUB) lo deja puesto y pasa el framebuffer en la estructura
+# Multiboot (ver console_init en kernel.c)
+.ifdef VIDEO_WIDTH
+.set VIDEO,    1<<2                  # Pedir modo de vídeo
+.else
+.set VIDEO,    0
+.endif
+.set FLAGS,    ALIGN | MEMINFO | VIDEO   # Campo de flags Multiboot
 .set MAGIC,    0x1BADB002            # Número mágico que identifica el header
 .set CHECKSUM, -(MAGIC + FLAGS)      # Checksum para validar el header
 
@@ -17,12 +25,20 @@
 .long MAGIC
 .long FLAGS  
 .long CHECKSUM
+.ifdef VIDEO_WIDTH
+.long 0, 0, 0, 0, 0                  # Direcciones (sólo con el bit 16; es un ELF)
+.long 0                              # Modo lineal
+.long VIDEO_WIDTH
+.long VIDEO_HEIGHT
+.long 32                             # Bits por píxel
+.endif
 
 # =============================================================================
 # CÓDIGO DE ENTRADA DEL KERNEL
 # =============================================================================
 
 .section .text
+.code32                         # El cargador entra en modo protegido de 32 bits
 .global _start
 .type _start, @function
 
@@ -30,26 +46,23 @@ _start:
     # Configurar la pila del kernel
     mov $stack_top, %esp
     
-    # Inicializar la imagen del disco con ceros (filesystem vacío)
-    cld                          # Dirección hacia adelante para string ops
-    mov $disk_image_start, %edi  # EDI = inicio del area de disco
-    mov $0, %eax                 # EAX = 0 (patrón a escribir)
-    mov $37088, %ecx             # ECX = (512 * 289 / 4) = número de dwords
-    rep stosl                    # Llenar con ceros
-    
-    # Inicializar el Boot Sector del filesystem (sector 0)
-    mov $disk_image_start, %edi
-    movb $0xEB, (%edi)          # Jump instruction (típico de boot sectors)
-    movb $0x00, 1(%edi)         # Completar el jump
-    movb $0x90, 2(%edi)         # NOP
-    
-    # Escribir signature de boot sector válido
-    mov $disk_image_start, %edi
-    add $510, %edi              # Posición del signature (offset 510)
-    movw $0xAA55, (%edi)        # Boot signature
-    
+    # No se limpia aquí el área de disco: el cargador ya la deja a cero al
+    # cargar el ELF, y fs_init() sólo formatea los metadatos cuando no se
+    # recibe una imagen ya preparada como módulo Multiboot.
+
+    # Pasar a kernel_main(magic, multiboot_info) los valores que deja el
+    # cargador: EAX = número mágico, EBX = puntero a la estructura Multiboot
+.ifdef LONG_MODE
+    # make ARCH=x86_64: boot64.s pasa antes a modo largo y los lleva en
+    # RDI y RSI
+    jmp long_mode_start
+.else
+    push %ebx
+    push %eax
+
     # Llamar a la función principal del kernel (escrita en C)
     call kernel_main
+.endif
     
     # Si kernel_main retorna (no debería), hacer un bucle infinito
     cli                         # Deshabilitar interrupciones
@@ -65,6 +78,7 @@ halt_loop:
 
 .section .bss
 .align 16
+.global stack_bottom, stack_top   # El perfilador recorre la pila entre ambos
 stack_bottom:
 .skip 16384      # Reservar 16 KiB para la pila
 stack_top:
@@ -73,9 +87,16 @@ stack_top:
 # DATOS DEL SISTEMA DE ARCHIVOS
 # =============================================================================
 
-.section .disk_image
+# El tamaño viene de DISK_SECTORS (Makefile: --defsym DISK_SECTORS=...), el
+# mismo valor del que fat16.h deriva toda la geometría. La sección es
+# @nobits: no ocupa espacio en el binario y el cargador la deja a cero.
+.ifndef DISK_SECTORS
+.set DISK_SECTORS, 2048
+.endif
+
+.section .disk_image, "aw", @nobits
 .align 4096
 .global disk_image_start
 disk_image_start:
-.skip 512 * 289  # 289 sectores × 512 bytes = espacio para el filesystem
+.skip 512 * DISK_SECTORS  # DISK_SECTORS sectores × 512 bytes
 disk_image_end:
@@ -0,0 +1,147 @@
+# boot64.s: paso a modo largo para el kernel de 64 bits (make ARCH=x86_64)
+#
+# Multiboot entra en modo protegido de 32 bits y sin paginación, y boot.s
+# salta aquí con la pila ya puesta. Se comprueba que la CPU tenga modo
+# largo, se construyen unas tablas de 4 niveles que mapean los primeros
+# 4 GiB sobre sí mismos con páginas de 2 MiB (lo mismo que el directorio de
+# 4 MiB de proc.c en 32 bits), se activan PAE, EFER.LME y la paginación y
+# se entra en 64 bits con una GDT mínima. idt.c instala después la
+# definitiva, y proc.c añade la ventana de usuario a estas mismas tablas.
+
+.set PAGE_PRESENT, 0x01
+.set PAGE_WRITE,   0x02
+.set PAGE_2M,      0x80
+.set MSR_EFER,     0xC0000080
+
+.section .text
+.code32
+.global long_mode_start
+.type long_mode_start, @function
+long_mode_start:
+    # EAX = número mágico, EBX = estructura Multiboot: para kernel_main
+    mov %eax, boot_magic
+    mov %ebx, boot_mbi
+
+    # ¿Hay modo largo? CPUID 0x80000001, EDX bit 29
+    mov $0x80000000, %eax
+    cpuid
+    cmp $0x80000001, %eax
+    jb no_long_mode
+    mov $0x80000001, %eax
+    cpuid
+    test $(1 << 29), %edx
+    jz no_long_mode
+
+    # PML4[0] -> PDPT, PDPT[0..3] -> los cuatro directorios. Las tablas
+    # están en .bss: el resto de entradas ya es cero.
+    mov $boot_pdpt, %eax
+    or $(PAGE_PRESENT | PAGE_WRITE), %eax
+    mov %eax, boot_pml4
+    mov $boot_pd, %eax
+    or $(PAGE_PRESENT | PAGE_WRITE), %eax
+    mov $boot_pdpt, %edi
+    mov $4, %ecx
+1:
+    mov %eax, (%edi)
+    add $4096, %eax
+    add $8, %edi
+    loop 1b
+
+    # 2048 páginas de 2 MiB: de 0 a 4 GiB, sólo para ring 0
+    mov $(PAGE_PRESENT | PAGE_WRITE | PAGE_2M), %eax
+    mov $boot_pd, %edi
+    mov $2048, %ecx
+2:
+    mov %eax, (%edi)
+    add $0x200000, %eax
+    add $8, %edi
+    loop 2b
+
+    mov $boot_pml4, %eax
+    mov %eax, %cr3
+    mov %cr4, %eax
+    or $(1 << 5), %eax          # CR4.PAE
+    mov %eax, %cr4
+    mov $MSR_EFER, %ecx
+    rdmsr
+    or $(1 << 8), %eax          # EFER.LME
+    wrmsr
+    mov %cr0, %eax
+    or $0x80000000, %eax        # CR0.PG: con LME, modo largo
+    mov %eax, %cr0
+
+    lgdt boot_gdt_desc
+    ljmp $0x08, $long_mode_64
+.size long_mode_start, . - long_mode_start
+
+# Sin modo largo no hay kernel que arrancar: se avisa en la pantalla de
+# texto, en blanco sobre rojo, y se detiene la CPU
+no_long_mode:
+    mov $no_long_mode_msg, %esi
+    mov $0xB8000, %edi
+    mov $0x4F, %ah
+3:
+    lodsb
+    test %al, %al
+    jz 4f
+    stosw
+    jmp 3b
+4:
+    cli
+    hlt
+    jmp 4b
+
+.code64
+long_mode_64:
+    mov $0x10, %ax
+    mov %ax, %ds
+    mov %ax, %es
+    mov %ax, %fs
+    mov %ax, %gs
+    mov %ax, %ss
+    mov $stack_top, %rsp
+
+    # kernel_main(magic, multiboot_info) en RDI y RSI
+    mov boot_magic(%rip), %edi
+    mov boot_mbi(%rip), %esi
+    call kernel_main
+
+    cli
+5:
+    hlt
+    jmp 5b
+
+# =============================================================================
+# GDT DE ARRANQUE
+# =============================================================================
+.section .rodata
+.align 8
+boot_gdt:
+    .quad 0
+    .quad 0x00AF9A000000FFFF    # Código de 64 bits, ring 0
+    .quad 0x00CF92000000FFFF    # Datos, ring 0
+boot_gdt_desc:
+    .word boot_gdt_desc - boot_gdt - 1
+    .long boot_gdt
+
+no_long_mode_msg:
+    .asciz "Esta CPU no tiene modo largo: arranque la imagen de 32 bits (make ARCH=i386)"
+
+# =============================================================================
+# TABLAS DE PÁGINAS
+# =============================================================================
+.section .bss
+.align 4096
+.global boot_pml4, boot_pdpt, boot_pd   # proc.c pone ahí la ventana de usuario
+boot_pml4:
+.skip 4096
+boot_pdpt:
+.skip 4096
+boot_pd:
+.skip 4096 * 4
+
+.align 4
+boot_magic:
+.skip 4
+boot_mbi:
+.skip 4
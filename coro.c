@@ -0,0 +1,49 @@
+// coro.c: planificador cooperativo de las etapas de un pipe (ver coro.h)
+//
+// No hay hilos ni pilas: el planificador llama a step() de cada etapa por
+// turnos y cada una avanza lo que puede. Como los anillos son pequeños, un
+// productor no se adelanta más de RING_SIZE bytes a su consumidor.
+
+#include <stdint.h>
+#include "platform.h"
+#include "trace.h"
+#include "coro.h"
+
+static void coro_finish(coro *c, int index) {
+    c->line = -1;
+    if (c->out) c->out->closed = 1;
+    if (c->stop) c->stop(c);
+    TRACE(TRACE_PIPE_STAGE, index, c->out ? c->out->head : 0);
+}
+
+int coro_step(coro **v, int lo, int hi) {
+    int alive = 0;
+    for (int i = hi; i >= lo; i--) {
+        coro *c = v[i];
+        if (c->line < 0) continue;
+        if (c->step(c) == CORO_MORE) {
+            alive++;
+            continue;
+        }
+        coro_finish(c, i);
+        coro_cancel(v, lo, i - 1);
+        break;
+    }
+    return alive;
+}
+
+void coro_cancel(coro **v, int lo, int hi) {
+    for (int i = lo; i <= hi; i++) {
+        if (v[i]->line >= 0) coro_finish(v[i], i);
+    }
+}
+
+int coro_run(coro **v, int n, int (*interrupted)(void)) {
+    while (coro_step(v, 0, n - 1)) {
+        if (interrupted && interrupted()) {
+            coro_cancel(v, 0, n - 1);
+            return 0;
+        }
+    }
+    return 1;
+}
@@ -0,0 +1,109 @@
+// coro.h: corrutinas sin pila para las etapas de los pipes (coro.c)
+//
+// Cada etapa es una función step() que avanza hasta que no puede seguir
+// (la salida está llena o la entrada vacía) y retorna CORO_MORE; la
+// siguiente llamada continúa justo ahí. Es la técnica de Duff/protothreads:
+// CORO_BEGIN abre un switch sobre 'line' y cada punto de espera guarda su
+// número de línea como etiqueta. Por eso:
+// - las variables que cruzan una espera viven en la estructura, no en la pila
+// - no puede haber un switch propio entre CORO_BEGIN y CORO_END
+// - como mucho una espera por línea de código
+//
+// Las etapas se comunican por anillos de RING_SIZE bytes: un pipe usa la
+// misma memoria lleve lo que lleve. Igual que text.c, sólo depende de
+// platform.h (que hay que incluir antes: la última etapa usa su putchar).
+#ifndef CORO_H
+#define CORO_H
+
+#include <stdint.h>
+
+#define RING_SIZE 512   // Potencia de dos
+
+// head y tail cuentan bytes desde el principio; su diferencia es lo que hay
+typedef struct {
+    uint32_t head, tail;
+    int      closed;      // El que escribe ha terminado
+    uint8_t  buf[RING_SIZE];
+} ring;
+
+static inline void ring_init(ring *r) {
+    r->head = r->tail = 0;
+    r->closed = 0;
+}
+
+static inline uint32_t ring_count(const ring *r) {
+    return r->head - r->tail;
+}
+
+// 0 si no cabe
+static inline int ring_put(ring *r, uint8_t c) {
+    if (r->head - r->tail == RING_SIZE) return 0;
+    r->buf[r->head++ & (RING_SIZE - 1)] = c;
+    return 1;
+}
+
+// Siguiente byte, o -1 si está vacío
+static inline int ring_get(ring *r) {
+    if (r->head == r->tail) return -1;
+    return r->buf[r->tail++ & (RING_SIZE - 1)];
+}
+
+enum { CORO_MORE, CORO_DONE };
+
+typedef struct coro coro;
+struct coro {
+    int   (*step)(coro *c);
+    void  (*stop)(coro *c);   // Al terminar o cancelarla (cerrar archivos); puede ser NULL
+    int     line;             // Punto de espera; 0 = al principio, -1 = terminada
+    ring   *in, *out;         // Sin 'in' no hay entrada; sin 'out' escribe con putchar
+};
+
+static inline void coro_init(coro *c, int (*step)(coro *c), ring *in, ring *out) {
+    c->step = step;
+    c->stop = 0;
+    c->line = 0;
+    c->in = in;
+    c->out = out;
+}
+
+#define CORO_BEGIN(c)       switch ((c)->line) { case 0:
+#define CORO_YIELD(c)       do { (c)->line = __LINE__; return CORO_MORE; case __LINE__:; } while (0)
+#define CORO_WAIT(c, cond)  while (!(cond)) CORO_YIELD(c)
+#define CORO_END(c)         } (c)->line = -1; return CORO_DONE
+
+#define CORO_EMPTY (-2)
+
+// Siguiente byte de la entrada, -1 al final o CORO_EMPTY si hay que esperar
+static inline int coro_take(coro *c) {
+    if (!c->in) return -1;
+    int b = ring_get(c->in);
+    if (b < 0 && !c->in->closed) return CORO_EMPTY;
+    return b;
+}
+
+// Escribe un byte en la salida; 0 si está llena
+static inline int coro_emit(coro *c, uint8_t b) {
+    if (c->out) return ring_put(c->out, b);
+    putchar(b);
+    return 1;
+}
+
+// Esperan a que haya entrada ('v' queda con el byte o -1) o sitio en la salida
+#define CORO_GET(c, v)  CORO_WAIT(c, ((v) = coro_take(c)) != CORO_EMPTY)
+#define CORO_PUT(c, b)  CORO_WAIT(c, coro_emit(c, b))
+
+// Una vuelta por las etapas v[lo..hi], de la última a la primera para que
+// cada una deje sitio antes de que escriba la anterior. Cuando una termina
+// se cierra su salida y se cancelan las de antes: ya nadie lee lo que
+// produzcan. Retorna cuántas siguen vivas.
+int coro_step(coro **v, int lo, int hi);
+
+// Corre las n etapas hasta que terminen todas. 'interrupted' (puede ser
+// NULL) se consulta tras cada vuelta; si retorna 1 se cancelan y coro_run
+// retorna 0.
+int coro_run(coro **v, int n, int (*interrupted)(void));
+
+// Termina las etapas v[lo..hi] que sigan vivas
+void coro_cancel(coro **v, int lo, int hi);
+
+#endif
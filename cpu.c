@@ -0,0 +1,395 @@
+// cpu.c: CPUID y variantes de memcpy, memset, memchr y CRC32C (ver cpu.h)
+//
+// Cada variante copia o busca igual que las demás; sólo cambia cuánto
+// avanza por instrucción. Las de SSE2 se compilan con target("sse2") para
+// que el resto del kernel siga siendo i686 genérico, y usan los vectores de
+// GCC en vez de <emmintrin.h>, que necesita la libc (mm_malloc.h).
+
+#include <stdint.h>
+#include "klib.h"
+#include "crc32c.h"
+#include "cpu.h"
+
+#define SMALL 64   // Por debajo, rep y SSE2 tardan más en arrancar que en copiar
+
+typedef uint32_t __attribute__((may_alias, aligned(1))) u32_any;
+typedef char __attribute__((vector_size(16), may_alias)) v16;              // Alineado: movdqa
+typedef char __attribute__((vector_size(16), may_alias, aligned(1))) v16u; // movdqu
+
+static cpu_info info;
+
+// =============================================================================
+// MEMCPY
+// =============================================================================
+// El compilador no debe convertir estos bucles en llamadas a memcpy/memset
+#define NO_LIBCALL __attribute__((optimize("no-tree-loop-distribute-patterns")))
+
+static NO_LIBCALL void *memcpy_byte(void *dest, const void *src, unsigned int n) {
+    uint8_t *d = dest;
+    const uint8_t *s = src;
+    for (unsigned int i = 0; i < n; i++) d[i] = s[i];
+    return dest;
+}
+
+// Palabras de 4 bytes y el resto de uno en uno, sin rep
+static inline NO_LIBCALL void copy_small(uint8_t *d, const uint8_t *s, unsigned int n) {
+    for (; n >= 4; d += 4, s += 4, n -= 4) *(u32_any *)d = *(const u32_any *)s;
+    while (n--) *d++ = *s++;
+}
+
+static void *memcpy_movsl(void *dest, const void *src, unsigned int n) {
+    if (n < SMALL) {
+        copy_small(dest, src, n);
+        return dest;
+    }
+    void *d = dest;
+    uintptr_t words = n >> 2, rest = n & 3;   // RCX entero en modo largo
+    asm volatile ("rep movsl\n\tmov %k3, %%ecx\n\trep movsb"
+                  : "+D"(d), "+S"(src), "+c"(words) : "r"(rest) : "memory");
+    return dest;
+}
+
+static void *memcpy_erms(void *dest, const void *src, unsigned int n) {
+    if (n < SMALL) {
+        copy_small(dest, src, n);
+        return dest;
+    }
+    void *d = dest;
+    uintptr_t count = n;
+    asm volatile ("rep movsb" : "+D"(d), "+S"(src), "+c"(count) : : "memory");
+    return dest;
+}
+
+// Con FSRM, rep movsb es rápido también con pocos bytes
+static void *memcpy_fsrm(void *dest, const void *src, unsigned int n) {
+    void *d = dest;
+    uintptr_t count = n;
+    asm volatile ("rep movsb" : "+D"(d), "+S"(src), "+c"(count) : : "memory");
+    return dest;
+}
+
+// 64 bytes por vuelta con el destino alineado a 16. La cabeza y la cola se
+// copian con un bloque de 16 que se solapa con lo ya copiado.
+__attribute__((target("sse2")))
+static void *memcpy_sse2(void *dest, const void *src, unsigned int n) {
+    uint8_t *d = dest;
+    const uint8_t *s = src;
+    if (n < SMALL) {
+        copy_small(d, s, n);
+        return dest;
+    }
+    v16u tail = *(const v16u *)(s + n - 16);
+    *(v16u *)d = *(const v16u *)s;
+    unsigned int skip = 16 - ((uintptr_t)d & 15);
+    d += skip;
+    s += skip;
+    n -= skip;
+    for (; n >= 64; d += 64, s += 64, n -= 64) {
+        v16 a = *(const v16u *)s, b = *(const v16u *)(s + 16);
+        v16 c = *(const v16u *)(s + 32), e = *(const v16u *)(s + 48);
+        *(v16 *)d = a;
+        *(v16 *)(d + 16) = b;
+        *(v16 *)(d + 32) = c;
+        *(v16 *)(d + 48) = e;
+    }
+    for (; n >= 16; d += 16, s += 16, n -= 16) *(v16 *)d = *(const v16u *)s;
+    *(v16u *)(d + n - 16) = tail;
+    return dest;
+}
+
+// =============================================================================
+// MEMSET
+// =============================================================================
+static NO_LIBCALL void *memset_byte(void *s, int c, unsigned int n) {
+    uint8_t *p = s;
+    for (unsigned int i = 0; i < n; i++) p[i] = (uint8_t)c;
+    return s;
+}
+
+static inline NO_LIBCALL void fill_small(uint8_t *p, uint32_t word, unsigned int n) {
+    for (; n >= 4; p += 4, n -= 4) *(u32_any *)p = word;
+    while (n--) *p++ = (uint8_t)word;
+}
+
+static void *memset_stosl(void *s, int c, unsigned int n) {
+    uint32_t word = (uint8_t)c * 0x01010101u;
+    if (n < SMALL) {
+        fill_small(s, word, n);
+        return s;
+    }
+    void *p = s;
+    uintptr_t words = n >> 2, rest = n & 3;
+    asm volatile ("rep stosl\n\tmov %k3, %%ecx\n\trep stosb"
+                  : "+D"(p), "+c"(words) : "a"(word), "r"(rest) : "memory");
+    return s;
+}
+
+static void *memset_erms(void *s, int c, unsigned int n) {
+    if (n < SMALL) {
+        fill_small(s, (uint8_t)c * 0x01010101u, n);
+        return s;
+    }
+    void *p = s;
+    uintptr_t count = n;
+    asm volatile ("rep stosb" : "+D"(p), "+c"(count) : "a"(c) : "memory");
+    return s;
+}
+
+__attribute__((target("sse2")))
+static void *memset_sse2(void *s, int c, unsigned int n) {
+    uint8_t *p = s;
+    if (n < SMALL) {
+        fill_small(p, (uint8_t)c * 0x01010101u, n);
+        return s;
+    }
+    v16 v = (v16){ 0 } + (char)c;
+    uint8_t *end = p + n;
+    *(v16u *)p = v;
+    p += 16 - ((uintptr_t)p & 15);
+    for (; end - p >= 64; p += 64) {
+        *(v16 *)p = v;
+        *(v16 *)(p + 16) = v;
+        *(v16 *)(p + 32) = v;
+        *(v16 *)(p + 48) = v;
+    }
+    for (; end - p >= 16; p += 16) *(v16 *)p = v;
+    *(v16u *)(end - 16) = v;
+    return s;
+}
+
+// =============================================================================
+// MEMCHR
+// =============================================================================
+static void *memchr_byte(const void *s, int c, unsigned int n) {
+    const uint8_t *p = s;
+    for (; n; p++, n--) {
+        if (*p == (uint8_t)c) return (void *)p;
+    }
+    return 0;
+}
+
+// Cuatro bytes por vuelta: tras el XOR, un byte igual a c queda a cero y
+// (x - 0x01..) & ~x marca su bit alto
+static void *memchr_swar(const void *s, int c, unsigned int n) {
+    const uint8_t *p = s;
+    uint32_t pattern = (uint8_t)c * 0x01010101u;
+    for (; n >= 4; p += 4, n -= 4) {
+        uint32_t x = *(const u32_any *)p ^ pattern;
+        if ((x - 0x01010101u) & ~x & 0x80808080u) break;
+    }
+    return memchr_byte(p, c, n);
+}
+
+// 64 bytes por vuelta: se comparan cuatro bloques (pcmpeqb) y se mira si
+// hay algún byte igual en su OR (pmovmskb)
+__attribute__((target("sse2")))
+static void *memchr_sse2(const void *s, int c, unsigned int n) {
+    const uint8_t *p = s;
+    v16 v = (v16){ 0 } + (char)c;
+    for (; n >= 64; p += 64, n -= 64) {
+        v16 a = *(const v16u *)p == v, b = *(const v16u *)(p + 16) == v;
+        v16 d = *(const v16u *)(p + 32) == v, e = *(const v16u *)(p + 48) == v;
+        if (__builtin_ia32_pmovmskb128((a | b) | (d | e))) break;
+    }
+    for (; n >= 16; p += 16, n -= 16) {
+        int mask = __builtin_ia32_pmovmskb128(*(const v16u *)p == v);
+        if (mask) return (void *)(p + __builtin_ctz(mask));
+    }
+    return memchr_byte(p, c, n);
+}
+
+// Hasta cpu_init(), lo que vale en cualquier i686
+void *(*memcpy_fn)(void *, const void *, unsigned int) = memcpy_movsl;
+void *(*memset_fn)(void *, int, unsigned int) = memset_stosl;
+void *(*memchr_fn)(const void *, int, unsigned int) = memchr_swar;
+
+// =============================================================================
+// TABLA DE VARIANTES
+// =============================================================================
+typedef struct {
+    const char *name;
+    uint32_t    needs;   // CPU_*
+    union {
+        void *(*copy)(void *, const void *, unsigned int);
+        void *(*fill)(void *, int, unsigned int);
+        void *(*find)(const void *, int, unsigned int);
+    } fn;
+} variant;
+
+enum { R_MEMCPY, R_MEMSET, R_MEMCHR, R_CRC32C, ROUTINES };
+
+static const variant memcpy_variants[] = {
+    { "bytes", 0,         { .copy = memcpy_byte } },
+    { "movsl", 0,         { .copy = memcpy_movsl } },
+    { "sse2",  CPU_SSE2,  { .copy = memcpy_sse2 } },
+    { "erms",  CPU_ERMS,  { .copy = memcpy_erms } },
+    { "fsrm",  CPU_FSRM,  { .copy = memcpy_fsrm } },
+    { 0, 0, { 0 } },
+};
+
+static const variant memset_variants[] = {
+    { "bytes", 0,         { .fill = memset_byte } },
+    { "stosl", 0,         { .fill = memset_stosl } },
+    { "sse2",  CPU_SSE2,  { .fill = memset_sse2 } },
+    { "erms",  CPU_ERMS,  { .fill = memset_erms } },
+    { 0, 0, { 0 } },
+};
+
+static const variant memchr_variants[] = {
+    { "bytes", 0,         { .find = memchr_byte } },
+    { "swar",  0,         { .find = memchr_swar } },
+    { "sse2",  CPU_SSE2,  { .find = memchr_sse2 } },
+    { 0, 0, { 0 } },
+};
+
+// El orden es el de crc32c_use_hw()
+static const variant crc32c_variants[] = {
+    { "slice-by-8", 0,         { 0 } },
+    { "sse4.2",     CPU_SSE42, { 0 } },
+    { 0, 0, { 0 } },
+};
+
+static const char *const routine_names[ROUTINES] = { "memcpy", "memset", "memchr", "crc32c" };
+static const variant *const variants[ROUTINES] = {
+    memcpy_variants, memset_variants, memchr_variants, crc32c_variants,
+};
+static int selected[ROUTINES] = { 1, 1, 1, 0 };
+
+static void install(int r, int v) {
+    const variant *x = &variants[r][v];
+    switch (r) {
+        case R_MEMCPY: memcpy_fn = x->fn.copy; break;
+        case R_MEMSET: memset_fn = x->fn.fill; break;
+        case R_MEMCHR: memchr_fn = x->fn.find; break;
+        case R_CRC32C: crc32c_use_hw(v); break;
+    }
+    selected[r] = v;
+}
+
+// =============================================================================
+// CPUID
+// =============================================================================
+static void cpuid(uint32_t leaf, uint32_t r[4]) {
+    asm volatile ("cpuid" : "=a"(r[0]), "=b"(r[1]), "=c"(r[2]), "=d"(r[3]) : "a"(leaf), "c"(0));
+}
+
+static void detect(void) {
+    uint32_t r[4];
+    cpuid(0, r);
+    uint32_t max = r[0];
+    memcpy(info.vendor, &r[1], 4);
+    memcpy(info.vendor + 4, &r[3], 4);
+    memcpy(info.vendor + 8, &r[2], 4);
+    info.vendor[12] = '\0';
+
+    cpuid(1, r);
+    uint32_t base_family = (r[0] >> 8) & 0xF, base_model = (r[0] >> 4) & 0xF;
+    info.stepping = r[0] & 0xF;
+    info.family = base_family == 0xF ? base_family + ((r[0] >> 20) & 0xFF) : base_family;
+    info.model = base_family == 6 || base_family == 0xF ? base_model | ((r[0] >> 12) & 0xF0) : base_model;
+    uint32_t f = 0;
+    if (r[3] & (1 << 4))  f |= CPU_TSC;
+    if (r[3] & (1 << 3))  f |= CPU_PSE;
+    // El Pentium Pro (familia 6, modelo < 3) anuncia SEP sin tenerlo
+    if ((r[3] & (1 << 11)) && !(base_family == 6 && base_model < 3)) f |= CPU_SEP;
+#ifdef __x86_64__
+    // En modo largo sólo Intel admite sysenter desde modo compatibilidad;
+    // AMD da #UD y los programas se quedan con int 0x80
+    if (strcmp(info.vendor, "GenuineIntel")) f &= ~CPU_SEP;
+#endif
+    if (r[3] & (1 << 24)) f |= CPU_FXSR;
+    if ((r[3] & (1 << 26)) && (r[3] & (1 << 24))) f |= CPU_SSE2;
+    if (r[2] & (1 << 20)) f |= CPU_SSE42;
+    if ((r[2] & (1 << 28)) && (r[2] & (1 << 26))) f |= CPU_AVX;   // AVX y XSAVE
+    if (r[3] & (1 << 9))  f |= CPU_APIC;
+    if ((r[3] & (1 << 9)) && (r[2] & (1 << 24))) f |= CPU_TSC_DEADLINE;
+    if (max >= 7) {
+        cpuid(7, r);
+        if (r[1] & (1 << 5)) f |= CPU_AVX2;
+        if (r[1] & (1 << 9)) f |= CPU_ERMS;
+        if (r[3] & (1 << 4)) f |= CPU_FSRM;
+    }
+
+    cpuid(0x80000000, r);
+    uint32_t ext = r[0];
+    info.brand[0] = '\0';
+    if (ext >= 0x80000004) {
+        for (uint32_t i = 0; i < 3; i++) {
+            cpuid(0x80000002 + i, r);
+            memcpy(info.brand + i * 16, r, 16);
+        }
+        info.brand[48] = '\0';
+        // Intel lo alinea a la derecha con espacios
+        uint32_t skip = 0, i = 0;
+        while (info.brand[skip] == ' ') skip++;
+        do info.brand[i] = info.brand[i + skip]; while (info.brand[i++]);
+    }
+    if (ext >= 0x80000007) {
+        cpuid(0x80000007, r);
+        if (r[3] & (1 << 8)) f |= CPU_INVARIANT_TSC;
+    }
+    info.features = f;
+}
+
+// CR0.EM a 0 y CR0.MP a 1 (las instrucciones SSE no se emulan);
+// CR4.OSFXSR y CR4.OSXMMEXCPT
+static void enable_sse(void) {
+    uintptr_t cr;
+    asm volatile ("mov %%cr0, %0" : "=r"(cr));
+    asm volatile ("mov %0, %%cr0" : : "r"((cr & ~(uintptr_t)(1 << 2)) | (1 << 1)));
+    asm volatile ("mov %%cr4, %0" : "=r"(cr));
+    asm volatile ("mov %0, %%cr4" : : "r"(cr | (1u << 9) | (1u << 10)));
+}
+
+void cpu_init(void) {
+    detect();
+    if (info.features & CPU_SSE2) enable_sse();
+    for (int r = 0; r < ROUTINES; r++) {
+        int best = 0;
+        for (int v = 0; variants[r][v].name; v++) {
+            if (cpu_variant_ok(r, v)) best = v;
+        }
+        install(r, best);
+    }
+}
+
+void cpu_get_info(cpu_info *ci) {
+    *ci = info;
+}
+
+int cpu_has(uint32_t features) {
+    return (info.features & features) == features;
+}
+
+int cpu_routines(void) {
+    return ROUTINES;
+}
+
+const char *cpu_routine(int r) {
+    return routine_names[r];
+}
+
+const char *cpu_variant(int r, int v) {
+    return variants[r][v].name;
+}
+
+int cpu_variant_ok(int r, int v) {
+    return cpu_has(variants[r][v].needs);
+}
+
+int cpu_selected(int r) {
+    return selected[r];
+}
+
+int cpu_use(const char *routine, const char *name) {
+    for (int r = 0; r < ROUTINES; r++) {
+        if (strcmp(routine_names[r], routine)) continue;
+        for (int v = 0; variants[r][v].name; v++) {
+            if (strcmp(variants[r][v].name, name)) continue;
+            if (!cpu_variant_ok(r, v)) return 0;
+            install(r, v);
+            return 1;
+        }
+    }
+    return 0;
+}
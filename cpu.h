@@ -0,0 +1,56 @@
+// cpu.h: lo que sabe hacer la CPU (CPUID) y elección de rutinas (cpu.c)
+//
+// cpu_init() lee CPUID una vez al arrancar y apunta memcpy, memset y memchr
+// (klib.h) a la mejor variante que la CPU admita; el CRC32C elige igual
+// entre la instrucción de SSE4.2 y las tablas. La misma imagen va así bien
+// en una CPU vieja y en una nueva. Hasta cpu_init() se usan variantes que
+// valen para cualquier i686.
+//
+// Las variantes SSE2 necesitan CR4.OSFXSR, que cpu_init() activa. Los
+// registros XMM no se guardan nunca: sólo los usan estas rutinas, ningún
+// manejador de interrupción las llama y los programas de usuario se
+// compilan sin SSE.
+#ifndef CPU_H
+#define CPU_H
+
+#include <stdint.h>
+
+#define CPU_TSC           (1 << 0)
+#define CPU_PSE           (1 << 1)    // Páginas de 4 MiB
+#define CPU_SEP           (1 << 2)    // sysenter/sysexit
+#define CPU_FXSR          (1 << 3)
+#define CPU_SSE2          (1 << 4)
+#define CPU_SSE42         (1 << 5)
+#define CPU_AVX           (1 << 6)    // La CPU lo tiene; el kernel no activa XSAVE
+#define CPU_AVX2          (1 << 7)
+#define CPU_ERMS          (1 << 8)    // rep movsb/stosb rápidos
+#define CPU_FSRM          (1 << 9)    // ... también con pocos bytes
+#define CPU_INVARIANT_TSC (1 << 10)   // Ritmo constante con cualquier frecuencia o estado
+#define CPU_APIC          (1 << 11)   // APIC local (timer.c)
+#define CPU_TSC_DEADLINE  (1 << 12)   // Su timer acepta un plazo absoluto del TSC
+
+typedef struct {
+    char     vendor[13];
+    char     brand[49];      // Vacío si la CPU no lo da
+    uint32_t family, model, stepping;
+    uint32_t features;       // CPU_*
+} cpu_info;
+
+void cpu_init(void);
+void cpu_get_info(cpu_info *ci);
+int  cpu_has(uint32_t features);   // 1 si tiene todas
+
+// Rutinas con varias variantes, ordenadas de la más sencilla a la mejor:
+// cpu_init() se queda con la última que la CPU admita. r va de 0 a
+// cpu_routines() - 1 y v de 0 hasta que cpu_variant() retorne NULL.
+int         cpu_routines(void);
+const char *cpu_routine(int r);
+const char *cpu_variant(int r, int v);
+int         cpu_variant_ok(int r, int v);
+int         cpu_selected(int r);
+
+// Fuerza una variante (para comparar con 'bench'). Retorna 0 si no existe
+// o la CPU no la admite.
+int cpu_use(const char *routine, const char *variant);
+
+#endif
@@ -0,0 +1,105 @@
+// crc32c.c: CRC32C por hardware o por tablas slice-by-8 (ver crc32c.h)
+//
+// Slice-by-8 procesa 8 bytes por vuelta con 8 tablas de 256 entradas: la
+// tabla k da el efecto de un byte seguido de k bytes a cero, así que los 8
+// bytes se combinan con un XOR en lugar de ir uno detrás de otro.
+
+#include <stdint.h>
+#include "crc32c.h"
+
+#define CRC32C_POLY 0x82F63B78   // Polinomio de Castagnoli, bits invertidos
+
+typedef uint32_t __attribute__((may_alias, aligned(1))) u32_any;
+typedef uint64_t __attribute__((may_alias, aligned(1))) u64_any;
+
+static uint32_t crc_table[8][256];
+static int      crc_mode = -1;   // -1 sin decidir, 0 tablas, 1 instrucción
+
+static int cpu_has_sse42(void) {
+#if defined(__i386__) || defined(__x86_64__)
+    uint32_t a = 1, b, c, d;
+    asm volatile ("cpuid" : "+a"(a), "=b"(b), "=c"(c), "=d"(d));
+    return (c >> 20) & 1;
+#else
+    return 0;
+#endif
+}
+
+static void crc_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = c & 1 ? (c >> 1) ^ CRC32C_POLY : c >> 1;
+        crc_table[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int s = 1; s < 8; s++) {
+            uint32_t prev = crc_table[s - 1][i];
+            crc_table[s][i] = (prev >> 8) ^ crc_table[0][prev & 0xFF];
+        }
+    }
+    crc_mode = cpu_has_sse42();
+}
+
+static uint32_t crc_soft(uint32_t crc, const uint8_t *p, uint32_t len) {
+    while (len && ((uintptr_t)p & 7)) {
+        crc = crc_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+        len--;
+    }
+    while (len >= 8) {
+        uint32_t lo = *(const u32_any *)p ^ crc;
+        uint32_t hi = *(const u32_any *)(p + 4);
+        crc = crc_table[7][lo & 0xFF] ^ crc_table[6][(lo >> 8) & 0xFF] ^
+              crc_table[5][(lo >> 16) & 0xFF] ^ crc_table[4][lo >> 24] ^
+              crc_table[3][hi & 0xFF] ^ crc_table[2][(hi >> 8) & 0xFF] ^
+              crc_table[1][(hi >> 16) & 0xFF] ^ crc_table[0][hi >> 24];
+        p += 8;
+        len -= 8;
+    }
+    while (len--) crc = crc_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+#if defined(__i386__) || defined(__x86_64__)
+// En 64 bits la instrucción admite 8 bytes de golpe; en 32, 4
+static uint32_t crc_hw(uint32_t crc, const uint8_t *p, uint32_t len) {
+    while (len && ((uintptr_t)p & 7)) {
+        asm ("crc32b %1, %0" : "+r"(crc) : "rm"(*p));
+        p++;
+        len--;
+    }
+#ifdef __x86_64__
+    uint64_t c64 = crc;
+    for (; len >= 8; p += 8, len -= 8) {
+        asm ("crc32q %1, %0" : "+r"(c64) : "rm"(*(const u64_any *)p));
+    }
+    crc = (uint32_t)c64;
+#endif
+    for (; len >= 4; p += 4, len -= 4) {
+        asm ("crc32l %1, %0" : "+r"(crc) : "rm"(*(const u32_any *)p));
+    }
+    while (len--) {
+        asm ("crc32b %1, %0" : "+r"(crc) : "rm"(*p));
+        p++;
+    }
+    return crc;
+}
+#endif
+
+uint32_t crc32c(uint32_t crc, const void *buf, uint32_t len) {
+    if (crc_mode < 0) crc_init();
+#if defined(__i386__) || defined(__x86_64__)
+    if (crc_mode) return ~crc_hw(~crc, buf, len);
+#endif
+    return ~crc_soft(~crc, buf, len);
+}
+
+int crc32c_use_hw(int hw) {
+    if (crc_mode < 0) crc_init();
+    crc_mode = hw && cpu_has_sse42();
+    return crc_mode;
+}
+
+const char *crc32c_impl(void) {
+    if (crc_mode < 0) crc_init();
+    return crc_mode ? "sse4.2" : "slice-by-8";
+}
@@ -0,0 +1,21 @@
+// crc32c.h: CRC32C (Castagnoli), por hardware o por tablas (crc32c.c)
+//
+// Con SSE4.2 se usa la instrucción crc32; sin ella, tablas slice-by-8 (8
+// bytes por vuelta). La elección se hace la primera vez, con CPUID, y da el
+// mismo resultado por los dos caminos.
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stdint.h>
+
+// CRC32C de 'len' bytes continuando desde 'crc' (0 para empezar)
+uint32_t crc32c(uint32_t crc, const void *buf, uint32_t len);
+
+// Elige el camino: hw = 1 pide la instrucción (si la CPU la tiene) y 0 las
+// tablas. Retorna 1 si queda en uso la instrucción.
+int crc32c_use_hw(int hw);
+
+// "sse4.2" o "slice-by-8"
+const char *crc32c_impl(void);
+
+#endif
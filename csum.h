@@ -0,0 +1,23 @@
+// csum.h: suma de comprobación de Internet (RFC 1071) (csum.c)
+//
+// La usan las cabeceras IPv4, ICMP y UDP. Se acumula por partes (la
+// pseudo-cabecera de UDP va aparte del datagrama) y al final se pliega.
+// Como el complemento a uno no depende del orden de los bytes, se suma en
+// el orden de la CPU y el resultado se guarda tal cual en la cabecera.
+#ifndef CSUM_H
+#define CSUM_H
+
+#include <stdint.h>
+
+// Suma 'len' bytes a 'sum' (0 para empezar). Todas las partes menos la
+// última deben tener longitud par.
+uint32_t csum_add(uint32_t sum, const void *buf, uint32_t len);
+
+// Pliega la suma a 16 bits y la complementa: lo que va en la cabecera
+static inline uint16_t csum_fold(uint32_t sum) {
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    return ~sum;
+}
+
+#endif
@@ -0,0 +1,349 @@
+// e1000.c: controlador de la Intel 82540EM (ver e1000.h)
+//
+// Registros y descriptores según el "PCI/PCI-X Family of Gigabit Ethernet
+// Controllers Software Developer's Manual" (8254x). Sólo se usa lo que
+// hace falta: descriptores clásicos, un marco por descriptor, sin
+// checksums por hardware ni VLANs.
+
+#include <stdint.h>
+#include "klib.h"
+#include "idt.h"
+#include "pci.h"
+#include "netbuf.h"
+#include "e1000.h"
+
+#define E1000_VENDOR 0x8086
+#define E1000_DEVICE 0x100E   // 82540EM
+
+// Registros (desplazamientos en la BAR0)
+#define REG_CTRL   0x0000
+#define REG_STATUS 0x0008
+#define REG_EERD   0x0014
+#define REG_MDIC   0x0020
+#define REG_ICR    0x00C0
+#define REG_ITR    0x00C4
+#define REG_IMS    0x00D0
+#define REG_IMC    0x00D8
+#define REG_RCTL   0x0100
+#define REG_TCTL   0x0400
+#define REG_TIPG   0x0410
+#define REG_RDBAL  0x2800
+#define REG_RDBAH  0x2804
+#define REG_RDLEN  0x2808
+#define REG_RDH    0x2810
+#define REG_RDT    0x2818
+#define REG_TDBAL  0x3800
+#define REG_TDBAH  0x3804
+#define REG_TDLEN  0x3808
+#define REG_TDH    0x3810
+#define REG_TDT    0x3818
+#define REG_MTA    0x5200   // 128 registros
+#define REG_RAL    0x5400
+#define REG_RAH    0x5404
+
+#define CTRL_ASDE  (1u << 5)    // Velocidad automática
+#define CTRL_SLU   (1u << 6)    // Subir el enlace
+#define CTRL_RST   (1u << 26)
+
+#define RCTL_EN    (1u << 1)
+#define RCTL_BAM   (1u << 15)   // Aceptar difusión
+#define RCTL_SECRC (1u << 26)   // Quitar el CRC del marco
+                                // BSIZE = 00: buffers de 2048 bytes
+
+#define TCTL_EN    (1u << 1)
+#define TCTL_PSP   (1u << 3)    // Rellenar los marcos cortos
+#define TCTL_CT    (0x10u << 4)
+#define TCTL_COLD  (0x40u << 12)
+#define TIPG_VALUE 0x0060200A   // IPGT 10, IPGR1 8, IPGR2 6 (manual, 13.4.34)
+
+#define ICR_TXDW   (1u << 0)
+#define ICR_LSC    (1u << 2)
+#define ICR_RXDMT0 (1u << 4)
+#define ICR_RXO    (1u << 6)
+#define ICR_RXT0   (1u << 7)
+
+#define MDIC_WRITE (1u << 26)
+#define MDIC_READ  (2u << 26)
+#define MDIC_READY (1u << 28)
+#define MDIC_ERROR (1u << 30)
+#define MDIC_PHY   (1u << 21)   // El PHY interno está en la dirección 1
+#define PHY_BMCR   0
+#define BMCR_LOOPBACK (1u << 14)
+
+#define DESC_DD    0x01         // status: la tarjeta terminó con él
+#define DESC_EOP   0x02         // status (rx) y cmd (tx): último del marco
+#define TXCMD_IFCS 0x02         // Añadir el CRC
+#define TXCMD_RS   0x08         // Informar en status al terminar
+
+typedef struct __attribute__((packed)) {
+    uint64_t addr;
+    uint16_t len, csum;
+    uint8_t  status, errors;
+    uint16_t special;
+} rx_desc;
+
+typedef struct __attribute__((packed)) {
+    uint64_t addr;
+    uint16_t len;
+    uint8_t  cso, cmd, status, css;
+    uint16_t special;
+} tx_desc;
+
+// Cada anillo ocupa un múltiplo de 128 bytes, como exige RDLEN/TDLEN
+static rx_desc  rx_ring[E1000_RX_DESCS] __attribute__((aligned(128)));
+static tx_desc  tx_ring[E1000_TX_DESCS] __attribute__((aligned(128)));
+static netbuf  *rx_bufs[E1000_RX_DESCS];
+static netbuf  *tx_bufs[E1000_TX_DESCS];
+
+static volatile uint32_t *regs;
+static int      irq_line = -1;
+static uint8_t  mac[6];
+static uint32_t rx_next;      // Siguiente descriptor que llenará la tarjeta
+static uint32_t tx_tail;      // Siguiente libre; los de antes hasta TDT ya son de la tarjeta
+static uint32_t tx_clean;     // El más antiguo sin recoger
+static uint32_t tx_queued;    // Encolados desde el último aviso
+static e1000_stats stats;
+
+static inline uint32_t reg_read(uint32_t reg) { return regs[reg / 4]; }
+static inline void reg_write(uint32_t reg, uint32_t v) { regs[reg / 4] = v; }
+
+// Los descriptores se escriben antes de avisar y se leen después de ver DD.
+// En x86 el orden de la memoria basta; sólo hay que impedir que el
+// compilador lo cambie.
+static inline void barrier(void) { asm volatile ("" ::: "memory"); }
+
+// =============================================================================
+// PHY Y DIRECCIÓN MAC
+// =============================================================================
+static int mdic_wait(uint32_t *v) {
+    for (int i = 0; i < 100000; i++) {
+        *v = reg_read(REG_MDIC);
+        if (*v & MDIC_READY) return !(*v & MDIC_ERROR);
+    }
+    return 0;
+}
+
+static int phy_read(uint32_t reg, uint16_t *val) {
+    uint32_t v;
+    reg_write(REG_MDIC, (reg << 16) | MDIC_PHY | MDIC_READ);
+    if (!mdic_wait(&v)) return 0;
+    *val = v & 0xFFFF;
+    return 1;
+}
+
+static int phy_write(uint32_t reg, uint16_t val) {
+    uint32_t v;
+    reg_write(REG_MDIC, val | (reg << 16) | MDIC_PHY | MDIC_WRITE);
+    return mdic_wait(&v);
+}
+
+void e1000_loopback(int on) {
+    uint16_t bmcr;
+    if (!regs || !phy_read(PHY_BMCR, &bmcr)) return;
+    phy_write(PHY_BMCR, on ? bmcr | BMCR_LOOPBACK : bmcr & ~BMCR_LOOPBACK);
+}
+
+// La BIOS (o QEMU) suele dejarla ya en RAL/RAH; si no, se lee de la EEPROM
+static void read_mac(void) {
+    uint32_t ral = reg_read(REG_RAL), rah = reg_read(REG_RAH);
+    if (rah & 0x80000000) {
+        for (int i = 0; i < 4; i++) mac[i] = ral >> (8 * i);
+        mac[4] = rah;
+        mac[5] = rah >> 8;
+        return;
+    }
+    for (int w = 0; w < 3; w++) {
+        reg_write(REG_EERD, (w << 8) | 1);
+        uint32_t v;
+        for (int i = 0; i < 100000 && !((v = reg_read(REG_EERD)) & 0x10); i++);
+        mac[2 * w] = v >> 16;
+        mac[2 * w + 1] = v >> 24;
+    }
+    reg_write(REG_RAL, mac[0] | mac[1] << 8 | mac[2] << 16 | (uint32_t)mac[3] << 24);
+    reg_write(REG_RAH, mac[4] | mac[5] << 8 | 0x80000000);
+}
+
+// =============================================================================
+// INICIALIZACIÓN
+// =============================================================================
+// Leer ICR reconoce la interrupción y baja la línea. No se toca ningún
+// anillo: eso lo hace e1000_poll() fuera de la IRQ.
+static void e1000_irq(interrupt_frame *frame) {
+    (void)frame;
+    reg_read(REG_ICR);
+    stats.irqs++;
+}
+
+static int rx_init(void) {
+    for (uint32_t i = 0; i < E1000_RX_DESCS; i++) {
+        netbuf *b = netbuf_alloc();
+        if (!b) return 0;
+        rx_bufs[i] = b;
+        rx_ring[i].addr = (uintptr_t)b->data;
+        rx_ring[i].status = 0;
+    }
+    rx_next = 0;
+    reg_write(REG_RDBAL, (uint32_t)(uintptr_t)rx_ring);
+    reg_write(REG_RDBAH, 0);
+    reg_write(REG_RDLEN, sizeof(rx_ring));
+    reg_write(REG_RDH, 0);
+    reg_write(REG_RDT, E1000_RX_DESCS - 1);   // Uno se reserva: RDT == RDH es "vacío"
+    reg_write(REG_RCTL, RCTL_EN | RCTL_BAM | RCTL_SECRC);
+    return 1;
+}
+
+static void tx_init(void) {
+    memset(tx_ring, 0, sizeof(tx_ring));
+    tx_tail = tx_clean = tx_queued = 0;
+    reg_write(REG_TDBAL, (uint32_t)(uintptr_t)tx_ring);
+    reg_write(REG_TDBAH, 0);
+    reg_write(REG_TDLEN, sizeof(tx_ring));
+    reg_write(REG_TDH, 0);
+    reg_write(REG_TDT, 0);
+    reg_write(REG_TIPG, TIPG_VALUE);
+    reg_write(REG_TCTL, TCTL_EN | TCTL_PSP | TCTL_CT | TCTL_COLD);
+}
+
+int e1000_init(void) {
+    pci_device dev;
+    if (!pci_find(E1000_VENDOR, E1000_DEVICE, &dev)) return 0;
+    pci_enable(&dev);
+    regs = (volatile uint32_t *)(uintptr_t)(pci_read(&dev, PCI_BAR0) & ~0xFu);
+
+    reg_write(REG_IMC, 0xFFFFFFFF);
+    reg_write(REG_CTRL, reg_read(REG_CTRL) | CTRL_RST);
+    for (int i = 0; i < 100000 && (reg_read(REG_CTRL) & CTRL_RST); i++);
+    reg_write(REG_IMC, 0xFFFFFFFF);
+    reg_read(REG_ICR);
+    reg_write(REG_CTRL, reg_read(REG_CTRL) | CTRL_SLU | CTRL_ASDE);
+
+    read_mac();
+    for (int i = 0; i < 128; i++) reg_write(REG_MTA + 4 * i, 0);
+    if (!rx_init()) {
+        regs = 0;
+        return 0;
+    }
+    tx_init();
+
+    // ITR va en unidades de 256 ns: el intervalo mínimo entre interrupciones
+    reg_write(REG_ITR, 1000000000u / 256 / E1000_IRQ_HZ);
+    irq_line = pci_read(&dev, PCI_IRQ_LINE) & 0xFF;
+    if (irq_line < 16) {
+        irq_install(irq_line, e1000_irq);
+        reg_write(REG_IMS, ICR_RXT0 | ICR_RXO | ICR_RXDMT0 | ICR_TXDW | ICR_LSC);
+    } else {
+        irq_line = -1;   // Sin IRQ asignada: sólo sondeo
+    }
+    return 1;
+}
+
+int e1000_present(void) {
+    return regs != 0;
+}
+
+const uint8_t *e1000_mac(void) {
+    return mac;
+}
+
+int e1000_irq_line(void) {
+    return irq_line;
+}
+
+// =============================================================================
+// ENVÍO Y RECEPCIÓN
+// =============================================================================
+// Libera los netbufs de los descriptores que la tarjeta ya mandó
+static void tx_reclaim(void) {
+    while (tx_clean != tx_tail && (tx_ring[tx_clean].status & DESC_DD)) {
+        barrier();
+        stats.tx_packets++;
+        stats.tx_bytes += tx_ring[tx_clean].len;
+        netbuf_free(tx_bufs[tx_clean]);
+        tx_bufs[tx_clean] = 0;
+        tx_clean = (tx_clean + 1) % E1000_TX_DESCS;
+    }
+}
+
+int e1000_send(netbuf *b) {
+    if (!regs) return 0;
+    uint32_t next = (tx_tail + 1) % E1000_TX_DESCS;
+    if (next == tx_clean) {
+        tx_reclaim();
+        if (next == tx_clean) {
+            // Lo encolado sin avisar no va a salir solo
+            e1000_flush();
+            stats.tx_full++;
+            return 0;
+        }
+    }
+    tx_desc *d = &tx_ring[tx_tail];
+    d->addr = (uintptr_t)netbuf_payload(b);
+    d->len = b->len;
+    d->cmd = DESC_EOP | TXCMD_IFCS | TXCMD_RS;
+    d->status = 0;
+    tx_bufs[tx_tail] = b;
+    tx_tail = next;
+    tx_queued++;
+    return 1;
+}
+
+void e1000_flush(void) {
+    if (!tx_queued) return;
+    barrier();
+    reg_write(REG_TDT, tx_tail);
+    stats.tx_doorbells++;
+    tx_queued = 0;
+}
+
+uint32_t e1000_tx_pending(void) {
+    if (!regs) return 0;
+    tx_reclaim();
+    return (tx_tail + E1000_TX_DESCS - tx_clean) % E1000_TX_DESCS;
+}
+
+int e1000_poll(void (*rx)(netbuf *b), int budget) {
+    if (!regs) return 0;
+    int delivered = 0, used = 0;
+    while (delivered < budget) {
+        rx_desc *d = &rx_ring[rx_next];
+        if (!(d->status & DESC_DD)) break;
+        barrier();
+        // El descriptor se queda con un netbuf nuevo y el lleno sube tal cual
+        netbuf *fresh = netbuf_alloc();
+        if (!fresh) {
+            stats.rx_nobuf++;
+            break;
+        }
+        netbuf *b = rx_bufs[rx_next];
+        int ok = (d->status & DESC_EOP) && !d->errors;
+        b->off = 0;
+        b->len = d->len;
+        if (!ok) {
+            stats.rx_errors++;
+            netbuf_free(fresh);
+            fresh = b;
+        }
+        rx_bufs[rx_next] = fresh;
+        d->addr = (uintptr_t)fresh->data;
+        d->status = 0;
+        rx_next = (rx_next + 1) % E1000_RX_DESCS;
+        used++;
+        if (ok) {
+            stats.rx_packets++;
+            stats.rx_bytes += b->len;
+            delivered++;
+            rx(b);
+        }
+    }
+    if (used) {
+        barrier();
+        reg_write(REG_RDT, (rx_next + E1000_RX_DESCS - 1) % E1000_RX_DESCS);
+        stats.rx_doorbells++;
+    }
+    tx_reclaim();
+    return delivered;
+}
+
+void e1000_get_stats(e1000_stats *st) {
+    *st = stats;
+}
@@ -0,0 +1,58 @@
+// e1000.h: controlador de la Intel 82540EM (e1000.c), la de QEMU -device e1000
+//
+// Dos anillos de descriptores reservados al arrancar, uno para recibir y
+// otro para enviar, que apuntan a netbufs: los paquetes no se copian al
+// pasar entre la tarjeta y las capas de arriba. Para no pagar un acceso a
+// sus registros (una salida de la máquina virtual en QEMU) por paquete:
+// - e1000_send() sólo encola; e1000_flush() avisa a la tarjeta de todo el
+//   lote con una escritura en TDT
+// - e1000_poll() procesa todo lo recibido y devuelve los descriptores con
+//   una escritura en RDT
+// - las interrupciones pasan por la moderación de la tarjeta (ITR): como
+//   mucho E1000_IRQ_HZ por segundo, por muchos paquetes que lleguen
+// Nada de esto lo usa la IRQ, que sólo cuenta y reconoce: los paquetes se
+// procesan cuando el kernel llama a e1000_poll().
+#ifndef E1000_H
+#define E1000_H
+
+#include <stdint.h>
+#include "netbuf.h"
+
+#define E1000_RX_DESCS 32
+#define E1000_TX_DESCS 32
+#define E1000_IRQ_HZ   8000
+
+typedef struct {
+    uint32_t rx_packets, rx_bytes, rx_errors, rx_nobuf;   // nobuf: no había netbuf para reponer
+    uint32_t tx_packets, tx_bytes, tx_full;               // full: el anillo estaba lleno
+    uint32_t rx_doorbells, tx_doorbells;                  // Escrituras en RDT y TDT
+    uint32_t irqs;
+} e1000_stats;
+
+// Busca la tarjeta en el bus PCI y la deja lista para recibir. Retorna 0
+// si no hay.
+int  e1000_init(void);
+int  e1000_present(void);
+const uint8_t *e1000_mac(void);
+int  e1000_irq_line(void);
+
+// Encola el marco de 'b' (len bytes desde off) para enviarlo; la tarjeta se
+// queda con su referencia y la suelta al terminar. Retorna 0 si el anillo
+// está lleno: 'b' sigue siendo de quien llama.
+int  e1000_send(netbuf *b);
+void e1000_flush(void);
+
+// Paquetes enviados a la tarjeta que aún no ha terminado de mandar
+uint32_t e1000_tx_pending(void);
+
+// Entrega a 'rx' hasta 'budget' paquetes recibidos; 'rx' se queda con el
+// netbuf y debe liberarlo. Retorna cuántos entregó.
+int  e1000_poll(void (*rx)(netbuf *b), int budget);
+
+// Bucle local: lo enviado vuelve como recibido sin salir de la tarjeta
+// (bit de loopback del PHY, el que emula QEMU)
+void e1000_loopback(int on);
+
+void e1000_get_stats(e1000_stats *st);
+
+#endif
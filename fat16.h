@@ -0,0 +1,136 @@
+// fat16.h: formato en disco del sistema de archivos FAT16 simplificado
+//
+// Lo comparten el kernel (fs.c) y las herramientas del host
+// (tools/mkdisk.c), de modo que una imagen generada en el host tenga
+// exactamente la geometría que el kernel espera.
+//
+// Estructura: [Boot Sector][FAT][Root Directory][Data Area]
+// - Boot Sector: 1 sector con el BPB (BIOS Parameter Block)
+// - FAT: una entrada de 16 bits por cluster, con el tamaño justo
+// - Root Directory: entradas de archivos en el directorio raíz (512 entradas)
+// - Data Area: contenido real de los archivos (1 sector por cluster)
+//
+// Toda la geometría se deriva de un único valor, DISK_SECTORS, que se fija
+// al compilar (make DISK_SECTORS=...). boot.s reserva ese mismo tamaño.
+#ifndef FAT16_H
+#define FAT16_H
+
+#include <stdint.h>
+
+#ifndef DISK_SECTORS
+#define DISK_SECTORS   2048   // 1 MiB por defecto
+#endif
+
+#define SECTOR_SIZE    512
+#define ROOT_ENTRIES   512
+#define DIR_ENTRY_SIZE 32
+
+#define RESERVED_SECTORS 1
+#define ROOT_SECTORS   (ROOT_ENTRIES * DIR_ENTRY_SIZE / SECTOR_SIZE)
+
+// La FAT necesita 2 bytes por cluster de datos más las 2 entradas
+// reservadas. Con M sectores para FAT + datos, el mínimo F que cumple
+// (M - F + 2) * 2 <= F * SECTOR_SIZE es ceil(2 * (M + 2) / (SECTOR_SIZE + 2)).
+#define FAT_DATA_SECTORS (DISK_SECTORS - RESERVED_SECTORS - ROOT_SECTORS)
+#define FAT_SECTORS    ((2 * (FAT_DATA_SECTORS + 2) + SECTOR_SIZE + 1) / (SECTOR_SIZE + 2))
+
+// Primer sector de cada región
+#define FAT_SECTOR     RESERVED_SECTORS
+#define ROOT_SECTOR    (FAT_SECTOR + FAT_SECTORS)
+#define DATA_SECTOR    (ROOT_SECTOR + ROOT_SECTORS)
+#define DATA_START     (DATA_SECTOR * SECTOR_SIZE)
+
+// Clusters de datos (numerados desde 2). En FAT16 los valores >= 0xFFF0
+// están reservados, así que no puede haber más de 0xFFF0 - 2 clusters.
+#define DATA_CLUSTERS_RAW (DISK_SECTORS - DATA_SECTOR)
+#define DATA_CLUSTERS  (DATA_CLUSTERS_RAW < 0xFFF0 - 2 ? DATA_CLUSTERS_RAW : 0xFFF0 - 2)
+#define CLUSTER_LIMIT  (2 + DATA_CLUSTERS)   // Primer cluster fuera del disco
+
+#define FAT16_MEDIA    0xF8   // Descriptor de medio "disco fijo"
+
+#if DISK_SECTORS <= RESERVED_SECTORS + ROOT_SECTORS + 2
+#error "DISK_SECTORS demasiado pequeno para la FAT y el directorio raiz"
+#endif
+
+typedef struct __attribute__((packed)) {
+    char     name[11];
+    uint8_t  attr;
+    uint8_t  reserved[10];
+    uint16_t time;           // Hora de última modificación
+    uint16_t date;           // Fecha de última modificación
+    uint16_t first_cluster;
+    uint32_t size;
+} fat16_dir_entry;
+
+// Bits de 'attr'. Un subdirectorio es una cadena de clusters con entradas
+// como las del raíz, empezando por "." y ".." (cluster 0 = el raíz).
+#define FAT_ATTR_DIRECTORY 0x10
+
+// Bits de reserved[0], que FAT16 no usa. Un archivo comprimido guarda su
+// contenido en bloques de FAT_COMP_BLOCK bytes comprimidos por separado
+// (formato de lz.h); su cadena empieza con una tabla de uint32_t con el
+// final de cada bloque, contado desde el final de la tabla, y sigue con los
+// bloques uno detrás de otro. Un bloque que no se reduce se guarda tal
+// cual. 'size' es siempre el tamaño sin comprimir.
+#define FAT_FLAG_COMPRESSED 0x01
+#define FAT_COMP_BLOCK      4096
+
+_Static_assert(sizeof(fat16_dir_entry) == DIR_ENTRY_SIZE, "entrada de directorio de 32 bytes");
+
+// BIOS Parameter Block: primeros 62 bytes del sector 0
+typedef struct __attribute__((packed)) {
+    uint8_t  jump[3];             // EB xx 90
+    char     oem[8];
+    uint16_t bytes_per_sector;
+    uint8_t  sectors_per_cluster;
+    uint16_t reserved_sectors;    // Sectores antes de la FAT (el boot sector)
+    uint8_t  num_fats;
+    uint16_t root_entries;
+    uint16_t total_sectors16;     // 0 si no cabe en 16 bits
+    uint8_t  media;
+    uint16_t sectors_per_fat;
+    uint16_t sectors_per_track;
+    uint16_t num_heads;
+    uint32_t hidden_sectors;
+    uint32_t total_sectors32;
+    uint8_t  drive_number;
+    uint8_t  reserved1;
+    uint8_t  boot_signature;      // 0x29: los tres campos siguientes son válidos
+    uint32_t volume_id;
+    char     volume_label[11];
+    char     fs_type[8];          // "FAT16   "
+} fat16_bpb;
+
+// Da formato a una imagen cuyos metadatos (DATA_START bytes) ya están a
+// cero: boot sector con el BPB de esta geometría y entradas reservadas de
+// la FAT. El directorio raíz vacío es simplemente todo ceros.
+static inline void fat16_format(uint8_t *image) {
+    fat16_bpb *bpb = (fat16_bpb *)image;
+    bpb->jump[0] = 0xEB; bpb->jump[1] = 0x3C; bpb->jump[2] = 0x90;
+    memcpy(bpb->oem, "R2OS    ", 8);
+    bpb->bytes_per_sector = SECTOR_SIZE;
+    bpb->sectors_per_cluster = 1;
+    bpb->reserved_sectors = RESERVED_SECTORS;
+    bpb->num_fats = 1;
+    bpb->root_entries = ROOT_ENTRIES;
+    bpb->total_sectors16 = DISK_SECTORS < 0x10000 ? DISK_SECTORS : 0;
+    bpb->media = FAT16_MEDIA;
+    bpb->sectors_per_fat = FAT_SECTORS;
+    bpb->sectors_per_track = 63;
+    bpb->num_heads = 16;
+    bpb->total_sectors32 = DISK_SECTORS < 0x10000 ? 0 : DISK_SECTORS;
+    bpb->drive_number = 0x80;
+    bpb->boot_signature = 0x29;
+    bpb->volume_id = 0x52324F53;  // "R2OS"
+    memcpy(bpb->volume_label, "R2OS DISK  ", 11);
+    memcpy(bpb->fs_type, "FAT16   ", 8);
+    image[510] = 0x55;
+    image[511] = 0xAA;
+
+    // Entradas reservadas de la FAT: cluster 0 = medio, cluster 1 = fin
+    uint8_t *fat = image + FAT_SECTOR * SECTOR_SIZE;
+    fat[0] = FAT16_MEDIA; fat[1] = 0xFF;
+    fat[2] = 0xFF;        fat[3] = 0xFF;
+}
+
+#endif
@@ -0,0 +1,508 @@
+// fbcon.c: consola de texto sobre un framebuffer lineal (ver fbcon.h)
+//
+// Lo que mantiene bajo el coste de pintar:
+// - Caché de glifos: para cada color (atributo) en uso se guardan los 256
+//   patrones posibles de una fila de 8 píxeles ya convertidos a 32 bits por
+//   píxel. Dibujar una celda es copiar 16 filas de 32 bytes con palabras de
+//   32 bits, sin mirar bits ni colores.
+// - Zonas sucias: cada fila de texto guarda el tramo de columnas que cambió
+//   desde el último fbcon_flush(), y sólo se pinta eso.
+// - Desplazamiento: en la VGA de Bochs la pantalla es una ventana sobre una
+//   zona más alta (VIRT_HEIGHT); subir el texto es mover el origen de la
+//   ventana (Y_OFFSET) sin copiar nada, y sólo al llegar al final de la
+//   zona se vuelve arriba repintando. Con el framebuffer del cargador se
+//   copia de una vez lo que sigue visible, por muchas líneas que se hayan
+//   acumulado.
+
+#include <stdint.h>
+#include "klib.h"
+#include "io.h"
+#include "pci.h"
+#include "fbcon.h"
+
+#define COLOR_SLOTS 4           // Atributos con sus filas en la caché
+
+// VGA de Bochs: registros VBE_DISPI, índice y dato por puertos
+#define BGA_VENDOR      0x1234
+#define BGA_DEVICE      0x1111
+#define BGA_INDEX       0x01CE
+#define BGA_DATA        0x01CF
+#define BGA_ID          0
+#define BGA_XRES        1
+#define BGA_YRES        2
+#define BGA_BPP         3
+#define BGA_ENABLE      4
+#define BGA_VIRT_WIDTH  6
+#define BGA_VIRT_HEIGHT 7
+#define BGA_X_OFFSET    8
+#define BGA_Y_OFFSET    9
+#define BGA_MEMORY_64K  10
+#define BGA_ID_MIN      0xB0C2  // 32 bits por píxel y framebuffer lineal
+#define BGA_ENABLED     0x01
+#define BGA_LFB         0x40
+
+typedef struct {
+    int      attr;              // -1: libre
+    uint32_t stamp;             // Último uso
+    uint32_t row[256][FBCON_FONT_W];
+} color_slot;
+
+static int         active;
+static const char *source = "";
+static uint8_t    *fb;          // Primera línea de la zona (no de la ventana)
+static uint32_t    pitch, width, height;
+static uint32_t    cols, rows;
+static uint16_t    cells[FBCON_MAX_COLS * FBCON_MAX_ROWS];
+static uint16_t    dirty_lo[FBCON_MAX_ROWS], dirty_hi[FBCON_MAX_ROWS];   // [lo, hi); hi 0: limpia
+static int         pending;     // Algo que pintar en el próximo fbcon_flush()
+static uint32_t    scroll_pending;
+static uint32_t    cur_x, cur_y;
+static int         cursor_shown;
+static uint32_t    shown_x, shown_y;
+static int         pan;         // Desplazar con Y_OFFSET
+static uint32_t    y_origin, virt_height;
+static uint32_t    palette[16];
+static color_slot  slots[COLOR_SLOTS];
+static uint32_t    slot_clock;
+static uint8_t     font[256][FBCON_FONT_H];   // Bit 7: columna izquierda
+static int         font_loaded;
+static fbcon_stats stats;
+
+// Los 16 colores del modo texto
+static const uint8_t vga_rgb[16][3] = {
+    { 0x00, 0x00, 0x00 }, { 0x00, 0x00, 0xAA }, { 0x00, 0xAA, 0x00 }, { 0x00, 0xAA, 0xAA },
+    { 0xAA, 0x00, 0x00 }, { 0xAA, 0x00, 0xAA }, { 0xAA, 0x55, 0x00 }, { 0xAA, 0xAA, 0xAA },
+    { 0x55, 0x55, 0x55 }, { 0x55, 0x55, 0xFF }, { 0x55, 0xFF, 0x55 }, { 0x55, 0xFF, 0xFF },
+    { 0xFF, 0x55, 0x55 }, { 0xFF, 0x55, 0xFF }, { 0xFF, 0xFF, 0x55 }, { 0xFF, 0xFF, 0xFF },
+};
+
+// Fuente de reserva de 8x8 para ' '..'~' (bit 0: columna izquierda), la
+// del PC original; se dibuja con cada fila doble. Sólo se usa si no se pudo
+// copiar la de la VGA, como cuando el cargador ya dejó un modo gráfico.
+static const uint8_t font8x8[95][8] = {
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // ' '
+    { 0x18, 0x3C, 0x3C, 0x18, 0x18, 0x00, 0x18, 0x00 },   // !
+    { 0x36, 0x36, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // "
+    { 0x36, 0x36, 0x7F, 0x36, 0x7F, 0x36, 0x36, 0x00 },   // #
+    { 0x0C, 0x3E, 0x03, 0x1E, 0x30, 0x1F, 0x0C, 0x00 },   // $
+    { 0x00, 0x63, 0x33, 0x18, 0x0C, 0x66, 0x63, 0x00 },   // %
+    { 0x1C, 0x36, 0x1C, 0x6E, 0x3B, 0x33, 0x6E, 0x00 },   // &
+    { 0x06, 0x06, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00 },   // '
+    { 0x18, 0x0C, 0x06, 0x06, 0x06, 0x0C, 0x18, 0x00 },   // (
+    { 0x06, 0x0C, 0x18, 0x18, 0x18, 0x0C, 0x06, 0x00 },   // )
+    { 0x00, 0x66, 0x3C, 0xFF, 0x3C, 0x66, 0x00, 0x00 },   // *
+    { 0x00, 0x0C, 0x0C, 0x3F, 0x0C, 0x0C, 0x00, 0x00 },   // +
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x06 },   // ,
+    { 0x00, 0x00, 0x00, 0x3F, 0x00, 0x00, 0x00, 0x00 },   // -
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x00 },   // .
+    { 0x60, 0x30, 0x18, 0x0C, 0x06, 0x03, 0x01, 0x00 },   // /
+    { 0x3E, 0x63, 0x73, 0x7B, 0x6F, 0x67, 0x3E, 0x00 },   // 0
+    { 0x0C, 0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x3F, 0x00 },   // 1
+    { 0x1E, 0x33, 0x30, 0x1C, 0x06, 0x33, 0x3F, 0x00 },   // 2
+    { 0x1E, 0x33, 0x30, 0x1C, 0x30, 0x33, 0x1E, 0x00 },   // 3
+    { 0x38, 0x3C, 0x36, 0x33, 0x7F, 0x30, 0x78, 0x00 },   // 4
+    { 0x3F, 0x03, 0x1F, 0x30, 0x30, 0x33, 0x1E, 0x00 },   // 5
+    { 0x1C, 0x06, 0x03, 0x1F, 0x33, 0x33, 0x1E, 0x00 },   // 6
+    { 0x3F, 0x33, 0x30, 0x18, 0x0C, 0x0C, 0x0C, 0x00 },   // 7
+    { 0x1E, 0x33, 0x33, 0x1E, 0x33, 0x33, 0x1E, 0x00 },   // 8
+    { 0x1E, 0x33, 0x33, 0x3E, 0x30, 0x18, 0x0E, 0x00 },   // 9
+    { 0x00, 0x0C, 0x0C, 0x00, 0x00, 0x0C, 0x0C, 0x00 },   // :
+    { 0x00, 0x0C, 0x0C, 0x00, 0x00, 0x0C, 0x0C, 0x06 },   // ;
+    { 0x18, 0x0C, 0x06, 0x03, 0x06, 0x0C, 0x18, 0x00 },   // <
+    { 0x00, 0x00, 0x3F, 0x00, 0x00, 0x3F, 0x00, 0x00 },   // =
+    { 0x06, 0x0C, 0x18, 0x30, 0x18, 0x0C, 0x06, 0x00 },   // >
+    { 0x1E, 0x33, 0x30, 0x18, 0x0C, 0x00, 0x0C, 0x00 },   // ?
+    { 0x3E, 0x63, 0x7B, 0x7B, 0x7B, 0x03, 0x1E, 0x00 },   // @
+    { 0x0C, 0x1E, 0x33, 0x33, 0x3F, 0x33, 0x33, 0x00 },   // A
+    { 0x3F, 0x66, 0x66, 0x3E, 0x66, 0x66, 0x3F, 0x00 },   // B
+    { 0x3C, 0x66, 0x03, 0x03, 0x03, 0x66, 0x3C, 0x00 },   // C
+    { 0x1F, 0x36, 0x66, 0x66, 0x66, 0x36, 0x1F, 0x00 },   // D
+    { 0x7F, 0x46, 0x16, 0x1E, 0x16, 0x46, 0x7F, 0x00 },   // E
+    { 0x7F, 0x46, 0x16, 0x1E, 0x16, 0x06, 0x0F, 0x00 },   // F
+    { 0x3C, 0x66, 0x03, 0x03, 0x73, 0x66, 0x7C, 0x00 },   // G
+    { 0x33, 0x33, 0x33, 0x3F, 0x33, 0x33, 0x33, 0x00 },   // H
+    { 0x1E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00 },   // I
+    { 0x78, 0x30, 0x30, 0x30, 0x33, 0x33, 0x1E, 0x00 },   // J
+    { 0x67, 0x66, 0x36, 0x1E, 0x36, 0x66, 0x67, 0x00 },   // K
+    { 0x0F, 0x06, 0x06, 0x06, 0x46, 0x66, 0x7F, 0x00 },   // L
+    { 0x63, 0x77, 0x7F, 0x7F, 0x6B, 0x63, 0x63, 0x00 },   // M
+    { 0x63, 0x67, 0x6F, 0x7B, 0x73, 0x63, 0x63, 0x00 },   // N
+    { 0x1C, 0x36, 0x63, 0x63, 0x63, 0x36, 0x1C, 0x00 },   // O
+    { 0x3F, 0x66, 0x66, 0x3E, 0x06, 0x06, 0x0F, 0x00 },   // P
+    { 0x1E, 0x33, 0x33, 0x33, 0x3B, 0x1E, 0x38, 0x00 },   // Q
+    { 0x3F, 0x66, 0x66, 0x3E, 0x36, 0x66, 0x67, 0x00 },   // R
+    { 0x1E, 0x33, 0x07, 0x0E, 0x38, 0x33, 0x1E, 0x00 },   // S
+    { 0x3F, 0x2D, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00 },   // T
+    { 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x3F, 0x00 },   // U
+    { 0x33, 0x33, 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x00 },   // V
+    { 0x63, 0x63, 0x63, 0x6B, 0x7F, 0x77, 0x63, 0x00 },   // W
+    { 0x63, 0x63, 0x36, 0x1C, 0x1C, 0x36, 0x63, 0x00 },   // X
+    { 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x0C, 0x1E, 0x00 },   // Y
+    { 0x7F, 0x63, 0x31, 0x18, 0x4C, 0x66, 0x7F, 0x00 },   // Z
+    { 0x1E, 0x06, 0x06, 0x06, 0x06, 0x06, 0x1E, 0x00 },   // [
+    { 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x40, 0x00 },   // barra invertida
+    { 0x1E, 0x18, 0x18, 0x18, 0x18, 0x18, 0x1E, 0x00 },   // ]
+    { 0x08, 0x1C, 0x36, 0x63, 0x00, 0x00, 0x00, 0x00 },   // ^
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF },   // _
+    { 0x0C, 0x0C, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00 },   // `
+    { 0x00, 0x00, 0x1E, 0x30, 0x3E, 0x33, 0x6E, 0x00 },   // a
+    { 0x07, 0x06, 0x06, 0x3E, 0x66, 0x66, 0x3B, 0x00 },   // b
+    { 0x00, 0x00, 0x1E, 0x33, 0x03, 0x33, 0x1E, 0x00 },   // c
+    { 0x38, 0x30, 0x30, 0x3E, 0x33, 0x33, 0x6E, 0x00 },   // d
+    { 0x00, 0x00, 0x1E, 0x33, 0x3F, 0x03, 0x1E, 0x00 },   // e
+    { 0x1C, 0x36, 0x06, 0x0F, 0x06, 0x06, 0x0F, 0x00 },   // f
+    { 0x00, 0x00, 0x6E, 0x33, 0x33, 0x3E, 0x30, 0x1F },   // g
+    { 0x07, 0x06, 0x36, 0x6E, 0x66, 0x66, 0x67, 0x00 },   // h
+    { 0x0C, 0x00, 0x0E, 0x0C, 0x0C, 0x0C, 0x1E, 0x00 },   // i
+    { 0x30, 0x00, 0x30, 0x30, 0x30, 0x33, 0x33, 0x1E },   // j
+    { 0x07, 0x06, 0x66, 0x36, 0x1E, 0x36, 0x67, 0x00 },   // k
+    { 0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00 },   // l
+    { 0x00, 0x00, 0x33, 0x7F, 0x7F, 0x6B, 0x63, 0x00 },   // m
+    { 0x00, 0x00, 0x1F, 0x33, 0x33, 0x33, 0x33, 0x00 },   // n
+    { 0x00, 0x00, 0x1E, 0x33, 0x33, 0x33, 0x1E, 0x00 },   // o
+    { 0x00, 0x00, 0x3B, 0x66, 0x66, 0x3E, 0x06, 0x0F },   // p
+    { 0x00, 0x00, 0x6E, 0x33, 0x33, 0x3E, 0x30, 0x78 },   // q
+    { 0x00, 0x00, 0x3B, 0x6E, 0x66, 0x06, 0x0F, 0x00 },   // r
+    { 0x00, 0x00, 0x3E, 0x03, 0x1E, 0x30, 0x1F, 0x00 },   // s
+    { 0x08, 0x0C, 0x3E, 0x0C, 0x0C, 0x2C, 0x18, 0x00 },   // t
+    { 0x00, 0x00, 0x33, 0x33, 0x33, 0x33, 0x6E, 0x00 },   // u
+    { 0x00, 0x00, 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x00 },   // v
+    { 0x00, 0x00, 0x63, 0x6B, 0x7F, 0x7F, 0x36, 0x00 },   // w
+    { 0x00, 0x00, 0x63, 0x36, 0x1C, 0x36, 0x63, 0x00 },   // x
+    { 0x00, 0x00, 0x33, 0x33, 0x33, 0x3E, 0x30, 0x1F },   // y
+    { 0x00, 0x00, 0x3F, 0x19, 0x0C, 0x26, 0x3F, 0x00 },   // z
+    { 0x38, 0x0C, 0x0C, 0x07, 0x0C, 0x0C, 0x38, 0x00 },   // {
+    { 0x18, 0x18, 0x18, 0x00, 0x18, 0x18, 0x18, 0x00 },   // |
+    { 0x07, 0x0C, 0x0C, 0x38, 0x0C, 0x0C, 0x07, 0x00 },   // }
+    { 0x6E, 0x3B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // ~
+};
+
+static inline void copy32(void *dst, const void *src, uintptr_t words) {
+    asm volatile ("rep movsl" : "+D"(dst), "+S"(src), "+c"(words) : : "memory");
+}
+
+static inline void fill32(void *dst, uint32_t value, uintptr_t words) {
+    asm volatile ("rep stosl" : "+D"(dst), "+c"(words) : "a"(value) : "memory");
+}
+
+// =============================================================================
+// FUENTE
+// =============================================================================
+// La BIOS de vídeo deja la fuente de 8x16 del modo texto en el plano 2 de
+// la VGA, un carácter cada 32 bytes. Para leerla se mapea el plano 2 en
+// 0xA0000 sin el modo par/impar y después se restaura todo.
+static void read_vga_font(void) {
+    outb(0x3C4, 0x02); uint8_t map_mask = inb(0x3C5);
+    outb(0x3C4, 0x04); uint8_t mem_mode = inb(0x3C5);
+    outb(0x3CE, 0x04); uint8_t read_map = inb(0x3CF);
+    outb(0x3CE, 0x05); uint8_t gfx_mode = inb(0x3CF);
+    outb(0x3CE, 0x06); uint8_t misc = inb(0x3CF);
+
+    outb(0x3C4, 0x02); outb(0x3C5, 0x04);
+    outb(0x3C4, 0x04); outb(0x3C5, 0x06);
+    outb(0x3CE, 0x04); outb(0x3CF, 0x02);
+    outb(0x3CE, 0x05); outb(0x3CF, 0x00);
+    outb(0x3CE, 0x06); outb(0x3CF, 0x04);   // 0xA0000, 64 KiB
+
+    const volatile uint8_t *plane = (const volatile uint8_t *)0xA0000;
+    for (int c = 0; c < 256; c++) {
+        for (int r = 0; r < FBCON_FONT_H; r++) font[c][r] = plane[c * 32 + r];
+    }
+
+    outb(0x3C4, 0x02); outb(0x3C5, map_mask);
+    outb(0x3C4, 0x04); outb(0x3C5, mem_mode);
+    outb(0x3CE, 0x04); outb(0x3CF, read_map);
+    outb(0x3CE, 0x05); outb(0x3CF, gfx_mode);
+    outb(0x3CE, 0x06); outb(0x3CF, misc);
+
+    // Sin nada en 'A' no es una fuente (no hay VGA o no está en modo texto)
+    for (int r = 0; r < FBCON_FONT_H; r++) {
+        if (font['A'][r]) font_loaded = 1;
+    }
+}
+
+static void load_fallback_font(void) {
+    memset(font, 0, sizeof(font));
+    for (int c = ' '; c <= '~'; c++) {
+        for (int r = 0; r < 8; r++) {
+            uint8_t bits = font8x8[c - ' '][r], rev = 0;
+            for (int b = 0; b < 8; b++) rev |= ((bits >> b) & 1) << (7 - b);
+            font[c][2 * r] = font[c][2 * r + 1] = rev;
+        }
+    }
+    font_loaded = 1;
+}
+
+// =============================================================================
+// CACHÉ DE GLIFOS
+// =============================================================================
+// Las filas de 8 píxeles de cada patrón con los colores de 'attr'; si no
+// está, ocupa la entrada usada hace más tiempo
+static const uint32_t (*color_rows(uint8_t attr))[FBCON_FONT_W] {
+    color_slot *victim = &slots[0];
+    for (int i = 0; i < COLOR_SLOTS; i++) {
+        if (slots[i].attr == attr) {
+            slots[i].stamp = ++slot_clock;
+            return slots[i].row;
+        }
+        if (slots[i].stamp < victim->stamp) victim = &slots[i];
+    }
+    uint32_t fg = palette[attr & 15], bg = palette[attr >> 4];
+    for (int p = 0; p < 256; p++) {
+        for (int b = 0; b < FBCON_FONT_W; b++) victim->row[p][b] = p & (0x80 >> b) ? fg : bg;
+    }
+    victim->attr = attr;
+    victim->stamp = ++slot_clock;
+    stats.color_misses++;
+    return victim->row;
+}
+
+// =============================================================================
+// DIBUJO
+// =============================================================================
+static inline uint8_t *pixel(uint32_t x, uint32_t y) {
+    return fb + (y_origin + y) * pitch + x * 4;
+}
+
+static inline void copy_row(uint32_t *dst, const uint32_t *src) {
+    dst[0] = src[0]; dst[1] = src[1]; dst[2] = src[2]; dst[3] = src[3];
+    dst[4] = src[4]; dst[5] = src[5]; dst[6] = src[6]; dst[7] = src[7];
+}
+
+static void draw_span(uint32_t y, uint32_t lo, uint32_t hi) {
+    const uint16_t *line = &cells[y * cols];
+    const uint32_t (*rowtab)[FBCON_FONT_W] = 0;
+    int attr = -1;
+    uint8_t *base = pixel(lo * FBCON_FONT_W, y * FBCON_FONT_H);
+    for (uint32_t x = lo; x < hi; x++, base += FBCON_FONT_W * 4) {
+        uint16_t cell = line[x];
+        if ((cell >> 8) != attr) {
+            attr = cell >> 8;
+            rowtab = color_rows(attr);
+        }
+        const uint8_t *glyph = font[cell & 0xFF];
+        uint8_t *dst = base;
+        for (int r = 0; r < FBCON_FONT_H; r++, dst += pitch) copy_row((uint32_t *)dst, rowtab[glyph[r]]);
+    }
+    stats.glyphs += hi - lo;
+}
+
+// Subrayado de dos líneas con el color del carácter
+static void draw_cursor(void) {
+    uint32_t fg = palette[(cells[cur_y * cols + cur_x] >> 8) & 15];
+    for (int r = FBCON_FONT_H - 2; r < FBCON_FONT_H; r++) {
+        fill32(pixel(cur_x * FBCON_FONT_W, cur_y * FBCON_FONT_H + r), fg, FBCON_FONT_W);
+    }
+    cursor_shown = 1;
+    shown_x = cur_x;
+    shown_y = cur_y;
+}
+
+static void bga_write(uint16_t index, uint16_t value) {
+    outw(BGA_INDEX, index);
+    outw(BGA_DATA, value);
+}
+
+static uint16_t bga_read(uint16_t index) {
+    outw(BGA_INDEX, index);
+    return inw(BGA_DATA);
+}
+
+// Sube el texto lo acumulado en fbcon_scrolled(). Las zonas sucias ya se
+// movieron con él y las filas nuevas están sucias enteras.
+static void apply_scroll(void) {
+    uint32_t n = scroll_pending, dy = n * FBCON_FONT_H, text_h = rows * FBCON_FONT_H;
+    scroll_pending = 0;
+    if (n >= rows) {
+        fbcon_touch_all();
+        stats.full_redraws++;
+    } else if (pan && y_origin + dy + height <= virt_height) {
+        y_origin += dy;
+        bga_write(BGA_Y_OFFSET, y_origin);
+        stats.pan_scrolls++;
+    } else if (pan) {
+        // Final de la zona: la ventana vuelve arriba y se repinta
+        y_origin = 0;
+        bga_write(BGA_Y_OFFSET, 0);
+        fbcon_touch_all();
+        stats.full_redraws++;
+    } else {
+        copy32(pixel(0, 0), pixel(0, dy), (text_h - dy) * pitch / 4);
+        stats.copy_scrolls++;
+    }
+}
+
+void fbcon_flush(void) {
+    if (!active || !pending) return;
+    if (scroll_pending) apply_scroll();
+    if (cursor_shown) fbcon_touch(shown_x, shown_y);   // Borrarlo
+    for (uint32_t y = 0; y < rows; y++) {
+        if (!dirty_hi[y]) continue;
+        draw_span(y, dirty_lo[y], dirty_hi[y]);
+        dirty_hi[y] = 0;
+    }
+    draw_cursor();
+    pending = 0;
+    stats.flushes++;
+}
+
+// =============================================================================
+// AVISOS DEL KERNEL
+// =============================================================================
+void fbcon_touch(uint32_t x, uint32_t y) {
+    if (x >= cols || y >= rows) return;
+    if (!dirty_hi[y]) {
+        dirty_lo[y] = x;
+        dirty_hi[y] = x + 1;
+    } else if (x < dirty_lo[y]) {
+        dirty_lo[y] = x;
+    } else if (x >= dirty_hi[y]) {
+        dirty_hi[y] = x + 1;
+    }
+    pending = 1;
+}
+
+void fbcon_touch_all(void) {
+    for (uint32_t y = 0; y < rows; y++) {
+        dirty_lo[y] = 0;
+        dirty_hi[y] = cols;
+    }
+    pending = 1;
+}
+
+void fbcon_scrolled(void) {
+    if (!active) return;
+    for (uint32_t y = 0; y + 1 < rows; y++) {
+        dirty_lo[y] = dirty_lo[y + 1];
+        dirty_hi[y] = dirty_hi[y + 1];
+    }
+    dirty_lo[rows - 1] = 0;
+    dirty_hi[rows - 1] = cols;
+    scroll_pending++;
+    // El cursor pintado sube con el texto
+    if (cursor_shown && shown_y) shown_y--;
+    else cursor_shown = 0;
+    pending = 1;
+}
+
+void fbcon_cursor(uint32_t x, uint32_t y) {
+    if (x >= cols) x = cols - 1;
+    if (y >= rows) y = rows - 1;
+    if (x != cur_x || y != cur_y) pending = 1;
+    cur_x = x;
+    cur_y = y;
+}
+
+// =============================================================================
+// INICIALIZACIÓN
+// =============================================================================
+static uint32_t rgb(const fb_info *info, const uint8_t *c) {
+    return (uint32_t)c[0] << info->red_pos | (uint32_t)c[1] << info->green_pos |
+           (uint32_t)c[2] << info->blue_pos;
+}
+
+int fbcon_init(const fb_info *info) {
+    if (!info->addr || info->width < 2 * FBCON_FONT_W || info->height < FBCON_FONT_H ||
+        info->pitch < info->width * 4) {
+        return 0;
+    }
+    fb = (uint8_t *)(uintptr_t)info->addr;
+    pitch = info->pitch;
+    width = info->width;
+    height = info->height;
+    cols = width / FBCON_FONT_W;
+    rows = height / FBCON_FONT_H;
+    if (cols > FBCON_MAX_COLS) cols = FBCON_MAX_COLS;
+    if (rows > FBCON_MAX_ROWS) rows = FBCON_MAX_ROWS;
+    cols &= ~1u;   // kernel.c mueve las celdas de dos en dos
+    for (int i = 0; i < 16; i++) palette[i] = rgb(info, vga_rgb[i]);
+    for (int i = 0; i < COLOR_SLOTS; i++) {
+        slots[i].attr = -1;
+        slots[i].stamp = 0;
+    }
+    if (!font_loaded) load_fallback_font();
+
+    y_origin = 0;
+    fill32(fb, palette[0], (pan ? virt_height : height) * pitch / 4);
+    for (uint32_t i = 0; i < cols * rows; i++) cells[i] = 0x0700 | ' ';
+    memset(dirty_hi, 0, sizeof(dirty_hi));
+    cur_x = cur_y = 0;
+    cursor_shown = 0;
+    scroll_pending = 0;
+    pending = 1;
+    if (!*source) source = "multiboot";
+    active = 1;
+    return 1;
+}
+
+int fbcon_bga(uint32_t w, uint32_t h) {
+    pci_device dev;
+    if (!pci_find(BGA_VENDOR, BGA_DEVICE, &dev) || bga_read(BGA_ID) < BGA_ID_MIN) return 0;
+    w -= w % FBCON_FONT_W;
+    h -= h % FBCON_FONT_H;   // Sin franja bajo la última fila al mover la ventana
+    if (w > FBCON_MAX_COLS * FBCON_FONT_W) w = FBCON_MAX_COLS * FBCON_FONT_W;
+    if (h > FBCON_MAX_ROWS * FBCON_FONT_H) h = FBCON_MAX_ROWS * FBCON_FONT_H;
+    if (w < 320 || h < 200) return 0;
+    read_vga_font();
+
+    // Toda la memoria de vídeo como zona para la ventana
+    uint32_t vram = (uint32_t)bga_read(BGA_MEMORY_64K) << 16;
+    uint32_t virt = vram ? vram / (w * 4) : h;
+    if (virt > 0xFFFF) virt = 0xFFFF;
+    if (virt < h) return 0;
+    bga_write(BGA_ENABLE, 0);
+    bga_write(BGA_XRES, w);
+    bga_write(BGA_YRES, h);
+    bga_write(BGA_BPP, 32);
+    bga_write(BGA_VIRT_WIDTH, w);
+    bga_write(BGA_VIRT_HEIGHT, virt);
+    bga_write(BGA_X_OFFSET, 0);
+    bga_write(BGA_Y_OFFSET, 0);
+    bga_write(BGA_ENABLE, BGA_ENABLED | BGA_LFB);
+    if (bga_read(BGA_XRES) != w || bga_read(BGA_YRES) != h) {
+        bga_write(BGA_ENABLE, 0);
+        return 0;
+    }
+    virt_height = bga_read(BGA_VIRT_HEIGHT);
+    pan = virt_height >= h + FBCON_FONT_H;
+
+    fb_info info;
+    info.addr = pci_read(&dev, PCI_BAR0) & ~0xFu;
+    info.pitch = w * 4;
+    info.width = w;
+    info.height = h;
+    info.red_pos = 16;
+    info.green_pos = 8;
+    info.blue_pos = 0;
+    source = "bga";
+    return fbcon_init(&info);
+}
+
+int fbcon_active(void) {
+    return active;
+}
+
+uint16_t *fbcon_cells(void) {
+    return cells;
+}
+
+uint32_t fbcon_cols(void) {
+    return cols;
+}
+
+uint32_t fbcon_rows(void) {
+    return rows;
+}
+
+const char *fbcon_source(void) {
+    return source;
+}
+
+void fbcon_size(uint32_t *w, uint32_t *h) {
+    *w = width;
+    *h = height;
+}
+
+void fbcon_get_stats(fbcon_stats *st) {
+    *st = stats;
+}
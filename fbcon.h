@@ -0,0 +1,69 @@
+// fbcon.h: consola de texto sobre un framebuffer lineal (fbcon.c)
+//
+// La consola sigue siendo una rejilla de celdas de 16 bits como la del modo
+// texto VGA (carácter en los 8 bits bajos, atributo en los altos): kernel.c
+// escribe en ella igual que en 0xB8000 y avisa de qué celdas tocó. Nada se
+// dibuja hasta fbcon_flush(), que repinta sólo lo que cambió desde la
+// anterior; el kernel la llama antes de esperar una tecla y, mientras la
+// salida no para, unas 60 veces por segundo. Así un 'cat' largo sólo pinta
+// las pantallas que se llegan a ver.
+//
+// El framebuffer puede venir de dos sitios:
+// - el cargador, si el kernel pidió un modo en la cabecera Multiboot
+//   (make VIDEO=1600x960, con GRUB; QEMU -kernel no lo atiende)
+// - la VGA de Bochs/QEMU (PCI 1234:1111), que se programa por puertos sin
+//   BIOS: arranque con "video" o "video=ANCHOxALTO" en la línea de comandos
+// Sólo se usan 32 bits por píxel.
+#ifndef FBCON_H
+#define FBCON_H
+
+#include <stdint.h>
+
+#define FBCON_FONT_W   8
+#define FBCON_FONT_H   16
+#define FBCON_MAX_COLS 320     // 2560 píxeles
+#define FBCON_MAX_ROWS 100     // 1600 píxeles
+
+typedef struct {
+    uint32_t addr;                            // Dirección física (= virtual)
+    uint32_t pitch, width, height;            // Bytes por línea y píxeles
+    uint8_t  red_pos, green_pos, blue_pos;    // Bit de cada componente
+} fb_info;
+
+typedef struct {
+    uint32_t flushes;          // fbcon_flush() que pintaron algo
+    uint32_t glyphs;           // Celdas dibujadas
+    uint32_t pan_scrolls;      // Desplazamientos resueltos moviendo el origen de la pantalla
+    uint32_t copy_scrolls;     // ... copiando el framebuffer
+    uint32_t full_redraws;     // ... repintando todo
+    uint32_t color_misses;     // Colores que hubo que añadir a la caché de glifos
+} fbcon_stats;
+
+// Empieza a usar 'fb' (lo deja en negro). Retorna 0 si no tiene 32 bits
+// por píxel o no caben dos columnas.
+int fbcon_init(const fb_info *fb);
+
+// Busca la VGA de Bochs/QEMU y la pone en 'width' x 'height'. Hay que
+// llamarla aún en modo texto: la fuente se copia de la memoria de la VGA.
+int fbcon_bga(uint32_t width, uint32_t height);
+
+int       fbcon_active(void);
+uint16_t *fbcon_cells(void);
+uint32_t  fbcon_cols(void);
+uint32_t  fbcon_rows(void);
+const char *fbcon_source(void);  // "bga" o "multiboot"
+void      fbcon_size(uint32_t *width, uint32_t *height);
+
+// Avisos de kernel.c: celdas escritas, pantalla entera, una fila de
+// desplazamiento (las celdas ya se movieron) y posición del cursor
+void fbcon_touch(uint32_t x, uint32_t y);
+void fbcon_touch_all(void);
+void fbcon_scrolled(void);
+void fbcon_cursor(uint32_t x, uint32_t y);
+
+// Pinta lo pendiente
+void fbcon_flush(void);
+
+void fbcon_get_stats(fbcon_stats *st);
+
+#endif
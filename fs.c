@@ -0,0 +1,3058 @@
+// fs.c: sistema de archivos FAT16 sobre el disco en RAM
+//
+// Capa de bloques con lectura anticipada, caché de nombres, descriptores de
+// archivo, edición por líneas y los comandos de archivo del shell. No toca
+// el hardware (ver platform.h), así que también se compila en el host.
+
+#include <stdint.h>
+#include "klib.h"
+#include "platform.h"
+#include "fs.h"
+#include "crc32c.h"
+#include "lz.h"
+#include "trace.h"
+
+// =============================================================================
+// SISTEMA DE ARCHIVOS FAT16 SIMPLIFICADO
+// =============================================================================
+// FAT16 es un sistema de archivos simple usado en discos pequeños.
+// El formato en disco (geometría, BPB y entradas de directorio) está en
+// fat16.h, compartido con las herramientas del host que generan imágenes.
+
+// Referencia al área de disco definida en boot.s
+// Si el cargador nos pasa una imagen como módulo Multiboot, disk_image
+// pasa a apuntar directamente a ella (ver fs_mount_image)
+static uint8_t *disk_image = disk_image_start;
+
+// =============================================================================
+// SUMAS DE COMPROBACIÓN
+// =============================================================================
+// Cada sector (que aquí es también un cluster) tiene su CRC32C en una tabla
+// en memoria: se actualiza al escribirlo, se comprueba al leerlo y se
+// recalcula entera al formatear o montar una imagen. Así se detecta
+// cualquier escritura que no pase por disk_transfer, como un puntero
+// desbocado del kernel que pise el disco en RAM. Un sector dañado se
+// anuncia una vez (hasta que se reescribe) y se cuenta en fs_stats; la
+// lectura sigue adelante con lo que haya.
+static uint32_t sector_crc[DISK_SECTORS];
+static uint8_t  sector_bad[(DISK_SECTORS + 7) / 8];
+static uint32_t scrub_next;   // Siguiente sector del repaso en segundo plano
+static struct { uint32_t errors, scrubbed; } crc_stats;
+
+static uint32_t sector_sum(const uint8_t *data) {
+    return crc32c(0, data, SECTOR_SIZE);
+}
+
+// Compara un sector con su suma. Retorna 0 si no coincide.
+static int sector_check(uint32_t lba, const uint8_t *data, int quiet) {
+    uint8_t bit = 1 << (lba & 7);
+    if (sector_sum(data) == sector_crc[lba]) {
+        sector_bad[lba / 8] &= ~bit;
+        return 1;
+    }
+    if (!(sector_bad[lba / 8] & bit)) {
+        sector_bad[lba / 8] |= bit;
+        crc_stats.errors++;
+        if (!quiet) printf("fs: suma de comprobacion incorrecta en el sector %u\n", lba);
+    }
+    return 0;
+}
+
+static void crc_rebuild(void) {
+    for (uint32_t lba = 0; lba < DISK_SECTORS; lba++) {
+        sector_crc[lba] = sector_sum(disk_image + lba * SECTOR_SIZE);
+    }
+    memset(sector_bad, 0, sizeof(sector_bad));
+    scrub_next = 0;
+}
+
+// Comprueba todo el disco tal como está en memoria, sin pasar por la cola
+// de bloques ni por las cachés
+void fs_scrub(fs_scrub_info *info) {
+    info->sectors = DISK_SECTORS;
+    info->errors = 0;
+    for (uint32_t lba = 0; lba < DISK_SECTORS; lba++) {
+        if (sector_check(lba, disk_image + lba * SECTOR_SIZE, 1)) continue;
+        if (info->errors < FS_SCRUB_BAD) info->bad[info->errors] = lba;
+        info->errors++;
+    }
+}
+
+// Repaso en segundo plano: comprueba un sector por llamada, en círculo.
+// Los errores sólo se cuentan (ver fs_stats); no se imprime nada. Retorna
+// 1 con el último sector del disco, al completar una vuelta.
+int fs_scrub_step(void) {
+    uint32_t lba = scrub_next;
+    scrub_next = lba + 1 < DISK_SECTORS ? lba + 1 : 0;
+    sector_check(lba, disk_image + lba * SECTOR_SIZE, 1);
+    crc_stats.scrubbed++;
+    return scrub_next == 0;
+}
+
+// =============================================================================
+// SIMULACIÓN DE DISCO EN MEMORIA RAM
+// =============================================================================
+// En lugar de acceder a un disco real, simulamos todo en memoria.
+// Esto simplifica enormemente el desarrollo pero mantiene la lógica intacta.
+// disk_transfer() hace de "controlador": mueve 'count' sectores contiguos
+// en una sola operación, como haría un comando DMA de un disco real.
+// Igual que un controlador, rechaza los sectores fuera del disco en lugar
+// de escribir más allá de disk_image_end.
+static struct { uint32_t read, written; } disk_stats;   // Sectores
+
+static void disk_transfer(uint32_t lba, uint32_t count, void *buf, int write) {
+    if (lba >= DISK_SECTORS || count > DISK_SECTORS - lba) {
+        printf("fs: acceso fuera del disco (sector %u, %u sectores)\n", lba, count);
+        if (!write) memset(buf, 0, count * SECTOR_SIZE);
+        return;
+    }
+    uint8_t *dev = disk_image + lba * SECTOR_SIZE;
+    TRACE(write ? TRACE_SECTOR_WRITE : TRACE_SECTOR_READ, lba, count);
+    if (write) disk_stats.written += count;
+    else       disk_stats.read += count;
+    if (write) memcpy(dev, buf, count * SECTOR_SIZE);
+    else       memcpy(buf, dev, count * SECTOR_SIZE);
+    
+    // Se suma lo que queda en el disco y se comprueba lo que recibe el lector
+    const uint8_t *data = write ? dev : buf;
+    for (uint32_t i = 0; i < count; i++, data += SECTOR_SIZE) {
+        if (write) {
+            sector_crc[lba + i] = sector_sum(data);
+            sector_bad[(lba + i) / 8] &= ~(1 << ((lba + i) & 7));
+        } else {
+            sector_check(lba + i, data, 0);
+        }
+    }
+}
+
+// =============================================================================
+// COLA DE PETICIONES DE BLOQUE (E/S ASÍNCRONA)
+// =============================================================================
+// Las lecturas anticipadas no se ejecutan en el momento: se encolan como
+// peticiones con una función de finalización (callback). Cuando alguien
+// necesita el dato, o la cola se llena, se "despacha" la cola: las
+// peticiones consecutivas con LBAs adyacentes se fusionan en una sola
+// transferencia grande al dispositivo y luego se avisa a cada solicitante.
+#define BLK_QUEUE_DEPTH 32   // Peticiones en vuelo como máximo
+#define BLK_MAX_MERGE   32   // Sectores máximos por transferencia fusionada
+
+typedef struct blk_request blk_request;
+typedef void (*blk_done_fn)(blk_request *rq);
+
+struct blk_request {
+    uint32_t     lba;      // Primer sector
+    uint32_t     count;    // Número de sectores
+    uint8_t     *buf;      // Memoria origen/destino
+    int          write;    // 0 = lectura, 1 = escritura
+    blk_done_fn  done;     // Callback de finalización (puede ser NULL)
+    void        *priv;     // Dato opaco para el callback
+    blk_request *next;
+};
+
+static blk_request  blk_pool[BLK_QUEUE_DEPTH];
+static blk_request *blk_free_list = 0;
+static blk_request *blk_head = 0, *blk_tail = 0;
+static int          blk_ready = 0;
+
+// Contadores de la capa de bloques
+static struct {
+    uint32_t submitted;    // Peticiones recibidas
+    uint32_t dispatched;   // Transferencias enviadas al dispositivo
+    uint32_t merged;       // Peticiones absorbidas por una fusión
+    uint32_t sectors;      // Sectores transferidos
+} blk_stats;
+
+static void blk_init(void) {
+    blk_free_list = 0;
+    for (int i = 0; i < BLK_QUEUE_DEPTH; i++) {
+        blk_pool[i].next = blk_free_list;
+        blk_free_list = &blk_pool[i];
+    }
+    blk_head = blk_tail = 0;
+    blk_ready = 1;
+}
+
+// Despacha todas las peticiones pendientes en orden FIFO.
+// Una "corrida" de peticiones del mismo sentido con LBAs adyacentes se
+// convierte en un único comando al dispositivo; si los buffers también son
+// contiguos se copia todo de una vez, si no se recorre como scatter-gather.
+static void blk_run_queue(void) {
+    while (blk_head) {
+        blk_request *first = blk_head, *last = first;
+        uint32_t total = first->count;
+        int contiguous = 1;
+
+        while (last->next &&
+               last->next->write == first->write &&
+               last->next->lba == last->lba + last->count &&
+               total + last->next->count <= BLK_MAX_MERGE) {
+            if (last->next->buf != last->buf + last->count * SECTOR_SIZE) contiguous = 0;
+            total += last->next->count;
+            last = last->next;
+            blk_stats.merged++;
+        }
+
+        blk_head = last->next;
+        if (!blk_head) blk_tail = 0;
+        last->next = 0;
+
+        if (contiguous) {
+            disk_transfer(first->lba, total, first->buf, first->write);
+        } else {
+            for (blk_request *rq = first; rq; rq = rq->next)
+                disk_transfer(rq->lba, rq->count, rq->buf, rq->write);
+        }
+        blk_stats.dispatched++;
+        blk_stats.sectors += total;
+
+        // Notificar finalización y devolver las peticiones al pool
+        blk_request *rq = first;
+        while (rq) {
+            blk_request *next = rq->next;
+            if (rq->done) rq->done(rq);
+            rq->next = blk_free_list;
+            blk_free_list = rq;
+            rq = next;
+        }
+    }
+}
+
+// Encola una petición. No bloquea: el callback se ejecutará cuando la cola
+// sea despachada. Si no quedan peticiones libres se despacha la cola primero.
+static void blk_submit(uint32_t lba, uint32_t count, void *buf, int write,
+                       blk_done_fn done, void *priv) {
+    if (!blk_ready) blk_init();
+    if (!blk_free_list) blk_run_queue();
+
+    blk_request *rq = blk_free_list;
+    blk_free_list = rq->next;
+    rq->lba = lba;
+    rq->count = count;
+    rq->buf = buf;
+    rq->write = write;
+    rq->done = done;
+    rq->priv = priv;
+    rq->next = 0;
+
+    if (blk_tail) blk_tail->next = rq; else blk_head = rq;
+    blk_tail = rq;
+    blk_stats.submitted++;
+}
+
+// Caché de un sector de la FAT (ver fat_get); se invalida al escribir
+static uint32_t fat_cache_lba = 0;
+static void ra_invalidate(uint32_t lba);
+
+// Acceso síncrono de un sector: vacía la cola antes para respetar el orden
+// con las peticiones asíncronas pendientes.
+static void read_sector(uint32_t lba, void *buf) {
+    if (blk_head) blk_run_queue();
+    disk_transfer(lba, 1, buf, 0);
+}
+static void write_sector(uint32_t lba, const void *buf) {
+    if (blk_head) blk_run_queue();
+    disk_transfer(lba, 1, (void *)buf, 1);
+    if (lba == fat_cache_lba) fat_cache_lba = 0;
+    ra_invalidate(lba);
+}
+
+// =============================================================================
+// MANIPULACIÓN DE ENTRADAS DE DIRECTORIO
+// =============================================================================
+// Cada archivo tiene una entrada de 32 bytes en su directorio.
+// Contiene: nombre (11 bytes), atributos, cluster inicial, tamaño, etc.
+// Una entrada se identifica en todo el disco por su "dirección": sector por
+// DIR_PER_SECTOR más su posición dentro del sector. Sirve igual para el
+// directorio raíz que para los subdirectorios (ver DIRECTORIOS).
+#define DIR_PER_SECTOR (SECTOR_SIZE / DIR_ENTRY_SIZE)
+
+static void dir_read_entry(uint32_t ent, fat16_dir_entry *e) {
+    uint8_t sec[SECTOR_SIZE];
+    read_sector(ent / DIR_PER_SECTOR, sec);
+    memcpy(e, sec + (ent % DIR_PER_SECTOR) * sizeof(*e), sizeof(*e));
+}
+static void dir_write_entry(uint32_t ent, const fat16_dir_entry *e) {
+    uint8_t sec[SECTOR_SIZE];
+    read_sector(ent / DIR_PER_SECTOR, sec);
+    memcpy(sec + (ent % DIR_PER_SECTOR) * sizeof(*e), e, sizeof(*e));
+    write_sector(ent / DIR_PER_SECTOR, sec);
+}
+
+static void dir_reset(void);
+static void refs_rebuild(void);
+static void tix_reset(void);
+static void tix_forget(uint32_t ent);
+static void tix_moved(uint32_t ent, uint32_t moved);
+
+// =============================================================================
+// INICIALIZACIÓN DEL SISTEMA DE ARCHIVOS
+// =============================================================================
+// Inicializa las estructuras básicas del sistema de archivos FAT16 en memoria
+// Sólo se limpian los metadatos (boot sector, FAT y directorio raíz) en una
+// pasada: los clusters de datos se limpian cuando se asignan
+void fs_init(void) {
+    memset(disk_image, 0, DATA_START);
+    fat16_format(disk_image);
+    crc_rebuild();
+    dir_reset();
+    refs_rebuild();
+    tix_reset();
+    printf("Sistema de archivos inicializado: %u clusters de %u bytes.\n",
+           DATA_CLUSTERS, SECTOR_SIZE);
+}
+
+// Monta una imagen FAT16 ya existente en memoria, sin copiarla
+// La imagen debe tener la misma geometría con la que se compiló el kernel
+// Retorna 1 si la imagen es válida y queda montada
+int fs_mount_image(uint8_t *base, uint32_t size) {
+    const fat16_bpb *bpb = (const fat16_bpb *)base;
+    
+    if (size < DATA_START) {
+        printf("Imagen demasiado pequena (%u bytes)\n", size);
+        return 0;
+    }
+    if (base[510] != 0x55 || base[511] != 0xAA) {
+        printf("Imagen sin firma de boot sector\n");
+        return 0;
+    }
+    if (bpb->bytes_per_sector != SECTOR_SIZE || bpb->sectors_per_cluster != 1 ||
+        bpb->reserved_sectors != 1 || bpb->num_fats != 1 ||
+        bpb->root_entries != ROOT_ENTRIES || bpb->sectors_per_fat != FAT_SECTORS ||
+        bpb->media != FAT16_MEDIA || memcmp(bpb->fs_type, "FAT16   ", 8)) {
+        printf("Geometria FAT16 incompatible con este kernel\n");
+        return 0;
+    }
+    
+    uint32_t total = bpb->total_sectors16 ? bpb->total_sectors16 : bpb->total_sectors32;
+    if (total != DISK_SECTORS || total * SECTOR_SIZE > size) {
+        printf("Imagen de %u sectores (%u bytes); el kernel espera %u sectores\n",
+               total, size, DISK_SECTORS);
+        printf("Genera la imagen con el mismo DISK_SECTORS que el kernel\n");
+        return 0;
+    }
+    
+    // Comprobar que las entradas del directorio apuntan dentro del disco
+    const fat16_dir_entry *root = (const fat16_dir_entry *)(base + ROOT_SECTOR * SECTOR_SIZE);
+    for (int i = 0; i < ROOT_ENTRIES; i++) {
+        if (root[i].name[0] == 0x00) break;
+        if ((uint8_t)root[i].name[0] == 0xE5) continue;
+        if (root[i].first_cluster < 2 || root[i].first_cluster >= CLUSTER_LIMIT) {
+            printf("Entrada %d con cluster invalido (%u)\n", i, root[i].first_cluster);
+            return 0;
+        }
+    }
+    
+    disk_image = base;
+    crc_rebuild();
+    dir_reset();
+    refs_rebuild();
+    tix_reset();
+    return 1;
+}
+
+// =============================================================================
+// GESTIÓN DE CLUSTERS
+// =============================================================================
+// -----------------------------------------------------------------------------
+// Cadenas de clusters
+// -----------------------------------------------------------------------------
+// Cada entrada de la FAT apunta al siguiente cluster del archivo.
+// Un valor >= 0xFFF8 marca el final de la cadena, 0 indica cluster libre.
+#define FAT_EOC        0xFFF8
+#define CLUSTER_SECTOR(c) (DATA_SECTOR + ((c) - 2))
+
+static uint8_t fat_cache[SECTOR_SIZE];
+
+// Lee la entrada FAT de un cluster (con caché del último sector leído)
+static uint16_t fat_get(uint16_t cluster) {
+    uint32_t fat_offset = cluster * 2;
+    uint32_t lba = FAT_SECTOR + (fat_offset / SECTOR_SIZE);
+    uint32_t off = fat_offset % SECTOR_SIZE;
+    if (fat_cache_lba != lba) {
+        read_sector(lba, fat_cache);
+        fat_cache_lba = lba;
+    }
+    return fat_cache[off] | (fat_cache[off + 1] << 8);
+}
+
+void fat_set(uint16_t cluster, uint16_t value) {
+    uint8_t fat_sector[SECTOR_SIZE];
+    uint32_t fat_offset = cluster * 2;
+    uint32_t lba = FAT_SECTOR + (fat_offset / SECTOR_SIZE);
+    uint32_t off = fat_offset % SECTOR_SIZE;
+    read_sector(lba, fat_sector);
+    fat_sector[off] = value & 0xFF;
+    fat_sector[off + 1] = value >> 8;
+    write_sector(lba, fat_sector);
+}
+
+// Siguiente cluster de la cadena, o 0 si es el último
+static uint16_t fat_next(uint16_t cluster) {
+    uint16_t next = fat_get(cluster);
+    return (next >= FAT_EOC || next < 2) ? 0 : next;
+}
+
+// -----------------------------------------------------------------------------
+// Clusters compartidos (copia en escritura)
+// -----------------------------------------------------------------------------
+// 'cp' no copia datos: el destino apunta a la misma cadena que el origen.
+// cluster_refs[c] cuenta los punteros que llegan a c, sean entradas de
+// directorio (primer cluster) o entradas de la FAT (cluster anterior). Un
+// cluster recién asignado nace con 1, el del puntero que va a recibir.
+// Si un cluster tiene más de una referencia, todos los que le siguen en la
+// cadena son alcanzables desde los dos archivos aunque cuenten 1, así que
+// un archivo sólo puede modificar el tramo inicial de su cadena anterior al
+// primer cluster compartido (ver inode_unshare).
+// La tabla no se guarda en el disco: se reconstruye al montar la imagen.
+#define REF_MAX 0xFFFF
+
+static uint16_t cluster_refs[CLUSTER_LIMIT];
+
+// Encuentra el próximo cluster libre y lo marca como ocupado
+// fat_get mantiene en caché el sector de la FAT, así que recorrer la tabla
+// cuesta una lectura cada SECTOR_SIZE / 2 clusters
+static struct { uint32_t allocated, freed, reflinks, cow_copies; } cluster_stats;
+
+uint16_t fs_alloc_cluster(void) {
+    // Empezar desde el cluster 2 (los primeros dos están reservados)
+    for (uint32_t cluster = 2; cluster < CLUSTER_LIMIT; cluster++) {
+        if (fat_get(cluster) == 0) {  // Cluster libre
+            // Marcarlo como fin de cadena (0xFFFF)
+            fat_set(cluster, 0xFFFF);
+            TRACE(TRACE_CLUSTER_ALLOC, cluster, 0);
+            cluster_refs[cluster] = 1;
+            cluster_stats.allocated++;
+            return cluster;
+        }
+    }
+    
+    return 0;  // No hay clusters libres
+}
+
+// Cuenta los clusters libres de la FAT
+uint32_t fs_free_clusters(void) {
+    uint32_t free = 0;
+    for (uint32_t cluster = 2; cluster < CLUSTER_LIMIT; cluster++) {
+        if (fat_get(cluster) == 0) free++;
+    }
+    return free;
+}
+
+// Suelta una referencia a la cadena que empieza en 'cluster': sus clusters
+// se liberan hasta llegar al primero que otra cadena sigue usando
+void fs_free_chain(uint16_t cluster) {
+    while (cluster) {
+        if (cluster_refs[cluster] > 1) {
+            cluster_refs[cluster]--;
+            break;
+        }
+        uint16_t next = fat_next(cluster);
+        fat_set(cluster, 0);
+        cluster_refs[cluster] = 0;
+        cluster_stats.freed++;
+        cluster = next;
+    }
+}
+
+// =============================================================================
+// LECTURA ANTICIPADA (READ-AHEAD)
+// =============================================================================
+// Cuando un archivo abierto se lee de forma secuencial, pedimos por
+// adelantado los siguientes clusters de su cadena FAT. Las peticiones van a
+// la cola de bloques sin esperar; como los slots de la caché se asignan de
+// forma circular, clusters consecutivos en disco quedan también consecutivos
+// en memoria y la cola los fusiona en una sola transferencia.
+// La ventana empieza en RA_MIN_WINDOW y se duplica mientras el acceso siga
+// siendo secuencial; un salto (seek) la reinicia. Cada archivo abierto tiene
+// su propio estado (ra_stream), ver la tabla de archivos abiertos.
+#define RA_SLOTS       64   // Clusters en la caché de lectura anticipada
+#define RA_MIN_WINDOW  2
+#define RA_MAX_WINDOW  32
+
+#define RA_EMPTY   0
+#define RA_PENDING 1
+#define RA_READY   2
+
+typedef struct {
+    uint16_t cluster;
+    uint8_t  state;
+} ra_slot;
+
+static ra_slot ra_slots[RA_SLOTS];
+static uint8_t ra_data[RA_SLOTS][SECTOR_SIZE];
+static int     ra_next_slot = 0;
+
+// Estado de acceso secuencial de un archivo abierto
+typedef struct {
+    uint32_t next_index;      // Índice esperado si el acceso es secuencial
+    uint32_t window;          // Tamaño actual de la ventana (clusters)
+    uint32_t ahead_index;     // Último cluster solicitado por adelantado
+    uint16_t ahead_cluster;   // (0 = todavía no se ha pedido nada)
+} ra_stream;
+
+static struct { uint32_t hits, misses, prefetched; } ra_stats;
+
+static int ra_lookup(uint16_t cluster) {
+    for (int i = 0; i < RA_SLOTS; i++) {
+        if (ra_slots[i].state != RA_EMPTY && ra_slots[i].cluster == cluster) return i;
+    }
+    return -1;
+}
+
+// Descarta de la caché el cluster que contiene 'lba' (llamado al escribir)
+static void ra_invalidate(uint32_t lba) {
+    if (lba < DATA_SECTOR) return;
+    int slot = ra_lookup(lba - DATA_SECTOR + 2);
+    if (slot >= 0) ra_slots[slot].state = RA_EMPTY;
+}
+
+static void ra_reset(ra_stream *s) {
+    s->next_index = 0;
+    s->window = RA_MIN_WINDOW;
+    s->ahead_index = 0;
+    s->ahead_cluster = 0;
+}
+
+static void ra_done(blk_request *rq) {
+    ((ra_slot *)rq->priv)->state = RA_READY;
+}
+
+// Reserva el siguiente slot de forma circular y encola su lectura
+static int ra_submit(uint16_t cluster) {
+    int slot = ra_next_slot;
+    ra_next_slot = (ra_next_slot + 1) % RA_SLOTS;
+    if (ra_slots[slot].state == RA_PENDING) blk_run_queue();
+    ra_slots[slot].cluster = cluster;
+    ra_slots[slot].state = RA_PENDING;
+    blk_submit(CLUSTER_SECTOR(cluster), 1, ra_data[slot], 0, ra_done, &ra_slots[slot]);
+    return slot;
+}
+
+// Encola lecturas anticipadas hasta el índice 'upto' de la cadena
+static void ra_prefetch(ra_stream *s, uint32_t upto) {
+    while (s->ahead_index < upto) {
+        uint16_t next = fat_next(s->ahead_cluster);
+        if (!next) break;
+        s->ahead_index++;
+        s->ahead_cluster = next;
+        if (ra_lookup(next) < 0) {
+            ra_submit(next);
+            ra_stats.prefetched++;
+        }
+    }
+}
+
+// Lee en 'dst' (SECTOR_SIZE bytes) el cluster 'cluster', que ocupa la
+// posición 'index' dentro del archivo, y ajusta la ventana de anticipación
+static void ra_read_cluster(ra_stream *s, uint32_t index, uint16_t cluster, void *dst) {
+    // La lectura pedida también pasa por la cola, así se fusiona con las
+    // lecturas anticipadas adyacentes que se encolen a continuación
+    int slot = ra_lookup(cluster);
+    if (slot >= 0) {
+        // Copiar ya: las lecturas anticipadas de abajo pueden reutilizar
+        // este slot al dar la vuelta a la caché
+        ra_stats.hits++;
+        if (ra_slots[slot].state == RA_PENDING) blk_run_queue();
+        memcpy(dst, ra_data[slot], SECTOR_SIZE);
+        dst = 0;
+    } else {
+        ra_stats.misses++;
+        slot = ra_submit(cluster);
+    }
+
+    // Detección de acceso secuencial
+    int sequential = (index == s->next_index);
+    s->next_index = index + 1;
+    if (!sequential) s->window = RA_MIN_WINDOW;
+    if (!sequential || !s->ahead_cluster || s->ahead_index < index) {
+        s->ahead_index = index;
+        s->ahead_cluster = cluster;
+    }
+    // Ventana asíncrona: se renueva cuando queda menos de la mitad por leer
+    if (s->ahead_index - index <= s->window / 2) {
+        if (sequential && s->window < RA_MAX_WINDOW) s->window *= 2;
+        ra_prefetch(s, index + s->window);
+    }
+
+    // En un fallo el slot pedido es el último asignado, y la ventana es
+    // menor que la caché, así que sigue siendo nuestro
+    if (dst) {
+        if (ra_slots[slot].state == RA_PENDING) blk_run_queue();
+        memcpy(dst, ra_data[slot], SECTOR_SIZE);
+    }
+}
+
+// =============================================================================
+// DIRECTORIOS
+// =============================================================================
+// Un directorio se identifica por su primer cluster; el raíz, que no tiene
+// cadena, por el 0 (el mismo valor que guarda ".." en sus hijos). Cada
+// subdirectorio es una cadena de clusters llena de entradas que empieza con
+// "." (él mismo) y ".." (su padre), y crece un cluster cada vez que se
+// llena. El raíz ocupa su zona fija de ROOT_ENTRIES entradas.
+static uint16_t cwd = 0;   // Directorio actual
+
+static int is_dir(const fat16_dir_entry *e) {
+    return (e->attr & FAT_ATTR_DIRECTORY) != 0;
+}
+
+// 1 si el nombre rellenado es ".", 2 si es "..", 0 si no
+static int name_is_dot(const char name[11]) {
+    if (name[0] != '.') return 0;
+    if (name[1] == ' ') return 1;
+    return name[1] == '.' && name[2] == ' ' ? 2 : 0;
+}
+
+// Sector 'n' de un directorio recorrido en orden: *cluster guarda la
+// posición en la cadena de una llamada a la siguiente. Retorna 0 al final.
+static uint32_t dir_sector(uint16_t dir, uint32_t n, uint16_t *cluster) {
+    if (!dir) return n < ROOT_SECTORS ? ROOT_SECTOR + n : 0;
+    *cluster = n ? fat_next(*cluster) : dir;
+    return *cluster ? CLUSTER_SECTOR(*cluster) : 0;
+}
+
+// Entrada que sigue a 'ent' en su directorio, o 0 si es la última
+static uint32_t dir_next_ent(uint16_t dir, uint32_t ent) {
+    if ((ent + 1) % DIR_PER_SECTOR) return ent + 1;
+    uint32_t lba = ent / DIR_PER_SECTOR;
+    if (!dir) return lba + 1 < ROOT_SECTOR + ROOT_SECTORS ? (lba + 1) * DIR_PER_SECTOR : 0;
+    uint16_t next = fat_next(lba - DATA_SECTOR + 2);
+    return next ? CLUSTER_SECTOR(next) * DIR_PER_SECTOR : 0;
+}
+
+// Padre de un subdirectorio, según su entrada ".."
+static uint16_t dir_parent(uint16_t dir) {
+    fat16_dir_entry e;
+    dir_read_entry(CLUSTER_SECTOR(dir) * DIR_PER_SECTOR + 1, &e);
+    return e.first_cluster;
+}
+
+// FNV-1a del directorio y el nombre rellenado. Lo comparten la caché de
+// nombres y los índices de directorio.
+static uint32_t name_hash(uint16_t dir, const char name[11]) {
+    uint32_t h = 2166136261u;
+    h = (h ^ (dir & 0xFF)) * 16777619u;
+    h = (h ^ (dir >> 8)) * 16777619u;
+    for (int i = 0; i < 11; i++) h = (h ^ (uint8_t)name[i]) * 16777619u;
+    return h;
+}
+
+// =============================================================================
+// CACHÉ DE NOMBRES (DENTRY CACHE)
+// =============================================================================
+// Guardamos el resultado de cada búsqueda en una tabla hash de acceso
+// directo: (directorio, nombre) -> dirección de la entrada. También se
+// guardan los fallos (dirección 0); como un fallo sólo deja de ser válido
+// cuando se crea un nombre nuevo, llevan el número de "generación" de los
+// directorios, que se incrementa en cada creación o renombrado.
+#define DCACHE_SIZE 128   // Potencia de 2
+
+typedef struct {
+    char     name[11];
+    uint8_t  valid;
+    uint16_t dir;
+    uint32_t ent;        // Dirección de la entrada, 0 = no existe
+    uint32_t gen;        // Generación de los directorios (sólo para fallos)
+} dcache_entry;
+
+static dcache_entry dcache[DCACHE_SIZE];
+static uint32_t     dir_gen = 1;
+static struct { uint32_t hits, misses; } dcache_stats;
+
+// Convierte un nombre a su forma de 11 caracteres rellenada con espacios
+static void fs_pad_name(const char *name, char out[11]) {
+    memset(out, ' ', 11);
+    for (int i = 0; i < 11 && name[i]; i++) out[i] = name[i];
+}
+
+static void dcache_insert(uint16_t dir, const char name[11], uint32_t ent) {
+    dcache_entry *d = &dcache[name_hash(dir, name) & (DCACHE_SIZE - 1)];
+    memcpy(d->name, name, 11);
+    d->dir = dir;
+    d->ent = ent;
+    d->gen = dir_gen;
+    d->valid = 1;
+}
+
+// =============================================================================
+// ÍNDICES DE DIRECTORIO
+// =============================================================================
+// La caché de nombres sólo ayuda con lo que ya se ha buscado. Para que un
+// directorio con cientos de entradas no se recorra entero en cada fallo,
+// los últimos directorios usados tienen un índice hash en memoria
+// (direccionamiento abierto): nombre -> dirección de la entrada. Se
+// construye con un solo recorrido la primera vez que se busca o se crea
+// algo en el directorio y después se mantiene en cada creación, borrado y
+// renombrado, así que llegar a un hueco vacío es un "no existe" seguro.
+// También recuerda dónde añadir entradas: las borradas que se pueden
+// reutilizar y la primera libre del final.
+// Un directorio con más de DIX_MAX entradas no se indexa y se recorre.
+#define DIR_INDEXES 4              // Directorios indexados a la vez
+#define DIX_SLOTS   2048           // Huecos por índice (potencia de 2)
+#define DIX_MAX     (DIX_SLOTS * 3 / 4)
+#define DIX_HOLES   32             // Entradas borradas que se recuerdan
+#define DIX_TOMB    0xFFFFFFFFu    // Hueco de un nombre que ya no existe
+
+typedef struct {
+    int      valid;
+    int      overflow;             // Demasiadas entradas: sin índice
+    uint16_t dir;
+    uint32_t last_use;
+    uint32_t used;                 // Huecos ocupados, lápidas incluidas
+    uint32_t end;                  // Primera entrada 0x00 (0 = cadena llena)
+    uint32_t nholes;
+    uint32_t holes[DIX_HOLES];     // Entradas 0xE5 reutilizables
+    uint16_t tag[DIX_SLOTS];       // Bits altos del hash: evita leer entradas ajenas
+    uint32_t ent[DIX_SLOTS];       // Dirección de la entrada, 0 = hueco libre
+} dir_index;
+
+static dir_index dix[DIR_INDEXES];
+static uint32_t  dix_clock = 0;
+static struct { uint32_t builds, scans; } dix_stats;
+
+static void dix_put(dir_index *x, uint32_t h, uint32_t ent) {
+    if (x->used >= DIX_MAX) {
+        x->valid = 0;   // Demasiadas lápidas: se reconstruye en el próximo uso
+        return;
+    }
+    for (uint32_t i = h;; i++) {
+        uint32_t s = i & (DIX_SLOTS - 1);
+        if (x->ent[s] && x->ent[s] != DIX_TOMB) continue;
+        if (!x->ent[s]) x->used++;
+        x->ent[s] = ent;
+        x->tag[s] = h >> 16;
+        return;
+    }
+}
+
+static void dix_remove(dir_index *x, uint32_t h, uint32_t ent) {
+    for (uint32_t i = h;; i++) {
+        uint32_t s = i & (DIX_SLOTS - 1);
+        if (!x->ent[s]) return;
+        if (x->ent[s] == ent) {
+            x->ent[s] = DIX_TOMB;
+            return;
+        }
+    }
+}
+
+// Dirección de la entrada 'name' (que deja en *e), o 0 si no existe
+static uint32_t dix_lookup(dir_index *x, uint32_t h, const char name[11], fat16_dir_entry *e) {
+    for (uint32_t i = h;; i++) {
+        uint32_t s = i & (DIX_SLOTS - 1);
+        if (!x->ent[s]) return 0;
+        if (x->ent[s] == DIX_TOMB || x->tag[s] != (uint16_t)(h >> 16)) continue;
+        dir_read_entry(x->ent[s], e);
+        if (!memcmp(e->name, name, 11)) return x->ent[s];
+    }
+}
+
+static void dix_build(dir_index *x, uint16_t dir) {
+    memset(x->ent, 0, sizeof(x->ent));
+    x->dir = dir;
+    x->valid = 1;
+    x->overflow = 0;
+    x->used = x->end = x->nholes = 0;
+    dix_stats.builds++;
+
+    uint8_t sec[SECTOR_SIZE];
+    uint16_t cluster = 0;
+    uint32_t lba;
+    for (uint32_t n = 0; (lba = dir_sector(dir, n, &cluster)) != 0; n++) {
+        read_sector(lba, sec);
+        const fat16_dir_entry *de = (const fat16_dir_entry *)sec;
+        for (int j = 0; j < DIR_PER_SECTOR; j++) {
+            uint32_t ent = lba * DIR_PER_SECTOR + j;
+            if (de[j].name[0] == 0x00) {
+                x->end = ent;
+                return;
+            }
+            if ((uint8_t)de[j].name[0] == 0xE5) {
+                if (x->nholes < DIX_HOLES) x->holes[x->nholes++] = ent;
+                continue;
+            }
+            if (x->used == DIX_MAX) {
+                x->overflow = 1;
+                return;
+            }
+            dix_put(x, name_hash(dir, de[j].name), ent);
+        }
+    }
+}
+
+// Índice de 'dir' si ya existe (sin construirlo)
+static dir_index *dix_find(uint16_t dir) {
+    for (int i = 0; i < DIR_INDEXES; i++) {
+        if (dix[i].valid && dix[i].dir == dir) return dix[i].overflow ? 0 : &dix[i];
+    }
+    return 0;
+}
+
+// Índice de 'dir', construyéndolo en el hueco usado hace más tiempo.
+// Retorna NULL si el directorio no cabe en un índice.
+static dir_index *dix_get(uint16_t dir) {
+    dir_index *victim = &dix[0];
+    dix_clock++;
+    for (int i = 0; i < DIR_INDEXES; i++) {
+        dir_index *x = &dix[i];
+        if (x->valid && x->dir == dir) {
+            x->last_use = dix_clock;
+            return x->overflow ? 0 : x;
+        }
+        if (victim->valid && (!x->valid || x->last_use < victim->last_use)) victim = x;
+    }
+    dix_build(victim, dir);
+    victim->last_use = dix_clock;
+    return victim->overflow ? 0 : victim;
+}
+
+static void dix_drop(uint16_t dir) {
+    for (int i = 0; i < DIR_INDEXES; i++) {
+        if (dix[i].dir == dir) dix[i].valid = 0;
+    }
+}
+
+// Vacía la caché de nombres y los índices de directorio (las búsquedas
+// siguientes vuelven a recorrer los directorios)
+void fs_dcache_flush(void) {
+    memset(dcache, 0, sizeof(dcache));
+    for (int i = 0; i < DIR_INDEXES; i++) dix[i].valid = 0;
+}
+
+// Tras formatear o montar otro disco nada de lo recordado sigue valiendo
+static void dir_reset(void) {
+    fs_dcache_flush();
+    cwd = 0;
+}
+
+// =============================================================================
+// BÚSQUEDA Y RESOLUCIÓN DE RUTAS
+// =============================================================================
+// Recorre el directorio sector a sector. Las entradas se ocupan siempre en
+// el primer hueco libre, así que tras una entrada 0x00 ya no puede haber
+// archivos. Sólo se usa con los directorios que no caben en un índice.
+static uint32_t dir_scan(uint16_t dir, const char name[11], fat16_dir_entry *e) {
+    uint8_t sec[SECTOR_SIZE];
+    uint16_t cluster = 0;
+    uint32_t lba;
+    dix_stats.scans++;
+    for (uint32_t n = 0; (lba = dir_sector(dir, n, &cluster)) != 0; n++) {
+        read_sector(lba, sec);
+        const fat16_dir_entry *de = (const fat16_dir_entry *)sec;
+        for (int j = 0; j < DIR_PER_SECTOR; j++) {
+            if (de[j].name[0] == 0x00) return 0;
+            if (!memcmp(de[j].name, name, 11)) {
+                memcpy(e, &de[j], sizeof(*e));
+                return lba * DIR_PER_SECTOR + j;
+            }
+        }
+    }
+    return 0;
+}
+
+// Busca un nombre rellenado en el directorio 'dir': primero en la caché de
+// nombres, luego en el índice del directorio (o recorriéndolo).
+// Retorna la dirección de la entrada, que deja en *e, o 0 si no existe.
+static uint32_t dir_lookup(uint16_t dir, const char name[11], fat16_dir_entry *e) {
+    uint32_t h = name_hash(dir, name);
+    dcache_entry *d = &dcache[h & (DCACHE_SIZE - 1)];
+    if (d->valid && d->dir == dir && !memcmp(d->name, name, 11)) {
+        if (!d->ent && d->gen == dir_gen) {
+            dcache_stats.hits++;
+            TRACE(TRACE_LOOKUP, -1, 1);
+            return 0;
+        }
+        if (d->ent) {
+            dir_read_entry(d->ent, e);
+            if (!memcmp(e->name, name, 11)) {
+                dcache_stats.hits++;
+                TRACE(TRACE_LOOKUP, d->ent, 1);
+                return d->ent;
+            }
+        }
+    }
+    dcache_stats.misses++;
+
+    dir_index *x = dix_get(dir);
+    uint32_t ent = x ? dix_lookup(x, h, name, e) : dir_scan(dir, name, e);
+    dcache_insert(dir, name, ent);
+    TRACE(TRACE_LOOKUP, ent ? (int)ent : -1, 0);
+    return ent;
+}
+
+// Copia el siguiente componente de la ruta en 'name' (rellenado, como
+// mucho 11 caracteres) y avanza *path. Retorna 0 si no quedan componentes.
+static int path_next(const char **path, char name[11]) {
+    const char *p = *path;
+    while (*p == '/') p++;
+    if (!*p) return 0;
+    memset(name, ' ', 11);
+    for (int i = 0; *p && *p != '/'; p++, i++) {
+        if (i < 11) name[i] = *p;
+    }
+    *path = p;
+    return 1;
+}
+
+// Directorio al que se llega desde 'dir' por el componente 'name', o -1
+static int dir_step(uint16_t dir, const char name[11]) {
+    fat16_dir_entry e;
+    if (!dir && name_is_dot(name)) return 0;   // El raíz no tiene "." ni ".."
+    if (!dir_lookup(dir, name, &e) || !is_dir(&e)) return -1;
+    return e.first_cluster;
+}
+
+// Resuelve 'path' (absoluta o relativa al directorio actual) salvo el
+// último componente, que se deja rellenado en 'last' (en blanco si la ruta
+// es el propio directorio, como "/"). En *dir queda el directorio que lo
+// contiene. Retorna 0 si un componente intermedio no es un directorio.
+static int path_parent(const char *path, uint16_t *dir, char last[11]) {
+    int d = path[0] == '/' ? 0 : cwd;
+    char name[11];
+    memset(last, ' ', 11);
+    while (path_next(&path, name)) {
+        if (last[0] != ' ' && (d = dir_step(d, last)) < 0) return 0;
+        memcpy(last, name, 11);
+    }
+    *dir = d;
+    return 1;
+}
+
+// Directorio al que lleva la ruta completa, o -1 si no existe
+static int path_dir(const char *path) {
+    uint16_t dir;
+    char last[11];
+    if (!path_parent(path, &dir, last)) return -1;
+    return last[0] == ' ' ? dir : dir_step(dir, last);
+}
+
+// =============================================================================
+// OPERACIONES BÁSICAS DEL SISTEMA DE ARCHIVOS
+// =============================================================================
+// Estas funciones implementan las operaciones esenciales que esperamos
+// de cualquier sistema de archivos: buscar, listar, crear, leer, escribir, etc.
+// Busca un archivo o directorio por su ruta
+// Los nombres en FAT16 son de exactamente 11 caracteres (8.3 format)
+// Retorna 1 si lo encuentra (en *idx queda la dirección de su entrada)
+int fs_find(const char *name, fat16_dir_entry *e, int *idx) {
+    uint16_t dir;
+    char last[11];
+    if (!path_parent(name, &dir, last) || last[0] == ' ') return 0;
+    *idx = dir_lookup(dir, last, e);
+    return *idx != 0;
+}
+
+int fs_chdir(const char *path) {
+    int dir = path_dir(path);
+    if (dir < 0) return 0;
+    cwd = dir;
+    return 1;
+}
+
+static void dir_open(uint16_t dir, fs_dir *d) {
+    d->dir = dir;
+    d->n = 0;
+    d->slot = DIR_PER_SECTOR;   // Cargar el primer sector en fs_readdir
+    d->done = 0;
+}
+
+// Nombre sin relleno de la entrada que apunta al subdirectorio 'child'
+// dentro de 'parent'. Retorna 0 si no aparece.
+static int dir_child_name(uint16_t parent, uint16_t child, char *out) {
+    fs_dir d;
+    fat16_dir_entry e;
+    dir_open(parent, &d);
+    while (fs_readdir(&d, &e)) {
+        if (!is_dir(&e) || e.first_cluster != child) continue;
+        int k = 11;
+        while (k > 0 && e.name[k - 1] == ' ') k--;
+        memcpy(out, e.name, k);
+        out[k] = '\0';
+        return 1;
+    }
+    return 0;
+}
+
+// Ruta absoluta del directorio actual. No se guarda en ningún sitio: se
+// sube por las entradas ".." y en cada padre se busca el nombre del hijo,
+// así sigue siendo correcta aunque se renombre un directorio intermedio.
+void fs_getcwd(char *buf, uint32_t size) {
+    char tmp[FS_PATH_MAX], name[12];
+    uint32_t pos = sizeof(tmp) - 1;
+    tmp[pos] = '\0';
+    for (uint16_t dir = cwd; dir; ) {
+        uint16_t parent = dir_parent(dir);
+        if (!dir_child_name(parent, dir, name)) memcpy(name, "?", 2);
+        uint32_t len = strlen(name);
+        if (len + 1 > pos) break;
+        pos -= len;
+        memcpy(tmp + pos, name, len);
+        tmp[--pos] = '/';
+        dir = parent;
+    }
+    if (!tmp[pos]) tmp[--pos] = '/';
+    uint32_t len = sizeof(tmp) - 1 - pos;
+    if (len >= size) len = size - 1;
+    memcpy(buf, tmp + pos, len);
+    buf[len] = '\0';
+}
+
+int fs_opendir(const char *path, fs_dir *d) {
+    int dir = path_dir(path);
+    if (dir < 0) return 0;
+    dir_open(dir, d);
+    return 1;
+}
+
+// Siguiente entrada del directorio, sin "." ni "..". Retorna 0 al final.
+int fs_readdir(fs_dir *d, fat16_dir_entry *e) {
+    while (!d->done) {
+        if (d->slot == DIR_PER_SECTOR) {
+            d->lba = dir_sector(d->dir, d->n++, &d->cluster);
+            d->slot = 0;
+            if (!d->lba) break;
+        }
+        dir_read_entry(d->lba * DIR_PER_SECTOR + d->slot++, e);
+        if (e->name[0] == 0x00) break;
+        if ((uint8_t)e->name[0] == 0xE5 || name_is_dot(e->name)) continue;
+        return 1;
+    }
+    d->done = 1;
+    return 0;
+}
+
+// Suma a cluster_refs las entradas de 'dir' y de sus subdirectorios
+// ('depth' corta los ciclos de una imagen corrupta)
+static void refs_count_dir(uint16_t dir, int depth) {
+    fs_dir d;
+    fat16_dir_entry e;
+    dir_open(dir, &d);
+    while (fs_readdir(&d, &e)) {
+        uint16_t c = e.first_cluster;
+        if (c < 2 || c >= CLUSTER_LIMIT) continue;
+        if (cluster_refs[c] < REF_MAX) cluster_refs[c]++;
+        if (is_dir(&e) && depth < 64) refs_count_dir(c, depth + 1);
+    }
+}
+
+// Recalcula las referencias de todos los clusters: una por cada entrada de
+// la FAT que apunta a él y una por cada entrada de directorio
+static void refs_rebuild(void) {
+    memset(cluster_refs, 0, sizeof(cluster_refs));
+    for (uint32_t c = 2; c < CLUSTER_LIMIT; c++) {
+        uint16_t next = fat_next(c);
+        if (next && next < CLUSTER_LIMIT && cluster_refs[next] < REF_MAX) cluster_refs[next]++;
+    }
+    refs_count_dir(0, 0);
+}
+
+void fs_ls(const char *path) {
+    fs_dir d;
+    fat16_dir_entry e; char fname[12];
+    if (!path || !*path) path = ".";
+    if (!fs_opendir(path, &d)) {
+        printf("Directorio no encontrado: %s\n", path);
+        return;
+    }
+    while (fs_readdir(&d, &e)) {
+        memcpy(fname, e.name, 11);
+        fname[11] = '\0';
+        if (is_dir(&e)) printf("%s  <DIR>\n", fname);
+        else printf("%s  %u bytes\n", fname, e.size);
+    }
+}
+
+// Busca dónde añadir una entrada recorriendo el directorio: la primera
+// libre o borrada. Si un subdirectorio está lleno se alarga con un cluster
+// vacío (*grew = 1). Retorna la dirección o 0 (*no_space si faltó disco).
+static uint32_t dir_find_free(uint16_t dir, int *grew, int *no_space) {
+    uint8_t sec[SECTOR_SIZE];
+    uint16_t cluster = 0, last = 0;
+    uint32_t lba;
+    *grew = 0;
+    for (uint32_t n = 0; (lba = dir_sector(dir, n, &cluster)) != 0; n++) {
+        read_sector(lba, sec);
+        const fat16_dir_entry *de = (const fat16_dir_entry *)sec;
+        for (int j = 0; j < DIR_PER_SECTOR; j++) {
+            if (de[j].name[0] == 0x00 || (uint8_t)de[j].name[0] == 0xE5)
+                return lba * DIR_PER_SECTOR + j;
+        }
+        last = cluster;
+    }
+    if (!dir) return 0;   // Directorio raíz lleno
+
+    uint16_t next = fs_alloc_cluster();
+    if (!next) {
+        *no_space = 1;
+        return 0;
+    }
+    memset(sec, 0, SECTOR_SIZE);
+    write_sector(CLUSTER_SECTOR(next), sec);
+    fat_set(last, next);
+    *grew = 1;
+    return CLUSTER_SECTOR(next) * DIR_PER_SECTOR;
+}
+
+// Escribe la entrada 'e' en un hueco libre de 'dir' y la registra en el
+// índice y en la caché de nombres. Retorna su dirección o 0 si no cabe.
+static uint32_t dir_add(uint16_t dir, const fat16_dir_entry *e, int *no_space) {
+    dir_index *x = dix_get(dir);
+    uint32_t ent;
+    int grew = 0;
+    *no_space = 0;
+    if (x && x->nholes) {
+        ent = x->holes[--x->nholes];
+    } else if (x && x->end) {
+        ent = x->end;
+        x->end = dir_next_ent(dir, ent);
+    } else {
+        ent = dir_find_free(dir, &grew, no_space);
+        if (!ent) return 0;
+        if (x && grew) x->end = dir_next_ent(dir, ent);
+    }
+    dir_write_entry(ent, e);
+    if (x) dix_put(x, name_hash(dir, e->name), ent);
+
+    // Un nombre nuevo invalida los fallos guardados en la caché
+    dir_gen++;
+    dcache_insert(dir, e->name, ent);
+    return ent;
+}
+
+// Marca como borrada la entrada 'ent' de 'dir' ('e' es su contenido)
+static void dir_remove(uint16_t dir, uint32_t ent, fat16_dir_entry *e) {
+    dir_index *x = dix_find(dir);
+    if (x) {
+        dix_remove(x, name_hash(dir, e->name), ent);
+        if (x->nholes < DIX_HOLES) x->holes[x->nholes++] = ent;
+    }
+    dcache_insert(dir, e->name, 0);
+    e->name[0] = 0xE5;
+    dir_write_entry(ent, e);
+}
+
+// 1 si el subdirectorio sólo contiene "." y ".."
+static int dir_is_empty(uint16_t dir) {
+    fs_dir d;
+    fat16_dir_entry e;
+    dir_open(dir, &d);
+    return !fs_readdir(&d, &e);
+}
+
+#define CREATE_NOSPACE 1   // No quedan clusters libres
+#define CREATE_FULL    2   // Directorio raíz lleno
+#define CREATE_NOPATH  3   // El directorio de destino no existe o el nombre no vale
+
+// Crear archivo o directorio sin verificar si existe (para uso interno)
+// Retorna la dirección de la nueva entrada (y la deja en *e), o 0 con el
+// motivo en *err
+static uint32_t fs_create_internal(const char *name, uint8_t attr, fat16_dir_entry *e, int *err) {
+    uint16_t dir;
+    char last[11];
+    int no_space;
+    *err = CREATE_NOPATH;
+    if (!path_parent(name, &dir, last) || last[0] == ' ' || name_is_dot(last)) return 0;
+    
+    // Asignar un cluster libre
+    uint16_t cluster = fs_alloc_cluster();
+    if (cluster == 0) {
+        *err = CREATE_NOSPACE;
+        return 0;  // No hay espacio
+    }
+    
+    // El primer sector: vacío, o con "." y ".." si es un directorio
+    uint8_t sec[SECTOR_SIZE];
+    memset(sec, 0, SECTOR_SIZE);
+    if (attr & FAT_ATTR_DIRECTORY) {
+        fat16_dir_entry *dots = (fat16_dir_entry *)sec;
+        fs_pad_name(".", dots[0].name);
+        dots[0].attr = FAT_ATTR_DIRECTORY;
+        dots[0].first_cluster = cluster;
+        fs_pad_name("..", dots[1].name);
+        dots[1].attr = FAT_ATTR_DIRECTORY;
+        dots[1].first_cluster = dir;
+    }
+    write_sector(CLUSTER_SECTOR(cluster), sec);
+    
+    memset(e, 0, sizeof(*e));
+    memcpy(e->name, last, 11);
+    e->attr = attr;
+    e->first_cluster = cluster;
+    e->size = 0;
+    uint32_t ent = dir_add(dir, e, &no_space);
+    if (!ent) {
+        fs_free_chain(cluster);
+        *err = no_space ? CREATE_NOSPACE : CREATE_FULL;
+    }
+    return ent;
+}
+
+static void create_error(int err, const char *name) {
+    if (err == CREATE_NOSPACE) printf("Error: No hay espacio disponible\n");
+    else if (err == CREATE_FULL) printf("Error: Directorio raíz lleno\n");
+    else printf("Error: Ruta no valida: %s\n", name);
+}
+
+void fs_touch(const char *name) {
+    fat16_dir_entry e; int idx, err;
+    
+    // Verificar si el archivo ya existe
+    if (fs_find(name, &e, &idx)) {
+        printf("El archivo ya existe: %s\n", name);
+        return;
+    }
+    
+    if (fs_create_internal(name, 0, &e, &err)) {
+        printf("Archivo creado: %s\n", name);
+    } else {
+        create_error(err, name);
+    }
+}
+
+void fs_mkdir(const char *name) {
+    fat16_dir_entry e; int idx, err;
+    if (fs_find(name, &e, &idx)) {
+        printf("Ya existe: %s\n", name);
+        return;
+    }
+    if (fs_create_internal(name, FAT_ATTR_DIRECTORY, &e, &err)) {
+        printf("Directorio creado: %s\n", name);
+    } else {
+        create_error(err, name);
+    }
+}
+
+// =============================================================================
+// TABLA DE ARCHIVOS ABIERTOS E INODOS EN MEMORIA
+// =============================================================================
+// Igual que en UNIX, abrir un archivo resuelve su nombre una sola vez y
+// devuelve un descriptor (un índice en fs_files). Cada archivo abierto
+// guarda su posición y su estado de lectura anticipada, y apunta a un
+// inodo en memoria compartido por todos los descriptores del mismo archivo.
+// El inodo recuerda el primer cluster, el tamaño y un mapa de los primeros
+// clusters de la cadena, así que leer o escribir en mitad del archivo no
+// obliga a recorrer la FAT desde el principio. Los inodos sin usar se
+// quedan en caché hasta que hace falta su hueco.
+#define MAX_OPEN_FILES 16
+#define INODE_CACHE    24    // Más que MAX_OPEN_FILES: siempre hay hueco
+#define INODE_MAP_SIZE 64    // Clusters recordados por inodo
+
+typedef struct {
+    int      dir_index;       // Dirección de su entrada de directorio (-1 = libre)
+    int      refcount;        // Descriptores abiertos que lo usan
+    uint16_t first_cluster;
+    uint32_t size;
+    uint16_t map[INODE_MAP_SIZE];  // map[i] = cluster i del archivo
+    uint32_t mapped;               // Entradas válidas al principio de map
+    uint32_t cur_index;            // Cursor para clusters más allá del mapa
+    uint16_t cur_cluster;
+    uint32_t private_upto;         // Clusters iniciales que no comparte con nadie
+    uint8_t  flags;                // reserved[0] de la entrada (FAT_FLAG_*)
+    uint32_t last_use;
+    uint32_t tix_from;             // Primer byte cambiado desde que se indexó (TIX_CLEAN = ninguno)
+} fs_inode;
+
+typedef struct {
+    fs_inode *inode;          // NULL = descriptor libre
+    uint32_t  pos;
+    int       flags;
+    ra_stream ra;
+} fs_file;
+
+#define TIX_CLEAN 0xFFFFFFFFu
+
+static void comp_forget(const fs_inode *ino);
+static void tix_refresh(fs_inode *ino);
+
+// Anota que el contenido de 'ino' cambió desde el byte 'from': el índice de
+// trigramas se pone al día al cerrar el último descriptor
+static void tix_note(fs_inode *ino, uint32_t from) {
+    if (from < ino->tix_from) ino->tix_from = from;
+}
+
+static fs_inode fs_inodes[INODE_CACHE];
+static fs_file  fs_files[MAX_OPEN_FILES];
+static uint32_t inode_clock = 0;
+static int      inodes_ready = 0;
+static struct { uint32_t hits, misses; } inode_stats;
+
+// Obtiene (y referencia) el inodo de la entrada con dirección 'idx'
+static fs_inode *inode_get(int idx, const fat16_dir_entry *e) {
+    fs_inode *victim = 0;
+    if (!inodes_ready) {
+        for (int i = 0; i < INODE_CACHE; i++) fs_inodes[i].dir_index = -1;
+        inodes_ready = 1;
+    }
+    inode_clock++;
+    for (int i = 0; i < INODE_CACHE; i++) {
+        fs_inode *ino = &fs_inodes[i];
+        if (ino->dir_index == idx) {
+            inode_stats.hits++;
+            ino->refcount++;
+            ino->last_use = inode_clock;
+            return ino;
+        }
+        if (ino->refcount == 0 && (!victim || ino->last_use < victim->last_use)) victim = ino;
+    }
+    inode_stats.misses++;
+    if (!victim) return 0;
+    victim->dir_index = idx;
+    victim->refcount = 1;
+    victim->first_cluster = e->first_cluster;
+    victim->size = e->size;
+    victim->map[0] = e->first_cluster;
+    victim->mapped = 1;
+    victim->cur_index = 0;
+    victim->cur_cluster = e->first_cluster;
+    victim->private_upto = 0;
+    victim->flags = e->reserved[0];
+    victim->last_use = inode_clock;
+    victim->tix_from = TIX_CLEAN;
+    comp_forget(victim);
+    return victim;
+}
+
+// Busca un inodo en caché sin referenciarlo
+static fs_inode *inode_find(int idx) {
+    if (!inodes_ready) return 0;
+    for (int i = 0; i < INODE_CACHE; i++) {
+        if (fs_inodes[i].dir_index == idx) return &fs_inodes[i];
+    }
+    return 0;
+}
+
+// Guarda tamaño, primer cluster y banderas en la entrada del directorio
+static void inode_sync(fs_inode *ino) {
+    fat16_dir_entry e;
+    dir_read_entry(ino->dir_index, &e);
+    e.size = ino->size;
+    e.first_cluster = ino->first_cluster;
+    e.reserved[0] = ino->flags;
+    dir_write_entry(ino->dir_index, &e);
+}
+
+static void inode_remember(fs_inode *ino, uint32_t index, uint16_t cluster) {
+    if (index < INODE_MAP_SIZE) {
+        if (index == ino->mapped) {
+            ino->map[index] = cluster;
+            ino->mapped++;
+        }
+    } else {
+        ino->cur_index = index;
+        ino->cur_cluster = cluster;
+    }
+}
+
+// Cluster que ocupa la posición 'index' del archivo. Si la cadena es más
+// corta y 'alloc' es distinto de 0, se alarga con clusters nuevos (en *fresh
+// se indica si el cluster devuelto se acaba de asignar). Retorna 0 si no hay.
+static uint16_t inode_cluster(fs_inode *ino, uint32_t index, int alloc, int *fresh) {
+    if (fresh) *fresh = 0;
+    if (index < ino->mapped) return ino->map[index];
+    
+    // Continuar desde el punto conocido más cercano
+    uint32_t i = ino->mapped - 1;
+    uint16_t c = ino->map[i];
+    if (ino->cur_index > i && ino->cur_index <= index) {
+        i = ino->cur_index;
+        c = ino->cur_cluster;
+    }
+    while (i < index) {
+        uint16_t next = fat_next(c);
+        if (!next) {
+            if (!alloc) return 0;
+            next = fs_alloc_cluster();
+            if (!next) return 0;
+            fat_set(c, next);
+            if (i + 1 == index) {
+                if (fresh) *fresh = 1;
+            } else {
+                // Hueco intermedio (seek más allá del final): debe leerse como ceros
+                uint8_t zero[SECTOR_SIZE];
+                memset(zero, 0, SECTOR_SIZE);
+                write_sector(CLUSTER_SECTOR(next), zero);
+            }
+        }
+        c = next;
+        i++;
+        inode_remember(ino, i, c);
+    }
+    return c;
+}
+
+// Olvida lo que se sabe de la cadena a partir del cluster 'keep', porque
+// esos clusters se han liberado o sustituido
+static void inode_unmap(fs_inode *ino, uint32_t keep) {
+    ino->map[0] = ino->first_cluster;
+    if (ino->mapped > keep) ino->mapped = keep ? keep : 1;
+    if (ino->cur_index >= keep) {
+        ino->cur_index = 0;
+        ino->cur_cluster = ino->first_cluster;
+    }
+    if (ino->private_upto > keep) ino->private_upto = keep;
+    comp_forget(ino);
+    // Las lecturas anticipadas en curso pueden apuntar a clusters liberados
+    for (int i = 0; i < MAX_OPEN_FILES; i++) {
+        if (fs_files[i].inode == ino) ra_reset(&fs_files[i].ra);
+    }
+}
+
+// Hace privados los clusters 0..index del archivo (o hasta el final de la
+// cadena si es más corta) antes de modificar alguno o su entrada de la FAT.
+// Desde el primer cluster compartido hasta 'index' se copian a clusters
+// nuevos; el último de la copia apunta a la cola antigua, que sigue
+// compartida. Con 'overwrite' el llamador va a reescribir entero el cluster
+// 'index' y no hace falta copiar su contenido. Retorna 0 si no hay espacio.
+static int inode_unshare(fs_inode *ino, uint32_t index, int overwrite) {
+    uint32_t i = ino->private_upto;
+    if (i > index) return 1;
+    uint16_t c = inode_cluster(ino, i, 0, 0);
+    while (c && cluster_refs[c] <= 1) {
+        ino->private_upto = ++i;
+        if (i > index) return 1;
+        c = inode_cluster(ino, i, 0, 0);
+    }
+    if (!c) return 1;
+    
+    // Copiar el tramo i..index (o hasta el final) a una cadena nueva
+    uint8_t sec[SECTOR_SIZE];
+    uint16_t head = 0, prev = 0, tail = c, old = c;
+    uint32_t last = i;
+    for (;;) {
+        uint16_t nc = fs_alloc_cluster();
+        if (!nc) {
+            if (head) fs_free_chain(head);
+            return 0;
+        }
+        if (prev) fat_set(prev, nc);
+        else head = nc;
+        prev = nc;
+        if (!overwrite || last != index) {
+            read_sector(CLUSTER_SECTOR(tail), sec);
+            write_sector(CLUSTER_SECTOR(nc), sec);
+            cluster_stats.cow_copies++;
+        }
+        uint16_t next = fat_next(tail);
+        if (last == index || !next) break;
+        tail = next;
+        last++;
+    }
+    
+    // La copia sustituye al tramo en esta cadena: hereda la cola antigua
+    // (que gana una referencia) y el primer cluster copiado pierde una
+    uint16_t rest = fat_next(tail);
+    if (rest) {
+        fat_set(prev, rest);
+        cluster_refs[rest]++;
+    }
+    if (i == 0) {
+        ino->first_cluster = head;
+        inode_sync(ino);
+    } else {
+        fat_set(inode_cluster(ino, i - 1, 0, 0), head);
+    }
+    cluster_refs[old]--;
+    inode_unmap(ino, i);
+    ino->private_upto = last + 1;
+    return 1;
+}
+
+// Recorta el archivo a 'size' bytes (siempre conserva el primer cluster)
+// Retorna 0 si el último cluster era compartido y no hay espacio para copiarlo
+static int inode_truncate(fs_inode *ino, uint32_t size) {
+    uint32_t keep = size ? (size + SECTOR_SIZE - 1) / SECTOR_SIZE : 1;
+    uint16_t last = inode_cluster(ino, keep - 1, 0, 0);
+    // Lo que queda tras el nuevo final debe leerse como ceros si el
+    // archivo vuelve a crecer más adelante
+    // (si el archivo queda vacío, su único cluster entero)
+    int clear = last && size < ino->size && (size % SECTOR_SIZE || size == 0);
+    if (last && (clear || fat_next(last))) {
+        // Se va a modificar el último cluster o su entrada de la FAT
+        if (!inode_unshare(ino, keep - 1, 0)) return 0;
+        last = inode_cluster(ino, keep - 1, 0, 0);
+        uint16_t rest = fat_next(last);
+        if (rest) {
+            fat_set(last, 0xFFFF);
+            fs_free_chain(rest);
+        }
+    }
+    inode_unmap(ino, keep);
+    if (size < ino->size) {
+        if (clear) {
+            uint8_t sec[SECTOR_SIZE];
+            read_sector(CLUSTER_SECTOR(last), sec);
+            memset(sec + size % SECTOR_SIZE, 0, SECTOR_SIZE - size % SECTOR_SIZE);
+            write_sector(CLUSTER_SECTOR(last), sec);
+        }
+        tix_note(ino, size);
+        ino->size = size;
+        inode_sync(ino);
+    }
+    return 1;
+}
+
+static fs_file *fs_get_file(int fd) {
+    if (fd < 0 || fd >= MAX_OPEN_FILES || !fs_files[fd].inode) return 0;
+    return &fs_files[fd];
+}
+
+// =============================================================================
+// ARCHIVOS COMPRIMIDOS
+// =============================================================================
+// Formato en fat16.h. Cada bloque se comprime por separado, así que leer en
+// cualquier posición sólo descomprime el bloque que la contiene; los últimos
+// bloques descomprimidos se guardan en una caché pequeña para que una
+// lectura secuencial descomprima cada bloque una sola vez. La tabla se lee
+// fuera de la lectura anticipada, que así sólo ve los bloques en orden.
+// Escribir en un archivo comprimido no está soportado: abrirlo para
+// escritura lo descomprime antes (ver fs_open_entry).
+#define COMP_CACHE      2
+#define COMP_MAX_BLOCKS (DATA_CLUSTERS * SECTOR_SIZE / FAT_COMP_BLOCK + 1)
+
+typedef struct {
+    const fs_inode *ino;      // NULL = libre
+    uint32_t block, last_use;
+    uint8_t  data[FAT_COMP_BLOCK];
+} comp_slot;
+
+static comp_slot comp_cache[COMP_CACHE];
+static uint32_t  comp_clock;
+static uint32_t  comp_table[COMP_MAX_BLOCKS];   // Tabla del archivo que se comprime
+static uint8_t   comp_in[FAT_COMP_BLOCK];        // Bloque sin comprimir
+static uint8_t   comp_out[FAT_COMP_BLOCK];       // Bloque comprimido
+static struct { uint32_t decoded, hits; } comp_stats;
+
+// Olvida los bloques descomprimidos de un inodo cuyo contenido cambia
+static void comp_forget(const fs_inode *ino) {
+    for (int i = 0; i < COMP_CACHE; i++) {
+        if (comp_cache[i].ino == ino) comp_cache[i].ino = 0;
+    }
+}
+
+static uint32_t comp_blocks(const fs_inode *ino) {
+    return (ino->size + FAT_COMP_BLOCK - 1) / FAT_COMP_BLOCK;
+}
+
+static uint32_t comp_block_len(const fs_inode *ino, uint32_t block) {
+    uint32_t left = ino->size - block * FAT_COMP_BLOCK;
+    return left < FAT_COMP_BLOCK ? left : FAT_COMP_BLOCK;
+}
+
+// Lee 'len' bytes desde la posición 'off' de la cadena tal como está en el
+// disco; con 'ra' las lecturas pasan por la lectura anticipada del
+// descriptor. Retorna 0 si la cadena es más corta.
+static int comp_read_raw(fs_inode *ino, ra_stream *ra, uint32_t off, void *buf, uint32_t len) {
+    uint8_t *dst = buf;
+    uint8_t sec[SECTOR_SIZE];
+    while (len) {
+        uint32_t index = off / SECTOR_SIZE;
+        uint32_t in_sec = off % SECTOR_SIZE;
+        uint32_t n = SECTOR_SIZE - in_sec;
+        if (n > len) n = len;
+        uint16_t cluster = inode_cluster(ino, index, 0, 0);
+        if (!cluster) return 0;
+        uint8_t *to = (in_sec == 0 && n == SECTOR_SIZE) ? dst : sec;
+        if (ra) ra_read_cluster(ra, index, cluster, to);
+        else read_sector(CLUSTER_SECTOR(cluster), to);
+        if (to == sec) memcpy(dst, sec + in_sec, n);
+        dst += n;
+        off += n;
+        len -= n;
+    }
+    return 1;
+}
+
+// Bloque 'block' del archivo, descomprimido. Retorna 0 si está dañado.
+static const uint8_t *comp_block(fs_inode *ino, ra_stream *ra, uint32_t block) {
+    comp_slot *slot = 0;
+    comp_clock++;
+    for (int i = 0; i < COMP_CACHE; i++) {
+        comp_slot *c = &comp_cache[i];
+        if (c->ino == ino && c->block == block) {
+            comp_stats.hits++;
+            c->last_use = comp_clock;
+            return c->data;
+        }
+        if (!slot || !c->ino || (slot->ino && c->last_use < slot->last_use)) slot = c;
+    }
+    
+    // Límites del bloque: final del anterior (0 para el primero) y el suyo
+    uint32_t bounds[2] = { 0, 0 };
+    int ok = block ? comp_read_raw(ino, 0, (block - 1) * 4, bounds, 8)
+                   : comp_read_raw(ino, 0, 0, &bounds[1], 4);
+    uint32_t want = comp_block_len(ino, block);
+    uint32_t start = comp_blocks(ino) * 4 + bounds[0];
+    uint32_t len = bounds[1] - bounds[0];
+    if (!ok || bounds[1] < bounds[0] || len > want) return 0;
+    
+    slot->ino = 0;
+    if (len == want) {
+        // Guardado sin comprimir
+        if (!comp_read_raw(ino, ra, start, slot->data, len)) return 0;
+    } else if (!comp_read_raw(ino, ra, start, comp_out, len) ||
+               lz_decompress(comp_out, len, slot->data, want) != (int)want) {
+        return 0;
+    }
+    slot->ino = ino;
+    slot->block = block;
+    slot->last_use = comp_clock;
+    comp_stats.decoded++;
+    return slot->data;
+}
+
+// fs_fread para archivos comprimidos ('len' ya está dentro del archivo)
+static int comp_fread(fs_file *f, uint8_t *out, uint32_t len) {
+    uint32_t done = 0;
+    while (done < len) {
+        uint32_t in_block = f->pos % FAT_COMP_BLOCK;
+        const uint8_t *data = comp_block(f->inode, &f->ra, f->pos / FAT_COMP_BLOCK);
+        if (!data) break;
+        uint32_t n = FAT_COMP_BLOCK - in_block;
+        if (n > len - done) n = len - done;
+        memcpy(out + done, data + in_block, n);
+        done += n;
+        f->pos += n;
+    }
+    return done;
+}
+
+// Escritor secuencial de una cadena nueva, cluster a cluster
+typedef struct {
+    uint16_t head, last;
+    uint32_t pos;             // Bytes escritos
+    uint8_t  sec[SECTOR_SIZE];
+} chain_writer;
+
+static int chain_put(chain_writer *w, const void *buf, uint32_t len) {
+    const uint8_t *src = buf;
+    while (len) {
+        uint32_t in_sec = w->pos % SECTOR_SIZE;
+        if (!in_sec) {
+            uint16_t nc = fs_alloc_cluster();
+            if (!nc) return 0;
+            if (w->last) fat_set(w->last, nc);
+            else w->head = nc;
+            w->last = nc;
+            memset(w->sec, 0, SECTOR_SIZE);
+        }
+        uint32_t n = SECTOR_SIZE - in_sec;
+        if (n > len) n = len;
+        memcpy(w->sec + in_sec, src, n);
+        src += n;
+        len -= n;
+        w->pos += n;
+        if (w->pos % SECTOR_SIZE == 0) write_sector(CLUSTER_SECTOR(w->last), w->sec);
+    }
+    return 1;
+}
+
+// Escribe el último cluster a medias. Un archivo tiene siempre un cluster.
+static int chain_finish(chain_writer *w) {
+    if (!w->head && !chain_put(w, "", 1)) return 0;
+    if (w->pos % SECTOR_SIZE) write_sector(CLUSTER_SECTOR(w->last), w->sec);
+    return 1;
+}
+
+// Sustituye el contenido del inodo por la cadena del escritor
+static void comp_swap(fs_inode *ino, chain_writer *w, uint8_t flags) {
+    uint16_t old = ino->first_cluster;
+    ino->first_cluster = w->head;
+    ino->flags = flags;
+    inode_unmap(ino, 0);
+    inode_sync(ino);
+    fs_free_chain(old);
+}
+
+// Bytes que ocupa en el disco el contenido comprimido (tabla incluida)
+static uint32_t comp_stored(fs_inode *ino) {
+    uint32_t n = comp_blocks(ino), end = 0;
+    if (n) comp_read_raw(ino, 0, (n - 1) * 4, &end, 4);
+    return n * 4 + end;
+}
+
+// Escribe la tabla (vacía) y los bloques comprimidos de un archivo normal
+// en la cadena del escritor. Retorna 1, -1 si no hay espacio o -3 si ya
+// ocupa tantos clusters como el original
+static int comp_write_blocks(fs_inode *ino, chain_writer *w) {
+    uint32_t nblocks = comp_blocks(ino);
+    uint32_t clusters = ino->size ? (ino->size + SECTOR_SIZE - 1) / SECTOR_SIZE : 1;
+    if (!nblocks) return -3;
+    
+    memset(comp_out, 0, sizeof(comp_out));
+    for (uint32_t left = nblocks * 4; left; ) {
+        uint32_t n = left < sizeof(comp_out) ? left : sizeof(comp_out);
+        if (!chain_put(w, comp_out, n)) return -1;
+        left -= n;
+    }
+    
+    uint32_t end = 0;
+    for (uint32_t b = 0; b < nblocks; b++) {
+        uint32_t want = comp_block_len(ino, b);
+        for (uint32_t off = 0; off < want; off += SECTOR_SIZE) {
+            uint16_t cluster = inode_cluster(ino, (b * FAT_COMP_BLOCK + off) / SECTOR_SIZE, 0, 0);
+            if (cluster) read_sector(CLUSTER_SECTOR(cluster), comp_in + off);
+            else memset(comp_in + off, 0, SECTOR_SIZE);
+        }
+        uint32_t n = lz_compress(comp_in, want, comp_out, want - 1);
+        if (!chain_put(w, n ? comp_out : comp_in, n ? n : want)) return -1;
+        end += n ? n : want;
+        comp_table[b] = end;
+        if ((w->pos + SECTOR_SIZE - 1) / SECTOR_SIZE >= clusters) return -3;
+    }
+    return chain_finish(w) ? 1 : -1;
+}
+
+// Comprime un archivo normal. Retorna 1, -1 si no hay espacio o -3 si
+// comprimido no ocuparía menos clusters
+static int comp_encode(fs_inode *ino, uint32_t *stored) {
+    chain_writer w;
+    memset(&w, 0, sizeof(w));
+    int r = comp_write_blocks(ino, &w);
+    if (r != 1) {
+        if (w.head) fs_free_chain(w.head);
+        return r;
+    }
+    
+    // Copiar la tabla al principio de la cadena nueva
+    uint8_t sec[SECTOR_SIZE];
+    uint32_t table = comp_blocks(ino) * 4;
+    uint16_t c = w.head;
+    for (uint32_t off = 0; off < table; off += SECTOR_SIZE) {
+        uint32_t n = table - off < SECTOR_SIZE ? table - off : SECTOR_SIZE;
+        read_sector(CLUSTER_SECTOR(c), sec);
+        memcpy(sec, (uint8_t *)comp_table + off, n);
+        write_sector(CLUSTER_SECTOR(c), sec);
+        c = fat_next(c);
+    }
+    *stored = w.pos;
+    comp_swap(ino, &w, ino->flags | FAT_FLAG_COMPRESSED);
+    return 1;
+}
+
+// Descomprime un archivo en una cadena normal. Retorna 1, -1 si no hay
+// espacio o -3 si algún bloque está dañado
+static int comp_decode(fs_inode *ino) {
+    chain_writer w;
+    memset(&w, 0, sizeof(w));
+    int r = 1;
+    for (uint32_t b = 0; r == 1 && b < comp_blocks(ino); b++) {
+        const uint8_t *data = comp_block(ino, 0, b);
+        if (!data) r = -3;
+        else if (!chain_put(&w, data, comp_block_len(ino, b))) r = -1;
+    }
+    if (r == 1 && !chain_finish(&w)) r = -1;
+    if (r != 1) {
+        if (w.head) fs_free_chain(w.head);
+        return r;
+    }
+    comp_swap(ino, &w, ino->flags & ~FAT_FLAG_COMPRESSED);
+    return 1;
+}
+
+// Abre el archivo de la entrada 'idx' (su contenido está en *e)
+static int fs_open_entry(int idx, const fat16_dir_entry *e, int flags) {
+    if (is_dir(e)) return -1;
+    int fd;
+    for (fd = 0; fd < MAX_OPEN_FILES; fd++) {
+        if (!fs_files[fd].inode) break;
+    }
+    if (fd == MAX_OPEN_FILES) return -1;
+    
+    fs_inode *ino = inode_get(idx, e);
+    if (!ino) return -1;
+    fs_files[fd].inode = ino;
+    fs_files[fd].pos = 0;
+    fs_files[fd].flags = flags;
+    ra_reset(&fs_files[fd].ra);
+    
+    if ((flags & O_ACCMODE) != O_RDONLY) {
+        // Para escribir, el archivo se descomprime primero
+        if (((ino->flags & FAT_FLAG_COMPRESSED) && comp_decode(ino) != 1) ||
+            ((flags & O_TRUNC) && !inode_truncate(ino, 0))) {
+            fs_close(fd);
+            return -1;
+        }
+    }
+    return fd;
+}
+
+// Abre un archivo y devuelve su descriptor, o -1 si no existe (y no se pidió
+// O_CREAT), es un directorio, no se pudo crear o no quedan descriptores libres
+int fs_open(const char *name, int flags) {
+    fat16_dir_entry e; int idx, err;
+    if (!fs_find(name, &e, &idx)) {
+        if (!(flags & O_CREAT)) return -1;
+        idx = fs_create_internal(name, 0, &e, &err);
+        if (!idx) return -1;
+    }
+    return fs_open_entry(idx, &e, flags);
+}
+
+void fs_close(int fd) {
+    fs_file *f = fs_get_file(fd);
+    if (!f) return;
+    fs_inode *ino = f->inode;
+    f->inode = 0;
+    if (--ino->refcount == 0 && ino->tix_from != TIX_CLEAN) tix_refresh(ino);
+}
+
+// Lee hasta 'len' bytes desde la posición actual. Retorna los bytes leídos
+// (0 al llegar al final del archivo) o -1 si el descriptor no es válido
+int fs_fread(int fd, void *buf, uint32_t len) {
+    fs_file *f = fs_get_file(fd);
+    if (!f || (f->flags & O_ACCMODE) == O_WRONLY) return -1;
+    fs_inode *ino = f->inode;
+    if (f->pos >= ino->size) return 0;
+    if (len > ino->size - f->pos) len = ino->size - f->pos;
+    
+    uint8_t *out = buf;
+    if (ino->flags & FAT_FLAG_COMPRESSED) return comp_fread(f, out, len);
+    uint8_t sec[SECTOR_SIZE];
+    uint32_t done = 0;
+    while (done < len) {
+        uint32_t index = f->pos / SECTOR_SIZE;
+        uint32_t in_sec = f->pos % SECTOR_SIZE;
+        uint32_t n = SECTOR_SIZE - in_sec;
+        if (n > len - done) n = len - done;
+        
+        uint16_t cluster = inode_cluster(ino, index, 0, 0);
+        if (!cluster) break;  // Cadena más corta que el tamaño
+        if (in_sec == 0 && n == SECTOR_SIZE) {
+            ra_read_cluster(&f->ra, index, cluster, out + done);
+        } else {
+            ra_read_cluster(&f->ra, index, cluster, sec);
+            memcpy(out + done, sec + in_sec, n);
+        }
+        done += n;
+        f->pos += n;
+    }
+    return done;
+}
+
+// Escribe 'len' bytes en la posición actual (al final con O_APPEND),
+// alargando la cadena de clusters si hace falta. Retorna los bytes escritos,
+// que pueden ser menos si el disco se llena, o -1 si el descriptor no es válido
+int fs_fwrite(int fd, const void *buf, uint32_t len) {
+    fs_file *f = fs_get_file(fd);
+    if (!f || (f->flags & O_ACCMODE) == O_RDONLY) return -1;
+    fs_inode *ino = f->inode;
+    if (f->flags & O_APPEND) f->pos = ino->size;
+    uint32_t start = f->pos;
+    
+    const uint8_t *src = buf;
+    uint8_t sec[SECTOR_SIZE];
+    uint32_t done = 0;
+    while (done < len) {
+        uint32_t index = f->pos / SECTOR_SIZE;
+        uint32_t in_sec = f->pos % SECTOR_SIZE;
+        uint32_t n = SECTOR_SIZE - in_sec;
+        if (n > len - done) n = len - done;
+        
+        int fresh;
+        if (!inode_unshare(ino, index, n == SECTOR_SIZE)) break;  // Disco lleno
+        uint16_t cluster = inode_cluster(ino, index, 1, &fresh);
+        if (!cluster) break;
+        
+        if (n == SECTOR_SIZE) {
+            write_sector(CLUSTER_SECTOR(cluster), src + done);
+        } else {
+            // Escritura parcial: leer-modificar-escribir. Lo que queda más
+            // allá del final actual del archivo se rellena con ceros.
+            uint32_t base = index * SECTOR_SIZE;
+            if (fresh || base >= ino->size) {
+                memset(sec, 0, SECTOR_SIZE);
+            } else {
+                read_sector(CLUSTER_SECTOR(cluster), sec);
+                if (ino->size - base < SECTOR_SIZE)
+                    memset(sec + (ino->size - base), 0, SECTOR_SIZE - (ino->size - base));
+            }
+            memcpy(sec + in_sec, src + done, n);
+            write_sector(CLUSTER_SECTOR(cluster), sec);
+        }
+        done += n;
+        f->pos += n;
+    }
+    
+    // Lo que hubiera entre el final y 'start' también es nuevo (ceros)
+    if (done) tix_note(ino, start < ino->size ? start : ino->size);
+    // Un seek más allá del final sólo hace crecer el archivo si se escribe algo
+    if (done && f->pos > ino->size) {
+        ino->size = f->pos;
+        inode_sync(ino);
+    }
+    return done;
+}
+
+// Cambia la posición del descriptor. Retorna la nueva posición o -1
+int fs_lseek(int fd, int offset, int whence) {
+    fs_file *f = fs_get_file(fd);
+    if (!f) return -1;
+    int base;
+    if (whence == SEEK_SET) base = 0;
+    else if (whence == SEEK_CUR) base = f->pos;
+    else if (whence == SEEK_END) base = f->inode->size;
+    else return -1;
+    if (base + offset < 0) return -1;
+    f->pos = base + offset;
+    return f->pos;
+}
+
+int fs_ftruncate(int fd, uint32_t size) {
+    fs_file *f = fs_get_file(fd);
+    if (!f || (f->flags & O_ACCMODE) == O_RDONLY) return -1;
+    return inode_truncate(f->inode, size) ? 0 : -1;
+}
+
+uint32_t fs_fsize(int fd) {
+    fs_file *f = fs_get_file(fd);
+    return f ? f->inode->size : 0;
+}
+
+// Lee un archivo completo (hasta 'max' bytes) siguiendo su cadena de clusters
+// En *size se devuelve el número de bytes copiados al buffer
+int fs_read(const char *name, void *buf, uint32_t max, uint32_t *size) {
+    int fd = fs_open(name, O_RDONLY);
+    if (fd < 0) return 0;
+    int n = fs_fread(fd, buf, max);
+    fs_close(fd);
+    *size = n > 0 ? n : 0;
+    return 1;
+}
+
+// Reemplaza el contenido de un archivo (lo crea si no existe)
+// Reutiliza los clusters que ya tenía y libera los que sobran
+void fs_write(const char *name, const void *buf, uint32_t size) {
+    int fd = fs_open(name, O_WRONLY | O_CREAT);
+    if (fd < 0) {
+        printf("Error: No se pudo crear el archivo %s\n", name);
+        return;
+    }
+    int written = fs_fwrite(fd, buf, size);
+    if (written < (int)size) printf("Error: No hay espacio disponible\n");
+    fs_ftruncate(fd, written > 0 ? written : 0);
+    fs_close(fd);
+}
+
+// Copia un archivo sin copiar sus datos: el destino pasa a compartir la
+// cadena de clusters del origen y cada uno se duplica cuando alguno de los
+// dos lo modifica (ver inode_unshare). Cuesta lo mismo sea cual sea el
+// tamaño. Si el destino es un directorio, la copia se crea dentro con el
+// mismo nombre. Retorna 1 si se copió, 0 si el origen no existe, -1 si
+// el destino no se puede crear o -2 si no queda espacio.
+int fs_copy(const char *src, const char *dst) {
+    char path[FS_PATH_MAX];
+    if (path_dir(dst) >= 0) {
+        const char *base = src;
+        for (const char *p = src; *p; p++) {
+            if (*p == '/') base = p + 1;
+        }
+        uint32_t len = strlen(dst), blen = strlen(base);
+        if (len + blen + 2 > sizeof(path)) return -1;
+        memcpy(path, dst, len);
+        path[len] = '/';
+        memcpy(path + len + 1, base, blen + 1);
+        dst = path;
+    }
+    int in = fs_open(src, O_RDONLY);
+    if (in < 0) return 0;
+    // El destino no se escribe, se le cambia la cadena: abrirlo para
+    // escritura lo descomprimiría en balde
+    int out = fs_open(dst, O_RDONLY | O_CREAT);
+    if (out < 0) {
+        fs_close(in);
+        return -1;
+    }
+    
+    fs_inode *from = fs_files[in].inode, *to = fs_files[out].inode;
+    if (from != to && cluster_refs[from->first_cluster] < REF_MAX) {
+        uint16_t old = to->first_cluster;
+        to->first_cluster = from->first_cluster;
+        to->size = from->size;
+        to->flags = from->flags;
+        cluster_refs[from->first_cluster]++;
+        fs_free_chain(old);
+        // Ninguno de los dos puede ya modificar su cadena sin copiarla
+        from->private_upto = 0;
+        inode_unmap(to, 0);
+        inode_sync(to);
+        tix_note(to, 0);
+        cluster_stats.reflinks++;
+    } else if (from != to) {
+        // Contador saturado: copia de verdad, por bloques
+        uint8_t buf[SECTOR_SIZE];
+        uint32_t total = 0;
+        int n;
+        int r = 1;
+        fs_close(out);
+        out = fs_open(dst, O_WRONLY);
+        while ((n = fs_fread(in, buf, sizeof(buf))) > 0) {
+            if (fs_fwrite(out, buf, n) < n) {
+                r = -2;
+                break;
+            }
+            total += n;
+        }
+        fs_ftruncate(out, total);
+        fs_close(in);
+        fs_close(out);
+        return r;
+    }
+    fs_close(in);
+    fs_close(out);
+    return 1;
+}
+
+void fs_cp(const char *src, const char *dst) {
+    int r = fs_copy(src, dst);
+    if (r == 0) printf("Archivo no encontrado: %s\n", src);
+    else if (r == -2) printf("Error: No hay espacio disponible\n");
+    else if (r < 0) printf("Error: No se pudo crear el archivo %s\n", dst);
+    else printf("Archivo copiado: %s -> %s\n", src, dst);
+}
+
+// Abre 'name' y le aplica una conversión de compresión. *info recibe los
+// tamaños con y sin comprimir.
+static int comp_convert(const char *name, int compress, fs_comp_info *info) {
+    fat16_dir_entry e; int idx;
+    if (!fs_find(name, &e, &idx) || is_dir(&e)) return 0;
+    int fd = fs_open_entry(idx, &e, O_RDONLY);
+    if (fd < 0) return 0;
+    fs_inode *ino = fs_files[fd].inode;
+    int was = (ino->flags & FAT_FLAG_COMPRESSED) != 0;
+    int r;
+    info->size = ino->size;
+    info->stored = was ? comp_stored(ino) : ino->size;
+    if (was == compress) r = -2;
+    else if (compress) r = comp_encode(ino, &info->stored);
+    else r = comp_decode(ino);
+    fs_close(fd);
+    return r;
+}
+
+int fs_compress(const char *name, fs_comp_info *info) {
+    return comp_convert(name, 1, info);
+}
+
+int fs_decompress(const char *name, fs_comp_info *info) {
+    return comp_convert(name, 0, info);
+}
+
+// Renombrar o mover un archivo o directorio
+// Si el destino es un directorio existente, se mueve dentro con el mismo
+// nombre. Dentro del mismo directorio basta con reescribir el nombre; entre
+// directorios la entrada se copia al destino y se borra del origen (los
+// datos no se mueven), y un directorio movido actualiza su "..".
+// Retorna 1 si se movió, 0 si el origen no existe o -1 si el destino no es
+// válido: ya existe, no hay sitio o es un directorio dentro de sí mismo
+int fs_mv(const char *old, const char *new) {
+    fat16_dir_entry e, t;
+    uint16_t src_dir, dst_dir;
+    char src_name[11], dst_name[11];
+    if (!path_parent(old, &src_dir, src_name) || src_name[0] == ' ' || name_is_dot(src_name)) return 0;
+    uint32_t ent = dir_lookup(src_dir, src_name, &e);
+    if (!ent) return 0;
+    if (!path_parent(new, &dst_dir, dst_name)) return -1;
+    
+    int into = name_is_dot(dst_name) ? dir_step(dst_dir, dst_name) : -1;
+    if (dst_name[0] != ' ' && into < 0) {
+        uint32_t found = dir_lookup(dst_dir, dst_name, &t);
+        if (found == ent) return 1;
+        if (found && !is_dir(&t)) return -1;
+        if (found) into = t.first_cluster;
+    }
+    if (into >= 0 || dst_name[0] == ' ') {
+        if (into >= 0) dst_dir = into;
+        memcpy(dst_name, src_name, 11);
+        if (dir_lookup(dst_dir, dst_name, &t)) return dst_dir == src_dir ? 1 : -1;
+    }
+    
+    if (is_dir(&e)) {
+        // Un directorio no puede acabar dentro de su propio subárbol
+        for (uint16_t d = dst_dir, steps = 0; d && steps < DATA_CLUSTERS; d = dir_parent(d), steps++) {
+            if (d == e.first_cluster) return -1;
+        }
+    }
+    
+    if (dst_dir == src_dir) {
+        dir_index *x = dix_find(src_dir);
+        if (x) dix_remove(x, name_hash(src_dir, e.name), ent);
+        dcache_insert(src_dir, e.name, 0);  // El nombre antiguo deja de existir
+        memcpy(e.name, dst_name, 11);       // Copiar el nuevo nombre
+        dir_write_entry(ent, &e);           // Escribir la entrada modificada
+        if (x) dix_put(x, name_hash(src_dir, e.name), ent);
+        dir_gen++;
+        dcache_insert(src_dir, e.name, ent);
+        return 1;
+    }
+    
+    int no_space;
+    t = e;
+    memcpy(t.name, dst_name, 11);
+    uint32_t moved = dir_add(dst_dir, &t, &no_space);
+    if (!moved) return -1;
+    dir_remove(src_dir, ent, &e);
+    // Los descriptores abiertos siguen al archivo
+    fs_inode *ino = inode_find(ent);
+    if (ino) ino->dir_index = moved;
+    tix_moved(ent, moved);
+    if (is_dir(&t)) {
+        uint32_t dotdot = CLUSTER_SECTOR(t.first_cluster) * DIR_PER_SECTOR + 1;
+        dir_read_entry(dotdot, &e);
+        e.first_cluster = dst_dir;
+        dir_write_entry(dotdot, &e);
+    }
+    return 1;
+}
+
+// Eliminar un archivo o un directorio vacío
+// Marca la entrada del directorio como eliminada usando el código 0xE5
+// Retorna 0, -1 si no existe, -2 si está en uso (descriptores abiertos,
+// el directorio actual, "." o "..") o -3 si es un directorio con entradas
+int fs_unlink(const char *name) {
+    fat16_dir_entry e;
+    uint16_t dir;
+    char last[11];
+    if (!path_parent(name, &dir, last) || last[0] == ' ') return -1;
+    uint32_t idx = dir_lookup(dir, last, &e);
+    if (!idx) return -1;
+    if (is_dir(&e)) {
+        if (name_is_dot(last) || e.first_cluster == cwd) return -2;
+        if (!dir_is_empty(e.first_cluster)) return -3;
+        // Sus clusters pueden volver a usarse para cualquier otra cosa
+        dix_drop(e.first_cluster);
+        memset(dcache, 0, sizeof(dcache));
+    }
+    fs_inode *ino = inode_find(idx);
+    if (ino && ino->refcount > 0) return -2;
+    if (ino) ino->dir_index = -1;
+    tix_forget(idx);
+    
+    // Marcar como eliminado con el código especial 0xE5
+    dir_remove(dir, idx, &e);
+    // Devolver sus clusters a la FAT
+    fs_free_chain(e.first_cluster);
+    return 0;
+}
+
+void fs_delete(const char *name) {
+    int r = fs_unlink(name);
+    if (r == -1) printf("Archivo no encontrado: %s\n", name);
+    else if (r == -2) printf("Archivo en uso: %s\n", name);
+    else if (r == -3) printf("Directorio no vacio: %s\n", name);
+    else printf("Archivo eliminado: %s\n", name);
+}
+
+// =============================================================================
+// MOTOR DE EDICIÓN POR LÍNEAS (TABLA DE PIEZAS)
+// =============================================================================
+// edln, delln e insln no reescriben el archivo en cada orden. El primer
+// comando de edición abre una "sesión" sobre el archivo: se recorre una vez
+// para indexar la posición de cada salto de línea, y a partir de ahí el
+// texto se representa como una tabla de piezas (piece table). Cada pieza
+// es un trozo del archivo original o del buffer de añadidos, donde se va
+// guardando el texto nuevo; editar es partir piezas y añadir texto, nunca
+// mover bytes.
+//
+// Con los índices de saltos de línea y las sumas acumuladas de bytes y
+// líneas por pieza, encontrar la línea N son dos búsquedas binarias.
+//
+// Los cambios se vuelcan al disco (edit_sync) antes de ejecutar cualquier
+// otro comando. Sólo se escriben los clusters afectados: desde el primer
+// byte modificado, y si ninguna edición cambió la longitud del archivo,
+// sólo hasta el último. Cuando el resto del archivo se desplaza, esa cola
+// se escribe en clusters nuevos que sustituyen a los antiguos en la cadena,
+// así el original sigue intacto mientras se lee.
+#define EDIT_MAX_PIECES 512
+#define EDIT_ADD_SIZE   8192    // Buffer de texto añadido
+#define EDIT_MAX_LINES  16384   // Saltos de línea indexados del original
+
+typedef struct {
+    uint8_t  add;       // 0 = archivo original, 1 = buffer de añadidos
+    uint32_t off;       // Posición dentro de su origen
+    uint32_t len;
+} edit_piece;
+
+static struct {
+    int        active;
+    int        dirty;
+    uint32_t   ent;                 // Entrada de directorio del archivo
+    char       path[FS_PATH_MAX];   // Ruta tal como se escribió (para mensajes)
+    uint32_t   size;                // Tamaño actual del texto
+    uint32_t   dirty_from;          // Primer byte modificado
+    uint32_t   dirty_to;            // Fin de lo modificado (si no hay desplazamiento)
+    int        shifted;             // Alguna edición cambió la longitud
+    uint32_t   orig_nl[EDIT_MAX_LINES];  // Posiciones de '\n' en el original
+    uint32_t   orig_lines;
+    char       add[EDIT_ADD_SIZE];
+    uint32_t   add_len;
+    uint32_t   add_nl[EDIT_ADD_SIZE];    // Posiciones de '\n' en 'add'
+    uint32_t   add_lines;
+    edit_piece pieces[EDIT_MAX_PIECES];
+    int        npieces;
+    uint32_t   byte_pfx[EDIT_MAX_PIECES + 1];  // Bytes antes de cada pieza
+    uint32_t   line_pfx[EDIT_MAX_PIECES + 1];  // Saltos de línea antes de cada pieza
+} ed;
+
+// Primer índice i con a[i] >= v
+static uint32_t ed_lower_bound(const uint32_t *a, uint32_t n, uint32_t v) {
+    uint32_t lo = 0, hi = n;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (a[mid] < v) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Saltos de línea dentro de [off, off + len) de un origen
+static uint32_t ed_count_lines(int add, uint32_t off, uint32_t len) {
+    const uint32_t *nl = add ? ed.add_nl : ed.orig_nl;
+    uint32_t n = add ? ed.add_lines : ed.orig_lines;
+    return ed_lower_bound(nl, n, off + len) - ed_lower_bound(nl, n, off);
+}
+
+// Recalcula las sumas acumuladas desde la pieza 'from'
+static void ed_reindex(int from) {
+    for (int i = from; i < ed.npieces; i++) {
+        edit_piece *p = &ed.pieces[i];
+        ed.byte_pfx[i + 1] = ed.byte_pfx[i] + p->len;
+        ed.line_pfx[i + 1] = ed.line_pfx[i] + ed_count_lines(p->add, p->off, p->len);
+    }
+    ed.size = ed.byte_pfx[ed.npieces];
+}
+
+// Pieza que contiene el byte 'pos' (npieces si pos es el final)
+static int ed_find_piece(uint32_t pos) {
+    if (pos >= ed.size) return ed.npieces;
+    // Última pieza que empieza en pos o antes
+    return ed_lower_bound(ed.byte_pfx, ed.npieces + 1, pos + 1) - 1;
+}
+
+// Deja un límite de pieza en 'pos' y devuelve el índice de la pieza que
+// empieza ahí
+static int ed_split(uint32_t pos) {
+    int i = ed_find_piece(pos);
+    if (i == ed.npieces || ed.byte_pfx[i] == pos) return i;
+    
+    uint32_t k = pos - ed.byte_pfx[i];
+    for (int j = ed.npieces; j > i + 1; j--) ed.pieces[j] = ed.pieces[j - 1];
+    ed.pieces[i + 1] = ed.pieces[i];
+    ed.pieces[i].len = k;
+    ed.pieces[i + 1].off += k;
+    ed.pieces[i + 1].len -= k;
+    ed.npieces++;
+    ed_reindex(i);
+    return i + 1;
+}
+
+// Byte donde empieza la línea n (1 = primera). Si el texto tiene menos
+// líneas devuelve el tamaño del texto.
+static uint32_t ed_line_start(uint32_t n) {
+    uint32_t k = n - 1;   // Saltos de línea que hay antes de la línea n
+    if (k == 0) return 0;
+    if (k > ed.line_pfx[ed.npieces]) return ed.size;
+    
+    // Pieza que contiene el salto número k, y luego el salto dentro de ella
+    int i = ed_lower_bound(ed.line_pfx, ed.npieces + 1, k) - 1;
+    edit_piece *p = &ed.pieces[i];
+    const uint32_t *nl = p->add ? ed.add_nl : ed.orig_nl;
+    uint32_t n_nl = p->add ? ed.add_lines : ed.orig_lines;
+    uint32_t first = ed_lower_bound(nl, n_nl, p->off);
+    uint32_t at = nl[first + (k - ed.line_pfx[i]) - 1];
+    return ed.byte_pfx[i] + (at - p->off) + 1;
+}
+
+// Sustituye [pos, pos + old_len) por 'text'
+static void ed_replace(uint32_t pos, uint32_t old_len, const char *text, uint32_t len) {
+    int a = ed_split(pos);
+    int b = ed_split(pos + old_len);
+    
+    // Quitar las piezas del rango
+    int removed = b - a;
+    for (int j = a; j + removed < ed.npieces; j++) ed.pieces[j] = ed.pieces[j + removed];
+    ed.npieces -= removed;
+    
+    if (len) {
+        // Añadir el texto al buffer e indexar sus saltos de línea
+        uint32_t off = ed.add_len;
+        for (uint32_t i = 0; i < len; i++) {
+            if (text[i] == '\n') ed.add_nl[ed.add_lines++] = off + i;
+            ed.add[off + i] = text[i];
+        }
+        ed.add_len += len;
+        
+        edit_piece *prev = a > 0 ? &ed.pieces[a - 1] : 0;
+        if (prev && prev->add && prev->off + prev->len == off) {
+            prev->len += len;   // Escritura seguida: alargar la pieza anterior
+            a--;
+        } else {
+            for (int j = ed.npieces; j > a; j--) ed.pieces[j] = ed.pieces[j - 1];
+            ed.pieces[a].add = 1;
+            ed.pieces[a].off = off;
+            ed.pieces[a].len = len;
+            ed.npieces++;
+        }
+    }
+    ed_reindex(a);
+    
+    if (!ed.dirty || pos < ed.dirty_from) ed.dirty_from = pos;
+    if (!ed.dirty || pos + len > ed.dirty_to) ed.dirty_to = pos + len;
+    if (len != old_len) ed.shifted = 1;
+    ed.dirty = 1;
+}
+
+// Copia 'len' bytes del texto desde 'pos'. 'fd' es el archivo original.
+static void ed_read(int fd, uint32_t pos, uint8_t *dst, uint32_t len) {
+    int i = ed_find_piece(pos);
+    while (len > 0 && i < ed.npieces) {
+        edit_piece *p = &ed.pieces[i];
+        uint32_t within = pos - ed.byte_pfx[i];
+        uint32_t n = p->len - within;
+        if (n > len) n = len;
+        if (p->add) {
+            memcpy(dst, ed.add + p->off + within, n);
+        } else {
+            fs_lseek(fd, p->off + within, SEEK_SET);
+            fs_fread(fd, dst, n);
+        }
+        dst += n; pos += n; len -= n;
+        i++;
+    }
+}
+
+// Vuelca los cambios pendientes al disco y cierra la sesión de edición
+void edit_sync(void) {
+    if (!ed.active) return;
+    ed.active = 0;
+    if (!ed.dirty) return;
+    
+    // Se reabre por su entrada: la sesión no depende del directorio actual
+    fat16_dir_entry e;
+    dir_read_entry(ed.ent, &e);
+    int fd = (e.name[0] && (uint8_t)e.name[0] != 0xE5) ? fs_open_entry(ed.ent, &e, O_RDWR) : -1;
+    if (fd < 0) {
+        printf("Error: No se pudieron guardar los cambios en %s\n", ed.path);
+        return;
+    }
+    fs_inode *ino = fs_files[fd].inode;
+    uint8_t sec[SECTOR_SIZE];
+    uint32_t first = ed.dirty_from / SECTOR_SIZE;
+    
+    if (!ed.shifted) {
+        // Misma longitud: reescribir en su sitio sólo los clusters tocados.
+        // Cada cluster depende sólo de los mismos bytes del original.
+        for (uint32_t c = first; c * SECTOR_SIZE < ed.dirty_to; c++) {
+            uint32_t n = ed.size - c * SECTOR_SIZE;
+            if (n > SECTOR_SIZE) n = SECTOR_SIZE;
+            ed_read(fd, c * SECTOR_SIZE, sec, n);
+            fs_lseek(fd, c * SECTOR_SIZE, SEEK_SET);
+            fs_fwrite(fd, sec, n);
+        }
+        fs_close(fd);
+        return;
+    }
+    
+    uint32_t total = ed.size ? (ed.size + SECTOR_SIZE - 1) / SECTOR_SIZE : 1;
+    if (first >= total) {
+        // Sólo se ha quitado texto del final
+        fs_ftruncate(fd, ed.size);
+        fs_close(fd);
+        return;
+    }
+    
+    // La cola desde 'first' va a una cadena nueva
+    uint16_t head = 0, prev = 0;
+    for (uint32_t c = first; c < total; c++) {
+        uint16_t nc = fs_alloc_cluster();
+        if (!nc) {
+            if (head) fs_free_chain(head);
+            printf("Error: No hay espacio disponible, cambios descartados\n");
+            fs_close(fd);
+            return;
+        }
+        if (prev) fat_set(prev, nc);
+        else head = nc;
+        prev = nc;
+        
+        uint32_t n = ed.size > c * SECTOR_SIZE ? ed.size - c * SECTOR_SIZE : 0;
+        if (n > SECTOR_SIZE) n = SECTOR_SIZE;
+        memset(sec, 0, SECTOR_SIZE);
+        ed_read(fd, c * SECTOR_SIZE, sec, n);
+        write_sector(CLUSTER_SECTOR(nc), sec);
+    }
+    
+    // Enganchar la cadena nueva en lugar de la cola antigua, que puede
+    // estar compartida con una copia: el cluster anterior no
+    if (first > 0 && !inode_unshare(ino, first - 1, 0)) {
+        fs_free_chain(head);
+        printf("Error: No hay espacio disponible, cambios descartados\n");
+        fs_close(fd);
+        return;
+    }
+    uint16_t old = inode_cluster(ino, first, 0, 0);
+    if (first == 0) ino->first_cluster = head;
+    else fat_set(inode_cluster(ino, first - 1, 0, 0), head);
+    if (old) fs_free_chain(old);
+    inode_unmap(ino, first);
+    tix_note(ino, first * SECTOR_SIZE);
+    ino->size = ed.size;
+    inode_sync(ino);
+    fs_close(fd);
+}
+
+// Abre (o reutiliza) la sesión de edición de 'name' con hueco para una
+// edición de hasta 'len' bytes. Retorna 0 si el archivo no existe y no se
+// pidió crearlo, o si no se puede indexar.
+static int edit_begin(const char *name, int create, uint32_t len) {
+    fat16_dir_entry e; int idx;
+    if (ed.active && fs_find(name, &e, &idx) && (uint32_t)idx == ed.ent) {
+        // Sin sitio para otra edición: volcar y empezar de nuevo
+        if (ed.npieces + 3 <= EDIT_MAX_PIECES && ed.add_len + len <= EDIT_ADD_SIZE) return 1;
+    }
+    edit_sync();
+    if (len > EDIT_ADD_SIZE) {
+        printf("Error: Edicion demasiado grande\n");
+        return 0;
+    }
+    
+    int fd = fs_open(name, O_RDONLY);
+    if (fd < 0) {
+        if (!create) {
+            printf("Archivo no encontrado: %s\n", name);
+            return 0;
+        }
+        fs_touch(name);  // Crear entrada de directorio
+        fd = fs_open(name, O_RDONLY);
+        if (fd < 0) return 0;
+    }
+    
+    // Indexar los saltos de línea del original (una sola pasada)
+    uint8_t buffer[SECTOR_SIZE];
+    uint32_t pos = 0;
+    int n;
+    ed.orig_lines = 0;
+    while ((n = fs_fread(fd, buffer, sizeof(buffer))) > 0) {
+        for (int i = 0; i < n; i++) {
+            if (buffer[i] != '\n') continue;
+            if (ed.orig_lines == EDIT_MAX_LINES) {
+                printf("Error: %s tiene demasiadas lineas para editar\n", name);
+                fs_close(fd);
+                return 0;
+            }
+            ed.orig_nl[ed.orig_lines++] = pos + i;
+        }
+        pos += n;
+    }
+    ed.ent = fs_files[fd].inode->dir_index;
+    fs_close(fd);
+    
+    uint32_t n_path = strlen(name);
+    if (n_path >= sizeof(ed.path)) n_path = sizeof(ed.path) - 1;
+    memcpy(ed.path, name, n_path);
+    ed.path[n_path] = '\0';
+    ed.add_len = 0;
+    ed.add_lines = 0;
+    ed.npieces = 0;
+    if (pos) {
+        ed.pieces[0].add = 0;
+        ed.pieces[0].off = 0;
+        ed.pieces[0].len = pos;
+        ed.npieces = 1;
+    }
+    ed.byte_pfx[0] = ed.line_pfx[0] = 0;
+    ed_reindex(0);
+    ed.dirty = ed.shifted = 0;
+    ed.active = 1;
+    return 1;
+}
+
+// Saltos de línea que faltan al final para que exista la línea 'line_num'
+static uint32_t edit_missing_lines(uint32_t line_num) {
+    uint32_t have = ed.line_pfx[ed.npieces] + 1;  // Línea en la que acaba el texto
+    return line_num > have ? line_num - have : 0;
+}
+
+// Añade 'n' saltos de línea al final del texto
+static void edit_pad(uint32_t n) {
+    static const char newlines[16] = "\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n";
+    while (n > 0) {
+        uint32_t k = n < sizeof(newlines) ? n : sizeof(newlines);
+        ed_replace(ed.size, 0, newlines, k);
+        n -= k;
+    }
+}
+
+// Editar una línea específica de un archivo
+// Si el archivo no existe, lo crea. Si la línea no existe, extiende el archivo
+void fs_edit_line(const char *name, int line_num, const char *new_text) {
+    char text[SECTOR_SIZE];
+    uint32_t len = strlen(new_text);
+    if (len > SECTOR_SIZE - 1) len = SECTOR_SIZE - 1;
+    memcpy(text, new_text, len);
+    text[len++] = '\n';
+    
+    if (!edit_begin(name, 1, len)) return;
+    uint32_t start = ed_line_start(line_num);
+    if (start < ed.size) {
+        ed_replace(start, ed_line_start(line_num + 1) - start, text, len);
+    } else {
+        // La línea no existe: rellenar con líneas vacías y añadirla al final
+        uint32_t pad = edit_missing_lines(line_num);
+        if (pad && !edit_begin(name, 1, len + pad)) return;
+        edit_pad(pad);
+        ed_replace(ed.size, 0, text, len);
+    }
+    printf("Linea %d editada en archivo: %s\n", line_num, name);
+}
+
+// Eliminar una línea específica de un archivo
+void fs_delete_line(const char *name, int line_num) {
+    if (!edit_begin(name, 0, 0)) return;
+    
+    uint32_t start = ed_line_start(line_num);
+    if (start >= ed.size) {
+        printf("Linea %d no existe en el archivo %s\n", line_num, name);
+        return;
+    }
+    ed_replace(start, ed_line_start(line_num + 1) - start, "", 0);
+    printf("Linea %d eliminada del archivo: %s\n", line_num, name);
+}
+
+// Insertar una línea en blanco en una posición específica
+void fs_insert_line(const char *name, int line_num) {
+    if (!edit_begin(name, 1, 1)) return;
+    
+    uint32_t start = ed_line_start(line_num);
+    if (start < ed.size) {
+        ed_replace(start, 0, "\n", 1);
+    } else {
+        // Más allá del final: líneas vacías hasta la posición
+        uint32_t pad = edit_missing_lines(line_num);
+        if (pad && !edit_begin(name, 1, 1 + pad)) return;
+        edit_pad(pad + 1);
+    }
+    printf("Linea en blanco insertada en posicion %d del archivo: %s\n", line_num, name);
+}
+
+// Mostrar contenido de archivo en hexadecimal
+void fs_hexdump(const char *name) {
+    uint8_t buffer[SECTOR_SIZE];
+    uint32_t file_size = 0;
+    
+    if (!fs_read(name, buffer, sizeof(buffer), &file_size)) {
+        printf("Archivo no encontrado: %s\n", name);
+        return;
+    }
+    
+    printf("=== HEXDUMP de %s (%u bytes) ===\n", name, file_size);
+    for (uint32_t i = 0; i < file_size; i += 16) {
+        printf("%04x: ", i);
+        // Mostrar hex
+        for (int j = 0; j < 16; j++) {
+            if (i + j < file_size) {
+                printf("%02x ", buffer[i + j]);
+            } else {
+                printf("   ");
+            }
+        }
+        printf(" ");
+        // Mostrar ASCII
+        for (int j = 0; j < 16 && i + j < file_size; j++) {
+            char c = buffer[i + j];
+            printf("%c", (c >= 32 && c < 127) ? c : '.');
+        }
+        printf("\n");
+    }
+}
+
+// Contar líneas, palabras y caracteres
+// Recorre el archivo por bloques para que los archivos grandes se lean
+// con lectura anticipada en lugar de cargarse enteros en la pila
+void fs_wc(const char *name) {
+    int fd = fs_open(name, O_RDONLY);
+    if (fd < 0) {
+        printf("Archivo no encontrado: %s\n", name);
+        return;
+    }
+    
+    uint8_t buffer[SECTOR_SIZE];
+    int lines = 0, words = 0, chars = fs_fsize(fd);
+    int in_word = 0;
+    int n;
+    
+    while ((n = fs_fread(fd, buffer, SECTOR_SIZE)) > 0) {
+        for (int i = 0; i < n; i++) {
+            char c = buffer[i];
+            if (c == '\n') lines++;
+            if (c == ' ' || c == '\t' || c == '\n') {
+                if (in_word) {
+                    words++;
+                    in_word = 0;
+                }
+            } else {
+                in_word = 1;
+            }
+        }
+    }
+    fs_close(fd);
+    if (in_word) words++; // Última palabra sin \n
+    
+    printf("%d %d %d %s\n", lines, words, chars, name);
+}
+
+
+// Primera aparición de 'term' (len bytes) en p[0..n): memchr salta hasta
+// el siguiente candidato por su primer byte y memcmp comprueba el resto
+static const uint8_t *mem_find(const uint8_t *p, uint32_t n, const char *term, uint32_t len) {
+    if (!len) return p;
+    while (n >= len) {
+        const uint8_t *hit = memchr(p, (uint8_t)term[0], n - len + 1);
+        if (!hit) return 0;
+        if (!memcmp(hit + 1, term + 1, len - 1)) return hit;
+        n -= hit + 1 - p;
+        p = hit + 1;
+    }
+    return 0;
+}
+
+// Escribe la línea si contiene 'term'. Retorna 1 si la escribió.
+static int grep_line(char *line, int line_len, int line_num, const char *term, uint32_t len,
+                     const char *path) {
+    line[line_len] = '\0';
+    // Buscar patrón simple (sin regex)
+    if (!mem_find((const uint8_t *)line, line_len, term, len)) return 0;
+    if (path) printf("%s:%d: %s\n", path, line_num, line);
+    else printf("%d: %s\n", line_num, line);
+    return 1;
+}
+
+// Escribe las líneas de 'fd' que contienen 'term' ("n: texto", o
+// "ruta:n: texto" si hay 'path'). Retorna cuántas había.
+static int grep_fd(int fd, const char *term, uint32_t len, const char *path) {
+    uint8_t buffer[SECTOR_SIZE];
+    char line[SECTOR_SIZE];
+    int line_len = 0;
+    int line_num = 1;
+    int matches = 0;
+    int n;
+    
+    // Las líneas pueden cruzar el límite entre bloques: se acumulan en 'line'.
+    // memchr salta hasta el siguiente salto de línea y el trozo se copia de
+    // una vez.
+    while ((n = fs_fread(fd, buffer, SECTOR_SIZE)) > 0) {
+        const uint8_t *p = buffer, *end = buffer + n;
+        while (p < end) {
+            const uint8_t *nl = memchr(p, '\n', end - p);
+            int len_part = (nl ? nl : end) - p;
+            if (len_part > SECTOR_SIZE - 1 - line_len) len_part = SECTOR_SIZE - 1 - line_len;
+            memcpy(line + line_len, p, len_part);
+            line_len += len_part;
+            if (!nl) break;
+            matches += grep_line(line, line_len, line_num, term, len, path);
+            line_len = 0;
+            line_num++;
+            p = nl + 1;
+        }
+    }
+    // La última línea puede no terminar en '\n'
+    if (line_len > 0) matches += grep_line(line, line_len, line_num, term, len, path);
+    return matches;
+}
+
+// Buscar texto en archivo
+void fs_grep(const char *pattern, const char *name) {
+    int fd = fs_open(name, O_RDONLY);
+    if (fd < 0) {
+        printf("Archivo no encontrado: %s\n", name);
+        return;
+    }
+    int matches = grep_fd(fd, pattern, strlen(pattern), 0);
+    fs_close(fd);
+    
+    if (matches == 0) {
+        printf("Patron '%s' no encontrado en %s\n", pattern, name);
+    }
+}
+
+// Mostrar primeras líneas de archivo
+void fs_head(const char *name, int lines) {
+    int fd = fs_open(name, O_RDONLY);
+    if (fd < 0) {
+        printf("Archivo no encontrado: %s\n", name);
+        return;
+    }
+    
+    uint8_t buffer[SECTOR_SIZE];
+    int current_line = 1, n;
+    while (current_line <= lines && (n = fs_fread(fd, buffer, sizeof(buffer))) > 0) {
+        for (int i = 0; i < n && current_line <= lines; i++) {
+            putchar(buffer[i]);
+            if (buffer[i] == '\n') current_line++;
+        }
+    }
+    fs_close(fd);
+}
+
+// Mostrar últimas líneas de archivo
+// Se recorre el archivo hacia atrás desde el final, bloque a bloque, hasta
+// encontrar el salto de línea anterior a la primera línea a mostrar
+void fs_tail(const char *name, int lines) {
+    int fd = fs_open(name, O_RDONLY);
+    if (fd < 0) {
+        printf("Archivo no encontrado: %s\n", name);
+        return;
+    }
+    
+    uint8_t buffer[SECTOR_SIZE];
+    uint32_t pos = fs_fsize(fd), start = 0;
+    int seen = 0, n;
+    while (pos > 0) {
+        uint32_t chunk = pos < SECTOR_SIZE ? pos : SECTOR_SIZE;
+        pos -= chunk;
+        fs_lseek(fd, pos, SEEK_SET);
+        n = fs_fread(fd, buffer, chunk);
+        for (int i = n - 1; i >= 0; i--) {
+            if (buffer[i] == '\n' && ++seen > lines) {
+                start = pos + i + 1;
+                goto found;
+            }
+        }
+    }
+found:
+    fs_lseek(fd, start, SEEK_SET);
+    while ((n = fs_fread(fd, buffer, sizeof(buffer))) > 0) {
+        for (int i = 0; i < n; i++) putchar(buffer[i]);
+    }
+    fs_close(fd);
+}
+
+// =============================================================================
+// ÍNDICE DE TRIGRAMAS
+// =============================================================================
+// Para buscar en todo el disco sin leerlo entero. Cada archivo con datos es
+// un documento (una columna) y cada trigrama (tres bytes seguidos) cae en
+// un cubo por hash; el cubo guarda un bit por documento: "este archivo tiene
+// algún trigrama de este cubo". Un término sólo puede estar en los archivos
+// que tienen todos sus trigramas, así que basta con un AND de las filas de
+// sus cubos para saber qué archivos hay que leer. Dos trigramas en el mismo
+// cubo sólo añaden candidatos de más, que la comprobación descarta.
+//
+// El índice es opcional (fs_index_enable) y se mantiene solo: cada
+// escritura o recorte anota en el inodo desde qué byte cambió el archivo
+// (tix_note) y, al cerrarse el último descriptor, tix_refresh indexa sólo
+// lo añadido si lo anterior no cambió o la columna entera si sí. Borrar o
+// mover un archivo sólo toca su documento.
+#define TIX_DOCS    512                  // Archivos indexados como mucho
+#define TIX_WORDS   (TIX_DOCS / 32)
+#define TIX_BUCKETS 4096                 // Cubos de trigramas (potencia de 2)
+#define TIX_BUCKET(w) (((w) * 2654435761u) >> 20)
+
+typedef struct {
+    uint32_t ent;             // Dirección de su entrada de directorio (0 = libre)
+    uint32_t size;            // Bytes indexados
+} tix_doc;
+
+static struct {
+    int      enabled;
+    int      complete;        // 0 si algún archivo se quedó fuera
+    tix_doc  docs[TIX_DOCS];
+    uint32_t bits[TIX_BUCKETS][TIX_WORDS];  // bits[cubo][documento]
+} tix;
+static struct { uint32_t builds, appends, rebuilds, forgets, bytes; } tix_stats;
+
+static int tix_find(uint32_t ent) {
+    for (int d = 0; d < TIX_DOCS; d++) {
+        if (tix.docs[d].ent == ent) return d;
+    }
+    return -1;
+}
+
+static int tix_alloc(uint32_t ent) {
+    int d = tix_find(0);
+    if (d >= 0) {
+        tix.docs[d].ent = ent;
+        tix.docs[d].size = 0;
+    }
+    return d;
+}
+
+// Borra la columna del documento 'd'
+static void tix_clear(int d) {
+    uint32_t word = d / 32, mask = ~(1u << d % 32);
+    for (int b = 0; b < TIX_BUCKETS; b++) tix.bits[b][word] &= mask;
+    tix.docs[d].size = 0;
+}
+
+static void tix_drop(int d) {
+    tix_clear(d);
+    tix.docs[d].ent = 0;
+}
+
+// Marca los trigramas de la entrada 'ent' desde el byte 'from' en la
+// columna 'd'. Retorna 0 si no se pudo abrir (no quedan descriptores).
+static int tix_scan(int d, uint32_t ent, uint32_t from) {
+    fat16_dir_entry e;
+    uint8_t buf[SECTOR_SIZE];
+    uint32_t word = d / 32, bit = 1u << d % 32;
+    uint32_t w = 0, seen = 0;    // Ventana con los tres últimos bytes
+    int n;
+    dir_read_entry(ent, &e);
+    int fd = fs_open_entry(ent, &e, O_RDONLY);
+    if (fd < 0) return 0;
+    fs_lseek(fd, from, SEEK_SET);
+    while ((n = fs_fread(fd, buf, sizeof(buf))) > 0) {
+        for (int i = 0; i < n; i++) {
+            w = (w << 8 | buf[i]) & 0xFFFFFF;
+            if (++seen >= 3) tix.bits[TIX_BUCKET(w)][word] |= bit;
+        }
+        tix_stats.bytes += n;
+    }
+    tix.docs[d].size = fs_fsize(fd);
+    fs_close(fd);
+    return 1;
+}
+
+// Pone al día el documento de un inodo que cambió desde ino->tix_from
+static void tix_refresh(fs_inode *ino) {
+    uint32_t from = ino->tix_from;
+    ino->tix_from = TIX_CLEAN;   // Antes de abrirlo: tix_scan lo vuelve a cerrar
+    if (!tix.enabled || ino->dir_index < 0) return;
+    int d = tix_find(ino->dir_index);
+    if (ino->size == 0) {
+        if (d >= 0) tix_drop(d);
+        return;
+    }
+    if (d >= 0 && from >= tix.docs[d].size) {
+        // Sólo ha crecido: basta con los trigramas que acaban en lo nuevo
+        uint32_t size = tix.docs[d].size;
+        from = size > 2 ? size - 2 : 0;
+        tix_stats.appends++;
+    } else {
+        if (d >= 0) tix_clear(d);
+        else d = tix_alloc(ino->dir_index);
+        if (d < 0) {
+            tix.complete = 0;
+            return;
+        }
+        from = 0;
+        tix_stats.rebuilds++;
+    }
+    if (!tix_scan(d, ino->dir_index, from)) {
+        tix_drop(d);
+        tix.complete = 0;
+    }
+}
+
+// Indexa todos los archivos de 'dir' y de sus subdirectorios
+static void tix_build_dir(uint16_t dir, int depth) {
+    fs_dir d;
+    fat16_dir_entry e;
+    dir_open(dir, &d);
+    while (fs_readdir(&d, &e)) {
+        if (is_dir(&e)) {
+            if (depth < 64) tix_build_dir(e.first_cluster, depth + 1);
+            continue;
+        }
+        if (!e.size) continue;
+        uint32_t ent = d.lba * DIR_PER_SECTOR + d.slot - 1;
+        int doc = tix_alloc(ent);
+        if (doc >= 0 && tix_scan(doc, ent, 0)) continue;
+        if (doc >= 0) tix_drop(doc);
+        tix.complete = 0;
+    }
+}
+
+static void tix_build(void) {
+    memset(tix.docs, 0, sizeof(tix.docs));
+    memset(tix.bits, 0, sizeof(tix.bits));
+    tix.complete = 1;
+    if (!tix.enabled) return;
+    tix_build_dir(0, 0);
+    tix_stats.builds++;
+}
+
+// Disco nuevo o recién montado
+static void tix_reset(void) {
+    if (tix.enabled) tix_build();
+}
+
+static void tix_forget(uint32_t ent) {
+    int d = tix.enabled ? tix_find(ent) : -1;
+    if (d < 0) return;
+    tix_drop(d);
+    tix_stats.forgets++;
+}
+
+static void tix_moved(uint32_t ent, uint32_t moved) {
+    int d = tix.enabled ? tix_find(ent) : -1;
+    if (d >= 0) tix.docs[d].ent = moved;
+}
+
+// Indexa lo que siga pendiente en archivos todavía abiertos
+static void tix_flush(void) {
+    if (!inodes_ready) return;
+    for (int i = 0; i < INODE_CACHE; i++) {
+        fs_inode *ino = &fs_inodes[i];
+        if (ino->dir_index >= 0 && ino->tix_from != TIX_CLEAN) tix_refresh(ino);
+    }
+}
+
+void fs_index_enable(int on) {
+    if (on && tix.enabled) return;
+    tix.enabled = on;
+    tix_build();
+}
+
+void fs_index_get_stats(fs_index_stats *st) {
+    memset(st, 0, sizeof(*st));
+    st->enabled  = tix.enabled;
+    st->complete = tix.complete;
+    for (int d = 0; d < TIX_DOCS; d++) {
+        if (!tix.docs[d].ent) continue;
+        st->docs++;
+        st->bytes += tix.docs[d].size;
+    }
+    for (int b = 0; b < TIX_BUCKETS; b++) {
+        for (int w = 0; w < TIX_WORDS; w++) {
+            if (tix.bits[b][w]) {
+                st->buckets++;
+                break;
+            }
+        }
+    }
+    st->builds   = tix_stats.builds;
+    st->appends  = tix_stats.appends;
+    st->rebuilds = tix_stats.rebuilds;
+    st->forgets  = tix_stats.forgets;
+    st->scanned  = tix_stats.bytes;
+}
+
+// --- Búsqueda en todo el disco -----------------------------------------------
+typedef struct {
+    const char     *term;
+    uint32_t        len;
+    int             flags;
+    uint32_t        cand[TIX_WORDS];    // Documentos que pueden contener el término
+    fs_search_info *info;
+    char            path[FS_PATH_MAX];
+} search_query;
+
+// 1 si el archivo contiene el término. Se lee por bloques y se conservan
+// los len - 1 últimos bytes de cada uno por si el término cruza el límite.
+static int file_contains(int fd, const char *term, uint32_t len) {
+    uint8_t buf[2 * SECTOR_SIZE];
+    uint32_t keep = 0;
+    int n;
+    while ((n = fs_fread(fd, buf + keep, SECTOR_SIZE)) > 0) {
+        uint32_t have = keep + n;
+        if (mem_find(buf, have, term, len)) return 1;
+        keep = len - 1 < have ? len - 1 : have;
+        for (uint32_t i = 0; i < keep; i++) buf[i] = buf[have - keep + i];
+    }
+    return 0;
+}
+
+// Recorre 'dir'; q->path[0..plen) es su ruta con la '/' final
+static void search_dir(search_query *q, uint16_t dir, uint32_t plen, int depth) {
+    fs_dir d;
+    fat16_dir_entry e;
+    dir_open(dir, &d);
+    while (fs_readdir(&d, &e)) {
+        uint32_t ent = d.lba * DIR_PER_SECTOR + d.slot - 1;
+        int k = 11;
+        while (k > 0 && e.name[k - 1] == ' ') k--;
+        if (plen + k + 2 > FS_PATH_MAX) continue;
+        memcpy(q->path + plen, e.name, k);
+        q->path[plen + k] = '\0';
+        if (is_dir(&e)) {
+            q->path[plen + k] = '/';
+            if (depth < 64) search_dir(q, e.first_cluster, plen + k + 1, depth + 1);
+            continue;
+        }
+        
+        q->info->files++;
+        if (!e.size) continue;
+        if (q->info->indexed) {
+            // Sin documento sólo puede tener el término si el índice no está completo
+            int doc = tix_find(ent);
+            if (doc >= 0 ? !(q->cand[doc / 32] & 1u << doc % 32) : tix.complete) continue;
+        }
+        q->info->candidates++;
+        int fd = fs_open_entry(ent, &e, O_RDONLY);
+        if (fd < 0) continue;
+        int found = (q->flags & FS_SEARCH_LINES) ? grep_fd(fd, q->term, q->len, q->path) > 0
+                                                 : file_contains(fd, q->term, q->len);
+        fs_close(fd);
+        if (!found) continue;
+        q->info->matches++;
+        if (!(q->flags & FS_SEARCH_LINES)) printf("%s\n", q->path);
+    }
+}
+
+int fs_search(const char *term, const char *dir, int flags, fs_search_info *info) {
+    static search_query q;   // Mucho para la pila del kernel
+    memset(info, 0, sizeof(*info));
+    uint32_t len = strlen(term);
+    if (!len || len > SECTOR_SIZE) return -1;
+    int start = path_dir(dir ? dir : ".");
+    if (start < 0) return 0;
+    
+    q.term = term;
+    q.len = len;
+    q.flags = flags;
+    q.info = info;
+    uint32_t plen = 0;
+    if (dir) {
+        plen = strlen(dir);
+        if (plen + 2 > FS_PATH_MAX) return 0;
+        memcpy(q.path, dir, plen);
+        if (plen && dir[plen - 1] != '/') q.path[plen++] = '/';
+    }
+    
+    if (tix.enabled && !(flags & FS_SEARCH_SCAN)) {
+        tix_flush();
+        info->indexed = 1;
+        memset(q.cand, 0xFF, sizeof(q.cand));
+        // Con menos de tres bytes no hay trigramas: todos son candidatos
+        for (uint32_t i = 0; i + 3 <= len; i++) {
+            const uint8_t *t = (const uint8_t *)term + i;
+            uint32_t *row = tix.bits[TIX_BUCKET((uint32_t)(t[0] << 16 | t[1] << 8 | t[2]))];
+            for (int w = 0; w < TIX_WORDS; w++) q.cand[w] &= row[w];
+        }
+        uint32_t any = 0;
+        for (int w = 0; w < TIX_WORDS; w++) any |= q.cand[w];
+        if (!any && tix.complete) return 1;   // Ni siquiera hace falta recorrer el árbol
+    }
+    search_dir(&q, start, plen, 0);
+    return 1;
+}
+
+// =============================================================================
+// ESTADÍSTICAS
+// =============================================================================
+// Copia de todos los contadores acumulados desde el arranque ('time' y
+// 'stats' en el shell restan dos copias para medir un comando)
+void fs_get_stats(fs_stats *st) {
+    st->sectors_read     = disk_stats.read;
+    st->sectors_written  = disk_stats.written;
+    st->blk_submitted    = blk_stats.submitted;
+    st->blk_dispatched   = blk_stats.dispatched;
+    st->blk_merged       = blk_stats.merged;
+    st->ra_hits          = ra_stats.hits;
+    st->ra_misses        = ra_stats.misses;
+    st->ra_prefetched    = ra_stats.prefetched;
+    st->dcache_hits      = dcache_stats.hits;
+    st->dcache_misses    = dcache_stats.misses;
+    st->dir_index_builds = dix_stats.builds;
+    st->dir_scans        = dix_stats.scans;
+    st->inode_hits       = inode_stats.hits;
+    st->inode_misses     = inode_stats.misses;
+    st->clusters_alloced = cluster_stats.allocated;
+    st->clusters_freed   = cluster_stats.freed;
+    st->reflinks         = cluster_stats.reflinks;
+    st->cow_copies       = cluster_stats.cow_copies;
+    st->comp_decoded     = comp_stats.decoded;
+    st->comp_hits        = comp_stats.hits;
+    st->crc_errors       = crc_stats.errors;
+    st->scrubbed         = crc_stats.scrubbed;
+}
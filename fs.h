@@ -0,0 +1,158 @@
+// fs.h: interfaz del sistema de archivos FAT16 (fs.c)
+//
+// El formato en disco está en fat16.h. Todo lo que hay aquí funciona igual
+// dentro del kernel y en el host (ver platform.h).
+#ifndef FS_H
+#define FS_H
+
+#include <stdint.h>
+#include "fat16.h"
+
+// Inicialización: formatear el disco en RAM o montar una imagen existente
+void fs_init(void);
+int  fs_mount_image(uint8_t *base, uint32_t size);
+
+// Directorios y rutas. Una ruta que empieza por '/' parte del raíz y las
+// demás del directorio actual; cada componente tiene como mucho 11
+// caracteres y admite "." y "..".
+#define FS_PATH_MAX 128
+
+typedef struct {
+    uint16_t dir, cluster;    // Directorio y cluster del sector actual
+    uint32_t n, lba, slot;    // Sector recorrido y entrada dentro de él
+    int      done;
+} fs_dir;
+
+int  fs_find(const char *name, fat16_dir_entry *e, int *idx);
+int  fs_chdir(const char *path);                 // 1 si existe el directorio
+void fs_getcwd(char *buf, uint32_t size);
+int  fs_opendir(const char *path, fs_dir *d);    // 1 si existe el directorio
+int  fs_readdir(fs_dir *d, fat16_dir_entry *e);  // Sin "." ni ".."; 0 al final
+void fs_dcache_flush(void);
+
+// Cadenas de clusters en la FAT
+uint16_t fs_alloc_cluster(void);
+void     fat_set(uint16_t cluster, uint16_t value);
+void     fs_free_chain(uint16_t cluster);
+uint32_t fs_free_clusters(void);
+
+// Contadores acumulados desde el arranque
+typedef struct {
+    uint32_t sectors_read, sectors_written;            // Dispositivo
+    uint32_t blk_submitted, blk_dispatched, blk_merged;  // Cola de bloques
+    uint32_t ra_hits, ra_misses, ra_prefetched;        // Lectura anticipada
+    uint32_t dcache_hits, dcache_misses;               // Caché de directorio
+    uint32_t dir_index_builds, dir_scans;              // Índices y recorridos lineales
+    uint32_t inode_hits, inode_misses;                 // Caché de inodos
+    uint32_t clusters_alloced, clusters_freed;         // Asignador de la FAT
+    uint32_t reflinks, cow_copies;                     // Copias compartidas y clusters duplicados
+    uint32_t comp_decoded, comp_hits;                  // Bloques comprimidos leídos / en caché
+    uint32_t crc_errors, scrubbed;                     // Sectores dañados / repasados en segundo plano
+} fs_stats;
+
+void fs_get_stats(fs_stats *st);
+
+// Integridad: cada sector lleva un CRC32C que se comprueba al leerlo.
+// fs_scrub repasa el disco entero; fs_scrub_step, un sector cada vez (un
+// temporizador del shell lo llama por tandas mientras espera una tecla) y
+// retorna 1 al acabar la vuelta.
+#define FS_SCRUB_BAD 8
+
+typedef struct {
+    uint32_t sectors, errors;
+    uint32_t bad[FS_SCRUB_BAD];   // Primeros sectores dañados
+} fs_scrub_info;
+
+void fs_scrub(fs_scrub_info *info);
+int  fs_scrub_step(void);
+
+// Descriptores de archivo
+#define O_RDONLY  0x0
+#define O_WRONLY  0x1
+#define O_RDWR    0x2
+#define O_ACCMODE 0x3
+#define O_CREAT   0x40
+#define O_TRUNC   0x200
+#define O_APPEND  0x400
+
+#define SEEK_SET 0
+#define SEEK_CUR 1
+#define SEEK_END 2
+
+int      fs_open(const char *name, int flags);
+void     fs_close(int fd);
+int      fs_fread(int fd, void *buf, uint32_t len);
+int      fs_fwrite(int fd, const void *buf, uint32_t len);
+int      fs_lseek(int fd, int offset, int whence);
+int      fs_ftruncate(int fd, uint32_t size);
+uint32_t fs_fsize(int fd);
+
+// Operaciones sobre archivos completos
+int  fs_read(const char *name, void *buf, uint32_t max, uint32_t *size);
+void fs_write(const char *name, const void *buf, uint32_t size);
+int  fs_unlink(const char *name);   // 0, -1 no existe, -2 en uso, -3 directorio no vacío
+int  fs_mv(const char *old, const char *new);   // 1, 0 no existe, -1 destino no válido
+int  fs_copy(const char *src, const char *dst); // 1, 0 no existe, -1 destino no válido, -2 sin espacio
+
+// Compresión transparente por archivo (formato en fat16.h): fs_fread
+// descomprime y abrir para escritura deja el archivo sin comprimir.
+// Retornan 1, 0 si no existe o es un directorio, -1 si no hay espacio,
+// -2 si ya estaba así o -3 si comprimido no ahorra ningún cluster
+// (fs_compress) o está dañado (fs_decompress)
+typedef struct {
+    uint32_t size;            // Tamaño del archivo
+    uint32_t stored;          // Bytes en el disco comprimido (tabla incluida)
+} fs_comp_info;
+
+int  fs_compress(const char *name, fs_comp_info *info);
+int  fs_decompress(const char *name, fs_comp_info *info);
+
+// Comandos de archivo del shell (imprimen su resultado)
+void fs_ls(const char *path);   // NULL o "" = directorio actual
+void fs_touch(const char *name);
+void fs_cp(const char *src, const char *dst);
+void fs_delete(const char *name);
+void fs_mkdir(const char *name);
+void fs_hexdump(const char *name);
+void fs_wc(const char *name);
+void fs_grep(const char *pattern, const char *name);
+void fs_head(const char *name, int lines);
+void fs_tail(const char *name, int lines);
+
+// Búsqueda en todo el disco (search y grep -r). Con el índice de trigramas
+// activado (fs_index_enable) sólo se leen los archivos que pueden contener
+// el término; el índice se construye leyendo el disco una vez y desde
+// entonces se pone al día cada vez que se cierra un archivo modificado, se
+// borra o se mueve. Sin él se leen todos.
+#define FS_SEARCH_LINES 1   // Escribir las líneas como grep -r (si no, sólo las rutas)
+#define FS_SEARCH_SCAN  2   // No usar el índice aunque esté activado
+
+typedef struct {
+    uint32_t files;           // Archivos recorridos
+    uint32_t candidates;      // ... leídos para comprobar el término
+    uint32_t matches;         // ... que lo contienen
+    int      indexed;         // 1 si el índice eligió los candidatos
+} fs_search_info;
+
+typedef struct {
+    int      enabled, complete;   // complete = 0 si algún archivo no cupo
+    uint32_t docs, bytes;         // Archivos y bytes indexados
+    uint32_t buckets;             // Cubos de trigramas con algún archivo
+    uint32_t builds, appends, rebuilds, forgets;
+    uint32_t scanned;             // Bytes leídos para indexar
+} fs_index_stats;
+
+// Busca 'term' en los archivos bajo 'dir' (NULL = directorio actual, y las
+// rutas salen relativas a él). Retorna 1, 0 si 'dir' no es un directorio o
+// -1 si el término está vacío o es más largo que un sector.
+int  fs_search(const char *term, const char *dir, int flags, fs_search_info *info);
+void fs_index_enable(int on);
+void fs_index_get_stats(fs_index_stats *st);
+
+// Edición por líneas: los cambios se acumulan hasta edit_sync()
+void fs_edit_line(const char *name, int line_num, const char *new_text);
+void fs_delete_line(const char *name, int line_num);
+void fs_insert_line(const char *name, int line_num);
+void edit_sync(void);
+
+#endif
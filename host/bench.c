@@ -0,0 +1,803 @@
+// bench.c: harness del host para fs.c y text.c (make host-bench)
+//
+// El sistema de archivos y los operadores de los pipes se compilan como
+// código nativo, de modo que se pueden medir y depurar con perf, valgrind o
+// los sanitizers, cosa imposible dentro de QEMU. Hay dos partes:
+// - Rendimiento: escritura y lectura secuencial, lecturas aleatorias con
+//   lseek, búsquedas en el raíz y en un subdirectorio de 512 entradas,
+//   grep/wc, edición de líneas, CRC32C, suma de Internet y scrub, y los
+//   operadores de texto, medidos con el reloj monotónico del host.
+// - Secuencias aleatorias: operaciones con descriptores, escrituras
+//   completas, truncados, renombrados (también entre directorios), borrados
+//   y ediciones de líneas, comprobadas contra un modelo en memoria. Al final
+//   se comprueban las sumas del disco (también con un byte pisado a mano)
+//   y la suma de Internet contra la de 16 bits, se borra todo y se verifica
+//   que la FAT recupera todos los clusters.
+//
+// Uso: fs-bench [-i imagen] [-o imagen] [-s semilla] [-n operaciones] [-b] [-r] [-v]
+//   -i imagen  monta una imagen de 'make image' en lugar de generar una
+//   -o imagen  guarda la imagen sintética (se puede arrancar con -initrd)
+//   -s, -n     semilla y longitud de la secuencia aleatoria
+//   -b, -r     sólo rendimiento / sólo secuencia aleatoria
+//   -v         muestra la salida de consola del kernel
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "crc32c.h"
+#include "csum.h"
+#include "fs.h"
+#include "text.h"
+#include "host/host.h"
+
+// =============================================================================
+// UTILIDADES
+// =============================================================================
+static uint32_t rng_state = 1;
+static uint32_t seed = 1;
+static int      op_index = -1;   // Operación aleatoria en curso
+
+// xorshift32: la misma semilla reproduce la misma secuencia en cualquier host
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint32_t rng_below(uint32_t n) {
+    return n ? rng() % n : 0;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void die(const char *msg) {
+    if (op_index >= 0) fprintf(stderr, "fs-bench: %s en la operacion %d (semilla %u)\n", msg, op_index, seed);
+    else               fprintf(stderr, "fs-bench: %s\n", msg);
+    exit(1);
+}
+
+// Rellena 'buf' con líneas de palabras, como un archivo de texto típico
+static uint32_t fill_text(char *buf, uint32_t size) {
+    static const char *words[] = {
+        "kernel", "fat16", "cluster", "sector", "inode", "shell", "pipe",
+        "grep", "buffer", "cache", "disk", "error", "linea", "archivo",
+    };
+    uint32_t len = 0;
+    while (len + 16 < size) {
+        const char *w = words[rng_below(sizeof(words) / sizeof(words[0]))];
+        uint32_t n = strlen(w);
+        memcpy(buf + len, w, n);
+        len += n;
+        buf[len++] = rng_below(6) ? ' ' : '\n';
+    }
+    buf[len++] = '\n';
+    buf[len] = '\0';
+    return len;
+}
+
+// =============================================================================
+// IMAGEN DE DISCO
+// =============================================================================
+static uint8_t *load_image(const char *path, uint32_t *size) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *buf = malloc(len ? len : 1);
+    if (buf && fread(buf, 1, len, f) != (size_t)len) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    *size = (uint32_t)len;
+    return buf;
+}
+
+// Imagen sintética: 'count' archivos de texto de hasta 8 KB
+static void populate(int count) {
+    static char buf[8192 + 1];
+    char name[12];
+    fs_init();
+    for (int i = 0; i < count; i++) {
+        snprintf(name, sizeof(name), "f%03d.txt", i);
+        fs_write(name, buf, fill_text(buf, 512 + rng_below(sizeof(buf) - 512)));
+    }
+}
+
+static int save_image(const char *path) {
+    FILE *f = fopen(path, "wb");
+    if (!f) return 0;
+    int ok = fwrite(disk_image_start, SECTOR_SIZE, DISK_SECTORS, f) == DISK_SECTORS;
+    return fclose(f) == 0 && ok;
+}
+
+// =============================================================================
+// RENDIMIENTO
+// =============================================================================
+// Cada prueba se repite hasta sumar al menos BENCH_MIN_TIME segundos y se
+// informa del tiempo medio por iteración y, si mueve datos, del caudal.
+#define BENCH_MIN_TIME 0.2
+
+#define BIG_SIZE   (64 * 1024)
+#define LINE_COUNT 2000
+#define MANY_FILES 512      // Entradas del subdirectorio "many"
+
+static char big[BIG_SIZE + 1];
+static char back[BIG_SIZE + 1];
+static char text[4096 + 1];
+static const char *names[64];
+
+static void run_write(void) { fs_write("big.bin", big, BIG_SIZE); }
+
+static void run_read(void) {
+    uint32_t size;
+    fs_read("big.bin", back, sizeof(back), &size);
+}
+
+static void run_fread_4k(void) {
+    int fd = fs_open("big.bin", O_RDONLY);
+    while (fs_fread(fd, back, 4096) > 0) { }
+    fs_close(fd);
+}
+
+static void run_seek_read(void) {
+    int fd = fs_open("big.bin", O_RDONLY);
+    for (int i = 0; i < 64; i++) {
+        fs_lseek(fd, rng_below(BIG_SIZE - 512), SEEK_SET);
+        fs_fread(fd, back, 512);
+    }
+    fs_close(fd);
+}
+
+static void run_find_hit(void) {
+    fat16_dir_entry e;
+    int idx;
+    for (int i = 0; i < 64; i++) fs_find(names[i], &e, &idx);
+}
+
+static void run_find_cold(void) {
+    fs_dcache_flush();
+    run_find_hit();
+}
+
+static void run_find_miss(void) {
+    fat16_dir_entry e;
+    int idx;
+    for (int i = 0; i < 64; i++) fs_find("no.existe", &e, &idx);
+}
+
+// Búsquedas repartidas por todo el subdirectorio: la caché de nombres no
+// alcanza para tantas entradas, así que casi todas pasan por el índice
+static void run_many_hit(void) {
+    fat16_dir_entry e;
+    int idx;
+    char path[32];
+    for (int i = 0; i < 64; i++) {
+        snprintf(path, sizeof(path), "many/f%u", rng_below(MANY_FILES));
+        if (!fs_find(path, &e, &idx)) die("many: archivo no encontrado");
+    }
+}
+
+static void run_many_miss(void) {
+    fat16_dir_entry e;
+    int idx;
+    char path[32];
+    for (int i = 0; i < 64; i++) {
+        snprintf(path, sizeof(path), "many/g%u", rng_below(MANY_FILES));
+        if (fs_find(path, &e, &idx)) die("many: archivo inesperado");
+    }
+}
+
+// La copia comparte los clusters de big.bin: cuesta lo mismo que crear un
+// archivo vacío. Al escribir en ella se duplican sólo los clusters tocados.
+static void run_copy(void) {
+    if (fs_copy("big.bin", "big.cp") != 1) die("fs_copy");
+}
+
+static void run_copy_write(void) {
+    run_copy();
+    int fd = fs_open("big.cp", O_WRONLY);
+    fs_fwrite(fd, big, 4096);
+    fs_close(fd);
+}
+
+// big.lz es big.txt comprimido: la lectura descomprime bloque a bloque
+static void run_read_lz(void) {
+    uint32_t size;
+    fs_read("big.lz", back, sizeof(back), &size);
+}
+
+static void run_lz_roundtrip(void) {
+    fs_comp_info info;
+    if (fs_decompress("big.lz", &info) != 1 || fs_compress("big.lz", &info) != 1) die("big.lz");
+}
+
+// CRC32C con la instrucción de SSE4.2 y con la tabla slice-by-8
+static uint32_t crc_sink;
+static void run_crc_hw(void) {
+    crc32c_use_hw(1);
+    crc_sink += crc32c(0, big, BIG_SIZE);
+}
+static void run_crc_soft(void) {
+    int hw = crc32c_use_hw(0);
+    crc_sink += crc32c(0, big, BIG_SIZE);
+    crc32c_use_hw(hw);
+}
+
+static uint32_t csum_sink;
+static void run_csum(void) { csum_sink += csum_fold(csum_add(0, big, BIG_SIZE)); }
+
+// La suma de Internet de 16 en 16 bits, tal como la describe el RFC 1071
+static uint16_t csum_ref(const uint8_t *p, uint32_t len) {
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i + 1 < len; i += 2) sum += p[i] | p[i + 1] << 8;
+    if (len & 1) sum += p[len - 1];
+    while (sum >> 16) sum = (sum & 0xFFFF) + (sum >> 16);
+    return ~sum;
+}
+
+static void run_scrub(void) {
+    fs_scrub_info info;
+    fs_scrub(&info);
+    if (info.errors) die("scrub: sumas incorrectas");
+}
+
+static void run_grep(void) { fs_grep("cache", "big.txt"); }
+
+// Todo el disco: el término sólo está en aguja.txt. Con el índice se leen
+// aguja.txt y big.bin, que por ser aleatorio tiene casi todos los trigramas;
+// sin él, todos. Van las últimas: con el índice activado cada archivo que
+// se cierra tras escribirlo se vuelve a indexar, y la primera iteración lo
+// construye.
+static void run_search(int flags) {
+    fs_search_info info;
+    fs_search("aguja", "/", flags, &info);
+    if (info.matches != 1) die("search: resultado incorrecto");
+}
+static void run_search_scan(void) { run_search(FS_SEARCH_SCAN); }
+static void run_search_index(void) {
+    fs_index_enable(1);
+    run_search(0);
+}
+static void run_wc(void) { fs_wc("big.txt"); }
+
+static void run_edit(void) {
+    for (int i = 0; i < 64; i++) {
+        fs_edit_line("lines.txt", 1 + rng_below(LINE_COUNT), "linea editada");
+        fs_insert_line("lines.txt", 1 + rng_below(LINE_COUNT));
+        fs_delete_line("lines.txt", 1 + rng_below(LINE_COUNT));
+    }
+    edit_sync();
+}
+
+static void run_text_grep(void) { text_grep(text, "cache"); }
+static void run_text_wc(void) { text_wc(text); }
+static void run_text_rev(void) { text_rev(text); }
+
+// big | grep cache | wc: 64 KB por dos anillos, sin guardarlos enteros
+static text_stage pipe_st[3];
+static ring       pipe_ring[2];
+static void run_pipe_stream(void) {
+    ring_init(&pipe_ring[0]);
+    ring_init(&pipe_ring[1]);
+    text_source_init(&pipe_st[0], big, BIG_SIZE, &pipe_ring[0]);
+    text_stage_init(&pipe_st[1], "grep cache", &pipe_ring[0], &pipe_ring[1]);
+    text_stage_init(&pipe_st[2], "wc", &pipe_ring[1], NULL);
+    coro *v[3] = { &pipe_st[0].c, &pipe_st[1].c, &pipe_st[2].c };
+    coro_run(v, 3, NULL);
+}
+
+typedef struct {
+    const char *name;
+    void      (*run)(void);
+    uint32_t    bytes;     // Bytes procesados por iteración (0 = sin caudal)
+} bench_case;
+
+static const bench_case cases[] = {
+    { "fs_write_64k",   run_write,     BIG_SIZE },
+    { "fs_read_64k",    run_read,      BIG_SIZE },
+    { "fs_fread_4k",    run_fread_4k,  BIG_SIZE },
+    { "fs_seek_read",   run_seek_read, 64 * 512 },
+    { "fs_read_lz_64k", run_read_lz,   BIG_SIZE },
+    { "lz_roundtrip",   run_lz_roundtrip, BIG_SIZE },
+    { "fs_copy_64k",    run_copy,      0 },
+    { "copy_write_4k",  run_copy_write, 4096 },
+    { "crc32c_hw_64k",  run_crc_hw,    BIG_SIZE },
+    { "crc32c_sw_64k",  run_crc_soft,  BIG_SIZE },
+    { "inet_csum_64k",  run_csum,      BIG_SIZE },
+    { "scrub_disk",     run_scrub,     DISK_SECTORS * 512 },
+    { "fs_find_hit",    run_find_hit,  0 },
+    { "fs_find_cold",   run_find_cold, 0 },
+    { "fs_find_miss",   run_find_miss, 0 },
+    { "dir512_hit",     run_many_hit,  0 },
+    { "dir512_miss",    run_many_miss, 0 },
+    { "fs_grep_64k",    run_grep,      BIG_SIZE },
+    { "fs_wc_64k",      run_wc,        BIG_SIZE },
+    { "edit_192_sync",  run_edit,      0 },
+    { "text_grep_4k",   run_text_grep, 4096 },
+    { "text_wc_4k",     run_text_wc,   4096 },
+    { "text_rev_4k",    run_text_rev,  4096 },
+    { "pipe_grep_wc_64k", run_pipe_stream, BIG_SIZE },
+    { "search_scan",    run_search_scan, 0 },
+    { "search_index",   run_search_index, 0 },
+};
+
+static void bench_setup(void) {
+    fill_text(big, BIG_SIZE);
+    fs_write("big.txt", big, strlen(big));
+    fs_write("big.lz", big, strlen(big));
+    fs_comp_info info;
+    if (fs_compress("big.lz", &info) != 1) die("fs_compress");
+    printf("big.lz: %u bytes, %u comprimido (%.2fx)\n", info.size, info.stored,
+           (double)info.size / info.stored);
+    for (uint32_t i = 0; i < BIG_SIZE; i++) big[i] = rng();
+    fs_write("big.bin", big, BIG_SIZE);
+
+    uint32_t len = 0;
+    for (int i = 1; i <= LINE_COUNT; i++) len += sprintf(back + len, "linea %d\n", i);
+    fs_write("lines.txt", back, len);
+    fs_write("aguja.txt", "una aguja en un pajar\n", 22);
+    fill_text(text, sizeof(text) - 1);
+
+    // Nombres para fs_find: los primeros archivos del directorio
+    static char found[64][12];
+    int n = 0;
+    fs_dir dir;
+    fat16_dir_entry e;
+    fs_opendir("/", &dir);
+    while (n < 64 && fs_readdir(&dir, &e)) {
+        int k = 11;
+        while (k > 0 && e.name[k - 1] == ' ') k--;
+        memcpy(found[n], e.name, k);
+        found[n][k] = '\0';
+        n++;
+    }
+    for (int i = 0; i < 64; i++) names[i] = found[i % n];
+
+    // Un subdirectorio con muchas entradas para las búsquedas indexadas
+    fs_mkdir("many");
+    for (int i = 0; i < MANY_FILES; i++) {
+        char path[32];
+        snprintf(path, sizeof(path), "many/f%d", i);
+        fs_close(fs_open(path, O_WRONLY | O_CREAT));
+    }
+}
+
+static void run_benchmarks(void) {
+    bench_setup();
+    printf("%-16s %8s %12s %10s\n", "prueba", "iter", "us/iter", "MB/s");
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        const bench_case *c = &cases[i];
+        unsigned long iters = 0;
+        double start = now(), elapsed;
+        do {
+            c->run();
+            iters++;
+            elapsed = now() - start;
+        } while (elapsed < BENCH_MIN_TIME);
+
+        double per_iter = elapsed / iters;
+        printf("%-16s %8lu %12.2f", c->name, iters, per_iter * 1e6);
+        if (c->bytes) printf(" %10.1f", c->bytes / per_iter / (1024.0 * 1024.0));
+        printf("\n");
+    }
+    fs_index_enable(0);
+    fs_unlink("big.txt");
+    fs_unlink("big.bin");
+    fs_unlink("big.cp");
+    fs_unlink("big.lz");
+    fs_unlink("lines.txt");
+    fs_unlink("aguja.txt");
+    for (int i = 0; i < MANY_FILES; i++) {
+        char path[32];
+        snprintf(path, sizeof(path), "many/f%d", i);
+        fs_unlink(path);
+    }
+    if (fs_unlink("many")) die("many: no se pudo borrar el directorio");
+}
+
+// =============================================================================
+// SECUENCIAS ALEATORIAS CONTRA UN MODELO
+// =============================================================================
+// El modelo guarda el contenido esperado de cada archivo. Los archivos
+// "rN" reciben operaciones de bytes; "lines" sólo recibe ediciones de líneas
+// (siempre termina en '\n', como los archivos que se editan con edln).
+#define MODEL_FILES 8
+#define MODEL_MAX   (32 * 1024)   // Tamaño a partir del cual sólo se encoge
+#define MODEL_SLACK (16 * 1024)   // Lo que puede crecer en una operación
+#define LINES_MAX   4096          // Líneas a partir de las cuales sólo se borra
+
+typedef struct {
+    char     name[12];
+    int      exists;
+    uint8_t *data;
+    uint32_t size;
+} model_file;
+
+static model_file model[MODEL_FILES];
+static char lines[LINES_MAX * 16];
+static uint32_t lines_len;
+static int lines_exist;         // edln e insln lo crean; delln no
+static uint8_t scratch[MODEL_MAX + MODEL_SLACK];
+
+static void model_resize(model_file *m, uint32_t size) {
+    if (size > m->size) memset(m->data + m->size, 0, size - m->size);
+    m->size = size;
+}
+
+static void check_file(const char *name, const void *data, uint32_t size) {
+    uint32_t got;
+    if (!fs_read(name, scratch, sizeof(scratch), &got)) die("archivo desaparecido");
+    if (got != size || memcmp(scratch, data, size)) {
+        fprintf(stderr, "fs-bench: %s: %u bytes, se esperaban %u\n", name, got, size);
+        die("contenido distinto del modelo");
+    }
+}
+
+// Posición donde empieza la línea n (1..), o lines_len si no existe
+static uint32_t line_start(int n) {
+    uint32_t pos = 0;
+    while (--n > 0 && pos < lines_len) {
+        while (pos < lines_len && lines[pos] != '\n') pos++;
+        if (pos < lines_len) pos++;
+    }
+    return pos;
+}
+
+static int line_count(void) {
+    int count = 0;
+    for (uint32_t i = 0; i < lines_len; i++) count += lines[i] == '\n';
+    return count;
+}
+
+static void lines_replace(uint32_t pos, uint32_t old, const char *s, uint32_t len) {
+    memmove(lines + pos + len, lines + pos + old, lines_len - pos - old);
+    memcpy(lines + pos, s, len);
+    lines_len += len - old;
+}
+
+// Añade las líneas vacías que faltan hasta que exista la línea n - 1
+static void lines_pad(int n) {
+    for (int have = line_count(); have < n - 1; have++) lines_replace(lines_len, 0, "\n", 1);
+}
+
+static void op_line_edit(void) {
+    int count = line_count();
+    int n = 1 + rng_below(count + 3);
+    uint32_t start = line_start(n);
+    int op = rng_below(3);
+
+    if (count > LINES_MAX) op = 1;
+    if (op == 0) {
+        char t[32];
+        int len = snprintf(t, sizeof(t), "e%u", rng_below(100000));
+        fs_edit_line("lines", n, t);
+        lines_exist = 1;
+        t[len++] = '\n';
+        if (start < lines_len) {
+            lines_replace(start, line_start(n + 1) - start, t, len);
+        } else {
+            lines_pad(n);
+            lines_replace(lines_len, 0, t, len);
+        }
+    } else if (op == 1) {
+        fs_delete_line("lines", n);
+        if (start < lines_len) lines_replace(start, line_start(n + 1) - start, "", 0);
+    } else {
+        fs_insert_line("lines", n);
+        lines_exist = 1;
+        if (start >= lines_len) lines_pad(n);
+        lines_replace(start < lines_len ? start : lines_len, 0, "\n", 1);
+    }
+}
+
+static void op_bytes(model_file *m) {
+    uint8_t buf[8192];
+    uint32_t len = rng_below(sizeof(buf));
+    for (uint32_t i = 0; i < len; i++) buf[i] = rng();
+
+    int op = rng_below(9);
+    if (m->exists && m->size > MODEL_MAX) op = 4;   // Sólo encoger
+    if (!m->exists && op >= 3) op = 0;
+
+    switch (op) {
+    case 0: {   // Reemplazo completo
+        fs_write(m->name, buf, len);
+        memcpy(m->data, buf, len);
+        m->size = len;
+        m->exists = 1;
+        break;
+    }
+    case 1: {   // Escritura en una posición, quizá más allá del final
+        uint32_t pos = rng_below((m->exists ? m->size : 0) + 2048);
+        int fd = fs_open(m->name, O_RDWR | O_CREAT);
+        if (fd < 0) die("fs_open O_CREAT");
+        if (!m->exists) m->size = 0;
+        m->exists = 1;
+        if (fs_lseek(fd, pos, SEEK_SET) != (int)pos) die("fs_lseek");
+        if (fs_fwrite(fd, buf, len) != (int)len) die("fs_fwrite");
+        if (len && pos + len > m->size) model_resize(m, pos + len);
+        memcpy(m->data + pos, buf, len);
+        if (fs_fsize(fd) != m->size) die("fs_fsize");
+        fs_close(fd);
+        break;
+    }
+    case 2: {   // Añadir al final
+        int fd = fs_open(m->name, O_WRONLY | O_APPEND | O_CREAT);
+        if (fd < 0) die("fs_open O_APPEND");
+        if (!m->exists) m->size = 0;
+        m->exists = 1;
+        if (fs_fwrite(fd, buf, len) != (int)len) die("fs_fwrite O_APPEND");
+        memcpy(m->data + m->size, buf, len);
+        m->size += len;
+        fs_close(fd);
+        break;
+    }
+    case 3: {   // Lectura parcial en una posición aleatoria
+        int fd = fs_open(m->name, O_RDONLY);
+        uint32_t pos = rng_below(m->size + 16);
+        uint32_t want = rng_below(4096);
+        fs_lseek(fd, pos, SEEK_SET);
+        int got = fs_fread(fd, buf, want);
+        uint32_t expect = pos < m->size ? (m->size - pos < want ? m->size - pos : want) : 0;
+        if (got != (int)expect || memcmp(buf, m->data + pos, expect)) die("lectura parcial");
+        fs_close(fd);
+        break;
+    }
+    case 4: {   // Truncar
+        uint32_t size = rng_below(m->size + 1);
+        int fd = fs_open(m->name, O_RDWR);
+        fs_ftruncate(fd, size);
+        fs_close(fd);
+        m->size = size;
+        break;
+    }
+    case 5: {   // Renombrar a un nombre libre
+        for (int i = 0; i < MODEL_FILES; i++) {
+            model_file *dst = &model[i];
+            if (dst->exists) continue;
+            if (fs_mv(m->name, dst->name) != 1) die("fs_mv");
+            uint8_t *data = dst->data;
+            dst->data = m->data;
+            dst->size = m->size;
+            dst->exists = 1;
+            m->data = data;
+            m->exists = 0;
+            return;
+        }
+        break;
+    }
+    case 6: {   // Borrar
+        if (fs_unlink(m->name)) die("fs_unlink");
+        m->exists = 0;
+        return;
+    }
+    case 7: {   // Copiar: origen y copia comparten clusters hasta que se escriben
+        if (lines_exist && lines_len <= MODEL_MAX && rng_below(4) == 0) {
+            // Así las ediciones de líneas también trabajan sobre cadenas compartidas
+            if (fs_copy("lines", m->name) != 1) die("fs_copy lines");
+            memcpy(m->data, lines, lines_len);
+            m->size = lines_len;
+            break;
+        }
+        model_file *dst = &model[rng_below(MODEL_FILES)];
+        if (fs_copy(m->name, dst->name) != 1) die("fs_copy");
+        if (dst != m) {
+            memcpy(dst->data, m->data, m->size);
+            dst->size = m->size;
+            dst->exists = 1;
+            check_file(dst->name, dst->data, dst->size);
+        }
+        break;
+    }
+    case 8: {   // Comprimir o descomprimir: el contenido no cambia
+        fs_comp_info info;
+        int r = fs_compress(m->name, &info);
+        if (r == -2) r = fs_decompress(m->name, &info);
+        if (r != 1 && r != -3) die("fs_compress");
+        if (info.size != m->size) die("fs_compress: tamano");
+        break;
+    }
+    }
+    check_file(m->name, m->data, m->size);
+}
+
+static int model_contains(const model_file *m, const char *term, uint32_t len) {
+    for (uint32_t i = 0; m->exists && i + len <= m->size; i++) {
+        if (!memcmp(m->data + i, term, len)) return 1;
+    }
+    return 0;
+}
+
+// Con el índice se encuentran los mismos archivos que leyéndolos todos, y
+// en sub/ los mismos que en el modelo. El término sale casi siempre de un
+// archivo, así que suele estar.
+static void check_search(void) {
+    char term[8];
+    model_file *m = &model[rng_below(MODEL_FILES)];
+    uint32_t len = 1 + rng_below(6);
+    int from_file = m->exists && m->size >= len;
+    uint32_t pos = from_file ? rng_below(m->size - len + 1) : 0;
+    for (uint32_t i = 0; i < len; i++) {
+        term[i] = from_file ? m->data[pos + i] : rng();
+        if (!term[i]) term[i] = 'x';
+    }
+    term[len] = '\0';
+
+    fs_search_info idx, scan;
+    if (fs_search(term, "/", 0, &idx) != 1 || fs_search(term, "/", FS_SEARCH_SCAN, &scan) != 1)
+        die("fs_search");
+    if (!idx.indexed || scan.indexed || idx.matches != scan.matches || idx.candidates > scan.candidates)
+        die("search: el indice no coincide con la lectura completa");
+    uint32_t expect = 0;
+    for (int i = 1; i < MODEL_FILES; i += 2) expect += model_contains(&model[i], term, len);
+    if (fs_search(term, "sub", 0, &idx) != 1 || idx.matches != expect)
+        die("search: sub/ no coincide con el modelo");
+}
+
+// Un término repartido entre varias escrituras al final del archivo: el
+// índice sólo lee lo añadido, pero los trigramas que cruzan cada límite
+// también tienen que estar
+static void check_search_append(void) {
+    static const char *parts[] = { "tri", "gr", "a", "ma" };
+    fs_search_info idx, scan;
+    for (int i = 0; i < 4; i++) {
+        int fd = fs_open("sub/tix", O_WRONLY | O_APPEND | O_CREAT);
+        fs_fwrite(fd, parts[i], strlen(parts[i]));
+        fs_close(fd);
+    }
+    fs_search("trigrama", "/", 0, &idx);
+    fs_search("trigrama", "/", FS_SEARCH_SCAN, &scan);
+    if (idx.matches != 1 || scan.matches != 1) die("search: faltan trigramas de lo anadido");
+    fs_unlink("sub/tix");
+}
+
+static void run_random(int ops) {
+    // La mitad de los archivos vive en un subdirectorio: los renombrados
+    // entre las dos mitades mueven entradas de un directorio a otro
+    fs_mkdir("sub");
+    for (int i = 0; i < MODEL_FILES; i++) {
+        snprintf(model[i].name, sizeof(model[i].name), i % 2 ? "sub/r%d" : "r%d", i);
+        model[i].data = malloc(MODEL_MAX + MODEL_SLACK);
+        if (!model[i].data) die("sin memoria");
+        fs_unlink(model[i].name);
+    }
+    fs_unlink("lines");
+    lines_len = 0;
+    lines_exist = 0;
+
+    uint32_t free_before = fs_free_clusters();
+    int edits = 0;
+    // Cada escritura, borrado o movimiento pone al día el índice de trigramas
+    fs_index_enable(1);
+    check_search_append();
+
+    for (op_index = 0; op_index < ops; op_index++) {
+        if (rng_below(3) == 0) {
+            op_line_edit();
+            edits++;
+            continue;
+        }
+        // Como en el shell: las ediciones pendientes se vuelcan antes de
+        // cualquier otro comando
+        if (edits) {
+            edit_sync();
+            if (lines_exist) check_file("lines", lines, lines_len);
+            edits = 0;
+        }
+        if (rng_below(16) == 0) check_search();
+        op_bytes(&model[rng_below(MODEL_FILES)]);
+    }
+    edit_sync();
+    if (lines_exist) check_file("lines", lines, lines_len);
+
+    // Todas las escrituras pasaron por disk_transfer: las sumas coinciden.
+    // Un byte pisado por fuera se detecta en su sector y sólo en él.
+    fs_scrub_info info;
+    fs_scrub(&info);
+    if (info.errors) die("scrub: sumas incorrectas tras la secuencia");
+    uint32_t lba = DISK_SECTORS - 1 - rng_below(DISK_SECTORS / 2);
+    uint8_t *stray = &disk_image_start[lba * 512 + rng_below(512)];
+    *stray ^= 0x40;
+    fs_scrub(&info);
+    if (info.errors != 1 || info.bad[0] != lba) die("scrub: no detecta el sector pisado");
+    *stray ^= 0x40;
+    fs_scrub(&info);
+    if (info.errors) die("scrub: el sector restaurado sigue marcado");
+
+    // La suma de Internet por palabras coincide con la de 16 bits en
+    // cualquier alineación y longitud, también sumada en dos partes
+    for (int i = 0; i < 2000; i++) {
+        uint32_t off = rng_below(8), len = rng_below(2000), cut = rng_below(len + 1) & ~1u;
+        for (uint32_t k = 0; k < off + len; k++) scratch[k] = rng();
+        const uint8_t *p = scratch + off;
+        if (csum_fold(csum_add(0, p, len)) != csum_ref(p, len)) die("csum: suma incorrecta");
+        if (csum_fold(csum_add(csum_add(0, p, cut), p + cut, len - cut)) != csum_ref(p, len))
+            die("csum: suma por partes incorrecta");
+    }
+
+    for (int i = 0; i < MODEL_FILES; i++) {
+        if (model[i].exists) check_file(model[i].name, model[i].data, model[i].size);
+        fs_unlink(model[i].name);
+        free(model[i].data);
+    }
+    fs_unlink("lines");
+    fs_index_stats ist;
+    fs_index_get_stats(&ist);
+    if (!ist.complete) die("search: el indice se quedo incompleto");
+    fs_index_enable(0);
+
+    uint32_t free_after = fs_free_clusters();
+    if (free_after != free_before) {
+        fprintf(stderr, "fs-bench: %u clusters libres, antes %u\n", free_after, free_before);
+        die("clusters perdidos");
+    }
+    if (fs_unlink("sub")) die("sub: no se pudo borrar el directorio");
+    printf("aleatorio: %d operaciones correctas\n", ops);
+}
+
+// =============================================================================
+// PROGRAMA PRINCIPAL
+// =============================================================================
+int main(int argc, char **argv) {
+    const char *in = NULL, *out = NULL;
+    int ops = 20000, bench = 1, random = 1, opt;
+
+    while ((opt = getopt(argc, argv, "i:o:s:n:brv")) != -1) {
+        switch (opt) {
+        case 'i': in = optarg; break;
+        case 'o': out = optarg; break;
+        case 's': seed = strtoul(optarg, NULL, 0); break;
+        case 'n': ops = atoi(optarg); break;
+        case 'b': random = 0; break;
+        case 'r': bench = 0; break;
+        case 'v': host_echo = 1; break;
+        default:
+            fprintf(stderr, "Uso: %s [-i imagen] [-o imagen] [-s semilla] [-n operaciones] [-b] [-r] [-v]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    if (!seed) seed = 1;
+    rng_state = seed;
+
+    if (in) {
+        uint32_t size;
+        uint8_t *image = load_image(in, &size);
+        if (!image) {
+            perror(in);
+            return 1;
+        }
+        if (!fs_mount_image(image, size)) {
+            fprintf(stderr, "fs-bench: %s no es una imagen valida para DISK_SECTORS=%u\n",
+                    in, DISK_SECTORS);
+            return 1;
+        }
+    } else {
+        populate(48);
+        if (out && !save_image(out)) {
+            perror(out);
+            return 1;
+        }
+    }
+    printf("disco: %u sectores, %u clusters libres de %u\n",
+           DISK_SECTORS, fs_free_clusters(), DATA_CLUSTERS);
+
+    if (bench) run_benchmarks();
+    if (random) {
+        // La secuencia sólo depende de la semilla, haya o no pruebas antes
+        rng_state = seed;
+        printf("semilla %u\n", seed);
+        run_random(ops);
+    }
+    return 0;
+}
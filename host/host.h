@@ -0,0 +1,19 @@
+// host.h: lo que host/platform.c ofrece al harness del host
+//
+// fs.c y text.c se compilan con printf/putchar renombrados a host_printf y
+// host_putchar (ver el target host-bench del Makefile). Su salida se cuenta
+// siempre y sólo se muestra si host_echo está activo.
+#ifndef HOST_H
+#define HOST_H
+
+#include <stdint.h>
+
+extern uint8_t disk_image_start[];   // El disco en RAM (platform.h)
+
+extern int host_echo;
+extern unsigned long host_chars;
+
+void host_putchar(char c);
+void host_printf(const char *fmt, ...);
+
+#endif
@@ -0,0 +1,42 @@
+// platform.c: platform.h para el host (make host-bench)
+//
+// La consola del kernel se convierte en un contador de caracteres que, con
+// host_echo, también escribe en stdout. El disco en RAM es un array global
+// del mismo tamaño que la zona que reserva boot.s.
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "fat16.h"
+#include "host/host.h"
+
+uint8_t disk_image_start[DISK_SECTORS * SECTOR_SIZE];
+uint64_t memcpy_bytes;   // Contador de klib.h
+
+// Las rutinas de klib.h: en el host, las de libc
+static void *host_memcpy(void *dest, const void *src, unsigned int n) { return memcpy(dest, src, n); }
+static void *host_memset(void *s, int c, unsigned int n) { return memset(s, c, n); }
+static void *host_memchr(const void *s, int c, unsigned int n) { return memchr(s, c, n); }
+void *(*memcpy_fn)(void *, const void *, unsigned int) = host_memcpy;
+void *(*memset_fn)(void *, int, unsigned int) = host_memset;
+void *(*memchr_fn)(const void *, int, unsigned int) = host_memchr;
+
+int host_echo;
+unsigned long host_chars;
+
+void host_putchar(char c) {
+    host_chars++;
+    if (host_echo) fputc(c, stdout);
+}
+
+// Los formatos del kernel (%s %c %d %u %x) son un subconjunto de los de libc
+void host_printf(const char *fmt, ...) {
+    char buf[1024];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    if (n > (int)sizeof(buf) - 1) n = sizeof(buf) - 1;
+    for (int i = 0; i < n; i++) host_putchar(buf[i]);
+}
@@ -0,0 +1,271 @@
+// idt.c: GDT, TSS, tabla de interrupciones, PIC 8259, PIT 8253 y entradas
+// de las llamadas al sistema (ver idt.h)
+
+#include <stdint.h>
+#include "io.h"
+#include "platform.h"
+#include "cpu.h"
+#include "idt.h"
+
+// =============================================================================
+// GDT (GLOBAL DESCRIPTOR TABLE)
+// =============================================================================
+// Modelo plano: un segmento de código y otro de datos de 4 GiB en ring 0,
+// los mismos dos en ring 3 y la TSS. Cada descriptor empaqueta base,
+// límite, acceso y granularidad en 8 bytes.
+//
+// En modo largo el código de ring 0 es de 64 bits (flag L) y el de ring 3
+// sigue siendo de 32: los programas corren en modo compatibilidad. La TSS
+// ocupa allí dos entradas.
+#ifdef __x86_64__
+#define CODE_FLAGS 0xA      // Granularidad de 4 KiB, 64 bits
+#define GDT_ENTRIES 7
+#else
+#define CODE_FLAGS 0xC      // Granularidad de 4 KiB, 32 bits
+#define GDT_ENTRIES 6
+#endif
+static uint64_t gdt[GDT_ENTRIES];
+
+// De la TSS sólo se usa la pila de ring 0 (esp0, ss0) a la que salta la
+// CPU cuando una interrupción llega en ring 3. iomap = tamaño: sin mapa de
+// puertos, así que ring 3 no puede hacer in/out.
+#ifdef __x86_64__
+static struct __attribute__((packed)) {
+    uint32_t unused0;
+    uint64_t esp0, rsp1, rsp2, unused1, ist[7], unused2;
+    uint16_t trap, iomap;
+} tss;
+#else
+static struct __attribute__((packed)) {
+    uint32_t prev, esp0, ss0, unused[22];
+    uint16_t trap, iomap;
+} tss;
+#endif
+
+static struct __attribute__((packed)) {
+    uint16_t  limit;
+    uintptr_t base;
+} gdt_desc, idt_desc;
+
+static uint64_t gdt_entry(uint32_t base, uint32_t limit, uint8_t access, uint8_t flags) {
+    uint64_t e = limit & 0xFFFF;
+    e |= (uint64_t)(base & 0xFFFFFF) << 16;
+    e |= (uint64_t)access << 40;
+    e |= (uint64_t)((limit >> 16) & 0xF) << 48;
+    e |= (uint64_t)(flags & 0xF) << 52;
+    e |= (uint64_t)(base >> 24) << 56;
+    return e;
+}
+
+void gdt_load(void *desc);   // isr.s
+
+static void gdt_init(void) {
+    gdt[0] = 0;
+    gdt[1] = gdt_entry(0, 0xFFFFF, 0x9A, CODE_FLAGS);  // Código: presente, ring 0, ejecutable
+    gdt[2] = gdt_entry(0, 0xFFFFF, 0x92, 0xC);  // Datos: presente, ring 0, escribible
+    gdt[3] = gdt_entry(0, 0xFFFFF, 0xFA, 0xC);  // Código de ring 3
+    gdt[4] = gdt_entry(0, 0xFFFFF, 0xF2, 0xC);  // Datos de ring 3
+    gdt[5] = gdt_entry((uint32_t)(uintptr_t)&tss, sizeof(tss) - 1, 0x89, 0x0);   // TSS disponible
+#ifdef __x86_64__
+    gdt[6] = (uint64_t)(uintptr_t)&tss >> 32;   // Bits altos de la base
+#else
+    tss.ss0 = KERNEL_DS;
+#endif
+    tss.iomap = sizeof(tss);
+    gdt_desc.limit = sizeof(gdt) - 1;
+    gdt_desc.base = (uintptr_t)gdt;
+    gdt_load(&gdt_desc);
+    asm volatile ("ltr %w0" : : "r"(TSS_SEL));
+}
+
+// =============================================================================
+// IDT (INTERRUPT DESCRIPTOR TABLE)
+// =============================================================================
+#define IDT_VECTORS 64
+#define IDT_GATE    0x8E   // Puerta de interrupción (de 32 o 64 bits según el modo), ring 0
+#define IDT_GATE_U  0xEE   // La misma, invocable desde ring 3 (int 0x80)
+
+// En modo largo cada puerta ocupa 16 bytes: los 8 de siempre más los 32
+// bits altos de la dirección
+typedef struct {
+    uint64_t low;
+#ifdef __x86_64__
+    uint64_t high;
+#endif
+} idt_gate;
+
+extern const uintptr_t isr_stubs[IDT_VECTORS];  // isr.s
+void isr_syscall(void);                         // isr.s
+
+static idt_gate idt[SYSCALL_VECTOR + 1];        // Los vectores sin stub quedan ausentes
+static irq_handler irq_handlers[16];
+static irq_handler local_handlers[IDT_VECTORS - LOCAL_BASE];
+volatile int irq_arrived;
+static syscall_handler syscall_fn;
+static fault_handler   fault_fn;
+
+static const char *const exception_names[32] = {
+    "division por cero", "depuracion", "NMI", "breakpoint", "overflow",
+    "BOUND", "opcode invalido", "sin coprocesador", "doble fallo", "?",
+    "TSS invalido", "segmento ausente", "fallo de pila", "proteccion general",
+    "fallo de pagina", "?", "error de coma flotante", "alineacion",
+    "machine check", "SIMD",
+};
+
+static void idt_set(int vector, uintptr_t handler, uint8_t gate) {
+    idt[vector].low = (handler & 0xFFFF) | ((uint64_t)KERNEL_CS << 16) |
+                      ((uint64_t)gate << 40) | ((uint64_t)((handler >> 16) & 0xFFFF) << 48);
+#ifdef __x86_64__
+    idt[vector].high = (uint64_t)handler >> 32;
+#endif
+}
+
+const char *exception_name(uint32_t vector) {
+    if (vector >= 20) return "reservada";
+    return exception_names[vector];
+}
+
+// =============================================================================
+// PIC 8259
+// =============================================================================
+// El PIC maestro (IRQ 0-7) y el esclavo (IRQ 8-15) entregan por defecto en
+// los vectores 8-15, que chocan con las excepciones de la CPU. Se
+// reprograman a 32-47 y se enmascaran todas las líneas.
+#define PIC1_CMD  0x20
+#define PIC1_DATA 0x21
+#define PIC2_CMD  0xA0
+#define PIC2_DATA 0xA1
+#define PIC_EOI   0x20
+
+static void pic_init(void) {
+    outb(PIC1_CMD, 0x11);          // ICW1: inicializar, ICW4 presente
+    outb(PIC2_CMD, 0x11);
+    outb(PIC1_DATA, IRQ_BASE);     // ICW2: vector base
+    outb(PIC2_DATA, IRQ_BASE + 8);
+    outb(PIC1_DATA, 0x04);         // ICW3: esclavo en la IRQ 2
+    outb(PIC2_DATA, 0x02);
+    outb(PIC1_DATA, 0x01);         // ICW4: modo 8086
+    outb(PIC2_DATA, 0x01);
+    outb(PIC1_DATA, 0xFF);         // Todas enmascaradas
+    outb(PIC2_DATA, 0xFF);
+}
+
+static void pic_set_mask(int irq, int masked) {
+    uint16_t port = irq < 8 ? PIC1_DATA : PIC2_DATA;
+    uint8_t bit = 1 << (irq & 7);
+    uint8_t mask = inb(port);
+    outb(port, masked ? mask | bit : mask & ~bit);
+    // Las IRQs del esclavo llegan a través de la IRQ 2 del maestro
+    if (irq >= 8 && !masked) pic_set_mask(2, 0);
+}
+
+// =============================================================================
+// DESPACHO
+// =============================================================================
+uint32_t syscall_dispatch(uint32_t num, uint32_t a, uint32_t b, uint32_t c);
+
+// Llamado desde isr_common con las interrupciones desactivadas
+void interrupt_dispatch(interrupt_frame *frame) {
+    if (frame->vector == SYSCALL_VECTOR) {
+        asm volatile ("sti");
+        frame->eax = syscall_dispatch(frame->eax, frame->ebx, frame->esi, frame->edi);
+        return;
+    }
+    if (frame->vector < IRQ_BASE) {
+        // Un fallo de un programa sólo termina el programa
+        if ((frame->cs & 3) == 3 && fault_fn) fault_fn(frame);
+        printf("\nExcepcion %u (%s) en eip=0x%lx, error=0x%x\n", (uint32_t)frame->vector,
+               exception_name(frame->vector), (unsigned long)frame->eip, (uint32_t)frame->error);
+        printf("Sistema detenido.\n");
+        for (;;) asm volatile ("cli; hlt");
+    }
+
+    irq_arrived = 1;
+    if (frame->vector >= LOCAL_BASE) {
+        int v = frame->vector - LOCAL_BASE;
+        if (local_handlers[v]) local_handlers[v](frame);
+        return;
+    }
+    int irq = frame->vector - IRQ_BASE;
+    if (irq_handlers[irq]) irq_handlers[irq](frame);
+    if (irq >= 8) outb(PIC2_CMD, PIC_EOI);
+    outb(PIC1_CMD, PIC_EOI);
+}
+
+void irq_install(int irq, irq_handler handler) {
+    asm volatile ("cli");
+    irq_handlers[irq] = handler;
+    pic_set_mask(irq, handler == 0);
+    asm volatile ("sti");
+}
+
+void local_install(int vector, irq_handler handler) {
+    asm volatile ("cli");
+    local_handlers[vector - LOCAL_BASE] = handler;
+    asm volatile ("sti");
+}
+
+// Programa el canal 0 del PIT como generador de frecuencia (modo 2)
+void pit_set_rate(uint32_t hz) {
+    uint32_t divisor = PIT_HZ / hz;
+    if (divisor < 1) divisor = 1;
+    if (divisor > 0xFFFF) divisor = 0xFFFF;
+    outb(0x43, 0x34);              // Canal 0, byte bajo y alto, modo 2
+    outb(0x40, divisor & 0xFF);
+    outb(0x40, divisor >> 8);
+}
+
+// =============================================================================
+// LLAMADAS AL SISTEMA
+// =============================================================================
+// Las dos entradas (int 0x80 e isr.s:sysenter_entry) acaban aquí, ya con
+// las interrupciones activadas. sysenter salta a la dirección y la pila que
+// digan tres MSR; la pila es la misma que la de la TSS (kernel_stack_set).
+#define MSR_SYSENTER_CS  0x174
+#define MSR_SYSENTER_ESP 0x175
+#define MSR_SYSENTER_EIP 0x176
+
+void sysenter_entry(void);   // isr.s
+
+static int sysenter_ok;
+
+static void wrmsr(uint32_t msr, uint64_t value) {
+    asm volatile ("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+uint32_t syscall_dispatch(uint32_t num, uint32_t a, uint32_t b, uint32_t c) {
+    return syscall_fn ? syscall_fn(num, a, b, c) : (uint32_t)-1;
+}
+
+void syscall_install(syscall_handler sys, fault_handler fault) {
+    syscall_fn = sys;
+    fault_fn = fault;
+}
+
+int sysenter_available(void) {
+    return sysenter_ok;
+}
+
+void kernel_stack_set(uintptr_t esp) {
+    tss.esp0 = esp;
+    if (sysenter_ok) wrmsr(MSR_SYSENTER_ESP, esp);
+}
+
+static void sysenter_init(void) {
+    sysenter_ok = cpu_has(CPU_SEP);
+    if (!sysenter_ok) return;
+    wrmsr(MSR_SYSENTER_CS, KERNEL_CS);
+    wrmsr(MSR_SYSENTER_EIP, (uintptr_t)sysenter_entry);
+}
+
+void interrupts_init(void) {
+    gdt_init();
+    pic_init();
+    for (int i = 0; i < IDT_VECTORS; i++) idt_set(i, isr_stubs[i], IDT_GATE);
+    idt_set(SYSCALL_VECTOR, (uintptr_t)isr_syscall, IDT_GATE_U);
+    sysenter_init();
+    idt_desc.limit = sizeof(idt) - 1;
+    idt_desc.base = (uintptr_t)idt;
+    asm volatile ("lidt %0" : : "m"(idt_desc));
+    asm volatile ("sti");
+}
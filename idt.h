@@ -0,0 +1,81 @@
+// idt.h: GDT, IDT, PIC y PIT (idt.c, isr.s)
+//
+// Hasta ahora el kernel funcionaba sin interrupciones: el teclado se lee
+// por sondeo. Esta capa instala una GDT propia (la del cargador no está
+// garantizada), los vectores de excepción 0-31 y las 16 IRQs del PIC en
+// los vectores 32-47. Todas las IRQs empiezan enmascaradas: se activan
+// una a una al registrar su manejador.
+//
+// Para los programas de usuario (proc.c) la GDT lleva además los segmentos
+// de ring 3 y una TSS, y hay dos entradas de llamadas al sistema: int 0x80
+// y sysenter (ver syscall.h).
+//
+// Con make ARCH=x86_64 el kernel corre en modo largo (boot64.s, isr64.s):
+// el código del kernel es de 64 bits y el segmento de ring 3 sigue siendo
+// de 32, así que los mismos programas corren en modo compatibilidad con
+// los mismos selectores.
+#ifndef IDT_H
+#define IDT_H
+
+#include <stdint.h>
+
+// Selectores de la GDT
+#define KERNEL_CS 0x08
+#define KERNEL_DS 0x10
+#define USER_CS   0x1B   // sysexit exige que estén en KERNEL_CS + 16 y + 24
+#define USER_DS   0x23
+#define TSS_SEL   0x28
+
+#define IRQ_BASE  32    // Vector de la IRQ 0 tras reprogramar el PIC
+#define IRQ_TIMER 0
+#define LOCAL_BASE 48   // Vectores 48-63: del APIC local (timer.c), sin PIC
+#define SYSCALL_VECTOR 0x80
+
+#define PIT_HZ    1193182   // Frecuencia de entrada del PIT
+
+// Estado guardado por isr.s: registros de pusha, vector, código de error y
+// lo que apila la CPU al entrar en la interrupción (user_esp y user_ss sólo
+// si venía de ring 3)
+#ifdef __x86_64__
+// En modo largo (isr64.s) se guardan los 15 registros y la CPU apila
+// siempre SS:RSP. Los campos conservan los nombres de 32 bits para que el
+// código común (llamadas al sistema, fallos, perfilador) sea el mismo.
+typedef struct {
+    uint64_t r15, r14, r13, r12, r11, r10, r9, r8;
+    uint64_t edi, esi, ebp, ebx, edx, ecx, eax;
+    uint64_t vector, error;
+    uint64_t eip, cs, eflags;
+    uint64_t user_esp, user_ss;
+} interrupt_frame;
+#else
+typedef struct {
+    uint32_t edi, esi, ebp, esp, ebx, edx, ecx, eax;
+    uint32_t vector, error;
+    uint32_t eip, cs, eflags;
+    uint32_t user_esp, user_ss;
+} interrupt_frame;
+#endif
+
+typedef void (*irq_handler)(interrupt_frame *frame);
+
+// Llamadas al sistema: (número, EBX, ESI, EDI) -> EAX. Una excepción en
+// ring 3 no detiene el sistema: va al manejador de fallos, que no retorna.
+typedef uint32_t (*syscall_handler)(uint32_t num, uint32_t a, uint32_t b, uint32_t c);
+typedef void (*fault_handler)(interrupt_frame *frame);
+
+void interrupts_init(void);
+void irq_install(int irq, irq_handler handler);   // NULL la desactiva
+// Vectores del APIC local: el manejador manda su propio EOI al APIC
+void local_install(int vector, irq_handler handler);
+void pit_set_rate(uint32_t hz);                   // Canal 0, modo 2
+void syscall_install(syscall_handler sys, fault_handler fault);
+int  sysenter_available(void);                    // CPUID: SEP
+void kernel_stack_set(uintptr_t esp);             // Pila al entrar desde ring 3
+const char *exception_name(uint32_t vector);
+
+// Se pone a 1 con cada IRQ o vector local. timer_idle() lo mira con las
+// interrupciones desactivadas antes de hlt, para no dormirse después de
+// una interrupción que ya llegó.
+extern volatile int irq_arrived;
+
+#endif
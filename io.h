@@ -0,0 +1,42 @@
+// io.h: acceso a puertos de E/S del x86 (sólo kernel)
+#ifndef IO_H
+#define IO_H
+
+#include <stdint.h>
+
+// =============================================================================
+// ENTRADA/SALIDA DE PUERTOS (I/O PORTS)
+// =============================================================================
+// En x86, los dispositivos se comunican a través de puertos I/O.
+// outb(): envía un byte a un puerto específico
+// inb(): lee un byte de un puerto específico
+static inline void outb(uint16_t port, uint8_t val) {
+    asm volatile ("outb %0, %1" : : "a"(val), "Nd"(port));
+}
+static inline uint8_t inb(uint16_t port) {
+    uint8_t ret;
+    asm volatile ("inb %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+// Lo mismo con 16 bits (registros de la VGA de Bochs)
+static inline void outw(uint16_t port, uint16_t val) {
+    asm volatile ("outw %0, %1" : : "a"(val), "Nd"(port));
+}
+static inline uint16_t inw(uint16_t port) {
+    uint16_t ret;
+    asm volatile ("inw %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+// Lo mismo con 32 bits (el espacio de configuración PCI)
+static inline void outl(uint16_t port, uint32_t val) {
+    asm volatile ("outl %0, %1" : : "a"(val), "Nd"(port));
+}
+static inline uint32_t inl(uint16_t port) {
+    uint32_t ret;
+    asm volatile ("inl %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+#endif
@@ -0,0 +1,174 @@
+# isr.s: puntos de entrada de las interrupciones, de las llamadas al
+# sistema y de los programas de usuario, y carga de la GDT
+
+# =============================================================================
+# CARGA DE LA GDT
+# =============================================================================
+# gdt_load(descriptor): carga GDTR y recarga todos los registros de segmento.
+# CS sólo se puede cambiar con un salto lejano.
+.section .text
+.global gdt_load
+.type gdt_load, @function
+gdt_load:
+    mov 4(%esp), %eax
+    lgdt (%eax)
+    mov $0x10, %ax              # KERNEL_DS
+    mov %ax, %ds
+    mov %ax, %es
+    mov %ax, %fs
+    mov %ax, %gs
+    mov %ax, %ss
+    ljmp $0x08, $1f             # KERNEL_CS
+1:
+    ret
+.size gdt_load, . - gdt_load
+
+# =============================================================================
+# STUBS DE INTERRUPCIÓN
+# =============================================================================
+# Cada vector apila un código de error (0 si la CPU no lo pone) y su número,
+# y salta a isr_common, que guarda los registros y llama a
+# interrupt_dispatch(frame) en idt.c. El frame resultante es el
+# interrupt_frame de idt.h.
+.macro ISR num, has_error
+isr_\num:
+    .if \has_error == 0
+    push $0
+    .endif
+    push $\num
+    jmp isr_common
+.endm
+
+# Excepciones con código de error: 8, 10-14, 17, 21
+.irp n, 0,1,2,3,4,5,6,7,9,15,16,18,19,20,22,23,24,25,26,27,28,29,30,31
+    ISR \n, 0
+.endr
+.irp n, 8,10,11,12,13,14,17,21
+    ISR \n, 1
+.endr
+# IRQs 0-15 del PIC en los vectores 32-47
+.irp n, 32,33,34,35,36,37,38,39,40,41,42,43,44,45,46,47
+    ISR \n, 0
+.endr
+# Vectores del APIC local (timer.c): 48-63
+.irp n, 48,49,50,51,52,53,54,55,56,57,58,59,60,61,62,63
+    ISR \n, 0
+.endr
+
+# int 0x80: llamada al sistema por el camino de las interrupciones (idt.c)
+.global isr_syscall
+isr_syscall:
+    push $0
+    push $0x80
+    jmp isr_common
+
+isr_common:
+    pusha
+    cld
+    push %esp                   # interrupt_frame *
+    call interrupt_dispatch
+    add $4, %esp
+    popa
+    add $8, %esp                # Vector y código de error
+    iret
+
+# =============================================================================
+# SYSENTER
+# =============================================================================
+# La CPU llega aquí en ring 0 con la pila del MSR 0x175 y las interrupciones
+# desactivadas, sin guardar nada. La libc deja en ECX su ESP y en EDX la
+# dirección de retorno, que es justo lo que sysexit restaura; el número y
+# los argumentos van en EAX, EBX, ESI y EDI (ver syscall.h).
+# sti retrasa las interrupciones una instrucción: no entra ninguna entre
+# sti y sysexit, cuando la pila aún es la del kernel.
+.global sysenter_entry
+.type sysenter_entry, @function
+sysenter_entry:
+    push %ecx
+    push %edx
+    push %edi
+    push %esi
+    push %ebx
+    push %eax
+    cld
+    sti
+    call syscall_dispatch       # Conserva EBX, ESI, EDI y EBP
+    add $16, %esp
+    cli
+    pop %edx
+    pop %ecx
+    sti
+    sysexit
+.size sysenter_entry, . - sysenter_entry
+
+# =============================================================================
+# ENTRADA Y SALIDA DE RING 3
+# =============================================================================
+# user_enter(eip, esp): salta a ring 3 con iret y vuelve cuando el programa
+# llama a user_leave(código) (exit o un fallo), que retorna ese código. Lo
+# que hay en la pila del kernel por debajo de los registros guardados es la
+# pila de ring 0 del programa: la usan sus interrupciones y llamadas.
+.global user_enter
+.type user_enter, @function
+user_enter:
+    push %ebp
+    push %ebx
+    push %esi
+    push %edi
+    mov %esp, user_kernel_esp
+    push %esp
+    call kernel_stack_set
+    add $4, %esp
+    mov 20(%esp), %ecx          # eip
+    mov 24(%esp), %edx          # esp
+    mov $0x23, %ax              # USER_DS
+    mov %ax, %ds
+    mov %ax, %es
+    mov %ax, %fs
+    mov %ax, %gs
+    push $0x23                  # SS
+    push %edx                   # ESP
+    pushf
+    orl $0x200, (%esp)          # Con interrupciones
+    push $0x1B                  # USER_CS
+    push %ecx                   # EIP
+    xor %eax, %eax              # Nada del kernel llega a los registros
+    xor %ebx, %ebx
+    xor %ecx, %ecx
+    xor %edx, %edx
+    xor %esi, %esi
+    xor %edi, %edi
+    xor %ebp, %ebp
+    iret
+.size user_enter, . - user_enter
+
+.global user_leave
+.type user_leave, @function
+user_leave:
+    mov 4(%esp), %eax
+    mov user_kernel_esp, %esp
+    mov $0x10, %cx              # KERNEL_DS
+    mov %cx, %ds
+    mov %cx, %es
+    mov %cx, %fs
+    mov %cx, %gs
+    pop %edi
+    pop %esi
+    pop %ebx
+    pop %ebp
+    sti                         # Desde un fallo se llega con IF = 0
+    ret
+.size user_leave, . - user_leave
+
+.section .bss
+.align 4
+user_kernel_esp:
+    .skip 4
+
+# Tabla de direcciones de los stubs, indexada por vector
+.section .rodata
+.global isr_stubs
+isr_stubs:
+.irp n, 0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,26,27,28,29,30,31,32,33,34,35,36,37,38,39,40,41,42,43,44,45,46,47,48,49,50,51,52,53,54,55,56,57,58,59,60,61,62,63
+    .long isr_\n
+.endr
@@ -0,0 +1,227 @@
+# isr64.s: lo mismo que isr.s para el kernel de 64 bits (make ARCH=x86_64)
+#
+# Los programas de usuario siguen siendo de 32 bits y corren en modo
+# compatibilidad: USER_CS es un segmento de 32 bits, así que iretq y sysexit
+# (sin REX.W) vuelven a ellos igual que en el kernel de 32. Los argumentos
+# de C llegan en RDI, RSI, RDX y RCX (System V), no en la pila.
+
+# =============================================================================
+# CARGA DE LA GDT
+# =============================================================================
+# gdt_load(descriptor): carga GDTR y recarga todos los registros de segmento.
+# En modo largo no hay ljmp a un selector inmediato: CS se cambia con lretq.
+.section .text
+.code64
+.global gdt_load
+.type gdt_load, @function
+gdt_load:
+    lgdt (%rdi)
+    mov $0x10, %ax              # KERNEL_DS
+    mov %ax, %ds
+    mov %ax, %es
+    mov %ax, %fs
+    mov %ax, %gs
+    mov %ax, %ss
+    pushq $0x08                 # KERNEL_CS
+    lea 1f(%rip), %rax
+    push %rax
+    lretq
+1:
+    ret
+.size gdt_load, . - gdt_load
+
+# =============================================================================
+# STUBS DE INTERRUPCIÓN
+# =============================================================================
+# Igual que en isr.s: código de error (0 si la CPU no lo pone), número de
+# vector y salto a isr_common. La CPU alinea la pila a 16 bytes antes de
+# apilar SS, RSP, RFLAGS, CS y RIP; con el error, el vector y los 15
+# registros la llamada a interrupt_dispatch sigue alineada.
+.macro ISR num, has_error
+isr_\num:
+    .if \has_error == 0
+    pushq $0
+    .endif
+    pushq $\num
+    jmp isr_common
+.endm
+
+# Excepciones con código de error: 8, 10-14, 17, 21
+.irp n, 0,1,2,3,4,5,6,7,9,15,16,18,19,20,22,23,24,25,26,27,28,29,30,31
+    ISR \n, 0
+.endr
+.irp n, 8,10,11,12,13,14,17,21
+    ISR \n, 1
+.endr
+# IRQs 0-15 del PIC en los vectores 32-47
+.irp n, 32,33,34,35,36,37,38,39,40,41,42,43,44,45,46,47
+    ISR \n, 0
+.endr
+# Vectores del APIC local (timer.c): 48-63
+.irp n, 48,49,50,51,52,53,54,55,56,57,58,59,60,61,62,63
+    ISR \n, 0
+.endr
+
+# int 0x80: llamada al sistema por el camino de las interrupciones (idt.c)
+.global isr_syscall
+isr_syscall:
+    pushq $0
+    pushq $0x80
+    jmp isr_common
+
+# El orden es el de interrupt_frame (idt.h): RAX queda más arriba y R15
+# en la dirección más baja
+isr_common:
+    push %rax
+    push %rcx
+    push %rdx
+    push %rbx
+    push %rbp
+    push %rsi
+    push %rdi
+    push %r8
+    push %r9
+    push %r10
+    push %r11
+    push %r12
+    push %r13
+    push %r14
+    push %r15
+    cld
+    mov %rsp, %rdi              # interrupt_frame *
+    call interrupt_dispatch
+    pop %r15
+    pop %r14
+    pop %r13
+    pop %r12
+    pop %r11
+    pop %r10
+    pop %r9
+    pop %r8
+    pop %rdi
+    pop %rsi
+    pop %rbp
+    pop %rbx
+    pop %rdx
+    pop %rcx
+    pop %rax
+    add $16, %rsp               # Vector y código de error
+    iretq
+
+# =============================================================================
+# SYSENTER
+# =============================================================================
+# Sólo en Intel (cpu.c): desde modo compatibilidad la CPU salta a
+# KERNEL_CS, ya de 64 bits, con la RSP del MSR 0x175. ECX (ESP del
+# programa) y EDX (retorno) son para sysexit; EAX, EBX, ESI y EDI pasan a
+# RDI, RSI, RDX y RCX para syscall_dispatch. RSI y RDI no se conservan en
+# System V, así que se guardan aquí junto con los demás del programa; con
+# seis registros apilados la pila (alineada por user_enter) sigue a 16.
+.global sysenter_entry
+.type sysenter_entry, @function
+sysenter_entry:
+    push %rcx
+    push %rdx
+    push %rdi
+    push %rsi
+    push %rbx
+    push %rbp
+    cld
+    sti
+    mov %edi, %ecx              # c
+    mov %esi, %edx              # b
+    mov %ebx, %esi              # a
+    mov %eax, %edi              # Número
+    call syscall_dispatch
+    pop %rbp
+    pop %rbx
+    pop %rsi
+    pop %rdi
+    cli
+    pop %rdx
+    pop %rcx
+    sti
+    sysexitl                    # De 32 bits: EIP = EDX, ESP = ECX, CS = USER_CS
+.size sysenter_entry, . - sysenter_entry
+
+# =============================================================================
+# ENTRADA Y SALIDA DE RING 3
+# =============================================================================
+# user_enter(eip, esp) y user_leave(código), como en isr.s. La pila de ring
+# 0 del programa empieza alineada a 16 bytes bajo los registros guardados.
+.global user_enter
+.type user_enter, @function
+user_enter:
+    push %rbp
+    push %rbx
+    push %r12
+    push %r13
+    push %r14
+    push %r15
+    mov %rsp, user_kernel_rsp(%rip)
+    mov %edi, %r12d             # eip (los 32 bits altos no están definidos)
+    mov %esi, %r13d             # esp
+    sub $8, %rsp                # Alinear la llamada
+    mov %rsp, %rdi
+    call kernel_stack_set
+    mov $0x23, %ax              # USER_DS: el modo compatibilidad sí lo usa
+    mov %ax, %ds
+    mov %ax, %es
+    mov %ax, %fs
+    mov %ax, %gs
+    pushq $0x23                 # SS
+    push %r13                   # ESP
+    pushfq
+    orq $0x200, (%rsp)          # Con interrupciones
+    pushq $0x1B                 # USER_CS, de 32 bits
+    push %r12                   # EIP
+    xor %eax, %eax              # Nada del kernel llega a los registros
+    xor %ebx, %ebx
+    xor %ecx, %ecx
+    xor %edx, %edx
+    xor %esi, %esi
+    xor %edi, %edi
+    xor %ebp, %ebp
+    xor %r8d, %r8d
+    xor %r9d, %r9d
+    xor %r10d, %r10d
+    xor %r11d, %r11d
+    xor %r12d, %r12d
+    xor %r13d, %r13d
+    xor %r14d, %r14d
+    xor %r15d, %r15d
+    iretq
+.size user_enter, . - user_enter
+
+.global user_leave
+.type user_leave, @function
+user_leave:
+    mov %edi, %eax
+    mov user_kernel_rsp(%rip), %rsp
+    mov $0x10, %cx              # KERNEL_DS
+    mov %cx, %ds
+    mov %cx, %es
+    mov %cx, %fs
+    mov %cx, %gs
+    pop %r15
+    pop %r14
+    pop %r13
+    pop %r12
+    pop %rbx
+    pop %rbp
+    sti                         # Desde un fallo se llega con IF = 0
+    ret
+.size user_leave, . - user_leave
+
+.section .bss
+.align 8
+user_kernel_rsp:
+    .skip 8
+
+# Tabla de direcciones de los stubs, indexada por vector
+.section .rodata
+.global isr_stubs
+isr_stubs:
+.irp n, 0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,26,27,28,29,30,31,32,33,34,35,36,37,38,39,40,41,42,43,44,45,46,47,48,49,50,51,52,53,54,55,56,57,58,59,60,61,62,63
+    .quad isr_\n
+.endr
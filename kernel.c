@@ -1,162 +1,25 @@
-// kernel.c: núcleo en C con filesystem FAT16 y shell educativo
+// kernel.c: núcleo en C con consola, teclado y shell educativo (FAT16 en fs.c)
 
 #include <stdint.h>
 #include <stdarg.h>
-
-// =============================================================================
-// IMPLEMENTACIÓN BÁSICA DE FUNCIONES DE LIBRERÍA ESTÁNDAR
-// =============================================================================
-// Como estamos en modo freestanding (sin biblioteca C estándar), 
-// debemos implementar nuestras propias funciones básicas de manipulación 
-// de memoria y cadenas.
-// Copia n bytes desde src hacia dest
-// Es fundamental en cualquier sistema operativo para mover datos en memoria
-static inline void *memcpy(void *dest, const void *src, unsigned int n) {
-    unsigned char *d = dest;
-    const unsigned char *s = src;
-    for (unsigned int i = 0; i < n; i++) d[i] = s[i];
-    return dest;
-}
-static inline void *memset(void *s, int c, unsigned int n) {
-    unsigned char *p = s;
-    for (unsigned int i = 0; i < n; i++) p[i] = (unsigned char)c;
-    return s;
-}
-static inline int memcmp(const void *a, const void *b, unsigned int n) {
-    const unsigned char *p = a, *q = b;
-    for (unsigned int i = 0; i < n; i++) {
-        if (p[i] != q[i]) return p[i] - q[i];
-    }
-    return 0;
-}
-static inline unsigned int strlen(const char *s) {
-    unsigned int len = 0;
-    while (s[len]) len++;
-    return len;
-}
-static inline char *strchr(const char *s, int c) {
-    for (; *s; s++) if (*s == (char)c) return (char *)s;
-    return 0;
-}
-static inline int strcmp(const char *a, const char *b) {
-    while (*a && (*a == *b)) { a++; b++; }
-    return (unsigned char)*a - (unsigned char)*b;
-}
-static inline char *strstr(const char *haystack, const char *needle) {
-    if (!*needle) return (char*)haystack;
-    while (*haystack) {
-        const char *h = haystack;
-        const char *n = needle;
-        while (*h && *n && (*h == *n)) { h++; n++; }
-        if (!*n) return (char*)haystack;
-        haystack++;
-    }
-    return (char*)0;
-}
-static inline int strncmp(const char *s1, const char *s2, unsigned int n) {
-    for (unsigned int i = 0; i < n; i++) {
-        if (s1[i] != s2[i]) return (unsigned char)s1[i] - (unsigned char)s2[i];
-        if (s1[i] == '\0') return 0;
-    }
-    return 0;
-}
-
-// =============================================================================
-// ENTRADA/SALIDA DE PUERTOS (I/O PORTS)
-// =============================================================================
-// En x86, los dispositivos se comunican a través de puertos I/O.
-// outb(): envía un byte a un puerto específico
-// inb(): lee un byte de un puerto específico
-static inline void outb(uint16_t port, uint8_t val) {
-    asm volatile ("outb %0, %1" : : "a"(val), "Nd"(port));
-}
-static inline uint8_t inb(uint16_t port) {
-    uint8_t ret;
-    asm volatile ("inb %1, %0" : "=a"(ret) : "Nd"(port));
-    return ret;
-}
-
-// =============================================================================
-// FUNCIONES AUXILIARES DE CADENAS
-// =============================================================================
-// Definir NULL
-#define NULL ((void*)0)
-
-// Implementación básica de strtok
-static char *strtok(char *str, const char *delim) {
-    static char *last_token = NULL;
-    char *token_start;
-    
-    // Si str es NULL, continuar con el último token
-    if (str == NULL) {
-        str = last_token;
-    }
-    
-    if (str == NULL) {
-        return NULL;
-    }
-    
-    // Saltar delimitadores al inicio
-    while (*str && strchr(delim, *str)) {
-        str++;
-    }
-    
-    if (*str == '\0') {
-        last_token = NULL;
-        return NULL;
-    }
-    
-    token_start = str;
-    
-    // Encontrar el final del token
-    while (*str && !strchr(delim, *str)) {
-        str++;
-    }
-    
-    if (*str) {
-        *str = '\0';
-        last_token = str + 1;
-    } else {
-        last_token = NULL;
-    }
-    
-    return token_start;
-}
-
-// Convierte una cadena a entero (implementación básica de atoi)
-static int atoi(const char *str) {
-    if (!str) return 0;  // Protección contra NULL
-    
-    int result = 0;
-    int sign = 1;
-    
-    // Saltar espacios en blanco
-    while (*str == ' ' || *str == '\t') str++;
-    
-    // Verificar que hay algo después de los espacios
-    if (*str == '\0') return 0;
-    
-    // Manejar signo
-    if (*str == '-') {
-        sign = -1;
-        str++;
-    } else if (*str == '+') {
-        str++;
-    }
-    
-    // Convertir dígitos
-    int found_digit = 0;
-    while (*str >= '0' && *str <= '9') {
-        result = result * 10 + (*str - '0');
-        str++;
-        found_digit = 1;
-    }
-    
-    // Si no encontramos ningún dígito, devolver 0
-    if (!found_digit) return 0;
-    
-    return sign * result;
-}
+#include "klib.h"
+#include "io.h"
+#include "platform.h"
+#include "fs.h"
+#include "crc32c.h"
+#include "coro.h"
+#include "text.h"
+#include "trace.h"
+#include "idt.h"
+#include "prof.h"
+#include "proc.h"
+#include "syscall.h"
+#include "netbuf.h"
+#include "e1000.h"
+#include "net.h"
+#include "fbcon.h"
+#include "cpu.h"
+#include "timer.h"
 
 // =============================================================================
 // CONTROLADOR DE TECLADO PS/2
@@ -204,115 +67,114 @@ static const char scancode_map[128] = {
 #define KEY_RIGHT 0x83
 #define KEY_DELETE 0x84
 
-// Obtiene un carácter del teclado PS/2
-// Espera hasta que haya una tecla disponible y la convierte a ASCII
-// Maneja teclas especiales como backspace, delete, flechas y secuencias Ctrl
-static unsigned char keyboard_getchar(void) {
+// Lee un scancode del teclado PS/2, si hay alguno, y lo convierte a ASCII.
+// Devuelve -1 si no hay tecla o si el scancode no produce carácter (teclas
+// liberadas, modificadores). Maneja teclas especiales como backspace,
+// delete, flechas y secuencias Ctrl.
+static int keyboard_poll(void) {
     static int ctrl_pressed = 0;  // Estado de la tecla Ctrl
     static int shift_pressed = 0; // Estado de la tecla Shift
     static int extended = 0;      // Estado para secuencias extendidas (0xE0)
     
-    while (1) {
-        // Verificar si hay datos disponibles en el buffer del teclado
-        if (inb(0x64) & 1) {  // Bit 0 del puerto 0x64 indica datos listos
-            uint8_t code = inb(0x60);  // Leer el scancode del puerto 0x60
-            
-            // Manejar secuencias extendidas (teclas especiales como flechas)
-            if (code == 0xE0) {
-                extended = 1;
-                continue;
+    // Bit 0 del puerto 0x64: hay datos en el buffer del teclado
+    if (!(inb(0x64) & 1)) return -1;
+    
+    uint8_t code = inb(0x60);  // Leer el scancode del puerto 0x60
+    
+    // Manejar secuencias extendidas (teclas especiales como flechas)
+    if (code == 0xE0) {
+        extended = 1;
+        return -1;
+    }
+    
+    // Manejar teclas de control especiales
+    if (code == 0x1D) {  // Ctrl presionado
+        ctrl_pressed = 1;
+        return -1;
+    } else if (code == 0x9D) {  // Ctrl liberado
+        ctrl_pressed = 0;
+        return -1;
+    } else if (code == 0x2A || code == 0x36) {  // Shift izquierdo/derecho presionado
+        shift_pressed = 1;
+        return -1;
+    } else if (code == 0xAA || code == 0xB6) {  // Shift izquierdo/derecho liberado
+        shift_pressed = 0;
+        return -1;
+    }
+    
+    // Si el bit 7 está en 0, es una tecla presionada (no liberada)
+    if (!(code & 0x80)) {
+        // Manejar teclas extendidas (flechas, delete, etc.)
+        if (extended) {
+            extended = 0;
+            switch (code) {
+                case 0x48: return KEY_UP;     // Flecha arriba
+                case 0x50: return KEY_DOWN;   // Flecha abajo  
+                case 0x4B: return KEY_LEFT;   // Flecha izquierda
+                case 0x4D: return KEY_RIGHT;  // Flecha derecha
+                case 0x53: return KEY_DELETE; // Delete
+                default: return -1;  // Ignorar otras teclas extendidas
             }
+        }
+        
+        // Manejar backspace (scancode 0x0E) y Delete en Mac (puede usar 0x0E también)
+        if (code == 0x0E) {
+            return 0x08;  // ASCII backspace
+        }
+        
+        char c = scancode_map[code];  // Convertir scancode a ASCII
+        if (c) {
+            // Debug deshabilitado temporalmente para compilación
             
-            // Manejar teclas de control especiales
-            if (code == 0x1D) {  // Ctrl presionado
-                ctrl_pressed = 1;
-                continue;
-            } else if (code == 0x9D) {  // Ctrl liberado
-                ctrl_pressed = 0;
-                continue;
-            } else if (code == 0x2A || code == 0x36) {  // Shift izquierdo/derecho presionado
-                shift_pressed = 1;
-                continue;
-            } else if (code == 0xAA || code == 0xB6) {  // Shift izquierdo/derecho liberado
-                shift_pressed = 0;
-                continue;
+            // Si Ctrl está presionado, generar código de control
+            if (ctrl_pressed && c >= 'a' && c <= 'z') {
+                return c - 'a' + 1;  // Ctrl+A = 0x01, Ctrl+B = 0x02, etc.
+            }
+            if (ctrl_pressed && c >= 'A' && c <= 'Z') {
+                return c - 'A' + 1;  // Ctrl+A = 0x01, Ctrl+B = 0x02, etc.
             }
             
-            // Si el bit 7 está en 0, es una tecla presionada (no liberada)
-            if (!(code & 0x80)) {
-                // Manejar teclas extendidas (flechas, delete, etc.)
-                if (extended) {
-                    extended = 0;
-                    switch (code) {
-                        case 0x48: return KEY_UP;     // Flecha arriba
-                        case 0x50: return KEY_DOWN;   // Flecha abajo  
-                        case 0x4B: return KEY_LEFT;   // Flecha izquierda
-                        case 0x4D: return KEY_RIGHT;  // Flecha derecha
-                        case 0x53: return KEY_DELETE; // Delete
-                        default: continue;  // Ignorar otras teclas extendidas
-                    }
-                }
-                
-                // Manejar backspace (scancode 0x0E) y Delete en Mac (puede usar 0x0E también)
-                if (code == 0x0E) {
-                    return 0x08;  // ASCII backspace
-                }
-                
-                char c = scancode_map[code];  // Convertir scancode a ASCII
-                if (c) {
-                    // Debug deshabilitado temporalmente para compilación
-                    
-                    // Si Ctrl está presionado, generar código de control
-                    if (ctrl_pressed && c >= 'a' && c <= 'z') {
-                        return c - 'a' + 1;  // Ctrl+A = 0x01, Ctrl+B = 0x02, etc.
-                    }
-                    if (ctrl_pressed && c >= 'A' && c <= 'Z') {
-                        return c - 'A' + 1;  // Ctrl+A = 0x01, Ctrl+B = 0x02, etc.
-                    }
-                    
-                    // Si Shift está presionado, convertir a mayúsculas o símbolos
-                    if (shift_pressed) {
-                        if (c >= 'a' && c <= 'z') {
-                            return c - 'a' + 'A';  // Convertir a mayúscula
-                        } else {
-                            // Manejo de símbolos con Shift
-                            switch (c) {
-                                case '1': return '!';
-                                case '2': return '@';
-                                case '3': return '#';
-                                case '4': return '$';
-                                case '5': return '%';
-                                case '6': return '^';
-                                case '7': return '&';
-                                case '8': return '*';
-                                case '9': return '(';
-                                case '0': return ')';
-                                case '-': return '_';
-                                case '=': return '+';
-                                case '[': return '{';
-                                case ']': return '}';
-                                case ';': return ':';
-                                case '\'': return '"';
-                                case ',': return '<';
-                                case '.': return '>';
-                                case '/': return '?';
-                                case '\\': return '|';  // Backslash + Shift = Pipe
-                                case '`': return '~';
-                                default: return c;
-                            }
-                        }
+            // Si Shift está presionado, convertir a mayúsculas o símbolos
+            if (shift_pressed) {
+                if (c >= 'a' && c <= 'z') {
+                    return c - 'a' + 'A';  // Convertir a mayúscula
+                } else {
+                    // Manejo de símbolos con Shift
+                    switch (c) {
+                        case '1': return '!';
+                        case '2': return '@';
+                        case '3': return '#';
+                        case '4': return '$';
+                        case '5': return '%';
+                        case '6': return '^';
+                        case '7': return '&';
+                        case '8': return '*';
+                        case '9': return '(';
+                        case '0': return ')';
+                        case '-': return '_';
+                        case '=': return '+';
+                        case '[': return '{';
+                        case ']': return '}';
+                        case ';': return ':';
+                        case '\'': return '"';
+                        case ',': return '<';
+                        case '.': return '>';
+                        case '/': return '?';
+                        case '\\': return '|';  // Backslash + Shift = Pipe
+                        case '`': return '~';
+                        default: return c;
                     }
-                    
-                    return c;
                 }
-            } else {
-                // Tecla liberada - resetear estado extendido si es necesario
-                extended = 0;
             }
+            
+            return c;
         }
+    } else {
+        // Tecla liberada - resetear estado extendido si es necesario
+        extended = 0;
     }
+    return -1;
 }
-#define getchar_stub keyboard_getchar
 
 // =============================================================================
 // CONTROLADOR DE PANTALLA VGA EN MODO TEXTO
@@ -321,10 +183,48 @@ static unsigned char keyboard_getchar(void) {
 // Cada carácter ocupa 2 bytes: [carácter][atributo]
 // El atributo 0x07 = texto blanco sobre fondo negro
 // La pantalla es de 80 columnas × 25 filas = 2000 caracteres
-#define VGA_WIDTH 80
+//
+// Con un framebuffer (fbcon.h) las celdas son las de fbcon.c, con tantas
+// filas y columnas como quepan, y se pintan en console_flush(). El cursor
+// tampoco se mueve con cada carácter: console_flush() lo pone en su sitio
+// antes de esperar una tecla y, mientras sigue saliendo texto, una vez
+// cada CONSOLE_FRAME_MS.
+#define VGA_WIDTH  80
 #define VGA_HEIGHT 25
-static uint16_t *const VGA_BUFFER = (uint16_t *)0xB8000;
-static uint8_t cursor_x = 0, cursor_y = 0;
+#define CONSOLE_FRAME_MS 16
+#define VIDEO_DEFAULT_W 1600   // 200x60 caracteres
+#define VIDEO_DEFAULT_H 960
+static uint16_t *con_cells = (uint16_t *)0xB8000;
+static uint32_t con_cols = VGA_WIDTH, con_rows = VGA_HEIGHT;
+static int      con_fb = 0;          // Las celdas son las de fbcon.c
+static int      con_dirty = 0;       // Algo cambió desde console_flush()
+static uint64_t con_flushed_at = 0;  // rdtsc del último console_flush()
+static uint64_t con_frame = 0;       // CONSOLE_FRAME_MS en ciclos
+static uint16_t cursor_x = 0, cursor_y = 0;
+static uint32_t chars_out = 0;   // Caracteres escritos (los cuentan 'time' y 'stats')
+static int console_mirror = 0;   // Copiar la pantalla al puerto serie (arranque con "serial")
+static void serial_putc(char c);
+
+// Salida redirigida a un archivo ('>' y '>>'): putchar la acumula aquí y la
+// escribe por bloques, sin pasar por la pantalla
+#define OUTPUT_BUFSIZE 4096
+static int      output_fd = -1;
+static int      output_short = 0;   // Algún bloque no cupo en el disco
+static uint32_t output_len = 0;
+static char     output_buf[OUTPUT_BUFSIZE];
+
+// Salida de la etapa de un pipe que corre con la pila del shell: putchar la
+// mete en el anillo de la siguiente (ver PIPES)
+static ring *pipe_out = 0;
+static int   pipe_pumping = 0;   // Avanzan las corrutinas: escriben a su manera
+static void  pipe_putc(char c);
+
+static void output_flush(void) {
+    uint32_t len = output_len;
+    output_len = 0;
+    if (len && fs_fwrite(output_fd, output_buf, len) != (int)len) output_short = 1;
+}
+uint64_t memcpy_bytes = 0;       // Bytes copiados por memcpy (klib.h)
 static void update_cursor(void) {
     uint16_t pos = cursor_y * VGA_WIDTH + cursor_x;
     outb(0x3D4, 0x0E);
@@ -332,24 +232,55 @@ static void update_cursor(void) {
     outb(0x3D4, 0x0F);
     outb(0x3D5, pos);
 }
+// Pone el cursor en su sitio y, con framebuffer, pinta lo que cambió
+static void console_flush(void) {
+    if (!con_dirty) return;
+    con_dirty = 0;
+    con_flushed_at = rdtsc();
+    if (con_fb) {
+        fbcon_cursor(cursor_x, cursor_y);
+        fbcon_flush();
+    } else {
+        update_cursor();
+    }
+}
+// console_flush() si ya pasó un cuadro desde el anterior
+static inline void console_tick(void) {
+    if (con_dirty && rdtsc() - con_flushed_at >= con_frame) console_flush();
+}
 // Función para hacer scroll hacia arriba cuando se llena la pantalla
 static void scroll_up(void) {
-    // Mover todas las líneas una posición hacia arriba
-    for (int y = 0; y < VGA_HEIGHT - 1; y++) {
-        for (int x = 0; x < VGA_WIDTH; x++) {
-            VGA_BUFFER[y * VGA_WIDTH + x] = VGA_BUFFER[(y + 1) * VGA_WIDTH + x];
-        }
-    }
+    // Mover todas las líneas una posición hacia arriba, de dos celdas en dos
+    // (las filas tienen un número par de columnas)
+    typedef uint32_t __attribute__((may_alias)) cell_pair;
+    cell_pair *dst = (cell_pair *)con_cells;
+    const cell_pair *src = (const cell_pair *)(con_cells + con_cols);
+    for (uint32_t i = 0; i < (con_rows - 1) * con_cols / 2; i++) dst[i] = src[i];
     // Limpiar la última línea
-    for (int x = 0; x < VGA_WIDTH; x++) {
-        VGA_BUFFER[(VGA_HEIGHT - 1) * VGA_WIDTH + x] = (uint16_t)' ' | 0x0700;
+    for (uint32_t x = 0; x < con_cols; x++) {
+        con_cells[(con_rows - 1) * con_cols + x] = (uint16_t)' ' | 0x0700;
     }
-    cursor_y = VGA_HEIGHT - 1;  // Posicionar en la última línea
+    cursor_y = con_rows - 1;  // Posicionar en la última línea
+    if (con_fb) fbcon_scrolled();
 }
 
 // Imprime un carácter en la pantalla VGA
 // Maneja saltos de línea y el desbordamiento de pantalla con scroll
-static void putchar(char c) {
+void putchar(char c) {
+    chars_out++;
+    if (pipe_out && !pipe_pumping) {
+        pipe_putc(c);
+        return;
+    }
+    if (output_fd >= 0) {
+        output_buf[output_len++] = c;
+        if (output_len == OUTPUT_BUFSIZE) output_flush();
+        return;
+    }
+    if (console_mirror) {
+        if (c == '\n') serial_putc('\r');
+        serial_putc(c);
+    }
     if (c == '\n') { 
         cursor_x = 0; cursor_y++;  // Nueva línea
     } else if (c == '\r') {
@@ -361,686 +292,410 @@ static void putchar(char c) {
         }
     } else {
         // Escribir carácter + atributo (0x0700 = blanco sobre negro)
-        VGA_BUFFER[cursor_y * VGA_WIDTH + cursor_x] = (uint16_t)c | 0x0700;
+        con_cells[cursor_y * con_cols + cursor_x] = (uint16_t)(uint8_t)c | 0x0700;
+        if (con_fb) fbcon_touch(cursor_x, cursor_y);
         cursor_x++;
         // Si llegamos al final de la línea, pasar a la siguiente
-        if (cursor_x >= VGA_WIDTH) { cursor_x = 0; cursor_y++; }
+        if (cursor_x >= con_cols) { cursor_x = 0; cursor_y++; }
     }
     // Si llegamos al final de la pantalla, hacer scroll hacia arriba
-    if (cursor_y >= VGA_HEIGHT) {
+    if (cursor_y >= con_rows) {
         scroll_up();
     }
-    update_cursor();
+    con_dirty = 1;
+    console_tick();
 }
 static void prints(const char *s) { while (*s) putchar(*s++); }
-static void printnum(unsigned int n, int base) {
+static void printnum(void (*out)(char), unsigned long n, int base) {
     char buf[32]; int i = 0;
-    if (!n) { putchar('0'); return; }
+    if (!n) { out('0'); return; }
     while (n) { int d = n % base; buf[i++] = (d < 10 ? '0'+d : 'a'+d-10); n /= base; }
-    while (i--) putchar(buf[i]);
+    while (i--) out(buf[i]);
 }
-void printf(const char *fmt, ...) {
-    va_list args; va_start(args, fmt);
+// printf genérico: 'out' decide a dónde va cada carácter
+static void vprintf_to(void (*out)(char), const char *fmt, va_list args) {
     for (const char *p = fmt; *p; p++) {
-        if (*p != '%') { putchar(*p); continue; }
+        if (*p != '%') { out(*p); continue; }
         p++;
         switch (*p) {
-            case 's': prints(va_arg(args, char*)); break;
-            case 'c': putchar((char)va_arg(args,int)); break;
-            case 'd': printnum(va_arg(args,int),10); break;
-            case 'u': printnum(va_arg(args,unsigned),10); break;  // Soporte para %u
-            case 'x': printnum(va_arg(args,unsigned),16); break;
-            case '%': putchar('%'); break;
-            default: putchar('?'); break;
+            case 's': for (const char *s = va_arg(args, char*); *s; s++) out(*s); break;
+            case 'c': out((char)va_arg(args,int)); break;
+            case 'd': printnum(out, va_arg(args,int),10); break;
+            case 'u': printnum(out, va_arg(args,unsigned),10); break;  // Soporte para %u
+            case 'x': printnum(out, va_arg(args,unsigned),16); break;
+            case 'l':   // %lu y %lx: unsigned long, de 64 bits en x86_64 (direcciones)
+                if (p[1] != 'u' && p[1] != 'x') { out('?'); break; }
+                p++;
+                printnum(out, va_arg(args,unsigned long), *p == 'x' ? 16 : 10);
+                break;
+            case '%': out('%'); break;
+            default: out('?'); break;
         }
     }
+}
+void printf(const char *fmt, ...) {
+    va_list args; va_start(args, fmt);
+    vprintf_to(putchar, fmt, args);
     va_end(args);
 }
 
 // =============================================================================
-// SISTEMA DE ARCHIVOS FAT16 SIMPLIFICADO
+// PUERTO SERIE (COM1)
 // =============================================================================
-// FAT16 es un sistema de archivos simple usado en discos pequeños.
-// Estructura: [Boot Sector][FAT][Root Directory][Data Area]
-// - Boot Sector: 1 sector con información del sistema de archivos
-// - FAT: tabla que indica qué clusters están ocupados (256 sectores)
-// - Root Directory: entradas de archivos en el directorio raíz (512 entradas)
-// - Data Area: contenido real de los archivos
-#define SECTOR_SIZE    512
-#define ROOT_ENTRIES   512
-#define FAT_SECTORS    256
-#define TOTAL_SECTORS  289
-#define DATA_START     ((1 + FAT_SECTORS) * SECTOR_SIZE + ROOT_ENTRIES * sizeof(fat16_dir_entry))
-
-typedef struct __attribute__((packed)) {
-    char     name[11];
-    uint8_t  attr;
-    uint8_t  reserved[10];
-    uint16_t first_cluster;
-    uint32_t size;
-} fat16_dir_entry;
+// Además de la pantalla, el kernel puede escribir por el primer puerto serie.
+// QEMU lo conecta a la terminal o a un archivo (opción -serial), así que es
+// la vía para sacar datos que lea otro programa, como los resultados de bench.
+#define COM1 0x3F8
 
-// Referencia al área de disco definida en boot.s
-extern uint8_t disk_image_start[];
-static uint8_t *disk_image = disk_image_start;
+static int serial_ready = 0;
 
-// =============================================================================
-// SIMULACIÓN DE DISCO EN MEMORIA RAM
-// =============================================================================
-// En lugar de acceder a un disco real, simulamos todo en memoria.
-// Esto simplifica enormemente el desarrollo pero mantiene la lógica intacta.
-static void read_sector(uint32_t lba, void *buf) {
-    memcpy(buf, disk_image + lba * SECTOR_SIZE, SECTOR_SIZE);
-}
-static void write_sector(uint32_t lba, const void *buf) {
-    memcpy(disk_image + lba * SECTOR_SIZE, buf, SECTOR_SIZE);
+static void serial_init(void) {
+    outb(COM1 + 7, 0xA5);  // Registro de prueba: si no se lee igual, no hay UART
+    if (inb(COM1 + 7) != 0xA5) return;
+    outb(COM1 + 1, 0x00);  // Sin interrupciones mientras se configura
+    outb(COM1 + 3, 0x80);  // DLAB = 1 para fijar la velocidad
+    outb(COM1 + 0, 0x03);  // Divisor 3 = 38400 baudios
+    outb(COM1 + 1, 0x00);
+    outb(COM1 + 3, 0x03);  // 8 bits, sin paridad, 1 bit de parada
+    outb(COM1 + 2, 0xC7);  // FIFO activada y vaciada
+    outb(COM1 + 4, 0x0B);  // DTR + RTS + OUT2 (la línea de IRQ hacia el PIC)
+    outb(COM1 + 1, 0x01);  // IRQ 4 al recibir: sólo despierta la CPU (ver idle_until)
+    serial_ready = 1;
 }
 
-// =============================================================================
-// MANIPULACIÓN DE ENTRADAS DEL DIRECTORIO RAÍZ
-// =============================================================================
-// Cada archivo tiene una entrada de 32 bytes en el directorio raíz.
-// Contiene: nombre (11 bytes), atributos, cluster inicial, tamaño, etc.
-static void read_root_entry(int idx, fat16_dir_entry *e) {
-    uint32_t base = 1 + FAT_SECTORS;
-    uint32_t off = idx * sizeof(*e);
-    uint8_t  sec[SECTOR_SIZE];
-    read_sector(base + off / SECTOR_SIZE, sec);
-    memcpy(e, sec + (off % SECTOR_SIZE), sizeof(*e));
-}
-static void write_root_entry(int idx, const fat16_dir_entry *e) {
-    uint32_t base = 1 + FAT_SECTORS;
-    uint32_t off = idx * sizeof(*e);
-    uint8_t  sec[SECTOR_SIZE];
-    read_sector(base + off / SECTOR_SIZE, sec);
-    memcpy(sec + (off % SECTOR_SIZE), e, sizeof(*e));
-    write_sector(base + off / SECTOR_SIZE, sec);
+static void serial_putc(char c) {
+    if (!serial_ready) return;
+    while (!(inb(COM1 + 5) & 0x20));  // Esperar a que el transmisor esté libre
+    outb(COM1, c);
 }
 
-// =============================================================================
-// INICIALIZACIÓN DEL SISTEMA DE ARCHIVOS
-// =============================================================================
-// Inicializa las estructuras básicas del sistema de archivos FAT16 en memoria
-static void fs_init(void) {
-    // Limpiar toda la imagen de disco
-    memset(disk_image, 0, TOTAL_SECTORS * SECTOR_SIZE);
-    
-    // Inicializar el sector de arranque (boot sector)
-    // Por simplicidad, solo ponemos algunos valores básicos
-    uint8_t boot_sector[SECTOR_SIZE];
-    memset(boot_sector, 0, SECTOR_SIZE);
-    
-    // Signature del boot sector
-    boot_sector[510] = 0x55;
-    boot_sector[511] = 0xAA;
-    
-    write_sector(0, boot_sector);
-    
-    // Inicializar la tabla FAT
-    // Marcar los primeros clusters como reservados
-    uint8_t fat_sector[SECTOR_SIZE];
-    memset(fat_sector, 0, SECTOR_SIZE);
-    
-    // FAT16: cada entrada es de 16 bits (2 bytes)
-    // Cluster 0: reservado (0xFFF8)
-    // Cluster 1: reservado (0xFFFF) 
-    fat_sector[0] = 0xF8; fat_sector[1] = 0xFF;  // Cluster 0
-    fat_sector[2] = 0xFF; fat_sector[3] = 0xFF;  // Cluster 1
-    
-    write_sector(1, fat_sector);  // Escribir el primer sector de la FAT
-    
-    // Limpiar el resto de sectores FAT
-    memset(fat_sector, 0, SECTOR_SIZE);
-    for (int i = 2; i <= FAT_SECTORS; i++) {
-        write_sector(i, fat_sector);
-    }
-    
-    // Inicializar el directorio raíz (limpiar todas las entradas)
-    uint8_t root_sector[SECTOR_SIZE];
-    memset(root_sector, 0, SECTOR_SIZE);
-    
-    // El directorio raíz empieza después de la FAT
-    uint32_t root_start = 1 + FAT_SECTORS;
-    uint32_t root_sectors = (ROOT_ENTRIES * sizeof(fat16_dir_entry) + SECTOR_SIZE - 1) / SECTOR_SIZE;
-    
-    for (uint32_t i = 0; i < root_sectors; i++) {
-        write_sector(root_start + i, root_sector);
-    }
-    
-    printf("Sistema de archivos inicializado.\n");
+static void serial_printf(const char *fmt, ...) {
+    va_list args; va_start(args, fmt);
+    vprintf_to(serial_putc, fmt, args);
+    va_end(args);
 }
 
 // =============================================================================
-// GESTIÓN DE CLUSTERS
+// FUENTES DE ENTRADA (consola, scripts y grabaciones)
 // =============================================================================
-// Encuentra el próximo cluster libre y lo marca como ocupado
-static uint16_t fs_alloc_cluster(void) {
-    uint8_t fat_sector[SECTOR_SIZE];
-    
-    // Empezar desde el cluster 2 (los primeros dos están reservados)
-    for (uint16_t cluster = 2; cluster < 1000; cluster++) {
-        uint32_t fat_offset = cluster * 2;  // FAT16: 2 bytes por entrada
-        uint32_t fat_sector_num = 1 + (fat_offset / SECTOR_SIZE);
-        uint32_t fat_entry_offset = fat_offset % SECTOR_SIZE;
-        
-        read_sector(fat_sector_num, fat_sector);
-        
-        // Leer entrada FAT (16 bits)
-        uint16_t fat_entry = fat_sector[fat_entry_offset] | (fat_sector[fat_entry_offset + 1] << 8);
-        
-        if (fat_entry == 0) {  // Cluster libre
-            // Marcarlo como fin de cadena (0xFFFF)
-            fat_sector[fat_entry_offset] = 0xFF;
-            fat_sector[fat_entry_offset + 1] = 0xFF;
-            write_sector(fat_sector_num, fat_sector);
-            return cluster;
+// Todo lo que lee el shell pasa por input_getchar(). Por defecto viene de la
+// consola: el teclado PS/2 y el puerto serie a la vez, lo que llegue antes.
+// Encima se apilan fuentes no interactivas:
+// - un script: los bytes de un archivo ('source', autorun.sh) o de un módulo
+//   Multiboot, entregados tal cual, como si se tecleasen
+// - una grabación ('replay'): las teclas guardadas con 'record', con las
+//   mismas pausas entre ellas si se pide
+// Al agotarse una fuente se sigue con la de debajo y, al final, la consola.
+#define INPUT_DEPTH   4      // Scripts anidados como máximo
+#define INPUT_BUFSIZE 128    // Los archivos se leen por bloques
+#define RECORD_MAX    2048   // Teclas por grabación
+
+typedef struct {
+    int            fd;        // Archivo abierto, o -1 si la fuente es memoria
+    const uint8_t *mem;       // Módulo Multiboot (fd == -1)
+    uint32_t       len, pos;  // Bytes disponibles en mem o buf y siguiente
+    uint8_t        buf[INPUT_BUFSIZE];
+    int            replay;    // 0 = script, 1 = grabación, 2 = con sus pausas
+    int            redirect;  // Entrada de un comando ('<'): al acabar da Ctrl+D
+    int            pipe;      // Lo que escribe la etapa anterior de un pipe
+    int            last;      // Último byte entregado de un script
+} input_source;
+
+static input_source input_stack[INPUT_DEPTH];
+static int          input_depth = 0;
+
+static int      recording = 0;
+static uint32_t record_count = 0;
+static uint32_t record_ms[RECORD_MAX];   // Pausa antes de cada tecla
+static uint8_t  record_key[RECORD_MAX];
+static uint64_t record_last;
+
+static uint32_t tsc_khz(void);
+static int      pipe_getc(void);
+
+// Carácter recibido por COM1, o -1. Las terminales mandan '\r' con Enter,
+// DEL (0x7F) para borrar y secuencias ESC [ A..D para las flechas.
+static int serial_poll(void) {
+    static int esc = 0;   // Posición dentro de una secuencia de escape
+    if (!serial_ready || !(inb(COM1 + 5) & 0x01)) return -1;
+    uint8_t c = inb(COM1);
+    if (esc == 1) {
+        esc = c == '[' ? 2 : 0;
+        return -1;
+    }
+    if (esc == 2) {
+        esc = 0;
+        switch (c) {
+            case 'A': return KEY_UP;
+            case 'B': return KEY_DOWN;
+            case 'C': return KEY_RIGHT;
+            case 'D': return KEY_LEFT;
+            case '3': esc = 3; return -1;   // ESC [ 3 ~ = Supr
+            default:  return -1;
         }
     }
-    
-    return 0;  // No hay clusters libres
+    if (esc == 3) {
+        esc = 0;
+        return c == '~' ? KEY_DELETE : -1;
+    }
+    if (c == 0x1B) { esc = 1; return -1; }
+    if (c == '\r') return '\n';
+    if (c == 0x7F) return '\b';
+    return c;
 }
 
 // =============================================================================
-// OPERACIONES BÁSICAS DEL SISTEMA DE ARCHIVOS
+// ESPERA
 // =============================================================================
-// Estas funciones implementan las operaciones esenciales que esperamos
-// de cualquier sistema de archivos: buscar, listar, crear, leer, escribir, etc.
-// Busca un archivo por nombre en el directorio raíz
-// Los nombres en FAT16 son de exactamente 11 caracteres (8.3 format)
-// Retorna 1 si lo encuentra, 0 si no existe
-static int fs_find(const char *name, fat16_dir_entry *e, int *idx) {
-    char buf[11]; 
-    memset(buf, ' ', 11);  // Llenar con espacios (formato FAT16)
-    // Copiar el nombre, máximo 11 caracteres
-    for (int i = 0; i < 11 && name[i]; i++) buf[i] = name[i];
-    
-    // Buscar en todas las entradas del directorio raíz
-    for (int i = 0; i < ROOT_ENTRIES; i++) {
-        read_root_entry(i, e);
-        if (!memcmp(e->name, buf, 11)) { 
-            *idx = i;  // Guardar el índice donde se encontró
-            return 1;  // Encontrado
-        }
-    }
-    return 0;  // No encontrado
-}
-static void	fs_ls(void) {
-    fat16_dir_entry e; char fname[12];
-    for (int i = 0; i < ROOT_ENTRIES; i++) {
-        read_root_entry(i, &e);
-        if (e.name[0] == 0x00) break;
-        if ((uint8_t)e.name[0] == 0xE5) continue;
-        memcpy(fname, e.name, 11);
-        fname[11] = '\0';
-        printf("%s  %u bytes\n", fname, e.size);
-    }
-}
-static void fs_touch(const char *name) {
-    fat16_dir_entry e; char buf[11]; memset(buf, ' ', 11);
-    for (int i = 0; i < 11 && name[i]; i++) buf[i] = name[i];
-    
-    // Verificar si el archivo ya existe
-    int idx;
-    if (fs_find(name, &e, &idx)) {
-        printf("El archivo ya existe: %s\n", name);
-        return;
-    }
-    
-    // Encontrar una entrada libre en el directorio raíz
-    for (int i = 0; i < ROOT_ENTRIES; i++) {
-        read_root_entry(i, &e);
-        if (e.name[0] == 0x00 || (uint8_t)e.name[0] == 0xE5) {
-            // Asignar un cluster libre
-            uint16_t cluster = fs_alloc_cluster();
-            if (cluster == 0) {
-                printf("Error: No hay espacio disponible\n");
-                return;
-            }
-            
-            memset(&e, 0, sizeof(e));
-            memcpy(e.name, buf, 11);
-            e.first_cluster = cluster;
-            e.size = 0;
-            write_root_entry(i, &e);
-            
-            // Limpiar el sector de datos del cluster
-            uint8_t zero[SECTOR_SIZE]; 
-            memset(zero, 0, SECTOR_SIZE);
-            uint32_t data_sector = DATA_START / SECTOR_SIZE + (cluster - 2);
-            write_sector(data_sector, zero);
-            
-            printf("Archivo creado: %s\n", name);
-            return;
-        }
-    }
-    printf("Error: Directorio raíz lleno\n");
-}
-static int fs_read(const char *name, void *buf, uint32_t *size) {
-    fat16_dir_entry e; int idx;
-    if (!fs_find(name, &e, &idx)) return 0;
-    read_sector(DATA_START / SECTOR_SIZE + (e.first_cluster - 2), buf);
-    *size = e.size;
-    return 1;
+// Quien espera (una tecla, un eco, una pausa) mira lo suyo y, si aún no
+// está, detiene la CPU con timer_idle() hasta la siguiente interrupción o
+// el siguiente temporizador. El teclado y COM1 tienen su IRQ sólo para
+// despertarla: los datos se siguen leyendo por sondeo, como siempre.
+#define SCRUB_BATCH 64      // Sectores por tanda del repaso en segundo plano
+#define SCRUB_EVERY 10      // ms entre tandas
+#define SCRUB_REST  10000   // ms de descanso al acabar una vuelta al disco
+
+static timer scrub_timer;
+
+static void wake_irq(interrupt_frame *frame) {
+    (void)frame;
 }
-// Crear archivo sin verificar si existe (para uso interno)
-static int fs_create_internal(const char *name) {
-    fat16_dir_entry e; 
-    char buf[11]; 
-    memset(buf, ' ', 11);
-    for (int i = 0; i < 11 && name[i]; i++) buf[i] = name[i];
-    
-    // Encontrar una entrada libre en el directorio raíz
-    for (int i = 0; i < ROOT_ENTRIES; i++) {
-        read_root_entry(i, &e);
-        if (e.name[0] == 0x00 || (uint8_t)e.name[0] == 0xE5) {
-            // Asignar un cluster libre
-            uint16_t cluster = fs_alloc_cluster();
-            if (cluster == 0) {
-                return 0;  // No hay espacio
-            }
-            
-            memset(&e, 0, sizeof(e));
-            memcpy(e.name, buf, 11);
-            e.first_cluster = cluster;
-            e.size = 0;
-            write_root_entry(i, &e);
-            
-            // Limpiar el sector de datos del cluster
-            uint8_t zero[SECTOR_SIZE]; 
-            memset(zero, 0, SECTOR_SIZE);
-            uint32_t data_sector = DATA_START / SECTOR_SIZE + (cluster - 2);
-            write_sector(data_sector, zero);
-            
-            return 1;  // Éxito
+
+static void scrub_tick(timer *t) {
+    uint32_t ms = SCRUB_EVERY;
+    for (int i = 0; i < SCRUB_BATCH; i++) {
+        if (fs_scrub_step()) {
+            ms = SCRUB_REST;
+            break;
         }
     }
-    return 0;  // Directorio lleno
+    timer_start(t, rdtsc() + (uint64_t)ms * tsc_khz());
 }
 
-static void fs_write(const char *name, const void *buf, uint32_t size) {
-    fat16_dir_entry e; int idx;
-    if (!fs_find(name, &e, &idx)) {
-        // Si el archivo no existe, crearlo primero
-        if (!fs_create_internal(name)) {
-            printf("Error: No se pudo crear el archivo %s\n", name);
-            return;
-        }
-        if (!fs_find(name, &e, &idx)) {
-            printf("Error: Archivo creado pero no encontrado\n");
-            return;
-        }
+// Sin IRQ, lo que llega a la tarjeta de red sólo se ve sondeando: con la
+// red activa la CPU se despierta al menos cada milisegundo
+static void idle_until(uint64_t until) {
+    if (net_up() && e1000_irq_line() < 0) {
+        uint64_t poll = rdtsc() + tsc_khz();
+        if (!until || poll < until) until = poll;
     }
-    
-    // Escribir los datos al sector correspondiente
-    uint32_t data_sector = DATA_START / SECTOR_SIZE + (e.first_cluster - 2);
-    write_sector(data_sector, buf);
-    
-    // Actualizar el tamaño del archivo en la entrada del directorio
-    e.size = size;
-    write_root_entry(idx, &e);
+    timer_idle(until);
 }
-// Renombrar un archivo en el sistema de archivos
-// Busca el archivo con el nombre antiguo y le cambia el nombre al nuevo
-static void fs_mv(const char *old, const char *new) {
-    fat16_dir_entry e; int idx;
-    if (!fs_find(old, &e, &idx)) return;
-    memset(e.name, ' ', 11);  // Limpiar el campo del nombre
-    memcpy(e.name, new, strlen(new));  // Copiar el nuevo nombre
-    write_root_entry(idx, &e);  // Escribir la entrada modificada
+
+static void idle_init(void) {
+    timer_init(tsc_khz());
+    irq_install(1, wake_irq);
+    if (serial_ready) irq_install(4, wake_irq);
+    timer_setup(&scrub_timer, scrub_tick);
+    timer_start(&scrub_timer, rdtsc());
 }
 
-// Eliminar un archivo del sistema de archivos
-// Marca la entrada del directorio como eliminada usando el código 0xE5
-static void fs_delete(const char *name) {
-    fat16_dir_entry e; int idx;
-    if (!fs_find(name, &e, &idx)) {
-        printf("Archivo no encontrado: %s\n", name);
-        return;
+// Espera una tecla de la consola. Mientras tanto el perfilador cuenta las
+// muestras como inactividad, el disco se repasa por tandas (scrub_tick) y
+// se atiende la red (ARP y ecos).
+static int console_getchar(void) {
+    int c;
+    console_flush();
+    prof_idle = 1;
+    while ((c = keyboard_poll()) < 0 && (c = serial_poll()) < 0) {
+        net_poll();
+        idle_until(0);
     }
-    // Marcar como eliminado con el código especial 0xE5
-    e.name[0] = 0xE5;
-    write_root_entry(idx, &e);
-    printf("Archivo eliminado: %s\n", name);
-}
-
-// Editar una línea específica de un archivo
-// Si el archivo no existe, lo crea. Si la línea no existe, extiende el archivo
-static void fs_edit_line(const char *name, int line_num, const char *new_text) {
-    uint8_t buffer[SECTOR_SIZE];
-    uint32_t file_size = 0;
-    
-    // Intentar leer el archivo existente
-    int file_exists = fs_read(name, buffer, &file_size);
-    if (!file_exists) {
-        // Si no existe, crear archivo vacío
-        memset(buffer, 0, SECTOR_SIZE);
-        file_size = 0;
-        fs_touch(name);  // Crear entrada de directorio
-    }
-    
-    // Crear un nuevo buffer para el archivo modificado
-    uint8_t new_buffer[SECTOR_SIZE];
-    memset(new_buffer, 0, SECTOR_SIZE);
-    
-    int current_line = 1;
-    uint32_t src_pos = 0;
-    uint32_t dst_pos = 0;
-    int line_replaced = 0;
-    
-    // Procesar el archivo línea por línea
-    while (src_pos < file_size && dst_pos < SECTOR_SIZE - 1) {
-        if (current_line == line_num && !line_replaced) {
-            // Reemplazar con el nuevo texto
-            int text_len = strlen(new_text);
-            if (dst_pos + text_len < SECTOR_SIZE - 1) {
-                memcpy(new_buffer + dst_pos, new_text, text_len);
-                dst_pos += text_len;
-                new_buffer[dst_pos++] = '\n';
-            }
-            line_replaced = 1;
-            
-            // Saltar la línea original hasta el siguiente \n
-            while (src_pos < file_size && buffer[src_pos] != '\n') {
-                src_pos++;
-            }
-            if (src_pos < file_size && buffer[src_pos] == '\n') {
-                src_pos++; // Saltar el \n
-            }
-            current_line++;
-        } else {
-            // Copiar línea existente
-            if (buffer[src_pos] == '\n') {
-                current_line++;
-            }
-            new_buffer[dst_pos++] = buffer[src_pos++];
-        }
+    prof_idle = 0;
+    if (recording) {
+        uint64_t now = rdtsc();
+        if (record_count < RECORD_MAX) {
+            record_ms[record_count] = (uint32_t)udiv64(now - record_last, tsc_khz());
+            record_key[record_count++] = c;
+        }
+        record_last = now;
     }
-    
-    // Si la línea no existía, añadirla al final
-    if (!line_replaced) {
-        // Asegurar que hay líneas vacías hasta llegar a la línea deseada
-        while (current_line < line_num && dst_pos < SECTOR_SIZE - 2) {
-            new_buffer[dst_pos++] = '\n';
-            current_line++;
-        }
-        
-        // Añadir el nuevo texto
-        int text_len = strlen(new_text);
-        if (dst_pos + text_len < SECTOR_SIZE - 1) {
-            memcpy(new_buffer + dst_pos, new_text, text_len);
-            dst_pos += text_len;
-            new_buffer[dst_pos++] = '\n';
-        }
-    }
-    
-    // Escribir el archivo modificado
-    fs_write(name, new_buffer, dst_pos);
-    printf("Linea %d editada en archivo: %s\n", line_num, name);
+    return c;
 }
 
-// Eliminar una línea específica de un archivo
-static void fs_delete_line(const char *name, int line_num) {
-    uint8_t buffer[SECTOR_SIZE];
-    uint32_t file_size = 0;
-    
-    // Leer el archivo existente
-    if (!fs_read(name, buffer, &file_size)) {
-        printf("Archivo no encontrado: %s\n", name);
-        return;
+// Ctrl+C: lo consultan los pipes y los programas entre paso y paso. Mira la
+// consola sin esperar; lo que se teclee mientras tanto se pierde. Queda
+// marcado hasta el siguiente comando (ver run_command).
+static int break_pending = 0;
+static int break_requested(void) {
+    console_tick();   // Que se vea lo que escriben mientras tanto
+    if (!break_pending) {
+        int c = keyboard_poll();
+        if (c < 0) c = serial_poll();
+        if (c == 0x03) break_pending = 1;
     }
-    
-    // Crear un nuevo buffer para el archivo sin la línea eliminada
-    uint8_t new_buffer[SECTOR_SIZE];
-    memset(new_buffer, 0, SECTOR_SIZE);
-    
-    int current_line = 1;
-    uint32_t src_pos = 0;
-    uint32_t dst_pos = 0;
-    int line_found = 0;
-    
-    // Procesar el archivo línea por línea
-    while (src_pos < file_size && dst_pos < SECTOR_SIZE - 1) {
-        if (current_line == line_num) {
-            // Saltar esta línea (no copiarla)
-            line_found = 1;
-            while (src_pos < file_size && buffer[src_pos] != '\n') {
-                src_pos++;
-            }
-            if (src_pos < file_size && buffer[src_pos] == '\n') {
-                src_pos++; // Saltar el \n también
-            }
-            current_line++;
-        } else {
-            // Copiar línea normal
-            if (buffer[src_pos] == '\n') {
-                current_line++;
-            }
-            new_buffer[dst_pos++] = buffer[src_pos++];
-        }
-    }
-    
-    if (!line_found) {
-        printf("Linea %d no existe en el archivo %s\n", line_num, name);
-        return;
-    }
-    
-    // Escribir el archivo modificado
-    fs_write(name, new_buffer, dst_pos);
-    printf("Linea %d eliminada del archivo: %s\n", line_num, name);
+    return break_pending;
 }
 
-// Insertar una línea en blanco en una posición específica
-static void fs_insert_line(const char *name, int line_num) {
-    uint8_t buffer[SECTOR_SIZE];
-    uint32_t file_size = 0;
-    
-    // Intentar leer el archivo existente
-    int file_exists = fs_read(name, buffer, &file_size);
-    if (!file_exists) {
-        // Si no existe, crear archivo nuevo con líneas vacías hasta la posición
-        memset(buffer, 0, SECTOR_SIZE);
-        file_size = 0;
-        fs_touch(name);  // Crear entrada de directorio
-    }
-    
-    // Crear un nuevo buffer para el archivo con la línea insertada
-    uint8_t new_buffer[SECTOR_SIZE];
-    memset(new_buffer, 0, SECTOR_SIZE);
-    
-    int current_line = 1;
-    uint32_t src_pos = 0;
-    uint32_t dst_pos = 0;
-    int line_inserted = 0;
-    
-    // Procesar el archivo línea por línea
-    while (src_pos < file_size && dst_pos < SECTOR_SIZE - 2) {
-        if (current_line == line_num && !line_inserted) {
-            // Insertar línea en blanco
-            new_buffer[dst_pos++] = '\n';
-            line_inserted = 1;
-            current_line++;
-            // No incrementar src_pos, continuar con la línea actual
-        } else {
-            // Copiar línea existente
-            if (buffer[src_pos] == '\n') {
-                current_line++;
-            }
-            new_buffer[dst_pos++] = buffer[src_pos++];
-        }
+// Siguiente byte de la fuente, o -1 cuando se acaba
+static int input_byte(input_source *src) {
+    if (src->pipe) return pipe_getc();
+    if (src->fd < 0) return src->pos < src->len ? src->mem[src->pos++] : -1;
+    if (src->pos == src->len) {
+        int n = fs_fread(src->fd, src->buf, INPUT_BUFSIZE);
+        if (n <= 0) return -1;
+        src->len = n;
+        src->pos = 0;
     }
-    
-    // Si la línea está más allá del final del archivo, añadir líneas vacías
-    if (!line_inserted) {
-        while (current_line < line_num && dst_pos < SECTOR_SIZE - 2) {
-            new_buffer[dst_pos++] = '\n';
-            current_line++;
-        }
-        // Insertar la línea en blanco final
-        new_buffer[dst_pos++] = '\n';
-    }
-    
-    // Escribir el archivo modificado
-    fs_write(name, new_buffer, dst_pos);
-    printf("Linea en blanco insertada en posicion %d del archivo: %s\n", line_num, name);
+    return src->buf[src->pos++];
 }
 
-// Mostrar contenido de archivo en hexadecimal
-static void fs_hexdump(const char *name) {
-    uint8_t buffer[SECTOR_SIZE];
-    uint32_t file_size = 0;
-    
-    if (!fs_read(name, buffer, &file_size)) {
-        printf("Archivo no encontrado: %s\n", name);
-        return;
-    }
-    
-    printf("=== HEXDUMP de %s (%u bytes) ===\n", name, file_size);
-    for (uint32_t i = 0; i < file_size; i += 16) {
-        printf("%04x: ", i);
-        // Mostrar hex
-        for (int j = 0; j < 16; j++) {
-            if (i + j < file_size) {
-                printf("%02x ", buffer[i + j]);
-            } else {
-                printf("   ");
-            }
-        }
-        printf(" ");
-        // Mostrar ASCII
-        for (int j = 0; j < 16 && i + j < file_size; j++) {
-            char c = buffer[i + j];
-            printf("%c", (c >= 32 && c < 127) ? c : '.');
-        }
-        printf("\n");
+// Los finales de línea "\r\n" cuentan como uno y, si el script no acaba en
+// salto de línea, se añade uno para que se ejecute su última orden
+static int script_char(input_source *src) {
+    for (;;) {
+        int c = input_byte(src);
+        if (c < 0) {
+            if (src->last == '\n') return -1;
+            c = '\n';
+        }
+        if (c == '\r') continue;
+        if (c == '\t') c = ' ';
+        src->last = c;
+        return c;
     }
 }
 
-// Contar líneas, palabras y caracteres
-static void fs_wc(const char *name) {
-    uint8_t buffer[SECTOR_SIZE];
-    uint32_t file_size = 0;
-    
-    if (!fs_read(name, buffer, &file_size)) {
-        printf("Archivo no encontrado: %s\n", name);
-        return;
-    }
-    
-    int lines = 0, words = 0, chars = file_size;
-    int in_word = 0;
-    
-    for (uint32_t i = 0; i < file_size; i++) {
-        char c = buffer[i];
-        if (c == '\n') lines++;
-        if (c == ' ' || c == '\t' || c == '\n') {
-            if (in_word) {
-                words++;
-                in_word = 0;
-            }
-        } else {
-            in_word = 1;
-        }
+// Siguiente tecla de una grabación: líneas "<pausa en ms> <código>"; las
+// que empiezan por '#' son comentarios
+static int replay_key(input_source *src) {
+    for (;;) {
+        char line[32];
+        int n = 0, c;
+        while ((c = input_byte(src)) >= 0 && c != '\n') {
+            if (n < (int)sizeof(line) - 1) line[n++] = c;
+        }
+        if (c < 0 && !n) return -1;
+        line[n] = '\0';
+        char *sp = strchr(line, ' ');
+        if (line[0] == '#' || !sp) continue;
+        
+        uint32_t ms = atoi(line);
+        if (src->replay == 2 && ms) {
+            uint64_t end = rdtsc() + (uint64_t)ms * tsc_khz();
+            prof_idle = 1;
+            while (rdtsc() < end) timer_idle(end);
+            prof_idle = 0;
+        }
+        return atoi(sp + 1) & 0xFF;
     }
-    if (in_word) words++; // Última palabra sin \n
-    
-    printf("%d %d %d %s\n", lines, words, chars, name);
 }
 
+static void input_pop(void) {
+    input_source *src = &input_stack[--input_depth];
+    if (src->fd >= 0) fs_close(src->fd);
+}
 
-// Buscar texto en archivo
-static void fs_grep(const char *pattern, const char *name) {
-    uint8_t buffer[SECTOR_SIZE];
-    uint32_t file_size = 0;
-    
-    if (!fs_read(name, buffer, &file_size)) {
-        printf("Archivo no encontrado: %s\n", name);
-        return;
-    }
-    
-    int line_num = 1;
-    int line_start = 0;
-    int matches = 0;
-    
-    for (uint32_t i = 0; i < file_size; i++) {
-        if (buffer[i] == '\n') {
-            // Procesar línea
-            buffer[i] = '\0';  // Terminar temporalmente
-            char *line = (char *)&buffer[line_start];
-            
-            // Buscar patrón simple (sin regex)
-            if (strstr(line, pattern)) {
-                printf("%d: %s\n", line_num, line);
-                matches++;
-            }
-            
-            buffer[i] = '\n';  // Restaurar
-            line_start = i + 1;
-            line_num++;
-        }
-    }
-    
-    if (matches == 0) {
-        printf("Patron '%s' no encontrado en %s\n", pattern, name);
-    }
+static input_source *input_push(void) {
+    if (input_depth == INPUT_DEPTH) return 0;
+    input_source *src = &input_stack[input_depth++];
+    src->fd = -1;
+    src->mem = 0;
+    src->len = src->pos = 0;
+    src->replay = 0;
+    src->redirect = 0;
+    src->pipe = 0;
+    src->last = '\n';
+    return src;
 }
 
-// Mostrar primeras líneas de archivo
-static void fs_head(const char *name, int lines) {
-    uint8_t buffer[SECTOR_SIZE];
-    uint32_t file_size = 0;
-    
-    if (!fs_read(name, buffer, &file_size)) {
-        printf("Archivo no encontrado: %s\n", name);
-        return;
-    }
-    
-    int current_line = 1;
-    for (uint32_t i = 0; i < file_size && current_line <= lines; i++) {
-        putchar(buffer[i]);
-        if (buffer[i] == '\n') current_line++;
-    }
+// Apila un archivo como script (replay = 0) o como grabación.
+// Devuelve 0, -1 si no existe o -2 si ya hay INPUT_DEPTH fuentes.
+static int input_push_file(const char *name, int replay) {
+    if (input_depth == INPUT_DEPTH) return -2;
+    int fd = fs_open(name, O_RDONLY);
+    if (fd < 0) return -1;
+    input_source *src = input_push();
+    src->fd = fd;
+    src->replay = replay;
+    return 0;
 }
 
-// Mostrar últimas líneas de archivo
-static void fs_tail(const char *name, int lines) {
-    uint8_t buffer[SECTOR_SIZE];
-    uint32_t file_size = 0;
-    
-    if (!fs_read(name, buffer, &file_size)) {
-        printf("Archivo no encontrado: %s\n", name);
-        return;
-    }
-    
-    // Contar líneas totales
-    int total_lines = 0;
-    for (uint32_t i = 0; i < file_size; i++) {
-        if (buffer[i] == '\n') total_lines++;
-    }
-    
-    // Mostrar desde la línea (total_lines - lines + 1)
-    int start_line = (total_lines > lines) ? total_lines - lines + 1 : 1;
-    int current_line = 1;
-    
-    for (uint32_t i = 0; i < file_size; i++) {
-        if (current_line >= start_line) {
-            putchar(buffer[i]);
+static int input_push_mem(const uint8_t *mem, uint32_t len) {
+    input_source *src = input_push();
+    if (!src) return -2;
+    src->mem = mem;
+    src->len = len;
+    return 0;
+}
+
+// 1 si la próxima tecla la va a dar una persona (ningún script activo)
+static int input_interactive(void) {
+    return input_depth == 0;
+}
+
+static unsigned char input_getchar(void) {
+    int c = -1;
+    while (input_depth && c < 0) {
+        input_source *src = &input_stack[input_depth - 1];
+        if (src->redirect) {
+            // Sin traducir nada; el comando deja de leer al ver Ctrl+D y la
+            // fuente se retira cuando termina (ver run_redirected)
+            c = input_byte(src);
+            if (c < 0) c = 0x04;
+        } else {
+            c = src->replay ? replay_key(src) : script_char(src);
+            if (c < 0) input_pop();
         }
-        if (buffer[i] == '\n') current_line++;
     }
+    if (c < 0) c = console_getchar();
+    TRACE(TRACE_KEY, c, 0);
+    return c;
 }
+#define getchar_stub input_getchar
 
-// Crear directorio simulado (como archivo especial)
-static void fs_mkdir(const char *name) {
-    char dirname[16];
-    // Agregar prefijo para directorios
-    dirname[0] = '[';
-    for (int i = 0; i < 10 && name[i]; i++) {
-        dirname[i + 1] = name[i];
+// record start          empieza a grabar las teclas de la consola
+// record stop <archivo> guarda la grabación (sin la línea de 'record stop')
+static void record_command(char *args) {
+    char *sub = args ? strtok(args, " ") : 0;
+    char *name = sub ? strtok(0, " ") : 0;
+    
+    if (sub && !strcmp(sub, "start")) {
+        tsc_khz();   // Calibrar antes de la primera pausa
+        recording = 1;
+        record_count = 0;
+        record_last = rdtsc();
+        printf("record: grabando teclas (maximo %u)\n", RECORD_MAX);
+    } else if (sub && !strcmp(sub, "stop") && name) {
+        if (!recording) {
+            printf("record: no se esta grabando\n");
+            return;
+        }
+        recording = 0;
+        uint32_t n = record_count;
+        if (input_interactive()) {
+            // La línea "record stop ..." que se acaba de teclear
+            if (n && record_key[n - 1] == '\n') n--;
+            while (n && record_key[n - 1] != '\n') n--;
+        }
+        int fd = fs_open(name, O_WRONLY | O_CREAT | O_TRUNC);
+        if (fd < 0) {
+            printf("record: no se puede crear %s\n", name);
+            return;
+        }
+        const char *header = "# r2os-keys 1: <pausa ms> <codigo>\n";
+        fs_fwrite(fd, header, strlen(header));
+        for (uint32_t i = 0; i < n; i++) {
+            char line[24], digits[10];
+            int len = 0;
+            uint32_t vals[2] = { record_ms[i], record_key[i] };
+            for (int k = 0; k < 2; k++) {
+                int d = 0;
+                uint32_t v = vals[k];
+                do { digits[d++] = '0' + v % 10; v /= 10; } while (v);
+                while (d) line[len++] = digits[--d];
+                line[len++] = k ? '\n' : ' ';
+            }
+            fs_fwrite(fd, line, len);
+        }
+        fs_close(fd);
+        printf("record: %u teclas guardadas en %s", n, name);
+        if (record_count == RECORD_MAX) printf(" (la grabacion se lleno)");
+        printf("\n");
+    } else {
+        printf("Uso: record start | stop <archivo>\n");
+        printf("Estado: %s, %u teclas\n", recording ? "grabando" : "detenido", record_count);
     }
-    dirname[strlen(name) + 1] = ']';
-    dirname[strlen(name) + 2] = '\0';
-    
-    fs_touch(dirname);
-    printf("Directorio simulado creado: %s\n", dirname);
 }
 
 // =============================================================================
@@ -1048,27 +703,30 @@ static void fs_mkdir(const char *name) {
 // =============================================================================
 // Llena toda la pantalla VGA con espacios y resetea el cursor
 static void clear_screen(void) {
-    for (int y = 0; y < VGA_HEIGHT; y++)
-        for (int x = 0; x < VGA_WIDTH; x++)
-            VGA_BUFFER[y * VGA_WIDTH + x] = (uint16_t)' ' | 0x0700;
-    cursor_x = cursor_y = 0; update_cursor();
+    for (uint32_t i = 0; i < con_cols * con_rows; i++) con_cells[i] = (uint16_t)' ' | 0x0700;
+    if (con_fb) fbcon_touch_all();
+    cursor_x = cursor_y = 0;
+    con_dirty = 1;
+    console_flush();
 }
 
 // Función para mostrar ayuda con pausas
 static void show_help_with_pause(void) {
     prints("=== MINI-KERNEL EDUCATIVO - COMANDOS DISPONIBLES ===\n");
     prints("=== ARCHIVOS Y DIRECTORIOS ===\n");
-    prints("ls              - Listar archivos del directorio raiz\n");
+    prints("ls [dir]        - Listar archivos de un directorio\n");
     prints("cat <file>      - Mostrar contenido de un archivo\n");
     prints("touch <file>    - Crear archivo vacio\n");
     prints("cp <src> <dst>  - Copiar archivo\n");
-    prints("mv <old> <new>  - Renombrar archivo\n");
-    prints("delete <file>   - Eliminar archivo\n");
-    prints("mkdir <dir>     - Crear directorio simulado\n");
+    prints("compress <file> - Comprimir archivo (se lee igual; decompress lo revierte)\n");
+    prints("mv <old> <new>  - Renombrar o mover a otro directorio\n");
+    prints("delete <file>   - Eliminar archivo o directorio vacio\n");
+    prints("mkdir <dir>     - Crear directorio\n");
+    prints("cd [dir]        - Cambiar de directorio (rutas con /, . y ..)\n");
     prints("pwd             - Mostrar directorio actual\n");
     
     prints("\n--- Presiona cualquier tecla para continuar ---");
-    getchar_stub();
+    if (input_interactive()) getchar_stub();
     
     prints("\n=== EDICION DE TEXTO ===\n");
     prints("copycon <file>  - Crear archivo desde teclado\n");
@@ -1078,45 +736,67 @@ static void show_help_with_pause(void) {
     prints("tee <file>      - Escribir a archivo y pantalla\n");
     
     prints("\n--- Presiona cualquier tecla para continuar ---");
-    getchar_stub();
+    if (input_interactive()) getchar_stub();
     
     prints("\n=== ANALISIS DE ARCHIVOS ===\n");
     prints("wc <file>       - Contar lineas, palabras, caracteres\n");
     prints("head <file> [n] - Mostrar primeras n lineas (def: 10)\n");
     prints("tail <file> [n] - Mostrar ultimas n lineas (def: 10)\n");
     prints("grep <txt> <file> - Buscar texto en archivo\n");
+    prints("grep -r <txt> [dir] - Buscar texto en todos los archivos de un arbol\n");
+    prints("search [-s] <txt> [dir] - Archivos que contienen el texto (con indice)\n");
+    prints("index [on|off]  - Indice de trigramas para search y grep -r\n");
     prints("hexdump <file>  - Mostrar archivo en hexadecimal\n");
     prints("file <file>     - Determinar tipo de archivo\n");
     prints("stat <file>     - Estadisticas de archivo\n");
     prints("du <file>       - Uso de disco del archivo\n");
     
     prints("\n--- Presiona cualquier tecla para continuar ---");
-    getchar_stub();
+    if (input_interactive()) getchar_stub();
     
     prints("\n=== UTILIDADES DE TEXTO ===\n");
     prints("echo <text>     - Imprimir texto\n");
     prints("rev <text>      - Invertir texto\n");
-    prints("yes <text>      - Repetir texto (limitado)\n");
+    prints("yes [text]      - Repetir texto hasta Ctrl+C (o hasta 'yes | head 3')\n");
     prints("sort <file>     - Ordenar contenido (simulado)\n");
     prints("which <cmd>     - Encontrar ubicacion de comando\n");
     
     prints("\n--- Presiona cualquier tecla para continuar ---");
-    getchar_stub();
+    if (input_interactive()) getchar_stub();
     
     prints("\n=== SISTEMA ===\n");
     prints("whoami          - Mostrar usuario actual\n");
     prints("uname           - Informacion del sistema\n");
     prints("date            - Fecha actual\n");
-    prints("cal             - Calendario\n");
+    prints("cal [mes [anio]] - Calendario (programa /bin/cal)\n");
     prints("uptime          - Tiempo funcionamiento\n");
-    prints("free            - Uso de memoria\n");
+    prints("sleep <ms>      - Esperar con la CPU detenida (Ctrl+C la corta)\n");
+    prints("free            - Memoria y disco: total, usado y libre\n");
+    prints("stats           - Contadores del kernel y tiempos por comando\n");
+    prints("cpuinfo [use <rutina> <variante>] - CPU y variantes de memcpy, memset...\n");
+    prints("scrub           - Comprobar las sumas CRC32C de todo el disco\n");
+    prints("netbench [n] [bytes] [ext] - Paquetes/s de la e1000 (loopback o red)\n");
+    prints("ping [ip] [n] [bytes] - Ecos ICMP (por defecto a la puerta de enlace)\n");
+    prints("udpecho [puerto] - Devolver los datagramas UDP que lleguen (Ctrl+C)\n");
+    prints("udpsend <file> [ip] [puerto] - Mandar un archivo por UDP\n");
+    prints("ifconfig [ip [mascara [puerta]]] - Configuracion y contadores de IP\n");
+    prints("time <cmd>      - Tiempo, E/S y caches que consume un comando\n");
+    prints("bench [json] [exit] [filtro] - Medir rendimiento (rdtsc)\n");
+    prints("trace start|stop|dump - Traza de eventos por el puerto serie\n");
+    prints("prof start [hz]|stop|report [n] - Perfilador por muestreo\n");
+    prints("cmd > f, >> f, < f - Redirigir salida (o anadir) y entrada\n");
+    prints("a | b | c       - Pipe en streaming (grep wc head tail rev sort uniq cut)\n");
+    prints("source <file>   - Ejecutar las lineas de un archivo\n");
+    prints("record start|stop <file> - Grabar teclas; replay <file> [real]\n");
+    prints("exit [n]        - Apagar QEMU con codigo n (isa-debug-exit)\n");
+    prints("<prog> [args]   - Ejecutar /bin/<prog> (o una ruta) en ring 3: cal, upper, sysbench\n");
     prints("history         - Historial de comandos\n");
     prints("man <cmd>       - Manual de comando especifico\n");
     prints("cls/clear       - Limpiar pantalla\n");
     prints("help/?          - Mostrar esta ayuda\n");
     
     prints("\n--- Presiona cualquier tecla para finalizar ---");
-    getchar_stub();
+    if (input_interactive()) getchar_stub();
     
     prints("\nTeclado: soporta letras, numeros, simbolos (.,;'[]/-=|\\)\n");
     prints("Usa backspace para borrar y Ctrl+combinaciones para funciones especiales.\n");
@@ -1163,245 +843,941 @@ static void redraw_line(const char *line, int cursor_pos) {
     // Limpiar caracteres extra agregando espacios
     for (int i = 0; i < 20; i++) putchar(' ');
     
-    // Volver al inicio y posicionar cursor
-    putchar('\r');
-    printf("shell> ");
-    for (int i = 0; i < cursor_pos; i++) {
-        putchar(line[i]);
+    // Volver al inicio y posicionar cursor
+    putchar('\r');
+    printf("shell> ");
+    for (int i = 0; i < cursor_pos; i++) {
+        putchar(line[i]);
+    }
+}
+
+// =============================================================================
+// PROGRAMAS DE USUARIO
+// =============================================================================
+// Lo que no es un comando interno se busca como programa: tal cual si lleva
+// una '/' y si no en /bin. Se carga del disco en ese momento y corre en
+// ring 3 (proc.c); su entrada y su salida son las del shell, así que '<',
+// '>' y los pipes funcionan igual que con los comandos internos. Ctrl+C lo
+// termina la próxima vez que lea o escriba.
+static int program_getchar(void) {
+    int echo = input_interactive();
+    unsigned char c = input_getchar();
+    if (c == 0x04) return -1;   // Ctrl+D, o el final de '<' o del pipe
+    if (echo) putchar(c);
+    return c;
+}
+
+// Retorna 0 si no hay ningún programa con ese nombre
+static int run_program(const char *cmd, const char *args) {
+    char path[64];
+    uint32_t len = strlen(cmd);
+    if (len + 6 > sizeof(path)) return 0;
+    if (strchr(cmd, '/')) {
+        memcpy(path, cmd, len + 1);
+    } else {
+        memcpy(path, "/bin/", 5);
+        memcpy(path + 5, cmd, len + 1);
+    }
+    
+    int status;
+    switch (proc_exec(path, cmd, args, program_getchar, break_requested, &status)) {
+    case 0:
+        return 0;
+    case -1:
+        printf("%s: no es un programa para este sistema\n", cmd);
+        break;
+    case -2:
+        printf("%s: terminado\n", cmd);
+        break;
+    case -3:
+        printf("%s: no hay memoria para programas de usuario\n", cmd);
+        break;
+    case -4:
+        printf("^C\n");
+        break;
+    }
+    return 1;
+}
+
+// =============================================================================
+// PIPES
+// =============================================================================
+// Cada orden de 'a | b | c' es una etapa (coro.h) y entre dos seguidas hay un
+// anillo de RING_SIZE bytes: los datos pasan según se producen, la memoria
+// no depende de cuánto salga y 'yes | head 3' termina. Las etapas son:
+// - los operadores de text.c: grep, wc, head, tail, rev, sort, uniq, cut, cat
+// - ls, cat <archivo> y yes, que son corrutinas de aquí
+// - cualquier otro comando interno o programa, como mucho uno por pipe: corre
+//   con la pila del shell y, cuando su salida se llena o su entrada se vacía,
+//   hace avanzar las etapas de después o las de antes (pipe_putc y pipe_getc)
+// Ctrl+C cancela el pipe en la siguiente espera.
+#define PIPE_STAGES 8
+
+static void execute_command(char *line);
+
+typedef struct {
+    coro            c;          // Primero, como en text_stage
+    int             fd;         // cat
+    fs_dir          dir;        // ls
+    fat16_dir_entry entry;
+    const char     *text;       // yes
+    uint32_t        len, pos;
+    uint8_t         buf[SECTOR_SIZE];
+} shell_stage;
+
+typedef union {
+    coro        c;
+    text_stage  text;
+    shell_stage shell;
+} pipe_stage;
+
+static pipe_stage pipe_stages[PIPE_STAGES];
+static ring       pipe_rings[PIPE_STAGES - 1];
+static coro      *pipe_v[PIPE_STAGES];
+static coro       pipe_hole;          // El sitio de la etapa con pila propia
+static int        pipe_n = 0;         // Etapas del pipe en curso (0 = ninguno)
+static int        pipe_ext;           // Cuál corre con la pila del shell, o -1
+static ring      *pipe_in;            // Su entrada
+
+// ls: un nombre por línea, sin el relleno y con '/' si es un directorio
+static int ls_step(coro *c) {
+    shell_stage *s = (shell_stage *)c;
+    CORO_BEGIN(c);
+    while (fs_readdir(&s->dir, &s->entry)) {
+        s->len = 11;
+        while (s->len > 0 && s->entry.name[s->len - 1] == ' ') s->len--;
+        memcpy(s->buf, s->entry.name, s->len);
+        if (s->entry.attr & FAT_ATTR_DIRECTORY) s->buf[s->len++] = '/';
+        for (s->pos = 0; s->pos < s->len; s->pos++) {
+            CORO_PUT(c, s->buf[s->pos]);
+        }
+        CORO_PUT(c, '\n');
+    }
+    CORO_END(c);
+}
+
+// cat <archivo>: un sector cada vez
+static int cat_file_step(coro *c) {
+    shell_stage *s = (shell_stage *)c;
+    CORO_BEGIN(c);
+    for (;;) {
+        int n = fs_fread(s->fd, s->buf, sizeof(s->buf));
+        if (n <= 0) break;
+        s->len = n;
+        for (s->pos = 0; s->pos < s->len; s->pos++) {
+            CORO_PUT(c, s->buf[s->pos]);
+        }
+    }
+    CORO_END(c);
+}
+
+static void cat_file_stop(coro *c) {
+    fs_close(((shell_stage *)c)->fd);
+}
+
+// yes [texto]: no acaba hasta que lo corta la etapa siguiente o Ctrl+C
+static int yes_step(coro *c) {
+    shell_stage *s = (shell_stage *)c;
+    CORO_BEGIN(c);
+    for (;;) {
+        for (s->pos = 0; s->pos < s->len; s->pos++) {
+            CORO_PUT(c, s->text[s->pos]);
+        }
+        CORO_PUT(c, '\n');
+    }
+    CORO_END(c);
+}
+
+// Prepara la etapa 'i'. Retorna 0 si 'cmd' tiene que correr con la pila del
+// shell.
+static int pipe_stage_init(int i, char *cmd, ring *in, ring *out) {
+    shell_stage *s = &pipe_stages[i].shell;
+    // Al principio no tienen de dónde leer: 'wc notas.txt | ...' es el
+    // comando interno
+    if (in && text_stage_init(&pipe_stages[i].text, cmd, in, out)) return 1;
+
+    if (!strcmp(cmd, "ls") || !strncmp(cmd, "ls ", 3)) {
+        char *path = cmd + 2;
+        while (*path == ' ') path++;
+        if (!*path) path = ".";
+        coro_init(&s->c, ls_step, in, out);
+        if (!fs_opendir(path, &s->dir)) {
+            printf("Directorio no encontrado: %s\n", path);
+            s->c.line = -1;
+        }
+    } else if (!strncmp(cmd, "cat ", 4)) {
+        char *name = cmd + 4;
+        while (*name == ' ') name++;
+        coro_init(&s->c, cat_file_step, in, out);
+        s->fd = fs_open(name, O_RDONLY);
+        if (s->fd < 0) {
+            printf("Archivo no encontrado: %s\n", name);
+            s->c.line = -1;
+        } else {
+            s->c.stop = cat_file_stop;
+        }
+    } else if (!strcmp(cmd, "yes") || !strncmp(cmd, "yes ", 4)) {
+        s->text = cmd + 3;
+        while (*s->text == ' ') s->text++;
+        if (!*s->text) s->text = "y";
+        s->len = strlen(s->text);
+        coro_init(&s->c, yes_step, in, out);
+    } else {
+        return 0;
+    }
+    if (s->c.line < 0 && out) out->closed = 1;   // No saldrá nada
+    return 1;
+}
+
+// putchar de la etapa con pila propia cuando su salida va al pipe
+static void pipe_putc(char c) {
+    while (!ring_put(pipe_out, c)) {
+        pipe_pumping = 1;
+        coro_step(pipe_v, pipe_ext + 1, pipe_n - 1);
+        pipe_pumping = 0;
+        // Si ya nadie lee, se descarta
+        if (pipe_v[pipe_ext + 1]->line < 0 || break_requested()) return;
+    }
+}
+
+// Su entrada (una fuente de input_getchar): -1 al final o con Ctrl+C
+static int pipe_getc(void) {
+    for (;;) {
+        int c = ring_get(pipe_in);
+        if (c >= 0 || pipe_in->closed || break_requested()) return c;
+        pipe_pumping = 1;
+        coro_step(pipe_v, 0, pipe_ext - 1);
+        pipe_pumping = 0;
+    }
+}
+
+// Corre el pipe con la etapa pipe_ext en la pila del shell. Retorna 0 si
+// se canceló.
+static int pipe_run_stack(char *cmd) {
+    int depth = input_depth;
+    pipe_in = pipe_ext ? &pipe_rings[pipe_ext - 1] : 0;
+    if (pipe_in) {
+        input_source *src = input_push();
+        if (!src) {
+            printf("Demasiadas fuentes de entrada anidadas\n");
+            coro_cancel(pipe_v, 0, pipe_n - 1);
+            return 1;
+        }
+        src->pipe = 1;
+        src->redirect = 1;
+    }
+    ring *out = pipe_ext < pipe_n - 1 ? &pipe_rings[pipe_ext] : 0;
+    pipe_out = out;
+    execute_command(cmd);
+    pipe_out = 0;
+    while (input_depth > depth) input_pop();
+    TRACE(TRACE_PIPE_STAGE, pipe_ext, out ? out->head : 0);
+
+    // Lo de antes ya no tiene quién lo lea; lo de después acaba lo que tenga
+    coro_cancel(pipe_v, 0, pipe_ext - 1);
+    if (!out) return !break_pending;
+    out->closed = 1;
+    return coro_run(pipe_v + pipe_ext + 1, pipe_n - pipe_ext - 1, break_requested);
+}
+
+// Ejecuta una línea con pipes ('line' se parte en las órdenes)
+static void execute_pipe(char *line) {
+    if (pipe_n) {
+        printf("Error: una etapa de un pipe no puede ejecutar otro pipe\n");
+        return;
+    }
+    char *cmds[PIPE_STAGES];
+    int n = 0;
+    for (char *p = line; p; ) {
+        if (n == PIPE_STAGES) {
+            printf("Error: un pipe tiene como mucho %d etapas\n", PIPE_STAGES);
+            return;
+        }
+        char *bar = strchr(p, '|');
+        if (bar) *bar = '\0';
+        while (*p == ' ') p++;
+        char *end = p + strlen(p);
+        while (end > p && end[-1] == ' ') *--end = '\0';
+        if (!*p) {
+            printf("Error: Comando vacío en el pipe\n");
+            return;
+        }
+        cmds[n++] = p;
+        p = bar ? bar + 1 : 0;
+    }
+
+    pipe_ext = -1;
+    pipe_hole.line = -1;
+    pipe_hole.out = 0;
+    pipe_hole.stop = 0;
+    for (int i = 0; i < n; i++) {
+        ring *in = i ? &pipe_rings[i - 1] : 0;
+        ring *out = i < n - 1 ? &pipe_rings[i] : 0;
+        if (out) ring_init(out);
+        if (pipe_stage_init(i, cmds[i], in, out)) {
+            pipe_v[i] = &pipe_stages[i].c;
+            continue;
+        }
+        if (pipe_ext >= 0) {
+            printf("Error: '%s' y '%s' no pueden ir en el mismo pipe\n", cmds[pipe_ext], cmds[i]);
+            printf("Sólo una etapa puede ser algo distinto de grep, wc, head, tail, rev, sort, uniq, cut, cat, ls o yes\n");
+            coro_cancel(pipe_v, 0, i - 1);
+            return;
+        }
+        pipe_ext = i;
+        pipe_v[i] = &pipe_hole;
+    }
+
+    pipe_n = n;
+    int done = pipe_ext < 0 ? coro_run(pipe_v, n, break_requested) : pipe_run_stack(cmds[pipe_ext]);
+    pipe_n = 0;
+    if (!done) printf("^C\n");
+}
+
+// =============================================================================
+// BANCO DE PRUEBAS DE RENDIMIENTO (bench)
+// =============================================================================
+// Cada prueba se repite BENCH_ITERS veces y se mide en ciclos del
+// procesador con rdtsc. Se informa el mínimo, la mediana y el percentil 99,
+// y para las pruebas que procesan datos, los bytes por ciclo.
+// Con la opción "json" cada resultado se envía además como una línea JSON por
+// el puerto serie, y con "exit" se apaga QEMU al terminar mediante el
+// dispositivo isa-debug-exit (puerto 0xF4), para poder ejecutar el banco
+// desde un script y comparar resultados entre versiones (make bench).
+#define BENCH_ITERS    100
+#define BENCH_BUF_SIZE 32768
+#define BENCH_FILES    64
+#define DEBUG_EXIT_PORT 0xF4
+
+typedef struct {
+    const char *name;
+    void (*setup)(void);      // Antes de la primera repetición (puede ser NULL)
+    void (*prepare)(void);    // Antes de cada repetición, fuera de la medida
+    void (*run)(void);        // Lo que se mide
+    void (*teardown)(void);   // Después de la última repetición
+    uint32_t bytes;           // Bytes procesados por repetición (0 = no aplica)
+} bench_case;
+
+static uint8_t  bench_src[BENCH_BUF_SIZE];
+static uint8_t  bench_dst[BENCH_BUF_SIZE];
+static uint32_t bench_samples[BENCH_ITERS];
+static uint16_t bench_chain;               // Clusters ocupados para llenar el disco
+static char     bench_pipe_line[32];
+static volatile uint32_t bench_sink;       // Evita que se descarten resultados
+
+// --- Memoria ---------------------------------------------------------------
+static void bench_memcpy(void) { memcpy(bench_dst, bench_src, BENCH_BUF_SIZE); }
+static void bench_memset(void) { memset(bench_dst, 0x5A, BENCH_BUF_SIZE); }
+static void bench_crc32c(void) { bench_sink += crc32c(0, bench_src, BENCH_BUF_SIZE); }
+static void bench_memchr(void) { bench_sink += memchr(bench_src, 0xFF, BENCH_BUF_SIZE) != 0; }   // No está
+
+// --- Búsqueda de nombres -----------------------------------------------------
+static void bench_files_setup(void) {
+    char name[8] = "bnch00";
+    for (int i = 0; i < BENCH_FILES; i++) {
+        name[4] = '0' + i / 10;
+        name[5] = '0' + i % 10;
+        fs_close(fs_open(name, O_WRONLY | O_CREAT));
+    }
+}
+static void bench_files_teardown(void) {
+    char name[8] = "bnch00";
+    for (int i = 0; i < BENCH_FILES; i++) {
+        name[4] = '0' + i / 10;
+        name[5] = '0' + i % 10;
+        fs_unlink(name);
+    }
+}
+static void bench_find_hit(void) {
+    fat16_dir_entry e; int idx;
+    bench_sink += fs_find("bnch63", &e, &idx);
+}
+static void bench_find_miss(void) {
+    fat16_dir_entry e; int idx;
+    bench_sink += fs_find("noexiste", &e, &idx);
+}
+
+// --- Asignación con el disco lleno -----------------------------------------
+static void bench_fill_disk(void) {
+    uint16_t prev = 0, c;
+    bench_chain = 0;
+    while ((c = fs_alloc_cluster()) != 0) {
+        if (prev) fat_set(prev, c);
+        else bench_chain = c;
+        prev = c;
+    }
+}
+static void bench_free_disk(void) {
+    if (bench_chain) fs_free_chain(bench_chain);
+}
+static void bench_alloc_full(void) { bench_sink += fs_alloc_cluster(); }
+
+// --- Lectura y escritura de archivos ---------------------------------------
+static void bench_write(void) { fs_write("bench.dat", bench_src, BENCH_BUF_SIZE); }
+static void bench_read(void) {
+    uint32_t size;
+    fs_read("bench.dat", bench_dst, BENCH_BUF_SIZE, &size);
+}
+static void bench_remove_file(void) { fs_unlink("bench.dat"); }
+// La copia comparte los clusters: su coste no depende del tamaño
+static void bench_copy(void) { bench_sink += fs_copy("bench.dat", "bench.cp"); }
+static void bench_remove_copy(void) { fs_unlink("bench.cp"); }
+
+// --- Consola -----------------------------------------------------------------
+static void bench_cursor_home(void) { cursor_x = cursor_y = 0; }
+static void bench_cursor_bottom(void) { cursor_x = 0; cursor_y = con_rows - 1; }
+static void bench_putchar(void) {
+    for (int i = 0; i < VGA_WIDTH * (VGA_HEIGHT - 1); i++) putchar('#');
+}
+// Pantalla entera desde las celdas, lo peor que puede costar un cuadro
+static void bench_fbcon_redraw(void) {
+    fbcon_touch_all();
+    fbcon_flush();
+}
+static void bench_scroll(void) {
+    for (int i = 0; i < VGA_HEIGHT - 1; i++) putchar('\n');
+}
+
+// --- Texto: grep y pipes ----------------------------------------------------
+static void bench_text_setup(void) {
+    // Líneas de 64 bytes; sólo la última contiene el patrón
+    for (int i = 0; i < BENCH_BUF_SIZE; i++) {
+        bench_src[i] = (i % 64 == 63) ? '\n' : 'a' + (i * 7) % 26;
+    }
+    memcpy(bench_src + BENCH_BUF_SIZE - 16, "aguja", 5);
+    fs_write("bench.txt", bench_src, BENCH_BUF_SIZE);
+}
+static void bench_text_teardown(void) { fs_unlink("bench.txt"); }
+static void bench_pipe_prepare(void) {
+    // execute_pipe parte la línea que recibe
+    memcpy(bench_pipe_line, "cat bench.txt | grep aguja | wc", 32);
+}
+static void bench_lz_setup(void) {
+    fs_comp_info info;
+    bench_text_setup();
+    fs_compress("bench.txt", &info);
+}
+static void bench_grep(void) { fs_grep("aguja", "bench.txt"); }
+static void bench_lz_read(void) {
+    uint32_t size;
+    fs_read("bench.txt", bench_dst, BENCH_BUF_SIZE, &size);
+}
+static void bench_pipe(void) { execute_pipe(bench_pipe_line); }
+// Todo el disco: con el índice sólo se lee bench.txt, sin él todo
+static int bench_index_was;
+static void bench_search_setup(void) {
+    fs_index_stats st;
+    bench_text_setup();
+    fs_index_get_stats(&st);
+    bench_index_was = st.enabled;
+    fs_index_enable(1);
+}
+static void bench_search_teardown(void) {
+    bench_text_teardown();
+    fs_index_enable(bench_index_was);
+}
+static void bench_search(void) {
+    fs_search_info info;
+    fs_search("aguja", "/", 0, &info);
+}
+static void bench_search_scan(void) {
+    fs_search_info info;
+    fs_search("aguja", "/", FS_SEARCH_SCAN, &info);
+}
+
+static const bench_case bench_cases[] = {
+    { "memcpy_32k",    0, 0, bench_memcpy, 0, BENCH_BUF_SIZE },
+    { "memset_32k",    0, 0, bench_memset, 0, BENCH_BUF_SIZE },
+    { "crc32c_32k",    0, 0, bench_crc32c, 0, BENCH_BUF_SIZE },
+    { "memchr_32k",    0, 0, bench_memchr, 0, BENCH_BUF_SIZE },
+    { "fs_find_hit",   bench_files_setup, 0, bench_find_hit, bench_files_teardown, 0 },
+    { "fs_find_hit_cold", bench_files_setup, fs_dcache_flush, bench_find_hit, bench_files_teardown, 0 },
+    { "fs_find_miss",  0, 0, bench_find_miss, 0, 0 },
+    { "fs_find_miss_cold", bench_files_setup, fs_dcache_flush, bench_find_miss, bench_files_teardown, 0 },
+    { "fs_alloc_full", bench_fill_disk, 0, bench_alloc_full, bench_free_disk, 0 },
+    { "fs_write_32k",  0, 0, bench_write, 0, BENCH_BUF_SIZE },
+    { "fs_copy_32k",   0, 0, bench_copy, bench_remove_copy, 0 },
+    { "fs_read_32k",   0, 0, bench_read, bench_remove_file, BENCH_BUF_SIZE },
+    { "putchar_1920",  0, bench_cursor_home, bench_putchar, 0, VGA_WIDTH * (VGA_HEIGHT - 1) },
+    { "scroll_24",     0, bench_cursor_bottom, bench_scroll, clear_screen, 0 },
+    { "fbcon_redraw",  0, 0, bench_fbcon_redraw, 0, 0 },
+    { "grep_32k",      bench_text_setup, 0, bench_grep, 0, BENCH_BUF_SIZE },
+    { "fs_read_lz_32k", bench_lz_setup, 0, bench_lz_read, 0, BENCH_BUF_SIZE },
+    { "pipe_cat_grep_wc_32k", bench_text_setup, bench_pipe_prepare, bench_pipe, bench_text_teardown, BENCH_BUF_SIZE },
+    { "search_index",  bench_search_setup, 0, bench_search, 0, 0 },
+    { "search_scan",   0, 0, bench_search_scan, bench_search_teardown, 0 },
+};
+#define BENCH_COUNT (sizeof(bench_cases) / sizeof(bench_cases[0]))
+
+typedef struct {
+    uint32_t min, median, p99;
+} bench_result;
+
+static void bench_run(const bench_case *b, bench_result *r) {
+    if (b->setup) b->setup();
+    for (int i = 0; i < BENCH_ITERS; i++) {
+        if (b->prepare) b->prepare();
+        uint32_t t0 = (uint32_t)rdtsc();
+        b->run();
+        bench_samples[i] = (uint32_t)rdtsc() - t0;
+    }
+    if (b->teardown) b->teardown();
+    
+    // Ordenación por inserción: son pocas muestras
+    for (int i = 1; i < BENCH_ITERS; i++) {
+        uint32_t v = bench_samples[i];
+        int j = i - 1;
+        while (j >= 0 && bench_samples[j] > v) {
+            bench_samples[j + 1] = bench_samples[j];
+            j--;
+        }
+        bench_samples[j + 1] = v;
+    }
+    r->min = bench_samples[0];
+    r->median = bench_samples[BENCH_ITERS / 2];
+    r->p99 = bench_samples[(BENCH_ITERS * 99 + 99) / 100 - 1];
+}
+
+// Bytes por ciclo con tres decimales (sin coma flotante)
+static uint32_t bench_milli_bpc(uint32_t bytes, uint32_t cycles) {
+    if (!bytes || !cycles) return 0;
+    uint64_t q = udiv64((uint64_t)bytes * 1000, cycles);
+    return q < 1000000000 ? (uint32_t)q : 1000000000;
+}
+
+static void bench_print_milli(void (*out)(char), uint32_t v) {
+    printnum(out, v / 1000, 10);
+    out('.');
+    out('0' + (v / 100) % 10);
+    out('0' + (v / 10) % 10);
+    out('0' + v % 10);
+}
+
+// Número alineado a la derecha en una columna de 10 caracteres
+static void bench_print_col(uint32_t v) {
+    char buf[10]; int n = 0;
+    do { buf[n++] = '0' + v % 10; v /= 10; } while (v);
+    for (int k = n; k < 10; k++) putchar(' ');
+    while (n--) putchar(buf[n]);
+}
+
+// bench [list] [json] [exit] [filtro]
+static void bench_command(char *args) {
+    int json = 0, do_exit = 0, list = 0;
+    const char *filter = 0;
+    for (char *tok = args; tok && *tok; ) {
+        char *next = strchr(tok, ' ');
+        if (next) *next++ = '\0';
+        if (!strcmp(tok, "json")) json = 1;
+        else if (!strcmp(tok, "exit")) do_exit = 1;
+        else if (!strcmp(tok, "list")) list = 1;
+        else if (*tok) filter = tok;
+        tok = next;
+    }
+    
+    if (list) {
+        for (uint32_t i = 0; i < BENCH_COUNT; i++) printf("%s\n", bench_cases[i].name);
+        return;
+    }
+    
+    static bench_result results[BENCH_COUNT];
+    int ran[BENCH_COUNT];
+    for (uint32_t i = 0; i < BENCH_COUNT; i++) {
+        const bench_case *b = &bench_cases[i];
+        ran[i] = !filter || strstr(b->name, filter);
+        if (!ran[i]) continue;
+        bench_run(b, &results[i]);
+        
+        if (json) {
+            bench_result *r = &results[i];
+            serial_printf("{\"bench\":\"%s\",\"iters\":%u,\"min\":%u,\"median\":%u,\"p99\":%u,\"bytes\":%u,\"bytes_per_cycle\":",
+                          b->name, BENCH_ITERS, r->min, r->median, r->p99, b->bytes);
+            bench_print_milli(serial_putc, bench_milli_bpc(b->bytes, r->median));
+            serial_printf("}\n");
+        }
+    }
+    
+    // La tabla se imprime al final: algunas pruebas escriben en pantalla
+    printf("prueba                   min   mediana       p99  bytes/ciclo\n");
+    for (uint32_t i = 0; i < BENCH_COUNT; i++) {
+        if (!ran[i]) continue;
+        const bench_case *b = &bench_cases[i];
+        bench_result *r = &results[i];
+        printf("%s", b->name);
+        for (int k = strlen(b->name); k < 18; k++) putchar(' ');
+        bench_print_col(r->min);
+        bench_print_col(r->median);
+        bench_print_col(r->p99);
+        prints("  ");
+        if (b->bytes) bench_print_milli(putchar, bench_milli_bpc(b->bytes, r->median));
+        else putchar('-');
+        putchar('\n');
+    }
+    
+    if (do_exit) {
+        // QEMU termina con código (valor << 1) | 1
+        outb(DEBUG_EXIT_PORT, 0);
+        printf("isa-debug-exit no disponible (falta -device isa-debug-exit)\n");
+    }
+}
+
+// =============================================================================
+// TRAZA DE EVENTOS (trace)
+// =============================================================================
+// Los puntos de traza (trace.h) registran en un buffer circular los accesos
+// a sectores, asignaciones de clusters, búsquedas en el directorio, teclas,
+// comandos y etapas de los pipes. 'trace dump' lo vuelca por el puerto serie
+// como texto, una línea por evento:
+//     # r2os-trace 1 cpus=<n> tsc_khz=<ciclos por ms>
+//     <cpu> <tsc alto hex> <tsc bajo hex> <evento> <a> <b>
+//     # fin eventos=<n> perdidos=<n>
+// tools/trace2json.py lo convierte al formato JSON de Chrome (chrome://tracing
+// o Perfetto).
+#define PIT_CH2      0x42
+#define PIT_CMD      0x43
+#define PIT_GATE     0x61
+#define PIT_HZ       1193182
+
+// Frecuencia del TSC en kHz, medida una vez contra el canal 2 del PIT:
+// se programa una cuenta de 10 ms y se cuentan los ciclos hasta que acaba
+static uint32_t tsc_khz(void) {
+    static uint32_t khz = 0;
+    if (khz) return khz;
+    
+    const uint32_t ticks = PIT_HZ / 100;
+    outb(PIT_GATE, (inb(PIT_GATE) & ~0x02) | 0x01);  // Gate activo, altavoz apagado
+    outb(PIT_CMD, 0xB0);                              // Canal 2, modo 0, 16 bits
+    outb(PIT_CH2, ticks & 0xFF);
+    outb(PIT_CH2, ticks >> 8);
+    uint32_t t0 = (uint32_t)rdtsc();
+    while (!(inb(PIT_GATE) & 0x20));                  // Salida a 1 al llegar a 0
+    khz = ((uint32_t)rdtsc() - t0) / 10;
+    return khz ? khz : 1;
+}
+
+static void trace_dump(void) {
+    uint32_t total = 0, lost = 0;
+    serial_printf("# r2os-trace 1 cpus=%u tsc_khz=%u\n", TRACE_CPUS, tsc_khz());
+    for (int cpu = 0; cpu < TRACE_CPUS; cpu++) {
+        uint32_t n = trace_count(cpu);
+        for (uint32_t i = 0; i < n; i++) {
+            const trace_event *ev = trace_get(cpu, i);
+            serial_printf("%u %x %x %s %u %u\n", ev->cpu, (uint32_t)(ev->tsc >> 32),
+                          (uint32_t)ev->tsc, trace_event_name(ev->id), ev->a, ev->b);
+        }
+        total += n;
+        lost += trace_lost(cpu);
+    }
+    serial_printf("# fin eventos=%u perdidos=%u\n", total, lost);
+    printf("trace: %u eventos volcados por el puerto serie", total);
+    if (lost) printf(" (%u sobrescritos)", lost);
+    printf("\n");
+}
+
+static void trace_command(const char *args) {
+    if (args && !strcmp(args, "start")) {
+        tsc_khz();  // Calibrar antes, fuera de la traza
+        trace_start();
+        printf("trace: registrando eventos (buffer de %u por CPU)\n", TRACE_ENTRIES);
+    } else if (args && !strcmp(args, "stop")) {
+        trace_stop();
+        printf("trace: detenido, %u eventos\n", trace_count(0));
+    } else if (args && !strcmp(args, "dump")) {
+        int was_enabled = trace_enabled;
+        trace_stop();  // El propio volcado no debe aparecer en la traza
+        trace_dump();
+        if (was_enabled) trace_start();
+    } else {
+        printf("Uso: trace start|stop|dump\n");
+        printf("Estado: %s, %u eventos\n", trace_enabled ? "activo" : "detenido", trace_count(0));
+    }
+}
+
+// =============================================================================
+// PERFILADOR (prof)
+// =============================================================================
+// prof start [hz]   empieza a muestrear (por defecto PROF_DEFAULT_HZ)
+// prof stop         deja de muestrear
+// prof report [n]   las n funciones con más muestras y su grafo de llamadas
+static void prof_command(char *args) {
+    char *sub = args ? strtok(args, " ") : 0;
+    char *num = sub ? strtok(0, " ") : 0;
+    
+    if (sub && !strcmp(sub, "start")) {
+        uint32_t hz = num ? (uint32_t)atoi(num) : PROF_DEFAULT_HZ;
+        if (!prof_start(hz)) {
+            printf("prof: frecuencia invalida (entre %u y %u Hz)\n", PIT_HZ / 0xFFFF + 1, PROF_MAX_HZ);
+            return;
+        }
+        printf("prof: muestreando a %u Hz\n", hz);
+    } else if (sub && !strcmp(sub, "stop")) {
+        prof_stop();
+        printf("prof: detenido\n");
+    } else if (sub && !strcmp(sub, "report")) {
+        int top = num ? atoi(num) : 15;
+        prof_report(top > 0 ? top : 15);
+    } else {
+        printf("Uso: prof start [hz] | stop | report [n]\n");
+        printf("Estado: %s\n", prof_running() ? "muestreando" : "detenido");
+    }
+}
+
+// =============================================================================
+// CONTABILIDAD DE RECURSOS (time, stats, free, uptime)
+// =============================================================================
+// run_command anota cuántas veces se ejecuta cada comando y cuántos ciclos
+// tarda. 'time <comando>' toma una instantánea de los contadores del kernel
+// antes y después de ejecutarlo y muestra la diferencia; 'stats' muestra
+// los totales desde el arranque.
+#define CMD_STATS 32   // Comandos distintos; el último hueco acumula el resto
+
+typedef struct {
+    char     name[12];
+    uint32_t count;
+    uint64_t cycles, max;
+} cmd_stat;
+
+static cmd_stat cmd_stats[CMD_STATS];
+static uint32_t cmd_stats_used = 0;
+static uint32_t commands_run = 0;
+static uint64_t boot_tsc = 0;       // TSC al entrar en kernel_main
+static uint32_t mem_upper_kb = 0;   // RAM por encima de 1 MiB (Multiboot), 0 = desconocida
+
+extern uint8_t _end[];   // linker.ld: fin de la imagen del kernel
+
+static void cmd_account(const char *name, uint64_t cycles) {
+    uint32_t i = 0;
+    while (i < cmd_stats_used && strcmp(cmd_stats[i].name, name)) i++;
+    if (i == cmd_stats_used) {
+        if (i < CMD_STATS - 1) cmd_stats_used++;
+        else { i = CMD_STATS - 1; name = "(otros)"; }
+        uint32_t len = strlen(name);
+        if (len > sizeof(cmd_stats[i].name) - 1) len = sizeof(cmd_stats[i].name) - 1;
+        memcpy(cmd_stats[i].name, name, len);
+        cmd_stats[i].name[len] = '\0';
+    }
+    cmd_stats[i].count++;
+    cmd_stats[i].cycles += cycles;
+    if (cycles > cmd_stats[i].max) cmd_stats[i].max = cycles;
+}
+
+// Número de 64 bits con 'frac' decimales (v en esas unidades), alineado a
+// la derecha en 'width' columnas
+static void print_u64(uint64_t v, int frac, int width) {
+    char buf[24]; int n = 0;
+    for (int k = 0; k < frac; k++) {
+        uint64_t q = udiv64(v, 10);
+        buf[n++] = '0' + (char)(v - q * 10);
+        v = q;
+    }
+    if (frac) buf[n++] = '.';
+    do {
+        uint64_t q = udiv64(v, 10);
+        buf[n++] = '0' + (char)(v - q * 10);
+        v = q;
+    } while (v);
+    for (int k = n; k < width; k++) putchar(' ');
+    while (n--) putchar(buf[n]);
+}
+
+// Ciclos del TSC como milisegundos con tres decimales
+static void print_ms(uint64_t cycles, int width) {
+    print_u64(udiv64(cycles * 1000, tsc_khz()), 3, width);
+}
+
+typedef struct {
+    uint64_t tsc, copied;
+    uint32_t chars;
+    fs_stats fs;
+} kstat_snapshot;
+
+static void kstat_take(kstat_snapshot *k) {
+    fs_get_stats(&k->fs);
+    k->copied = memcpy_bytes;
+    k->chars = chars_out;
+    k->tsc = rdtsc();
+}
+
+static void execute_command(char *line);
+
+// time <comando>: el comando completo, pipes incluidos
+static void time_command(char *line) {
+    kstat_snapshot before, after;
+    tsc_khz();   // Calibrar fuera de la medida
+    kstat_take(&before);
+    execute_command(line);
+    kstat_take(&after);
+    
+    const fs_stats *a = &after.fs, *b = &before.fs;
+    uint64_t cycles = after.tsc - before.tsc;
+    if (cursor_x) putchar('\n');
+    printf("real    ");
+    print_ms(cycles, 0);
+    printf(" ms (");
+    print_u64(cycles, 0, 0);
+    printf(" ciclos)\n");
+    printf("disco   %u sectores leidos, %u escritos\n",
+           a->sectors_read - b->sectors_read, a->sectors_written - b->sectors_written);
+    printf("memcpy  %u bytes\n", (uint32_t)(after.copied - before.copied));
+    printf("cache   aciertos/fallos: anticipada %u/%u, directorio %u/%u, inodos %u/%u\n",
+           a->ra_hits - b->ra_hits, a->ra_misses - b->ra_misses,
+           a->dcache_hits - b->dcache_hits, a->dcache_misses - b->dcache_misses,
+           a->inode_hits - b->inode_hits, a->inode_misses - b->inode_misses);
+    printf("salida  %u caracteres\n", after.chars - before.chars);
+}
+
+// Memoria y disco en KB: total, usado y libre. No hay montículo: la RAM
+// usada es la imagen del kernel (con el disco en RAM), de 1 MiB a _end.
+static void free_command(void) {
+    uint32_t disk_free = fs_free_clusters();
+    printf("            total     usado     libre  (KB)\n");
+    if (mem_upper_kb) {
+        uint32_t total = 1024 + mem_upper_kb;
+        uint32_t used = ((uint32_t)(uintptr_t)_end + 1023) / 1024 - 1024;
+        printf("RAM   ");
+        bench_print_col(total);
+        bench_print_col(used);
+        bench_print_col(total - 1024 > used ? total - 1024 - used : 0);
+        printf("\n");
+    } else {
+        printf("RAM   (el cargador no informo del tamano)\n");
+    }
+    printf("Disco ");
+    bench_print_col(DATA_CLUSTERS * SECTOR_SIZE / 1024);
+    bench_print_col((DATA_CLUSTERS - disk_free) * SECTOR_SIZE / 1024);
+    bench_print_col(disk_free * SECTOR_SIZE / 1024);
+    printf("\n");
+}
+
+static void uptime_command(void) {
+    uint64_t ms = udiv64(rdtsc() - boot_tsc, tsc_khz());
+    uint32_t secs = (uint32_t)udiv64(ms, 1000);
+    printf("arriba %u:%c%c:%c%c, %u comandos ejecutados\n", secs / 3600,
+           '0' + secs / 600 % 6, '0' + secs / 60 % 10, '0' + secs % 60 / 10, '0' + secs % 10,
+           commands_run);
+}
+
+// Qué tiene la CPU y qué variante de cada rutina se usa. Con "use" se
+// fuerza otra, para compararlas con 'bench'.
+static void cpuinfo_command(char *arg) {
+    static const char *const features[] = {
+        "tsc", "pse", "sep", "fxsr", "sse2", "sse4.2", "avx", "avx2", "erms", "fsrm", "tsc-invariante",
+        "apic", "tsc-deadline",
+    };
+    char *sub = strtok(arg, " ");
+    if (sub && !strcmp(sub, "use")) {
+        char *routine = strtok(0, " "), *variant = strtok(0, " ");
+        if (!routine || !variant) {
+            printf("Uso: cpuinfo [use <rutina> <variante>]\n");
+        } else if (!cpu_use(routine, variant)) {
+            printf("cpuinfo: %s no tiene la variante %s o esta CPU no la admite\n", routine, variant);
+        }
+        return;
+    }
+    cpu_info ci;
+    cpu_get_info(&ci);
+    printf("CPU: %s, familia %u, modelo %u, revision %u\n", ci.vendor, ci.family, ci.model, ci.stepping);
+    if (ci.brand[0]) printf("     %s\n", ci.brand);
+    printf("     %u MHz (TSC)\n", tsc_khz() / 1000);
+    printf("Tiene:");
+    for (uint32_t i = 0; i < sizeof(features) / sizeof(features[0]); i++) {
+        if (ci.features & (1u << i)) printf(" %s", features[i]);
+    }
+    printf("\nRutinas (* en uso; entre parentesis, las que esta CPU no admite):\n");
+    for (int r = 0; r < cpu_routines(); r++) {
+        printf("  %s ", cpu_routine(r));
+        for (int v = 0; cpu_variant(r, v); v++) {
+            const char *mark = v == cpu_selected(r) ? "*" : "";
+            if (cpu_variant_ok(r, v)) printf(" %s%s", mark, cpu_variant(r, v));
+            else printf(" (%s)", cpu_variant(r, v));
+        }
+        printf("\n");
+    }
+}
+
+static void stats_command(void) {
+    fs_stats st;
+    fs_get_stats(&st);
+    
+    printf("Comandos (%u desde el arranque):\n", commands_run);
+    printf("comando          veces   total ms   media ms    max ms\n");
+    for (uint32_t i = 0; i < CMD_STATS; i++) {
+        const cmd_stat *c = &cmd_stats[i];
+        if (!c->count) continue;
+        printf("%s", c->name);
+        for (int k = strlen(c->name); k < 12; k++) putchar(' ');
+        print_u64(c->count, 0, 9);
+        print_ms(c->cycles, 11);
+        print_ms(udiv64(c->cycles, c->count), 11);
+        print_ms(c->max, 10);
+        printf("\n");
+    }
+    
+    printf("Disco: %u de %u clusters libres; %u asignados y %u liberados\n",
+           fs_free_clusters(), DATA_CLUSTERS, st.clusters_alloced, st.clusters_freed);
+    printf("Copias compartidas: %u; clusters duplicados al escribir: %u\n",
+           st.reflinks, st.cow_copies);
+    printf("Compresion: %u bloques descomprimidos, %u servidos desde cache\n",
+           st.comp_decoded, st.comp_hits);
+    printf("Integridad: %u sectores danados, %u repasados en segundo plano (crc32c %s)\n",
+           st.crc_errors, st.scrubbed, crc32c_impl());
+    proc_stats ps;
+    proc_get_stats(&ps);
+    printf("Programas: %u ejecutados, %u terminados por un fallo y %u con Ctrl+C, %u llamadas al sistema (%s)\n",
+           ps.runs, ps.killed, ps.interrupted, ps.syscalls, sysenter_available() ? "sysenter" : "int 0x80");
+    if (e1000_present()) {
+        e1000_stats ns;
+        e1000_get_stats(&ns);
+        printf("Red: %u paquetes recibidos (%u KB), %u enviados (%u KB), %u interrupciones, %u sin buffer\n",
+               ns.rx_packets, ns.rx_bytes >> 10, ns.tx_packets, ns.tx_bytes >> 10, ns.irqs, ns.rx_nobuf);
+        net_stats is;
+        net_get_stats(&is);
+        printf("IP: %u recibidos, %u enviados; UDP: %u datagramas recibidos, %u enviados, %u descartados\n",
+               is.ip_in, is.ip_out, is.udp_in, is.udp_out, is.udp_noport + is.udp_overflow + is.udp_bad);
     }
+    printf("E/S: %u sectores leidos, %u escritos; cola: %u peticiones, %u transferencias, %u fusiones\n",
+           st.sectors_read, st.sectors_written, st.blk_submitted, st.blk_dispatched, st.blk_merged);
+    printf("Cache (aciertos/fallos): anticipada %u/%u (%u pedidos), directorio %u/%u, inodos %u/%u\n",
+           st.ra_hits, st.ra_misses, st.ra_prefetched, st.dcache_hits, st.dcache_misses,
+           st.inode_hits, st.inode_misses);
+    printf("Directorios: %u indices construidos, %u recorridos lineales\n",
+           st.dir_index_builds, st.dir_scans);
+    printf("memcpy: %u KB copiados; pantalla: %u caracteres\n", (uint32_t)(memcpy_bytes >> 10), chars_out);
+    if (con_fb) {
+        fbcon_stats fs;
+        fbcon_get_stats(&fs);
+        printf("Framebuffer: %u cuadros, %u celdas pintadas, desplazamientos: %u moviendo la pantalla, %u copiando, %u repintando; %u colores a la cache\n",
+               fs.flushes, fs.glyphs, fs.pan_scrolls, fs.copy_scrolls, fs.full_redraws, fs.color_misses);
+    }
+    timer_stats ts;
+    timer_get_stats(&ts);
+    printf("Espera (%s): CPU detenida %u veces, ", timer_mode(), ts.halts);
+    print_ms(ts.idle_cycles, 0);
+    printf(" ms; %u interrupciones del timer, %u temporizadores vencidos, retraso medio %u us, max %u us\n",
+           ts.timer_irqs, ts.fired,
+           (uint32_t)udiv64(udiv64(ts.late_cycles * 1000, tsc_khz()), ts.fired ? ts.fired : 1),
+           (uint32_t)udiv64(ts.late_max * 1000, tsc_khz()));
+    uptime_command();
 }
 
-// =============================================================================
-// PIPES SIMPLES
-// =============================================================================
-// Implementación básica de pipes para comandos educativos
-// Captura la salida del primer comando y la pasa como entrada al segundo
-static void execute_pipe(char *cmd1, char *cmd2) {
-    // Buffer temporal para capturar la salida del primer comando
-    static char pipe_buffer[4096];
-    static char temp_output[4096];
-    
-    // Limpiar buffer
-    memset(pipe_buffer, 0, sizeof(pipe_buffer));
-    memset(temp_output, 0, sizeof(temp_output));
-    
-    printf("Ejecutando pipe: '%s' | '%s'\n", cmd1, cmd2);
-    
-    // Para esta implementación educativa, solo soportamos algunos comandos básicos
-    // cmd1 debe ser un comando que produzca salida (cat, ls, echo)
-    // cmd2 debe ser un comando que procese entrada (grep, wc, head, tail)
-    
-    // Ejecutar primer comando y capturar salida
-    if (strcmp(cmd1, "ls") == 0) {
-        // Capturar salida de ls
-        int count = 0;
-        for (int i = 0; i < 32; i++) {
-            fat16_dir_entry entry;
-            read_root_entry(i, &entry);
-            if (entry.name[0] != 0x00 && entry.name[0] != 0xE5) {
-                // Formatear nombre de archivo FAT16 a string normal
-                char filename[13];
-                int k = 0;
-                // Copiar nombre (8 caracteres)
-                for (int j = 0; j < 8 && entry.name[j] != ' '; j++) {
-                    filename[k++] = entry.name[j];
-                }
-                // Agregar punto si hay extensión
-                if (entry.name[8] != ' ') {
-                    filename[k++] = '.';
-                    for (int j = 8; j < 11 && entry.name[j] != ' '; j++) {
-                        filename[k++] = entry.name[j];
-                    }
-                }
-                filename[k] = '\0';
-                
-                // Agregar al buffer
-                int len = strlen(filename);
-                if (count + len + 1 < sizeof(pipe_buffer)) {
-                    if (count > 0) {
-                        pipe_buffer[count++] = '\n';
-                    }
-                    memcpy(pipe_buffer + count, filename, len);
-                    count += len;
-                }
-            }
-        }
-    } else if (strncmp(cmd1, "cat ", 4) == 0) {
-        // Capturar salida de cat
-        char *filename = cmd1 + 4;
-        while (*filename == ' ') filename++; // Limpiar espacios
-        
-        uint32_t size = 0;
-        if (fs_read(filename, pipe_buffer, &size)) {
-            // fs_read ya copió el contenido a pipe_buffer
-        }
-    } else if (strncmp(cmd1, "echo ", 5) == 0) {
-        // Capturar salida de echo
-        char *text = cmd1 + 5;
-        while (*text == ' ') text++; // Limpiar espacios
-        
-        int len = strlen(text);
-        if (len < sizeof(pipe_buffer)) {
-            memcpy(pipe_buffer, text, len);
-        }
-    } else if (strncmp(cmd1, "rev ", 4) == 0) {
-        // Capturar salida de rev (texto invertido)
-        char *text = cmd1 + 4;
-        while (*text == ' ') text++; // Limpiar espacios
-        
-        int len = strlen(text);
-        if (len < sizeof(pipe_buffer)) {
-            // Invertir el texto y guardarlo en pipe_buffer
-            for (int i = len - 1; i >= 0; i--) {
-                pipe_buffer[len - 1 - i] = text[i];
-            }
-            pipe_buffer[len] = '\0'; // Null terminator
-        }
-    } else if (strcmp(cmd1, "date") == 0) {
-        // Capturar salida de date
-        const char *date_str = "Lun Ene 01 12:00:00 UTC 2024";
-        int len = strlen(date_str);
-        if (len < sizeof(pipe_buffer)) {
-            memcpy(pipe_buffer, date_str, len);
-            pipe_buffer[len] = '\0';
-        }
-    } else if (strcmp(cmd1, "whoami") == 0) {
-        // Capturar salida de whoami
-        const char *user = "root";
-        int len = strlen(user);
-        if (len < sizeof(pipe_buffer)) {
-            memcpy(pipe_buffer, user, len);
-            pipe_buffer[len] = '\0';
-        }
-    } else if (strcmp(cmd1, "uname") == 0) {
-        // Capturar salida de uname
-        const char *uname_str = "MiniKernel x86 1.0";
-        int len = strlen(uname_str);
-        if (len < sizeof(pipe_buffer)) {
-            memcpy(pipe_buffer, uname_str, len);
-            pipe_buffer[len] = '\0';
-        }
-    } else {
-        printf("Error: Comando '%s' no soportado en pipes\n", cmd1);
-        printf("Comandos soportados como entrada: ls, cat <file>, echo <text>, rev <text>, date, whoami, uname\n");
+// sleep <ms>: la CPU se detiene hasta el plazo; la red se sigue atendiendo
+static void sleep_command(const char *arg) {
+    if (!arg) {
+        printf("Uso: sleep <ms>\n");
         return;
     }
-    
-    // Procesar segundo comando con la salida del primero
-    if (strncmp(cmd2, "grep ", 5) == 0) {
-        // grep palabra
-        char *search_term = cmd2 + 5;
-        while (*search_term == ' ') search_term++; // Limpiar espacios
-        
-        printf("Buscando '%s' en la salida:\n", search_term);
-        
-        // Buscar línea por línea
-        char *line_start = pipe_buffer;
-        char *line_end;
-        
-        while (*line_start) {
-            line_end = line_start;
-            while (*line_end && *line_end != '\n') line_end++;
-            
-            // Crear línea temporal
-            char line[256];
-            int line_len = line_end - line_start;
-            if (line_len < sizeof(line)) {
-                memcpy(line, line_start, line_len);
-                line[line_len] = '\0';
-                
-                // Buscar término en la línea
-                if (strstr(line, search_term)) {
-                    printf("%s\n", line);
-                }
-            }
-            
-            // Avanzar a la siguiente línea
-            line_start = line_end;
-            if (*line_start == '\n') line_start++;
-        }
-    } else if (strcmp(cmd2, "wc") == 0 || strcmp(cmd2, "wc -l") == 0) {
-        // Contar líneas, palabras, caracteres
-        int lines = 0, words = 0, chars = 0;
-        int in_word = 0;
-        
-        for (int i = 0; pipe_buffer[i]; i++) {
-            chars++;
-            if (pipe_buffer[i] == '\n') lines++;
-            if (pipe_buffer[i] == ' ' || pipe_buffer[i] == '\n' || pipe_buffer[i] == '\t') {
-                in_word = 0;
-            } else if (!in_word) {
-                in_word = 1;
-                words++;
-            }
-        }
-        
-        printf("  %d  %d  %d\n", lines, words, chars);
-    } else if (strncmp(cmd2, "head", 4) == 0) {
-        // Mostrar primeras líneas
-        int max_lines = 10; // Por defecto
-        
-        // Verificar si hay número especificado
-        if (strlen(cmd2) > 5) {
-            char *num_str = cmd2 + 5;
-            while (*num_str == ' ') num_str++;
-            if (*num_str >= '0' && *num_str <= '9') {
-                max_lines = atoi(num_str);
-            }
-        }
-        
-        // Mostrar líneas
-        char *line_start = pipe_buffer;
-        char *line_end;
-        int line_count = 0;
-        
-        while (*line_start && line_count < max_lines) {
-            line_end = line_start;
-            while (*line_end && *line_end != '\n') line_end++;
-            
-            // Imprimir línea
-            for (char *p = line_start; p < line_end; p++) {
-                printf("%c", *p);
-            }
-            printf("\n");
-            
-            line_count++;
-            line_start = line_end;
-            if (*line_start == '\n') line_start++;
-        }
-    } else if (strncmp(cmd2, "tail", 4) == 0) {
-        // Mostrar últimas líneas (implementación simplificada)
-        int max_lines = 10; // Por defecto
-        
-        printf("Últimas líneas de la salida:\n");
-        printf("%s\n", pipe_buffer); // Simplificado para esta versión educativa
-    } else if (strcmp(cmd2, "rev") == 0) {
-        // Invertir toda la salida del comando anterior
-        int len = strlen(pipe_buffer);
-        printf("Texto invertido:\n");
-        for (int i = len - 1; i >= 0; i--) {
-            printf("%c", pipe_buffer[i]);
-        }
-        printf("\n");
-    } else if (strncmp(cmd2, "sort", 4) == 0) {
-        // Ordenar líneas (implementación básica)
-        printf("Contenido ordenado (simulado):\n");
-        printf("%s\n", pipe_buffer);
-    } else if (strcmp(cmd2, "uniq") == 0) {
-        // Mostrar líneas únicas (implementación básica)
-        printf("Líneas únicas:\n");
-        printf("%s\n", pipe_buffer);
-    } else if (strncmp(cmd2, "cut ", 4) == 0) {
-        // Extraer campos (implementación básica)
-        printf("Campos extraídos:\n");
-        printf("%s\n", pipe_buffer);
-    } else {
-        printf("Error: Comando '%s' no soportado como destino de pipe\n", cmd2);
-        printf("Comandos soportados como salida: grep <patrón>, wc, head [n], tail [n], rev, sort, uniq, cut\n");
-        printf("Salida del primer comando:\n%s\n", pipe_buffer);
+    uint64_t end = rdtsc() + (uint64_t)atoi(arg) * tsc_khz();
+    prof_idle = 1;
+    while (rdtsc() < end && !break_requested()) {
+        net_poll();
+        idle_until(end);
     }
+    prof_idle = 0;
+    if (break_pending) printf("^C\n");
 }
 
+static void run_command(char *line);
+
 // Bucle principal del shell: lee y ejecuta comandos
 // Esta función implementa la lógica básica de cualquier intérprete de comandos
 static void shell_loop(void) {
@@ -1522,59 +1898,684 @@ static void shell_loop(void) {
         add_to_history(cmdbuf);
     }
     
-    // Verificar si hay pipe en el comando
-    char *pipe_pos = strchr(cmdbuf, '|');
-    if (pipe_pos) {
-        // Separar comandos por pipe
-        *pipe_pos = '\0';
-        char *cmd1 = cmdbuf;
-        char *cmd2 = pipe_pos + 1;
-        
-        // Limpiar espacios al inicio
-        while (*cmd1 == ' ') cmd1++;
-        while (*cmd2 == ' ') cmd2++;
-        
-        // Limpiar espacios al final de cmd1
-        char *end1 = cmd1 + strlen(cmd1) - 1;
-        while (end1 >= cmd1 && *end1 == ' ') {
-            *end1 = '\0';
-            end1--;
+    run_command(cmdbuf);
+}
+
+// =============================================================================
+// RUTAS
+// =============================================================================
+// basename (base = 1) y dirname (base = 0) de una ruta, como en POSIX: sólo
+// se mira el texto, así que la ruta no tiene por qué existir
+static void path_split(const char *path, int base) {
+    int len = strlen(path);
+    while (len > 1 && path[len - 1] == '/') len--;   // Barras finales
+    int slash = len - 1;
+    while (slash >= 0 && path[slash] != '/') slash--;
+    
+    int start = 0, end = len;
+    if (base) {
+        if (len > 1 || path[0] != '/') start = slash + 1;   // "/" es su propia base
+    } else if (slash < 0) {
+        path = ".";
+        end = 1;
+    } else {
+        end = slash;
+        while (end > 0 && path[end - 1] == '/') end--;
+        if (end == 0) end = 1;   // Cuelga del raíz
+    }
+    for (int i = start; i < end; i++) putchar(path[i]);
+    putchar('\n');
+}
+
+// =============================================================================
+// INTEGRIDAD (scrub)
+// =============================================================================
+// Zona del disco a la que pertenece un sector, para los informes
+static void print_sector_zone(uint32_t lba) {
+    if (lba < FAT_SECTOR) printf("arranque");
+    else if (lba < ROOT_SECTOR) printf("FAT");
+    else if (lba < DATA_SECTOR) printf("directorio raiz");
+    else printf("cluster %u", lba - DATA_SECTOR + 2);
+}
+
+static void scrub_command(void) {
+    fs_scrub_info info;
+    uint64_t t0 = rdtsc();
+    fs_scrub(&info);
+    uint64_t cycles = rdtsc() - t0;
+    
+    uint32_t us = (uint32_t)udiv64(cycles * 1000, tsc_khz());
+    uint32_t kb = info.sectors * (SECTOR_SIZE / 512) / 2;
+    printf("scrub: %u sectores (%u KB) en ", info.sectors, kb);
+    print_ms(cycles, 0);
+    printf(" ms, %u MB/s (crc32c %s)\n", (uint32_t)udiv64((uint64_t)kb * 1000000 / 1024, us ? us : 1),
+           crc32c_impl());
+    if (!info.errors) {
+        printf("scrub: sin errores\n");
+        return;
+    }
+    printf("scrub: %u sectores danados\n", info.errors);
+    for (uint32_t i = 0; i < info.errors && i < FS_SCRUB_BAD; i++) {
+        printf("  sector %u (", info.bad[i]);
+        print_sector_zone(info.bad[i]);
+        printf(")\n");
+    }
+    if (info.errors > FS_SCRUB_BAD) printf("  ...\n");
+}
+
+// =============================================================================
+// BÚSQUEDA EN EL DISCO (search, grep -r, index)
+// =============================================================================
+// search [-s] <termino> [dir]: rutas de los archivos que contienen el
+// término (por defecto en todo el disco) y lo que costó encontrarlas.
+// grep -r <patron> [dir]: las líneas, como grep, desde el directorio
+// actual. -s lee todos los archivos aunque el índice esté activado, para
+// comparar.
+static void search_command(char *arg, int flags) {
+    const char *usage = (flags & FS_SEARCH_LINES) ? "Uso: grep -r <patron> [directorio]\n"
+                                                  : "Uso: search [-s] <termino> [directorio]\n";
+    if (!strncmp(arg, "-s ", 3)) {
+        flags |= FS_SEARCH_SCAN;
+        arg += 3;
+    }
+    char *term = arg, *space = strchr(arg, ' ');
+    const char *dir = 0;
+    if (space) {
+        *space = '\0';
+        dir = space + 1;
+    }
+    if (!*term) {
+        printf("%s", usage);
+        return;
+    }
+    if (!dir && !(flags & FS_SEARCH_LINES)) dir = "/";
+    
+    fs_search_info info;
+    uint64_t t0 = rdtsc();
+    int r = fs_search(term, dir, flags, &info);
+    uint64_t cycles = rdtsc() - t0;
+    if (r < 0) {
+        printf("%s", usage);
+        return;
+    }
+    if (r == 0) {
+        printf("Directorio no encontrado: %s\n", dir);
+        return;
+    }
+    if (flags & FS_SEARCH_LINES) {
+        // Como grep: la salida puede ir a un pipe
+        if (!info.matches) printf("Patron '%s' no encontrado\n", term);
+        return;
+    }
+    printf("search: %u de %u archivos (%u leidos, %s) en ", info.matches, info.files,
+           info.candidates, info.indexed ? "con indice" : "sin indice");
+    print_ms(cycles, 0);
+    printf(" ms\n");
+}
+
+// index [on|off]: activa el índice de trigramas (construyéndolo) o muestra
+// su estado
+static void index_command(const char *arg) {
+    fs_index_stats st;
+    if (!strcmp(arg, "off")) {
+        fs_index_enable(0);
+        printf("index: desactivado\n");
+        return;
+    }
+    if (!strcmp(arg, "on")) {
+        uint64_t t0 = rdtsc();
+        fs_index_enable(1);
+        uint64_t cycles = rdtsc() - t0;
+        fs_index_get_stats(&st);
+        printf("index: %u archivos (%u KB) en ", st.docs, st.bytes / 1024);
+        print_ms(cycles, 0);
+        printf(" ms\n");
+    } else if (*arg) {
+        printf("Uso: index [on|off]\n");
+        return;
+    }
+    fs_index_get_stats(&st);
+    if (!st.enabled) {
+        printf("index: desactivado (index on para construirlo)\n");
+        return;
+    }
+    printf("index: %u archivos, %u KB, %u cubos de trigramas ocupados%s\n", st.docs,
+           st.bytes / 1024, st.buckets,
+           st.complete ? "" : " (incompleto: se leen los archivos que no caben)");
+    printf("  construcciones %u, anadidos %u, reindexados %u, olvidados %u, %u KB leidos\n",
+           st.builds, st.appends, st.rebuilds, st.forgets, st.scanned / 1024);
+}
+
+// =============================================================================
+// COMPRESIÓN (compress, decompress)
+// =============================================================================
+// Informa del tamaño antes y después, la razón de compresión y el caudal
+// (bytes sin comprimir por segundo) de la conversión
+static void compress_command(const char *name, int compress) {
+    fs_comp_info info;
+    uint64_t t0 = rdtsc();
+    int r = compress ? fs_compress(name, &info) : fs_decompress(name, &info);
+    uint64_t cycles = rdtsc() - t0;
+    
+    if (r == 0) printf("Archivo no encontrado: %s\n", name);
+    else if (r == -1) printf("Error: No hay espacio disponible\n");
+    else if (r == -2) printf("%s: %s\n", name, compress ? "ya esta comprimido" : "no esta comprimido");
+    else if (r == -3 && compress) printf("%s: comprimido no ahorra ningun cluster\n", name);
+    else if (r == -3) printf("%s: datos comprimidos danados\n", name);
+    if (r != 1) return;
+    
+    uint32_t ratio = info.stored ? (uint32_t)udiv64((uint64_t)info.size * 100, info.stored) : 0;
+    uint32_t us = (uint32_t)udiv64(cycles * 1000, tsc_khz());
+    uint32_t kbs = (uint32_t)udiv64((uint64_t)info.size * 1000000 / 1024, us ? us : 1);
+    printf("%s: %u bytes, %u comprimido (%u.%u%ux) en ", name, info.size, info.stored,
+           ratio / 100, ratio / 10 % 10, ratio % 10);
+    print_ms(cycles, 0);
+    printf(" ms, %u KB/s\n", kbs);
+}
+
+// =============================================================================
+// RED (netbench)
+// =============================================================================
+// netbench [paquetes] [bytes] [ext]: manda marcos Ethernet tan rápido como
+// admite el anillo, por lotes de NETBENCH_BATCH con un solo aviso a la
+// tarjeta. Por defecto la tarjeta está en loopback y se cuentan también los
+// que vuelven; con 'ext' salen de verdad (en QEMU, a la red de usuario, que
+// los descarta) y sólo se mide el envío. No hace falta red externa.
+#define NETBENCH_TYPE  0x88B5   // Tipo de Ethernet para experimentos locales
+#define NETBENCH_BATCH 16
+
+static uint32_t netbench_rx_packets, netbench_rx_bytes;
+
+// printf no rellena con ceros: "52:54:00:12:34:56"
+static void print_mac(const uint8_t *mac) {
+    static const char hex[] = "0123456789abcdef";
+    for (int i = 0; i < 6; i++) {
+        if (i) putchar(':');
+        putchar(hex[mac[i] >> 4]);
+        putchar(hex[mac[i] & 15]);
+    }
+}
+
+static void netbench_rx(netbuf *b) {
+    if (b->len >= 14 && b->data[12] == (NETBENCH_TYPE >> 8) && b->data[13] == (NETBENCH_TYPE & 0xFF)) {
+        netbench_rx_packets++;
+        netbench_rx_bytes += b->len;
+    }
+    netbuf_free(b);
+}
+
+static void netbench_rates(const char *what, uint32_t packets, uint32_t bytes, uint32_t us) {
+    if (!us) us = 1;
+    printf("  %s %u paquetes, %u KB: %u paq/s, ", what, packets, bytes >> 10,
+           (uint32_t)udiv64((uint64_t)packets * 1000000, us));
+    print_u64(udiv64((uint64_t)bytes * 10, us), 1, 0);   // bytes/us = MB/s
+    printf(" MB/s\n");
+}
+
+static void netbench_command(char *args) {
+    if (!e1000_present()) {
+        printf("netbench: no hay tarjeta de red (en QEMU: -device e1000)\n");
+        return;
+    }
+    uint32_t count = 10000, size = 1514;
+    int ext = 0, n = 0;
+    for (char *tok = strtok(args, " "); tok; tok = strtok(0, " ")) {
+        if (!strcmp(tok, "ext")) ext = 1;
+        else if (n++ == 0) count = atoi(tok);
+        else size = atoi(tok);
+    }
+    if (size < 60) size = 60;            // Mínimo de Ethernet sin el CRC
+    if (size > 1514) size = 1514;
+    
+    e1000_loopback(!ext);
+    while (e1000_poll(netbench_rx, 64));   // Lo que hubiera pendiente no cuenta
+    netbench_rx_packets = netbench_rx_bytes = 0;
+    e1000_stats before, after;
+    e1000_get_stats(&before);
+    
+    const uint8_t *mac = e1000_mac();
+    uint32_t sent = 0;
+    uint64_t t0 = rdtsc(), progress = t0;
+    uint64_t patience = (uint64_t)tsc_khz() * 500;   // Medio segundo sin avances: se abandona
+    while (sent < count || (!ext && netbench_rx_packets < sent) || e1000_tx_pending()) {
+        uint32_t batch = 0;
+        while (batch < NETBENCH_BATCH && sent < count) {
+            netbuf *b = netbuf_alloc();
+            if (!b) break;
+            // Destino: ella misma en loopback, difusión si sale fuera
+            for (int i = 0; i < 6; i++) {
+                b->data[i] = ext ? 0xFF : mac[i];
+                b->data[6 + i] = mac[i];
+            }
+            b->data[12] = NETBENCH_TYPE >> 8;
+            b->data[13] = NETBENCH_TYPE & 0xFF;
+            memcpy(b->data + 14, &sent, 4);
+            b->len = size;
+            if (!e1000_send(b)) {
+                netbuf_free(b);
+                break;
+            }
+            sent++;
+            batch++;
+        }
+        e1000_flush();
+        uint32_t got = e1000_poll(netbench_rx, 64);
+        uint64_t now = rdtsc();
+        if (batch || got) progress = now;
+        else if (now - progress > patience) break;
+        if (break_requested()) break;
+    }
+    uint64_t cycles = rdtsc() - t0;
+    e1000_get_stats(&after);
+    
+    uint32_t us = (uint32_t)udiv64(cycles * 1000, tsc_khz());
+    uint32_t tx = after.tx_packets - before.tx_packets;
+    printf("netbench: %u paquetes de %u bytes (%s) en ", sent, size, ext ? "red externa" : "loopback");
+    print_ms(cycles, 0);
+    printf(" ms\n");
+    netbench_rates("enviados: ", tx, after.tx_bytes - before.tx_bytes, us);
+    if (!ext) {
+        netbench_rates("recibidos:", netbench_rx_packets, netbench_rx_bytes, us);
+        if (netbench_rx_packets < sent) printf("  perdidos: %u\n", sent - netbench_rx_packets);
+    }
+    printf("  avisos a la tarjeta: %u TDT, %u RDT; %u interrupciones; anillo lleno %u veces\n",
+           after.tx_doorbells - before.tx_doorbells, after.rx_doorbells - before.rx_doorbells,
+           after.irqs - before.irqs, after.tx_full - before.tx_full);
+    e1000_loopback(0);
+}
+
+// =============================================================================
+// RED: IP Y UDP (ping, udpecho, udpsend, ifconfig)
+// =============================================================================
+// La pila está en net.c; aquí sólo están las órdenes. Con la red de usuario
+// de QEMU la máquina es 10.0.2.15 y la puerta de enlace, 10.0.2.2, contesta
+// a los ecos y lleva lo que se le mande al 127.0.0.1 del anfitrión.
+#define UDP_ECHO_PORT  7
+#define UDP_SEND_PORT  5556
+
+static void print_ip(uint32_t ip) {
+    char buf[16];
+    net_format_ip(ip, buf);
+    printf("%s", buf);
+}
+
+static int net_required(const char *cmd) {
+    if (net_up()) return 1;
+    printf("%s: no hay tarjeta de red (en QEMU: -device e1000)\n", cmd);
+    return 0;
+}
+
+// Espera como mucho un segundo a conocer la MAC del siguiente salto,
+// preguntando cada cuarto de segundo
+static int net_wait_route(uint32_t ip) {
+    uint64_t quarter = (uint64_t)tsc_khz() * 250, asked = 0;
+    for (int tries = 0; !net_route_ready(ip); ) {
+        uint64_t now = rdtsc();
+        if (!asked || now - asked > quarter) {
+            if (tries++ == 4) return 0;
+            net_arp_request(ip);
+            asked = now;
+        }
+        net_poll();
+        if (break_requested()) return 0;
+        if (!net_route_ready(ip)) idle_until(asked + quarter);
+    }
+    return 1;
+}
+
+// ping [ip] [n] [bytes]: ecos ICMP seguidos, cada uno al llegar la
+// respuesta del anterior (o al pasar un segundo)
+static void ping_command(char *args) {
+    if (!net_required("ping")) return;
+    net_config cfg;
+    net_get_config(&cfg);
+    uint32_t ip = cfg.gateway, count = 4, size = 56;
+    int n = 0;
+    for (char *tok = strtok(args, " "); tok; tok = strtok(0, " ")) {
+        if (strchr(tok, '.')) {
+            if (!net_parse_ip(tok, &ip)) {
+                printf("ping: direccion incorrecta: %s\n", tok);
+                return;
+            }
+        } else if (n++ == 0) count = atoi(tok);
+        else size = atoi(tok);
+    }
+    if (size > NET_UDP_MAX) size = NET_UDP_MAX;
+    if (!net_wait_route(ip)) {
+        printf("ping: ");
+        print_ip(ip);
+        printf(" no responde a ARP\n");
+        return;
+    }
+    printf("PING ");
+    print_ip(ip);
+    printf(": %u bytes de datos\n", size);
+
+    uint64_t second = (uint64_t)tsc_khz() * 1000;
+    uint64_t min = ~0ull, max = 0, total = 0;
+    uint32_t sent = 0, received = 0;
+    for (uint32_t seq = 1; seq <= count && !break_requested(); seq++) {
+        uint64_t t0 = rdtsc(), when;
+        uint8_t ttl;
+        if (!net_ping(ip, seq, size)) {
+            printf("ping: no quedan buffers\n");
+            break;
+        }
+        sent++;
+        while (!net_ping_reply(seq, &when, &ttl) && rdtsc() - t0 < second && !break_requested()) {
+            net_poll();
+            idle_until(t0 + second);
+        }
+        if (!net_ping_reply(seq, &when, &ttl)) {
+            if (!break_pending) printf("seq=%u: sin respuesta\n", seq);
+            continue;
         }
-        
-        // Limpiar espacios al final de cmd2
-        char *end2 = cmd2 + strlen(cmd2) - 1;
-        while (end2 >= cmd2 && *end2 == ' ') {
-            *end2 = '\0';
-            end2--;
+        uint64_t rtt = when - t0;
+        received++;
+        total += rtt;
+        if (rtt < min) min = rtt;
+        if (rtt > max) max = rtt;
+        printf("%u bytes de ", size + 8);
+        print_ip(ip);
+        printf(": seq=%u ttl=%u tiempo=", seq, ttl);
+        print_ms(rtt, 0);
+        printf(" ms\n");
+    }
+    if (break_pending) printf("^C\n");
+    printf("%u enviados, %u recibidos", sent, received);
+    if (received) {
+        printf("; tiempo min/media/max = ");
+        print_ms(min, 0);
+        printf("/");
+        print_ms(udiv64(total, received), 0);
+        printf("/");
+        print_ms(max, 0);
+        printf(" ms");
+    }
+    printf("\n");
+}
+
+// udpecho [puerto]: devuelve cada datagrama a quien lo mandó, en el mismo
+// netbuf en que llegó, hasta Ctrl+C. Desde el anfitrión, con 'make run-net':
+// nc -u localhost 5555
+static void udpecho_command(char *args) {
+    if (!net_required("udpecho")) return;
+    uint16_t port = args[0] ? atoi(args) : UDP_ECHO_PORT;
+    int s = udp_bind(port);
+    if (s < 0) {
+        printf("udpecho: el puerto %u esta ocupado\n", port);
+        return;
+    }
+    printf("udpecho: escuchando en el puerto %u (Ctrl+C para terminar)\n", port);
+    uint32_t datagrams = 0, bytes = 0;
+    while (!break_requested()) {
+        net_poll();
+        netbuf *b;
+        uint32_t ip;
+        uint16_t from;
+        while ((b = udp_recv(s, &ip, &from))) {
+            datagrams++;
+            bytes += b->len;
+            if (!net_route_ready(ip)) net_wait_route(ip);
+            udp_send(s, b, ip, from);
+        }
+        net_flush();
+        idle_until(0);
+    }
+    udp_close(s);
+    printf("^C\nudpecho: %u datagramas, %u bytes devueltos\n", datagrams, bytes);
+}
+
+// udpsend <archivo> [ip] [puerto]: manda el archivo en datagramas de
+// NET_UDP_MAX bytes leídos directamente sobre el netbuf que sale, por lotes
+// de NETBENCH_BATCH con un aviso a la tarjeta. Por defecto va al puerto
+// UDP_SEND_PORT del anfitrión: nc -lu 5556 > copia. UDP no reenvía nada:
+// si el que recibe no da abasto, faltarán trozos.
+static void udpsend_command(char *args) {
+    if (!net_required("udpsend")) return;
+    net_config cfg;
+    net_get_config(&cfg);
+    char *name = strtok(args, " ");
+    char *ip_text = strtok(0, " ");
+    char *port_text = strtok(0, " ");
+    uint32_t ip = cfg.gateway;
+    uint16_t port = port_text ? atoi(port_text) : UDP_SEND_PORT;
+    if (!name || (ip_text && !net_parse_ip(ip_text, &ip))) {
+        printf("Uso: udpsend <archivo> [ip] [puerto]\n");
+        return;
+    }
+    int fd = fs_open(name, O_RDONLY);
+    if (fd < 0) {
+        printf("udpsend: no existe %s\n", name);
+        return;
+    }
+    int s = udp_bind(0);
+    if (s < 0 || !net_wait_route(ip)) {
+        printf("udpsend: ");
+        print_ip(ip);
+        printf(" no responde a ARP\n");
+        if (s >= 0) udp_close(s);
+        fs_close(fd);
+        return;
+    }
+    uint32_t datagrams = 0, bytes = 0, batch = 0;
+    uint64_t t0 = rdtsc();
+    while (!break_requested()) {
+        netbuf *b = udp_alloc();
+        if (!b) {
+            net_poll();   // Recoge los que ya salieron
+            continue;
+        }
+        int n = fs_fread(fd, netbuf_payload(b), NET_UDP_MAX);
+        if (n <= 0) {
+            netbuf_free(b);
+            break;
+        }
+        b->len = n;
+        if (!udp_send(s, b, ip, port)) break;
+        datagrams++;
+        bytes += n;
+        if (++batch == NETBENCH_BATCH) {
+            net_flush();
+            batch = 0;
+        }
+    }
+    net_flush();
+    while (e1000_tx_pending() && !break_requested());
+    uint64_t cycles = rdtsc() - t0;
+    udp_close(s);
+    fs_close(fd);
+    if (break_pending) printf("^C\n");
+    uint32_t us = (uint32_t)udiv64(cycles * 1000, tsc_khz());
+    printf("udpsend: %u bytes en %u datagramas a ", bytes, datagrams);
+    print_ip(ip);
+    printf(":%u en ", port);
+    print_ms(cycles, 0);
+    printf(" ms (");
+    print_u64(udiv64((uint64_t)bytes * 10, us ? us : 1), 1, 0);
+    printf(" MB/s)\n");
+}
+
+// ifconfig [ip [mascara [puerta]]]: muestra o cambia la configuración
+static void ifconfig_command(char *args) {
+    if (!net_required("ifconfig")) return;
+    net_config cfg;
+    net_get_config(&cfg);
+    char *tok = strtok(args, " ");
+    if (tok) {
+        uint32_t *field[3] = { &cfg.ip, &cfg.mask, &cfg.gateway };
+        for (int i = 0; tok && i < 3; i++, tok = strtok(0, " ")) {
+            if (!net_parse_ip(tok, field[i])) {
+                printf("ifconfig: direccion incorrecta: %s\n", tok);
+                return;
+            }
         }
+        net_set_config(&cfg);
+    }
+    printf("e1000 ");
+    print_mac(e1000_mac());
+    printf(": ");
+    print_ip(cfg.ip);
+    printf(" mascara ");
+    print_ip(cfg.mask);
+    printf(" puerta de enlace ");
+    print_ip(cfg.gateway);
+    printf("\n");
+    for (int i = 0; i < NET_ARP_ENTRIES; i++) {
+        uint32_t ip;
+        uint8_t mac[6];
+        if (!net_arp_entry(i, &ip, mac)) continue;
+        printf("  arp ");
+        print_ip(ip);
+        printf(" -> ");
+        print_mac(mac);
+        printf("\n");
+    }
+    net_stats ns;
+    net_get_stats(&ns);
+    printf("  ip: %u recibidos, %u enviados, %u incorrectos, %u fragmentos descartados\n",
+           ns.ip_in, ns.ip_out, ns.ip_bad, ns.ip_frag);
+    printf("  arp: %u recibidos, %u enviados, %u paquetes perdidos esperando\n",
+           ns.arp_in, ns.arp_out, ns.arp_drops);
+    printf("  icmp: %u recibidos, %u enviados\n", ns.icmp_in, ns.icmp_out);
+    printf("  udp: %u recibidos, %u enviados, %u incorrectos, %u sin socket, %u con la cola llena\n",
+           ns.udp_in, ns.udp_out, ns.udp_bad, ns.udp_noport, ns.udp_overflow);
+    printf("  buffers libres: %u de %u\n", netbuf_available(), NETBUF_COUNT);
+}
+
+// =============================================================================
+// REDIRECCIONES (>, >>, <)
+// =============================================================================
+// Van al final de la línea y se aplican a toda ella, pipes incluidos:
+//     grep hola notas.txt > res.txt      ls >> lista.txt      cat < a > b
+// La salida va directa al archivo (ver putchar) y la entrada del comando,
+// lo que lee con getchar_stub, sale del archivo y acaba con Ctrl+D.
+// Separa las redirecciones del final de 'line'. Devuelve 0 si no hay, 1 si
+// las hay y -1 si están mal escritas (falta el archivo o sobra algo).
+static int parse_redirects(char *line, char **out, int *append, char **in) {
+    char *p = line;
+    while (*p && *p != '>' && *p != '<') p++;
+    if (!*p) return 0;
+    
+    char *end = p;
+    while (end > line && end[-1] == ' ') end--;
+    char op = *p;
+    *end = '\0';
+    *out = *in = 0;
+    *append = 0;
+    while (op) {
+        p++;
+        int app = op == '>' && *p == '>';
+        if (app) p++;
+        while (*p == ' ') p++;
+        char *name = p;
+        while (*p && *p != ' ' && *p != '>' && *p != '<') p++;
+        if (p == name) return -1;
+        char next = *p;
+        *p = '\0';
+        if (op == '<') *in = name;
+        else { *out = name; *append = app; }
         
-        // Validar que ambos comandos no estén vacíos
-        if (strlen(cmd1) == 0) {
-            printf("Error: Comando vacío antes del pipe\n");
-            return;
+        if (next == '>' || next == '<') {
+            op = next;   // Pegado al nombre: 'p' está sobre él
+        } else {
+            if (next) p++;
+            while (*p == ' ') p++;
+            if (*p && *p != '>' && *p != '<') return -1;
+            op = *p;
         }
-        if (strlen(cmd2) == 0) {
-            printf("Error: Comando vacío después del pipe\n");
+    }
+    return 1;
+}
+
+static void run_redirected(char *line, const char *out, int append, const char *in) {
+    int depth = input_depth;
+    if (in) {
+        int r = input_push_file(in, 0);
+        if (r == -1) { printf("Archivo no encontrado: %s\n", in); return; }
+        if (r == -2) { printf("Demasiadas fuentes de entrada anidadas\n"); return; }
+        input_stack[input_depth - 1].redirect = 1;
+    }
+    
+    int prev_fd = output_fd, prev_short = output_short;
+    if (out) {
+        int fd = fs_open(out, O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC));
+        if (fd < 0) {
+            printf("No se puede escribir en: %s\n", out);
+            while (input_depth > depth) input_pop();
             return;
         }
-        
-        // Ejecutar pipe simple
-        execute_pipe(cmd1, cmd2);
+        if (prev_fd >= 0) output_flush();
+        output_fd = fd;
+        output_short = 0;
+    }
+    
+    execute_command(line);
+    
+    if (out) {
+        output_flush();
+        fs_close(output_fd);
+        output_fd = prev_fd;
+        if (output_short) printf("%s: disco lleno, la salida esta incompleta\n", out);
+        output_short = prev_short;
+    }
+    while (input_depth > depth) input_pop();
+}
+
+// Interpreta y ejecuta una línea de comando (modifica 'line' al separarla)
+static void execute_command(char *line) {
+    // 'time <comando>' mide el resto de la línea
+    if (!strncmp(line, "time ", 5)) {
+        time_command(line + 5);
+        return;
+    }
+    
+    char *out, *in;
+    int append;
+    int r = parse_redirects(line, &out, &append, &in);
+    if (r < 0) {
+        printf("Redireccion incorrecta: cada '>', '>>' o '<' lleva un archivo\n");
+        return;
+    }
+    if (r) {
+        run_redirected(line, out, append, in);
+        return;
+    }
+    
+    // Los comandos de edición por líneas acumulan cambios en memoria;
+    // cualquier otro comando ve el archivo ya actualizado en el disco
+    if (strncmp(line, "edln ", 5) && strncmp(line, "delln ", 6) && strncmp(line, "insln ", 6)) {
+        edit_sync();
+    }
+    
+    // Pipes; 'yes' también va por ahí, para que Ctrl+C lo pare
+    if (strchr(line, '|') || !strcmp(line, "yes") || !strncmp(line, "yes ", 4)) {
+        execute_pipe(line);
         return;
     }
     
     // Separar comando de argumentos (por el primer espacio)
-    char *cmd = cmdbuf, *arg = strchr(cmd, ' ');
+    char *cmd = line, *arg = strchr(cmd, ' ');
     if (arg) { 
         *arg = '\0';  // Terminar el comando
         arg++;        // Apuntar al primer argumento
     }
     
     // Interpretar y ejecutar los comandos
-    if (!strcmp(cmd,"ls")) fs_ls();
+    if (!strcmp(cmd,"ls")) fs_ls(arg);
     else if (!strcmp(cmd,"cat") && arg) {
-        uint8_t buf[SECTOR_SIZE]; uint32_t sz;
-        if (fs_read(arg, buf, &sz)) for (uint32_t i=0;i<sz;i++) putchar(buf[i]);
+        int fd = fs_open(arg, O_RDONLY);
+        if (fd >= 0) {
+            uint8_t buf[SECTOR_SIZE]; int sz;
+            while ((sz = fs_fread(fd, buf, sizeof(buf))) > 0) {
+                for (int i=0;i<sz;i++) putchar(buf[i]);
+            }
+            fs_close(fd);
+        }
+    } else if (!strcmp(cmd,"cat")) {
+        // Sin archivo: copia la entrada (teclado o '<') hasta Ctrl+D
+        unsigned char c;
+        while ((c = getchar_stub()) != 0x04) putchar(c);
     } else if (!strcmp(cmd,"echo") && arg) { prints(arg); putchar('\n'); }
     else if (!strcmp(cmd,"touch") && arg) fs_touch(arg);
     else if (!strcmp(cmd,"cp") && arg) {
@@ -1582,40 +2583,33 @@ static void shell_loop(void) {
         char *dst = strchr(arg,' '); 
         if (dst) { 
             *dst=0; dst++; 
-            uint8_t buf2[SECTOR_SIZE]; uint32_t sz2; 
-            if(fs_read(arg,buf2,&sz2)) {
-                fs_write(dst,buf2,sz2);  // fs_write creará el archivo si no existe
-                printf("Archivo copiado: %s -> %s\n", arg, dst);
-            } else {
-                printf("Archivo no encontrado: %s\n", arg);
-            }
+            fs_cp(arg, dst);  // Crea el destino si no existe
         }
     } else if (!strcmp(cmd,"copy") && arg) {
         // Alias del comando cp para compatibilidad con MS-DOS
         char *dst = strchr(arg,' '); 
         if (dst) { 
             *dst=0; dst++; 
-            uint8_t buf2[SECTOR_SIZE]; uint32_t sz2; 
-            if(fs_read(arg,buf2,&sz2)) {
-                fs_write(dst,buf2,sz2);  // fs_write creará el archivo si no existe
-                printf("Archivo copiado: %s -> %s\n", arg, dst);
-            } else {
-                printf("Archivo no encontrado: %s\n", arg);
-            }
+            fs_cp(arg, dst);  // Crea el destino si no existe
         }
     } else if (!strcmp(cmd,"mv") && arg) {
         // Comando mv: renombrar/mover archivo
         char *dst = strchr(arg,' '); 
         if (dst) { 
             *dst=0; dst++; 
-            fat16_dir_entry e; int idx;
-            if (fs_find(arg, &e, &idx)) {
-                fs_mv(arg,dst);
+            int r = fs_mv(arg, dst);
+            if (r > 0) {
                 printf("Archivo renombrado: %s -> %s\n", arg, dst);
-            } else {
+            } else if (r == 0) {
                 printf("Archivo no encontrado: %s\n", arg);
+            } else {
+                printf("mv: destino no valido: %s\n", dst);
             }
         }
+    } else if (!strcmp(cmd,"compress") && arg) {
+        compress_command(arg, 1);
+    } else if (!strcmp(cmd,"decompress") && arg) {
+        compress_command(arg, 0);
     } else if (!strcmp(cmd,"delete") && arg) {
         // Comando delete: eliminar archivo
         fs_delete(arg);
@@ -1651,10 +2645,17 @@ static void shell_loop(void) {
         fs_write(arg, buf3, i);
         printf("Archivo creado: %s (%d bytes)\n", arg, i);
     } else if (!strcmp(cmd,"clear") || !strcmp(cmd,"cls")) clear_screen();
-    else if (!strcmp(cmd,"free")) {
-        uint32_t used = (TOTAL_SECTORS*SECTOR_SIZE)/1024;
-        printf("RAM libre: %u KB\n", used);
-    } else if (!strcmp(cmd,"help")||!strcmp(cmd,"?")) {
+    else if (!strcmp(cmd,"free")) free_command();
+    else if (!strcmp(cmd,"stats")) stats_command();
+    else if (!strcmp(cmd,"cpuinfo")) cpuinfo_command(arg ? arg : "");
+    else if (!strcmp(cmd,"scrub")) scrub_command();
+    else if (!strcmp(cmd,"search")) search_command(arg ? arg : "", 0);
+    else if (!strcmp(cmd,"index")) index_command(arg ? arg : "");
+    else if (!strcmp(cmd,"ping")) ping_command(arg ? arg : "");
+    else if (!strcmp(cmd,"udpecho")) udpecho_command(arg ? arg : "");
+    else if (!strcmp(cmd,"udpsend")) udpsend_command(arg ? arg : "");
+    else if (!strcmp(cmd,"ifconfig")) ifconfig_command(arg ? arg : "");
+    else if (!strcmp(cmd,"netbench")) netbench_command(arg ? arg : ""); else if (!strcmp(cmd,"help")||!strcmp(cmd,"?")) {
         show_help_with_pause();
     } else if (!strcmp(cmd, "edln") && arg) {
         // Comando edln: editar línea específica de un archivo
@@ -1750,6 +2751,9 @@ static void shell_loop(void) {
     } else if (!strcmp(cmd, "wc") && arg) {
         // Comando wc: contar líneas, palabras y caracteres
         fs_wc(arg);
+    } else if (!strcmp(cmd, "grep") && arg && !strncmp(arg, "-r ", 3)) {
+        // grep -r: en todos los archivos de un directorio y sus subdirectorios
+        search_command(arg + 3, FS_SEARCH_LINES);
     } else if (!strcmp(cmd, "grep") && arg) {
         // Comando grep: buscar patrón en archivo
         char *pattern = arg;
@@ -1784,38 +2788,58 @@ static void shell_loop(void) {
         }
         fs_tail(filename, lines);
     } else if (!strcmp(cmd, "mkdir") && arg) {
-        // Comando mkdir: crear directorio simulado
+        // Comando mkdir: crear un subdirectorio
         fs_mkdir(arg);
+    } else if (!strcmp(cmd, "cd")) {
+        // Comando cd: cambiar de directorio (sin argumento, al raíz)
+        if (!fs_chdir(arg ? arg : "/")) printf("cd: %s: directorio no encontrado\n", arg);
     } else if (!strcmp(cmd, "pwd")) {
         // Comando pwd: mostrar directorio actual
-        printf("/root\n");
+        char path[FS_PATH_MAX];
+        fs_getcwd(path, sizeof(path));
+        printf("%s\n", path);
     } else if (!strcmp(cmd, "whoami")) {
         // Comando whoami: mostrar usuario actual
         printf("root\n");
     } else if (!strcmp(cmd, "uname")) {
         // Comando uname: información del sistema
         printf("r2os 1.0 i686 mini-kernel educativo\n");
+    } else if (!strcmp(cmd, "bench")) {
+        // Comando bench: banco de pruebas de rendimiento
+        bench_command(arg);
+    } else if (!strcmp(cmd, "prof")) {
+        // Comando prof: perfilador por muestreo
+        prof_command(arg);
+    } else if (!strcmp(cmd, "trace")) {
+        // Comando trace: traza de eventos del kernel
+        trace_command(arg);
+    } else if (!strcmp(cmd, "source") && arg) {
+        // Comando source: las líneas del archivo se leen como si se tecleasen
+        int r = input_push_file(arg, 0);
+        if (r == -1) printf("Archivo no encontrado: %s\n", arg);
+        else if (r == -2) printf("source: demasiados scripts anidados (maximo %u)\n", INPUT_DEPTH);
+    } else if (!strcmp(cmd, "record")) {
+        // Comando record: grabar las teclas con sus tiempos
+        record_command(arg);
+    } else if (!strcmp(cmd, "replay") && arg) {
+        // Comando replay: reproducir una grabación; con "real", con sus pausas
+        char *file = strtok(arg, " ");
+        char *mode = strtok(0, " ");
+        int r = input_push_file(file, mode && !strcmp(mode, "real") ? 2 : 1);
+        if (r == -1) printf("Archivo no encontrado: %s\n", file);
+        else if (r == -2) printf("replay: demasiadas fuentes anidadas (maximo %u)\n", INPUT_DEPTH);
+    } else if (!strcmp(cmd, "exit")) {
+        // Comando exit: apagar QEMU (isa-debug-exit), para ejecuciones sin nadie
+        outb(DEBUG_EXIT_PORT, arg ? atoi(arg) : 0);
+        printf("isa-debug-exit no disponible (falta -device isa-debug-exit)\n");
     } else if (!strcmp(cmd, "uptime")) {
-        // Comando uptime: tiempo de funcionamiento (simulado)
-        printf("Sistema funcionando correctamente\n");
+        // Comando uptime: tiempo desde el arranque, medido con el TSC
+        uptime_command();
+    } else if (!strcmp(cmd, "sleep")) {
+        sleep_command(arg);
     } else if (!strcmp(cmd, "date")) {
         // Comando date: fecha actual (simulada)
         printf("Lun Dic  1 12:00:00 UTC 2024\n");
-    } else if (!strcmp(cmd, "cal")) {
-        // Comando cal: calendario simple
-        printf("   Diciembre 2024\n");
-        printf("Do Lu Ma Mi Ju Vi Sa\n");
-        printf(" 1  2  3  4  5  6  7\n");
-        printf(" 8  9 10 11 12 13 14\n");
-        printf("15 16 17 18 19 20 21\n");
-        printf("22 23 24 25 26 27 28\n");
-        printf("29 30 31\n");
-    } else if (!strcmp(cmd, "yes") && arg) {
-        // Comando yes: repetir texto (limitado)
-        for (int i = 0; i < 10; i++) {
-            printf("%s\n", arg);
-        }
-        printf("(limitado a 10 repeticiones)\n");
     } else if (!strcmp(cmd, "rev") && arg) {
         // Comando rev: invertir texto
         int len = strlen(arg);
@@ -1827,7 +2851,7 @@ static void shell_loop(void) {
         // Comando sort: mostrar contenido ordenado (simple)
         uint8_t buffer[SECTOR_SIZE];
         uint32_t file_size = 0;
-        if (fs_read(arg, buffer, &file_size)) {
+        if (fs_read(arg, buffer, sizeof(buffer), &file_size)) {
             printf("Contenido de %s (simulacion de sort):\n", arg);
             for (uint32_t i = 0; i < file_size; i++) {
                 putchar(buffer[i]);
@@ -1851,11 +2875,12 @@ static void shell_loop(void) {
         // Comando file: tipo de archivo
         uint8_t buffer[16];
         uint32_t file_size = 0;
-        if (fs_read(arg, buffer, &file_size)) {
+        fat16_dir_entry e; int idx;
+        if (fs_find(arg, &e, &idx) && (e.attr & FAT_ATTR_DIRECTORY)) {
+            printf("%s: directorio\n", arg);
+        } else if (fs_read(arg, buffer, sizeof(buffer), &file_size)) {
             if (file_size == 0) {
                 printf("%s: archivo vacio\n", arg);
-            } else if (buffer[0] == '[' && buffer[file_size-1] == ']') {
-                printf("%s: directorio simulado\n", arg);
             } else {
                 printf("%s: archivo de texto ASCII\n", arg);
             }
@@ -1864,10 +2889,9 @@ static void shell_loop(void) {
         }
     } else if (!strcmp(cmd, "du") && arg) {
         // Comando du: uso de disco
-        uint8_t buffer[SECTOR_SIZE];
-        uint32_t file_size = 0;
-        if (fs_read(arg, buffer, &file_size)) {
-            printf("%u\t%s\n", (file_size + 511) / 512, arg);  // En sectores
+        fat16_dir_entry e; int idx;
+        if (fs_find(arg, &e, &idx)) {
+            printf("%u\t%s\n", (e.size + 511) / 512, arg);  // En sectores
         } else {
             printf("0\t%s (no encontrado)\n", arg);
         }
@@ -1878,16 +2902,17 @@ static void shell_loop(void) {
             printf("Archivo: %s\n", arg);
             printf("Tamaño: %u bytes\n", e.size);
             printf("Cluster: %u\n", e.first_cluster);
-            printf("Tipo: archivo regular\n");
+            printf("Tipo: %s\n", (e.attr & FAT_ATTR_DIRECTORY) ? "directorio" :
+                   (e.reserved[0] & FAT_FLAG_COMPRESSED) ? "archivo comprimido" : "archivo regular");
         } else {
             printf("stat: %s: archivo no encontrado\n", arg);
         }
     } else if (!strcmp(cmd, "basename") && arg) {
-        // Comando basename: nombre base de archivo
-        printf("%s\n", arg);  // Simplificado, no hay rutas
+        // Comando basename: último componente de la ruta
+        path_split(arg, 1);
     } else if (!strcmp(cmd, "dirname") && arg) {
-        // Comando dirname: directorio de archivo
-        printf(".\n");  // Simplificado, todo en directorio actual
+        // Comando dirname: la ruta sin su último componente
+        path_split(arg, 0);
     } else if (!strcmp(cmd, "tee") && arg) {
         // Comando tee: escribir a archivo y pantalla
         printf("Escriba texto (Ctrl+D para terminar):\n");
@@ -1926,7 +2951,9 @@ static void shell_loop(void) {
         } else if (!strcmp(arg, "grep")) {
             printf("MANUAL: grep\n");
             printf("Uso: grep <patron> <archivo>\n");
-            printf("Descripcion: Busca un patron de texto en un archivo\n");
+            printf("     grep -r <patron> [directorio]\n");
+            printf("Descripcion: Busca un patron de texto en un archivo, o con -r en\n");
+            printf("todos los archivos bajo un directorio (por defecto el actual)\n");
             printf("Ejemplo: grep hola test.txt\n");
         } else if (!strcmp(arg, "head")) {
             printf("MANUAL: head\n");
@@ -2021,26 +3048,260 @@ static void shell_loop(void) {
                 printf("No se detectó el caracter pipe en: %s\n", test_input);
             }
         }
-    } else if (strlen(cmd) > 0) {
+    } else if (strlen(cmd) > 0 && !run_program(cmd, arg)) {
         printf("comando no encontrado: %s\n",cmd);
     }
 }
 
+// Ejecuta un comando entre sus dos puntos de traza. Los eventos llevan el
+// número de comando y sus primeros 4 caracteres para reconocerlo en la traza.
+// También suma su duración a la cuenta del comando (ver 'stats').
+static void run_command(char *line) {
+    char name[12];
+    int len = 0;
+    while (*line == ' ') line++;
+    while (len < (int)sizeof(name) - 1 && line[len] && line[len] != ' ') {
+        name[len] = line[len];
+        len++;
+    }
+    name[len] = '\0';
+    if (!len) return;
+    uint32_t tag = 0;
+    for (int i = 0; i < 4 && name[i]; i++) tag |= (uint32_t)(uint8_t)name[i] << (8 * i);
+    uint32_t n = ++commands_run;
+    break_pending = 0;
+    
+    TRACE(TRACE_CMD_BEGIN, n, tag);
+    uint64_t t0 = rdtsc();
+    execute_command(line);
+    cmd_account(name, rdtsc() - t0);
+    TRACE(TRACE_CMD_END, n, tag);
+}
+
+// =============================================================================
+// INFORMACIÓN MULTIBOOT
+// =============================================================================
+// El cargador (GRUB o QEMU -kernel) deja en EAX el número mágico 0x2BADB002
+// y en EBX la dirección de esta estructura. boot.s nos pasa ambos valores.
+// Los módulos (qemu -initrd archivo) quedan cargados en memoria alineados a
+// página; los usamos para recibir una imagen de disco ya preparada.
+#define MULTIBOOT_BOOTLOADER_MAGIC 0x2BADB002
+#define MULTIBOOT_INFO_MEMORY      (1 << 0)
+#define MULTIBOOT_INFO_CMDLINE     (1 << 2)
+#define MULTIBOOT_INFO_MODS        (1 << 3)
+#define MULTIBOOT_INFO_FRAMEBUFFER (1 << 12)
+#define MULTIBOOT_FRAMEBUFFER_RGB  1
+
+typedef struct __attribute__((packed)) {
+    uint32_t mod_start;
+    uint32_t mod_end;
+    uint32_t string;     // Línea de comandos del módulo
+    uint32_t reserved;
+} multiboot_module;
+
+typedef struct __attribute__((packed)) {
+    uint32_t flags;
+    uint32_t mem_lower;
+    uint32_t mem_upper;
+    uint32_t boot_device;
+    uint32_t cmdline;
+    uint32_t mods_count;
+    uint32_t mods_addr;
+    uint32_t syms[4];
+    uint32_t mmap_length, mmap_addr;
+    uint32_t drives_length, drives_addr;
+    uint32_t config_table, boot_loader_name, apm_table;
+    uint32_t vbe_control_info, vbe_mode_info;
+    uint16_t vbe_mode, vbe_interface_seg, vbe_interface_off, vbe_interface_len;
+    // Modo gráfico que dejó el cargador (make VIDEO=...)
+    uint64_t framebuffer_addr;
+    uint32_t framebuffer_pitch, framebuffer_width, framebuffer_height;
+    uint8_t  framebuffer_bpp, framebuffer_type;
+    uint8_t  red_pos, red_size, green_pos, green_size, blue_pos, blue_size;
+} multiboot_info;
+
+// Primer bloque de 4 MiB libre para la ventana de los programas de usuario:
+// por encima del kernel y de todos los módulos. 0 si no cabe en la RAM.
+static uint32_t user_frame(uint32_t magic, const multiboot_info *mbi) {
+    uint32_t top = (uint32_t)(uintptr_t)_end;
+    if (magic == MULTIBOOT_BOOTLOADER_MAGIC && (mbi->flags & MULTIBOOT_INFO_MODS)) {
+        const multiboot_module *mods = (const multiboot_module *)(uintptr_t)mbi->mods_addr;
+        for (uint32_t i = 0; i < mbi->mods_count; i++) {
+            if (mods[i].mod_end > top) top = mods[i].mod_end;
+        }
+    }
+    top = (top + USER_SIZE - 1) & ~(USER_SIZE - 1);
+    if (!mem_upper_kb || top + USER_SIZE > 0x100000 + mem_upper_kb * 1024) return 0;
+    return top;
+}
+
+// Busca una imagen FAT16 entre los módulos y la monta sin copiarla
+static int mount_boot_module(uint32_t magic, const multiboot_info *mbi) {
+    if (magic != MULTIBOOT_BOOTLOADER_MAGIC || !(mbi->flags & MULTIBOOT_INFO_MODS)) return 0;
+    
+    const multiboot_module *mods = (const multiboot_module *)(uintptr_t)mbi->mods_addr;
+    for (uint32_t i = 0; i < mbi->mods_count; i++) {
+        uint8_t *base = (uint8_t *)(uintptr_t)mods[i].mod_start;
+        uint32_t size = mods[i].mod_end - mods[i].mod_start;
+        printf("Modulo %u: %u bytes en 0x%x\n", i, size, mods[i].mod_start);
+        if (fs_mount_image(base, size)) {
+            printf("Imagen FAT16 montada desde el modulo %u.\n", i);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Scripts de arranque: autorun.sh del disco y, después, los módulos cuyo
+// nombre acaba en ".sh" (qemu -initrd "disk.img,prueba.sh"), en orden. La
+// pila de fuentes de entrada se llena al revés: lo último apilado va antes.
+static void push_boot_scripts(uint32_t magic, const multiboot_info *mbi) {
+    if (magic == MULTIBOOT_BOOTLOADER_MAGIC && (mbi->flags & MULTIBOOT_INFO_MODS)) {
+        const multiboot_module *mods = (const multiboot_module *)(uintptr_t)mbi->mods_addr;
+        for (int i = mbi->mods_count - 1; i >= 0; i--) {
+            const char *name = (const char *)(uintptr_t)mods[i].string;
+            uint32_t len = name ? strlen(name) : 0;
+            if (len < 3 || strcmp(name + len - 3, ".sh")) continue;
+            if (input_push_mem((const uint8_t *)(uintptr_t)mods[i].mod_start, mods[i].mod_end - mods[i].mod_start)) break;
+            printf("Script del modulo %u: %s\n", i, name);
+        }
+    }
+    if (!input_push_file("autorun.sh", 0)) printf("Ejecutando autorun.sh\n");
+}
+
+// "video" o "video=ANCHOxALTO" al principio de la línea de comandos (tras
+// el nombre del kernel). Retorna lo que sigue, o NULL si no está.
+static const char *cmdline_video(uint32_t magic, const multiboot_info *mbi, uint32_t *w, uint32_t *h) {
+    if (magic != MULTIBOOT_BOOTLOADER_MAGIC || !(mbi->flags & MULTIBOOT_INFO_CMDLINE)) return 0;
+    const char *args = strchr((const char *)(uintptr_t)mbi->cmdline, ' ');
+    if (!args) return 0;
+    while (*args == ' ') args++;
+    if (strncmp(args, "video", 5) || (args[5] != ' ' && args[5] != '=' && args[5] != '\0')) return 0;
+    args += 5;
+    *w = VIDEO_DEFAULT_W;
+    *h = VIDEO_DEFAULT_H;
+    if (*args == '=') {
+        const char *x = strchr(args, 'x');
+        if (x) {
+            *w = atoi(args + 1);
+            *h = atoi(x + 1);
+        }
+        while (*args && *args != ' ') args++;
+    }
+    while (*args == ' ') args++;
+    return args;
+}
+
+// Pasa la consola a un framebuffer si el cargador dejó uno de 32 bits o se
+// pidió con "video"; si no, sigue en modo texto
+static void console_init(uint32_t magic, const multiboot_info *mbi) {
+    uint32_t w, h;
+    int ok = 0;
+    if (magic == MULTIBOOT_BOOTLOADER_MAGIC && (mbi->flags & MULTIBOOT_INFO_FRAMEBUFFER) &&
+        mbi->framebuffer_type == MULTIBOOT_FRAMEBUFFER_RGB && mbi->framebuffer_bpp == 32 &&
+        !(mbi->framebuffer_addr >> 32)) {
+        fb_info info;
+        info.addr = (uint32_t)mbi->framebuffer_addr;
+        info.pitch = mbi->framebuffer_pitch;
+        info.width = mbi->framebuffer_width;
+        info.height = mbi->framebuffer_height;
+        info.red_pos = mbi->red_pos;
+        info.green_pos = mbi->green_pos;
+        info.blue_pos = mbi->blue_pos;
+        ok = fbcon_init(&info);
+    }
+    if (!ok && cmdline_video(magic, mbi, &w, &h)) ok = fbcon_bga(w, h);
+    if (ok) {
+        con_cells = fbcon_cells();
+        con_cols = fbcon_cols();
+        con_rows = fbcon_rows();
+        con_fb = 1;
+    }
+    con_frame = (uint64_t)tsc_khz() * CONSOLE_FRAME_MS;
+}
+
+// Línea de comandos del kernel (qemu -append "..."). Tras el nombre del
+// kernel (y "video", ver console_init) puede venir "serial", que copia la
+// consola al puerto serie para ejecuciones sin pantalla, y después
+// "bench ...", que ejecuta el banco de pruebas al arrancar.
+static void run_boot_cmdline(uint32_t magic, const multiboot_info *mbi) {
+    static char line[CMD_BUFSIZE];
+    if (magic != MULTIBOOT_BOOTLOADER_MAGIC || !(mbi->flags & MULTIBOOT_INFO_CMDLINE)) return;
+    
+    uint32_t w, h;
+    const char *cmdline = (const char *)(uintptr_t)mbi->cmdline;
+    const char *args = cmdline_video(magic, mbi, &w, &h);
+    if (!args) args = strchr(cmdline, ' ');  // Saltar el nombre del kernel
+    if (!args) return;
+    while (*args == ' ') args++;
+    
+    uint32_t len = strlen(args);
+    if (len >= sizeof(line)) len = sizeof(line) - 1;
+    memcpy(line, args, len);
+    line[len] = '\0';
+    char *rest = line;
+    if (!strncmp(rest, "serial", 6) && (rest[6] == ' ' || rest[6] == '\0')) {
+        console_mirror = 1;
+        rest += 6;
+        while (*rest == ' ') rest++;
+    }
+    if (!strncmp(rest, "bench", 5) && (rest[5] == ' ' || rest[5] == '\0')) {
+        bench_command(rest[5] ? rest + 6 : 0);
+    }
+}
+
 // =============================================================================
 // FUNCIÓN PRINCIPAL DEL KERNEL
 // =============================================================================
 // Esta es la función que se ejecuta cuando arranca el sistema operativo.
 // Inicializa la pantalla y entra en el bucle principal del shell.
-void kernel_main(void) {
-    // Limpiar pantalla al inicio
+void kernel_main(uint32_t magic, const multiboot_info *mbi) {
+    boot_tsc = rdtsc();
+    cpu_init();   // Antes que nada: elige memcpy, memset...
+    if (magic == MULTIBOOT_BOOTLOADER_MAGIC && (mbi->flags & MULTIBOOT_INFO_MEMORY)) {
+        mem_upper_kb = mbi->mem_upper;
+    }
+    
+    // Limpiar pantalla al inicio (o pasar al framebuffer)
+    console_init(magic, mbi);
     clear_screen();
+    serial_init();
+    interrupts_init();
+    idle_init();
     
     // Mensaje de bienvenida
     printf("Bienvenido al mini-kernel educativo!\n");
     printf("Inicializando sistema...\n\n");
+    if (con_fb) {
+        uint32_t w, h;
+        fbcon_size(&w, &h);
+        printf("Pantalla: %ux%u pixeles (%s), %ux%u caracteres\n", w, h, fbcon_source(), con_cols, con_rows);
+    }
+    
+    // Montar la imagen recibida como módulo o, si no hay, formatear el disco
+    if (!mount_boot_module(magic, mbi)) fs_init();
+    
+    // Paginación y ventana para los programas de /bin
+    uint32_t frame = user_frame(magic, mbi);
+    if (!frame || !proc_init(frame)) printf("Sin programas de usuario: no hay 4 MiB libres o la CPU no tiene PSE\n");
+    
+    // Tarjeta de red (QEMU trae una e1000 salvo con -nic none)
+    if (e1000_init()) {
+        printf("Red: e1000 ");
+        print_mac(e1000_mac());
+        if (e1000_irq_line() >= 0) printf(", IRQ %d", e1000_irq_line());
+        if (net_init()) {
+            net_config cfg;
+            net_get_config(&cfg);
+            printf(", IP ");
+            print_ip(cfg.ip);
+        }
+        printf("\n");
+    }
     
-    // Inicializar el sistema de archivos
-    fs_init();
+    // Órdenes pasadas en la línea de comandos del kernel
+    run_boot_cmdline(magic, mbi);
+    push_boot_scripts(magic, mbi);
     
     // Mostrar ayuda automáticamente al arrancar
     show_help();
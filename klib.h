@@ -0,0 +1,173 @@
+// klib.h: funciones básicas de biblioteca estándar para el kernel
+//
+// Las usan kernel.c, fs.c y text.c. Son static inline, así que cada archivo
+// tiene su propia copia y se pueden compilar también en el host (make
+// host-bench) sin chocar con las de libc.
+#ifndef KLIB_H
+#define KLIB_H
+
+#include <stdint.h>
+
+// =============================================================================
+// IMPLEMENTACIÓN BÁSICA DE FUNCIONES DE LIBRERÍA ESTÁNDAR
+// =============================================================================
+// Como estamos en modo freestanding (sin biblioteca C estándar), 
+// debemos implementar nuestras propias funciones básicas de manipulación 
+// de memoria y cadenas.
+// Copia n bytes desde src hacia dest
+// Es fundamental en cualquier sistema operativo para mover datos en memoria.
+// memcpy_bytes acumula lo copiado (lo muestran 'time' y 'stats'); se define
+// en kernel.c, o en host/platform.c para el host.
+extern uint64_t memcpy_bytes;
+
+// memcpy, memset y memchr llaman a la variante que cpu_init() (cpu.c) eligió
+// para esta CPU; en el host apuntan a las de libc (host/platform.c).
+extern void *(*memcpy_fn)(void *dest, const void *src, unsigned int n);
+extern void *(*memset_fn)(void *s, int c, unsigned int n);
+extern void *(*memchr_fn)(const void *s, int c, unsigned int n);
+
+static inline void *memcpy(void *dest, const void *src, unsigned int n) {
+    memcpy_bytes += n;
+    return memcpy_fn(dest, src, n);
+}
+static inline void *memset(void *s, int c, unsigned int n) {
+    return memset_fn(s, c, n);
+}
+// Primer byte igual a c entre los n primeros, o NULL
+static inline void *memchr(const void *s, int c, unsigned int n) {
+    return memchr_fn(s, c, n);
+}
+static inline int memcmp(const void *a, const void *b, unsigned int n) {
+    const unsigned char *p = a, *q = b;
+    for (unsigned int i = 0; i < n; i++) {
+        if (p[i] != q[i]) return p[i] - q[i];
+    }
+    return 0;
+}
+static inline unsigned int strlen(const char *s) {
+    unsigned int len = 0;
+    while (s[len]) len++;
+    return len;
+}
+static inline char *strchr(const char *s, int c) {
+    for (; *s; s++) if (*s == (char)c) return (char *)s;
+    return 0;
+}
+static inline int strcmp(const char *a, const char *b) {
+    while (*a && (*a == *b)) { a++; b++; }
+    return (unsigned char)*a - (unsigned char)*b;
+}
+static inline char *strstr(const char *haystack, const char *needle) {
+    if (!*needle) return (char*)haystack;
+    while (*haystack) {
+        const char *h = haystack;
+        const char *n = needle;
+        while (*h && *n && (*h == *n)) { h++; n++; }
+        if (!*n) return (char*)haystack;
+        haystack++;
+    }
+    return (char*)0;
+}
+static inline int strncmp(const char *s1, const char *s2, unsigned int n) {
+    for (unsigned int i = 0; i < n; i++) {
+        if (s1[i] != s2[i]) return (unsigned char)s1[i] - (unsigned char)s2[i];
+        if (s1[i] == '\0') return 0;
+    }
+    return 0;
+}
+
+// =============================================================================
+// FUNCIONES AUXILIARES DE CADENAS
+// =============================================================================
+// Definir NULL
+#define NULL ((void*)0)
+
+// Implementación básica de strtok
+static inline char *strtok(char *str, const char *delim) {
+    static char *last_token = NULL;
+    char *token_start;
+    
+    // Si str es NULL, continuar con el último token
+    if (str == NULL) {
+        str = last_token;
+    }
+    
+    if (str == NULL) {
+        return NULL;
+    }
+    
+    // Saltar delimitadores al inicio
+    while (*str && strchr(delim, *str)) {
+        str++;
+    }
+    
+    if (*str == '\0') {
+        last_token = NULL;
+        return NULL;
+    }
+    
+    token_start = str;
+    
+    // Encontrar el final del token
+    while (*str && !strchr(delim, *str)) {
+        str++;
+    }
+    
+    if (*str) {
+        *str = '\0';
+        last_token = str + 1;
+    } else {
+        last_token = NULL;
+    }
+    
+    return token_start;
+}
+
+// Convierte una cadena a entero (implementación básica de atoi)
+static inline int atoi(const char *str) {
+    if (!str) return 0;  // Protección contra NULL
+    
+    int result = 0;
+    int sign = 1;
+    
+    // Saltar espacios en blanco
+    while (*str == ' ' || *str == '\t') str++;
+    
+    // Verificar que hay algo después de los espacios
+    if (*str == '\0') return 0;
+    
+    // Manejar signo
+    if (*str == '-') {
+        sign = -1;
+        str++;
+    } else if (*str == '+') {
+        str++;
+    }
+    
+    // Convertir dígitos
+    int found_digit = 0;
+    while (*str >= '0' && *str <= '9') {
+        result = result * 10 + (*str - '0');
+        str++;
+        found_digit = 1;
+    }
+    
+    // Si no encontramos ningún dígito, devolver 0
+    if (!found_digit) return 0;
+    
+    return sign * result;
+}
+
+// División de 64 entre 32 bits por desplazamiento y resta: sin libgcc no
+// hay __udivdi3, así que el compilador no puede dividir un uint64_t
+static inline uint64_t udiv64(uint64_t n, uint32_t d) {
+    uint64_t q = 0, r = 0;
+    if (!d) return 0;
+    for (int bit = 63; bit >= 0; bit--) {
+        r = (r << 1) | ((n >> bit) & 1);
+        if (r >= d) { r -= d; q |= (uint64_t)1 << bit; }
+    }
+    return q;
+}
+
+#endif
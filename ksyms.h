@@ -0,0 +1,19 @@
+// ksyms.h: tabla de símbolos del propio kernel
+//
+// ksyms.c no se escribe a mano: el Makefile enlaza el kernel una primera
+// vez, extrae con nm las funciones ordenadas por dirección
+// (tools/mksyms.sh) y vuelve a enlazar con la tabla generada.
+#ifndef KSYMS_H
+#define KSYMS_H
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t    addr;
+    const char *name;
+} ksym;
+
+extern const ksym     ksyms[];
+extern const uint32_t ksyms_count;
+
+#endif
@@ -0,0 +1,137 @@
+// lz.c: compresor LZ de la familia LZ4 (ver lz.h)
+//
+// El compresor es voraz: una tabla hash recuerda la última posición de cada
+// secuencia de 4 bytes y, si la posición que da coincide, la coincidencia se
+// alarga hacia delante y hacia atrás. No busca la mejor coincidencia, sólo
+// una barata: así comprime a cientos de MB/s y el descompresor, que sólo
+// copia literales y repeticiones, va todavía más rápido.
+
+#include <stdint.h>
+#include "klib.h"
+#include "lz.h"
+
+#define LZ_MIN_MATCH 4
+#define LZ_LAST_LITERALS 5    // Los últimos bytes siempre van como literales
+#define LZ_MATCH_LIMIT 12     // Ninguna coincidencia empieza tan cerca del final
+#define LZ_HASH_BITS 12
+
+// Posición + 1 de la última aparición de cada hash (0 = ninguna)
+static uint16_t lz_table[1 << LZ_HASH_BITS];
+
+static uint32_t lz_load32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t lz_hash(uint32_t seq) {
+    return (seq * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+// Longitud ampliada: bytes 255 mientras quede y el resto en el último
+static uint8_t *lz_put_len(uint8_t *op, uint32_t n) {
+    while (n >= 255) {
+        *op++ = 255;
+        n -= 255;
+    }
+    *op++ = n;
+    return op;
+}
+
+// Emite una secuencia: literales [lit, lit + nlit) y, si mlen no es 0, una
+// repetición de mlen bytes a distancia 'off'. Retorna el nuevo final de la
+// salida, o 0 si no cabe.
+static uint8_t *lz_emit(uint8_t *op, uint8_t *end, const uint8_t *lit, uint32_t nlit,
+                        uint32_t off, uint32_t mlen) {
+    uint32_t ml = mlen ? mlen - LZ_MIN_MATCH : 0;
+    uint32_t need = 1 + nlit + nlit / 255 + 1 + (mlen ? 2 + ml / 255 + 1 : 0);
+    if (need > (uint32_t)(end - op)) return 0;
+    *op++ = (nlit >= 15 ? 15 : nlit) << 4 | (ml >= 15 ? 15 : ml);
+    if (nlit >= 15) op = lz_put_len(op, nlit - 15);
+    memcpy(op, lit, nlit);
+    op += nlit;
+    if (!mlen) return op;
+    *op++ = off & 0xFF;
+    *op++ = off >> 8;
+    if (ml >= 15) op = lz_put_len(op, ml - 15);
+    return op;
+}
+
+uint32_t lz_compress(const uint8_t *src, uint32_t len, uint8_t *dst, uint32_t cap) {
+    if (len > LZ_MAX_INPUT) return 0;
+    uint8_t *op = dst, *end = dst + cap;
+    uint32_t anchor = 0, ip = 0;
+    uint32_t limit = len > LZ_MATCH_LIMIT ? len - LZ_MATCH_LIMIT : 0;
+    memset(lz_table, 0, sizeof(lz_table));
+
+    while (ip < limit) {
+        uint32_t seq = lz_load32(src + ip);
+        uint32_t h = lz_hash(seq);
+        uint32_t ref = lz_table[h];
+        lz_table[h] = ip + 1;
+        if (!ref || lz_load32(src + --ref) != seq) {
+            // Sin coincidencias el paso crece: los datos que no se repiten
+            // se atraviesan deprisa
+            ip += 1 + ((ip - anchor) >> 5);
+            continue;
+        }
+        while (ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1]) {
+            ip--;
+            ref--;
+        }
+        uint32_t mlen = LZ_MIN_MATCH;
+        while (ip + mlen < len - LZ_LAST_LITERALS && src[ref + mlen] == src[ip + mlen]) mlen++;
+
+        op = lz_emit(op, end, src + anchor, ip - anchor, ip - ref, mlen);
+        if (!op) return 0;
+        ip += mlen;
+        anchor = ip;
+        // Recordar también una posición dentro de la coincidencia
+        lz_table[lz_hash(lz_load32(src + ip - 2))] = ip - 1;
+    }
+    op = lz_emit(op, end, src + anchor, len - anchor, 0, 0);
+    return op ? (uint32_t)(op - dst) : 0;
+}
+
+int lz_decompress(const uint8_t *src, uint32_t len, uint8_t *dst, uint32_t cap) {
+    uint32_t ip = 0, op = 0;
+    while (ip < len) {
+        uint8_t token = src[ip++];
+        uint32_t nlit = token >> 4;
+        if (nlit == 15) {
+            uint8_t b;
+            do {
+                if (ip >= len) return -1;
+                b = src[ip++];
+                nlit += b;
+            } while (b == 255);
+        }
+        if (nlit > len - ip || nlit > cap - op) return -1;
+        memcpy(dst + op, src + ip, nlit);
+        ip += nlit;
+        op += nlit;
+        if (ip == len) break;   // La última secuencia no lleva repetición
+
+        if (len - ip < 2) return -1;
+        uint32_t off = src[ip] | (src[ip + 1] << 8);
+        ip += 2;
+        if (!off || off > op) return -1;
+        uint32_t mlen = token & 15;
+        if (mlen == 15) {
+            uint8_t b;
+            do {
+                if (ip >= len) return -1;
+                b = src[ip++];
+                mlen += b;
+            } while (b == 255);
+        }
+        mlen += LZ_MIN_MATCH;
+        if (mlen > cap - op) return -1;
+        if (off >= mlen) {
+            memcpy(dst + op, dst + op - off, mlen);
+        } else {
+            // Solapada: repite el patrón de 'off' bytes byte a byte
+            for (uint32_t i = 0; i < mlen; i++) dst[op + i] = dst[op + i - off];
+        }
+        op += mlen;
+    }
+    return op;
+}
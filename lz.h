@@ -0,0 +1,23 @@
+// lz.h: compresor LZ de la familia LZ4 (lz.c)
+//
+// Formato de bloque de LZ4: secuencias de [token][literales][distancia]
+// [longitud], sin marco ni sumas de control. Cada bloque se comprime y se
+// descomprime por separado, y como las distancias son de 16 bits un bloque
+// no puede pasar de LZ_MAX_INPUT bytes. Igual que fs.c, sólo depende de
+// klib.h.
+#ifndef LZ_H
+#define LZ_H
+
+#include <stdint.h>
+
+#define LZ_MAX_INPUT 65535
+
+// Comprime 'len' bytes en dst. Retorna el tamaño comprimido, o 0 si no
+// cabe en 'cap' bytes (el llamador guarda entonces el bloque sin comprimir)
+uint32_t lz_compress(const uint8_t *src, uint32_t len, uint8_t *dst, uint32_t cap);
+
+// Descomprime un bloque. Retorna los bytes producidos, o -1 si el bloque
+// está corrupto o no cabe en 'cap' bytes
+int lz_decompress(const uint8_t *src, uint32_t len, uint8_t *dst, uint32_t cap);
+
+#endif
@@ -0,0 +1,609 @@
+// net.c: ARP, IPv4, ICMP eco y sockets UDP (ver net.h)
+//
+// Sólo lo necesario para hablar con la red de usuario de QEMU: sin
+// fragmentación (los fragmentos se descartan), sin opciones IP al enviar y
+// sin caducidad en la caché ARP (las entradas se reemplazan por antigüedad).
+// Las sumas de comprobación se calculan con csum.c.
+
+#include <stdint.h>
+#include "klib.h"
+#include "platform.h"
+#include "csum.h"
+#include "netbuf.h"
+#include "e1000.h"
+#include "net.h"
+
+#define ETH_IP   0x0800
+#define ETH_ARP  0x0806
+#define ARP_REQUEST 1
+#define ARP_REPLY   2
+#define IP_ICMP  1
+#define IP_UDP   17
+#define IP_DF    0x4000
+#define IP_TTL   64
+#define ICMP_ECHO_REPLY   0
+#define ICMP_ECHO_REQUEST 8
+#define PING_ID  0x5232            // "R2": identifica los ecos propios
+#define PORT_EPHEMERAL 49152
+#define TX_RETRIES 100000          // Vueltas esperando sitio en el anillo de envío
+
+typedef struct __attribute__((packed)) {
+    uint8_t  dst[6], src[6];
+    uint16_t type;
+} eth_hdr;
+
+typedef struct __attribute__((packed)) {
+    uint16_t htype, ptype;
+    uint8_t  hlen, plen;
+    uint16_t op;
+    uint8_t  sha[6];
+    uint32_t spa;
+    uint8_t  tha[6];
+    uint32_t tpa;
+} arp_pkt;
+
+typedef struct __attribute__((packed)) {
+    uint8_t  vhl, tos;
+    uint16_t len, id, frag;
+    uint8_t  ttl, proto;
+    uint16_t csum;
+    uint32_t src, dst;
+} ip_hdr;
+
+typedef struct __attribute__((packed)) {
+    uint8_t  type, code;
+    uint16_t csum, id, seq;
+} icmp_hdr;
+
+typedef struct __attribute__((packed)) {
+    uint16_t sport, dport, len, csum;
+} udp_hdr;
+
+static inline uint16_t htons(uint16_t v) { return (uint16_t)(v << 8 | v >> 8); }
+static inline uint32_t htonl(uint32_t v) {
+    return v << 24 | (v & 0xFF00) << 8 | (v >> 8 & 0xFF00) | v >> 24;
+}
+#define ntohs htons
+#define ntohl htonl
+
+enum { ARP_FREE, ARP_PENDING, ARP_OK };
+
+typedef struct {
+    int      state;
+    uint32_t ip;
+    uint8_t  mac[6];
+    uint32_t stamp;       // Último uso, para elegir a quién reemplazar
+    netbuf  *parked;      // Marco completo esperando la MAC
+} arp_entry;
+
+typedef struct {
+    netbuf  *b;
+    uint32_t ip;
+    uint16_t port;
+} udp_datagram;
+
+typedef struct {
+    int          used;
+    uint16_t     port;
+    uint32_t     head, tail;
+    udp_datagram q[NET_SOCKET_QUEUE];
+} udp_socket;
+
+static int        up;
+static net_config cfg;
+static uint8_t    our_mac[6];
+static net_stats  stats;
+static arp_entry  arp[NET_ARP_ENTRIES];
+static uint32_t   arp_clock;
+static udp_socket sockets[NET_SOCKETS];
+static uint16_t   next_port = PORT_EPHEMERAL;
+static uint16_t   ip_id;
+
+static const uint8_t broadcast_mac[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+
+// Último eco propio contestado
+static int      ping_got;
+static uint16_t ping_seq;
+static uint64_t ping_when;
+static uint8_t  ping_ttl;
+
+// =============================================================================
+// CONFIGURACIÓN
+// =============================================================================
+int net_init(void) {
+    if (!e1000_present()) return 0;
+    memcpy(our_mac, e1000_mac(), 6);
+    cfg.ip = IP4(10, 0, 2, 15);
+    cfg.mask = IP4(255, 255, 255, 0);
+    cfg.gateway = IP4(10, 0, 2, 2);
+    up = 1;
+    return 1;
+}
+
+int net_up(void) {
+    return up;
+}
+
+void net_get_config(net_config *c) {
+    *c = cfg;
+}
+
+void net_set_config(const net_config *c) {
+    cfg = *c;
+    // Las MAC aprendidas pueden no valer en la subred nueva
+    for (int i = 0; i < NET_ARP_ENTRIES; i++) {
+        if (arp[i].parked) netbuf_free(arp[i].parked);
+        arp[i].parked = 0;
+        arp[i].state = ARP_FREE;
+    }
+}
+
+void net_get_stats(net_stats *st) {
+    *st = stats;
+}
+
+int net_parse_ip(const char *s, uint32_t *ip) {
+    uint32_t v = 0;
+    for (int part = 0; part < 4; part++) {
+        if (*s < '0' || *s > '9') return 0;
+        uint32_t n = 0;
+        while (*s >= '0' && *s <= '9') {
+            n = n * 10 + (*s++ - '0');
+            if (n > 255) return 0;
+        }
+        v = v << 8 | n;
+        if (part < 3 && *s++ != '.') return 0;
+    }
+    if (*s) return 0;
+    *ip = v;
+    return 1;
+}
+
+void net_format_ip(uint32_t ip, char *buf) {
+    for (int part = 3; part >= 0; part--) {
+        uint32_t n = (ip >> (8 * part)) & 0xFF;
+        if (n >= 100) *buf++ = '0' + n / 100;
+        if (n >= 10) *buf++ = '0' + n / 10 % 10;
+        *buf++ = '0' + n % 10;
+        if (part) *buf++ = '.';
+    }
+    *buf = '\0';
+}
+
+static int is_broadcast(uint32_t ip) {
+    return ip == 0xFFFFFFFF || ip == (cfg.ip | ~cfg.mask);
+}
+
+static uint32_t next_hop(uint32_t ip) {
+    return (ip & cfg.mask) == (cfg.ip & cfg.mask) ? ip : cfg.gateway;
+}
+
+// =============================================================================
+// ENVÍO
+// =============================================================================
+// Entrega un marco completo (off en la cabecera Ethernet) a la tarjeta. Si
+// el anillo está lleno se espera a que mande algo; aquí no se recibe, así
+// que se puede llamar desde el proceso de un paquete.
+static int xmit(netbuf *b) {
+    for (int i = 0; !e1000_send(b); i++) {
+        if (i == TX_RETRIES) {
+            stats.tx_drops++;
+            netbuf_free(b);
+            return 0;
+        }
+        e1000_tx_pending();
+    }
+    return 1;
+}
+
+static eth_hdr *eth_prepend(netbuf *b, const uint8_t *dst, uint16_t type) {
+    netbuf_header(b, NET_ETH_HLEN);
+    eth_hdr *eth = (eth_hdr *)netbuf_payload(b);
+    memcpy(eth->dst, dst, 6);
+    memcpy(eth->src, our_mac, 6);
+    eth->type = htons(type);
+    return eth;
+}
+
+static void arp_request(uint32_t ip) {
+    netbuf *b = netbuf_alloc();
+    if (!b) return;
+    b->off = NET_ETH_HLEN;
+    b->len = sizeof(arp_pkt);
+    arp_pkt *a = (arp_pkt *)netbuf_payload(b);
+    a->htype = htons(1);
+    a->ptype = htons(ETH_IP);
+    a->hlen = 6;
+    a->plen = 4;
+    a->op = htons(ARP_REQUEST);
+    memcpy(a->sha, our_mac, 6);
+    a->spa = htonl(cfg.ip);
+    memset(a->tha, 0, 6);
+    a->tpa = htonl(ip);
+    eth_prepend(b, broadcast_mac, ETH_ARP);
+    stats.arp_out++;
+    xmit(b);
+}
+
+static arp_entry *arp_find(uint32_t ip) {
+    for (int i = 0; i < NET_ARP_ENTRIES; i++) {
+        if (arp[i].state != ARP_FREE && arp[i].ip == ip) return &arp[i];
+    }
+    return 0;
+}
+
+// Entrada para 'ip': la suya, una libre o la usada hace más tiempo
+static arp_entry *arp_slot(uint32_t ip) {
+    arp_entry *e = arp_find(ip);
+    if (e) return e;
+    e = &arp[0];
+    for (int i = 0; i < NET_ARP_ENTRIES; i++) {
+        if (arp[i].state == ARP_FREE) {
+            e = &arp[i];
+            break;
+        }
+        if (arp[i].stamp < e->stamp) e = &arp[i];
+    }
+    if (e->parked) {
+        netbuf_free(e->parked);
+        e->parked = 0;
+        stats.arp_drops++;
+    }
+    e->state = ARP_PENDING;
+    e->ip = ip;
+    e->stamp = ++arp_clock;
+    return e;
+}
+
+// Anota la MAC de 'ip' y suelta el marco que la esperaba
+static void arp_learn(uint32_t ip, const uint8_t *mac) {
+    arp_entry *e = arp_slot(ip);
+    memcpy(e->mac, mac, 6);
+    e->state = ARP_OK;
+    if (e->parked) {
+        netbuf *b = e->parked;
+        e->parked = 0;
+        memcpy(((eth_hdr *)netbuf_payload(b))->dst, mac, 6);
+        xmit(b);
+    }
+}
+
+int net_route_ready(uint32_t ip) {
+    if (is_broadcast(ip)) return 1;
+    arp_entry *e = arp_find(next_hop(ip));
+    return e && e->state == ARP_OK;
+}
+
+void net_arp_request(uint32_t ip) {
+    if (!up) return;
+    uint32_t hop = next_hop(ip);
+    if (!arp_find(hop)) arp_slot(hop);
+    arp_request(hop);
+    e1000_flush();
+}
+
+int net_arp_entry(int i, uint32_t *ip, uint8_t mac[6]) {
+    if (i < 0 || i >= NET_ARP_ENTRIES || arp[i].state != ARP_OK) return 0;
+    *ip = arp[i].ip;
+    memcpy(mac, arp[i].mac, 6);
+    return 1;
+}
+
+// 'b' lleva el paquete de transporte en off/len. Se le antepone la cabecera
+// IP y la Ethernet; 'mac' es el destino si ya se conoce (una respuesta).
+// Se queda con la referencia de 'b'.
+static int ip_output(netbuf *b, uint32_t dst, uint8_t proto, const uint8_t *mac) {
+    netbuf_header(b, NET_IP_HLEN);
+    ip_hdr *ip = (ip_hdr *)netbuf_payload(b);
+    ip->vhl = 0x45;
+    ip->tos = 0;
+    ip->len = htons(b->len);
+    ip->id = htons(ip_id++);
+    ip->frag = htons(IP_DF);
+    ip->ttl = IP_TTL;
+    ip->proto = proto;
+    ip->csum = 0;
+    ip->src = htonl(cfg.ip);
+    ip->dst = htonl(dst);
+    ip->csum = csum_fold(csum_add(0, ip, NET_IP_HLEN));
+    stats.ip_out++;
+
+    if (mac || is_broadcast(dst)) {
+        eth_prepend(b, mac ? mac : broadcast_mac, ETH_IP);
+        return xmit(b);
+    }
+    uint32_t hop = next_hop(dst);
+    arp_entry *e = arp_find(hop);
+    if (e && e->state == ARP_OK) {
+        e->stamp = ++arp_clock;
+        eth_prepend(b, e->mac, ETH_IP);
+        return xmit(b);
+    }
+    // Sin MAC: el marco espera en la entrada (sustituye al que hubiera)
+    e = arp_slot(hop);
+    if (e->parked) {
+        netbuf_free(e->parked);
+        stats.arp_drops++;
+    }
+    eth_prepend(b, broadcast_mac, ETH_IP);
+    e->parked = b;
+    arp_request(hop);
+    return 1;
+}
+
+void net_flush(void) {
+    e1000_flush();
+}
+
+// =============================================================================
+// RECEPCIÓN
+// =============================================================================
+static void arp_input(netbuf *b) {
+    arp_pkt *a = (arp_pkt *)netbuf_payload(b);
+    if (b->len < sizeof(arp_pkt) || a->htype != htons(1) || a->ptype != htons(ETH_IP) ||
+        a->hlen != 6 || a->plen != 4) {
+        netbuf_free(b);
+        return;
+    }
+    stats.arp_in++;
+    uint32_t spa = ntohl(a->spa), tpa = ntohl(a->tpa);
+    // Se aprende de quien pregunta por nosotros y de quien ya se conocía
+    if (tpa == cfg.ip || arp_find(spa)) arp_learn(spa, a->sha);
+    if (a->op != htons(ARP_REQUEST) || tpa != cfg.ip) {
+        netbuf_free(b);
+        return;
+    }
+    // La respuesta sale en el mismo buffer
+    uint8_t peer[6];
+    memcpy(peer, a->sha, 6);
+    a->op = htons(ARP_REPLY);
+    memcpy(a->tha, peer, 6);
+    a->tpa = a->spa;
+    memcpy(a->sha, our_mac, 6);
+    a->spa = htonl(cfg.ip);
+    b->len = sizeof(arp_pkt);
+    eth_prepend(b, peer, ETH_ARP);
+    stats.arp_out++;
+    xmit(b);
+}
+
+static void icmp_input(netbuf *b, const ip_hdr *ip, const uint8_t *peer) {
+    icmp_hdr *h = (icmp_hdr *)netbuf_payload(b);
+    if (b->len < sizeof(icmp_hdr) || csum_fold(csum_add(0, h, b->len))) {
+        stats.ip_bad++;
+        netbuf_free(b);
+        return;
+    }
+    stats.icmp_in++;
+    if (h->type == ICMP_ECHO_REQUEST && ntohl(ip->dst) == cfg.ip) {
+        uint32_t src = ntohl(ip->src);
+        h->type = ICMP_ECHO_REPLY;
+        h->csum = 0;
+        h->csum = csum_fold(csum_add(0, h, b->len));
+        stats.icmp_out++;
+        ip_output(b, src, IP_ICMP, peer);
+        return;
+    }
+    if (h->type == ICMP_ECHO_REPLY && h->id == htons(PING_ID)) {
+        ping_seq = ntohs(h->seq);
+        ping_when = rdtsc();
+        ping_ttl = ip->ttl;
+        ping_got = 1;
+    }
+    netbuf_free(b);
+}
+
+static udp_socket *socket_by_port(uint16_t port) {
+    for (int i = 0; i < NET_SOCKETS; i++) {
+        if (sockets[i].used && sockets[i].port == port) return &sockets[i];
+    }
+    return 0;
+}
+
+// Suma de la pseudo-cabecera de UDP; src y dst en orden de red
+static uint32_t udp_pseudo(uint32_t src, uint32_t dst, uint16_t len_net) {
+    uint32_t ph[3] = { src, dst, (uint32_t)len_net << 16 | htons(IP_UDP) };
+    return csum_add(0, ph, sizeof(ph));
+}
+
+static void udp_input(netbuf *b, const ip_hdr *ip) {
+    udp_hdr *u = (udp_hdr *)netbuf_payload(b);
+    uint16_t len = b->len >= sizeof(udp_hdr) ? ntohs(u->len) : 0;
+    if (len < sizeof(udp_hdr) || len > b->len) {
+        stats.udp_bad++;
+        netbuf_free(b);
+        return;
+    }
+    b->len = len;
+    // Suma 0: el que envía no la calculó
+    if (u->csum && csum_fold(csum_add(udp_pseudo(ip->src, ip->dst, u->len), u, len))) {
+        stats.udp_bad++;
+        netbuf_free(b);
+        return;
+    }
+    stats.udp_in++;
+    udp_socket *s = socket_by_port(ntohs(u->dport));
+    if (!s) {
+        stats.udp_noport++;
+        netbuf_free(b);
+        return;
+    }
+    if (s->head - s->tail == NET_SOCKET_QUEUE) {
+        stats.udp_overflow++;
+        netbuf_free(b);
+        return;
+    }
+    udp_datagram *d = &s->q[s->head++ % NET_SOCKET_QUEUE];
+    d->ip = ntohl(ip->src);
+    d->port = ntohs(u->sport);
+    netbuf_header(b, -(int)sizeof(udp_hdr));
+    d->b = b;
+}
+
+static void ip_input(netbuf *b, const eth_hdr *eth) {
+    ip_hdr *ip = (ip_hdr *)netbuf_payload(b);
+    uint32_t hl = (ip->vhl & 0xF) * 4;
+    uint32_t len = b->len >= NET_IP_HLEN ? ntohs(ip->len) : 0;
+    if (b->len < NET_IP_HLEN || (ip->vhl >> 4) != 4 || hl < NET_IP_HLEN || len < hl ||
+        len > b->len || csum_fold(csum_add(0, ip, hl))) {
+        stats.ip_bad++;
+        netbuf_free(b);
+        return;
+    }
+    uint32_t dst = ntohl(ip->dst);
+    if (dst != cfg.ip && !is_broadcast(dst)) {
+        netbuf_free(b);
+        return;
+    }
+    if (ntohs(ip->frag) & 0x3FFF) {   // MF o desplazamiento: un fragmento
+        stats.ip_frag++;
+        netbuf_free(b);
+        return;
+    }
+    stats.ip_in++;
+    b->len = len;                     // Fuera el relleno de los marcos cortos
+    netbuf_header(b, -(int)hl);
+    // Las cabeceras de antes se van a pisar al responder: la MAC se copia
+    uint8_t peer[6];
+    memcpy(peer, eth->src, 6);
+    if (ip->proto == IP_ICMP) icmp_input(b, ip, peer);
+    else if (ip->proto == IP_UDP) udp_input(b, ip);
+    else netbuf_free(b);
+}
+
+static void net_input(netbuf *b) {
+    if (b->len < NET_ETH_HLEN) {
+        netbuf_free(b);
+        return;
+    }
+    const eth_hdr *eth = (const eth_hdr *)netbuf_payload(b);
+    uint16_t type = ntohs(eth->type);
+    netbuf_header(b, -NET_ETH_HLEN);
+    if (type == ETH_ARP) arp_input(b);
+    else if (type == ETH_IP) ip_input(b, eth);
+    else netbuf_free(b);
+}
+
+int net_poll(void) {
+    if (!up) return 0;
+    int n = e1000_poll(net_input, E1000_RX_DESCS);
+    e1000_flush();   // Las respuestas que se hayan generado
+    return n;
+}
+
+// =============================================================================
+// ICMP ECO
+// =============================================================================
+int net_ping(uint32_t ip, uint16_t seq, uint32_t size) {
+    if (!up || size > NET_MTU - NET_IP_HLEN - sizeof(icmp_hdr)) return 0;
+    netbuf *b = netbuf_alloc();
+    if (!b) return 0;
+    b->off = NET_ETH_HLEN + NET_IP_HLEN;
+    b->len = sizeof(icmp_hdr) + size;
+    icmp_hdr *h = (icmp_hdr *)netbuf_payload(b);
+    h->type = ICMP_ECHO_REQUEST;
+    h->code = 0;
+    h->id = htons(PING_ID);
+    h->seq = htons(seq);
+    uint8_t *data = (uint8_t *)(h + 1);
+    for (uint32_t i = 0; i < size; i++) data[i] = 'a' + i % 26;
+    h->csum = 0;
+    h->csum = csum_fold(csum_add(0, h, b->len));
+    stats.icmp_out++;
+    int ok = ip_output(b, ip, IP_ICMP, 0);
+    e1000_flush();
+    return ok;
+}
+
+int net_ping_reply(uint16_t seq, uint64_t *when, uint8_t *ttl) {
+    if (!ping_got || ping_seq != seq) return 0;
+    *when = ping_when;
+    *ttl = ping_ttl;
+    return 1;
+}
+
+// =============================================================================
+// SOCKETS UDP
+// =============================================================================
+int udp_bind(uint16_t port) {
+    if (!up) return -1;
+    if (!port) {
+        for (int tries = 0; tries < 65536 - PORT_EPHEMERAL && socket_by_port(next_port); tries++) {
+            next_port = next_port == 0xFFFF ? PORT_EPHEMERAL : next_port + 1;
+        }
+        port = next_port;
+        next_port = next_port == 0xFFFF ? PORT_EPHEMERAL : next_port + 1;
+    }
+    if (socket_by_port(port)) return -1;
+    for (int i = 0; i < NET_SOCKETS; i++) {
+        if (sockets[i].used) continue;
+        sockets[i].used = 1;
+        sockets[i].port = port;
+        sockets[i].head = sockets[i].tail = 0;
+        return i;
+    }
+    return -1;
+}
+
+void udp_close(int s) {
+    if (s < 0 || s >= NET_SOCKETS || !sockets[s].used) return;
+    udp_socket *sk = &sockets[s];
+    while (sk->tail != sk->head) netbuf_free(sk->q[sk->tail++ % NET_SOCKET_QUEUE].b);
+    sk->used = 0;
+}
+
+uint16_t udp_port(int s) {
+    return s >= 0 && s < NET_SOCKETS && sockets[s].used ? sockets[s].port : 0;
+}
+
+netbuf *udp_alloc(void) {
+    netbuf *b = netbuf_alloc();
+    if (b) b->off = NET_UDP_HEADROOM;
+    return b;
+}
+
+int udp_send(int s, netbuf *b, uint32_t ip, uint16_t port) {
+    if (s < 0 || s >= NET_SOCKETS || !sockets[s].used || b->off < NET_UDP_HEADROOM ||
+        b->len > NET_UDP_MAX) {
+        netbuf_free(b);
+        return 0;
+    }
+    netbuf_header(b, sizeof(udp_hdr));
+    udp_hdr *u = (udp_hdr *)netbuf_payload(b);
+    u->sport = htons(sockets[s].port);
+    u->dport = htons(port);
+    u->len = htons(b->len);
+    u->csum = 0;
+    uint16_t sum = csum_fold(csum_add(udp_pseudo(htonl(cfg.ip), htonl(ip), u->len), u, b->len));
+    u->csum = sum ? sum : 0xFFFF;   // 0 significa "sin suma"
+    stats.udp_out++;
+    return ip_output(b, ip, IP_UDP, 0);
+}
+
+netbuf *udp_recv(int s, uint32_t *ip, uint16_t *port) {
+    if (s < 0 || s >= NET_SOCKETS || !sockets[s].used) return 0;
+    udp_socket *sk = &sockets[s];
+    if (sk->tail == sk->head) return 0;
+    udp_datagram *d = &sk->q[sk->tail++ % NET_SOCKET_QUEUE];
+    if (ip) *ip = d->ip;
+    if (port) *port = d->port;
+    return d->b;
+}
+
+int udp_sendto(int s, const void *buf, uint32_t len, uint32_t ip, uint16_t port) {
+    if (len > NET_UDP_MAX) return 0;
+    netbuf *b = udp_alloc();
+    if (!b) return 0;
+    memcpy(netbuf_payload(b), buf, len);
+    b->len = len;
+    return udp_send(s, b, ip, port);
+}
+
+int udp_recvfrom(int s, void *buf, uint32_t len, uint32_t *ip, uint16_t *port) {
+    netbuf *b = udp_recv(s, ip, port);
+    if (!b) return -1;
+    uint32_t n = b->len < len ? b->len : len;
+    memcpy(buf, netbuf_payload(b), n);
+    netbuf_free(b);
+    return n;
+}
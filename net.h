@@ -0,0 +1,99 @@
+// net.h: pila IPv4 mínima sobre la e1000: ARP, ICMP eco y UDP (net.c)
+//
+// Los paquetes no se copian entre capas: el netbuf que entrega la tarjeta
+// se recorre cabecera a cabecera y, si es un datagrama para un socket, se
+// encola tal cual con el 'off' en la carga. Al enviar, quien llama escribe
+// la carga a partir de NET_UDP_HEADROOM (udp_alloc() ya lo deja así) y cada
+// capa antepone su cabecera en el mismo buffer. Las respuestas de eco (ICMP
+// y 'udpecho') reutilizan el buffer recibido.
+//
+// Nada corre en la interrupción: los paquetes se procesan cuando alguien
+// llama a net_poll() (el shell lo hace mientras espera una tecla). La
+// configuración por defecto es la de la red de usuario de QEMU (slirp).
+#ifndef NET_H
+#define NET_H
+
+#include <stdint.h>
+#include "netbuf.h"
+
+#define NET_ETH_HLEN     14
+#define NET_IP_HLEN      20
+#define NET_UDP_HLEN     8
+#define NET_UDP_HEADROOM (NET_ETH_HLEN + NET_IP_HLEN + NET_UDP_HLEN)
+#define NET_MTU          1500
+#define NET_UDP_MAX      (NET_MTU - NET_IP_HLEN - NET_UDP_HLEN)   // 1472
+
+#define NET_ARP_ENTRIES  8
+#define NET_SOCKETS      8
+#define NET_SOCKET_QUEUE 16    // Datagramas esperando en cada socket
+
+// Direcciones en el orden de la CPU: IP4(10,0,2,15)
+#define IP4(a, b, c, d) ((uint32_t)(a) << 24 | (uint32_t)(b) << 16 | (uint32_t)(c) << 8 | (uint32_t)(d))
+
+typedef struct {
+    uint32_t ip, mask, gateway;
+} net_config;
+
+typedef struct {
+    uint32_t ip_in, ip_out, ip_bad;        // bad: cabecera o suma incorrecta
+    uint32_t ip_frag;                      // Fragmentos (no se reensamblan)
+    uint32_t arp_in, arp_out, arp_drops;   // drops: aparcados que se perdieron
+    uint32_t icmp_in, icmp_out;
+    uint32_t udp_in, udp_out, udp_bad;
+    uint32_t udp_noport, udp_overflow;     // Sin socket / cola llena
+    uint32_t tx_drops;                     // El anillo de envío no se vació a tiempo
+} net_stats;
+
+// Deja la configuración de QEMU: 10.0.2.15/24, puerta de enlace 10.0.2.2.
+// Retorna 0 si no hay tarjeta.
+int  net_init(void);
+int  net_up(void);
+void net_get_config(net_config *cfg);
+void net_set_config(const net_config *cfg);
+void net_get_stats(net_stats *st);
+
+// Procesa lo recibido y recoge lo enviado. Retorna cuántos paquetes procesó.
+int  net_poll(void);
+// Avisa a la tarjeta de lo encolado desde la última vez
+void net_flush(void);
+
+// "a.b.c.d" -> dirección; retorna 0 si no es válida
+int  net_parse_ip(const char *s, uint32_t *ip);
+// Escribe "a.b.c.d" en 'buf' (16 bytes)
+void net_format_ip(uint32_t ip, char *buf);
+
+// ARP. El siguiente salto de 'ip' es ella misma si está en la subred y la
+// puerta de enlace si no. Un paquete hacia un salto sin resolver se aparca
+// (uno por entrada) y sale cuando llega la respuesta.
+int  net_route_ready(uint32_t ip);   // 1 si ya se conoce la MAC del salto
+void net_arp_request(uint32_t ip);   // Pregunta por el salto de 'ip'
+int  net_arp_entry(int i, uint32_t *ip, uint8_t mac[6]);   // 0 si la entrada i no es válida
+
+// ICMP eco. La respuesta a un eco propio se anota con su hora de llegada
+// (rdtsc) y se consulta con net_ping_reply(); los ecos que llegan se
+// contestan solos.
+int  net_ping(uint32_t ip, uint16_t seq, uint32_t size);   // 0 si no se pudo enviar
+int  net_ping_reply(uint16_t seq, uint64_t *when, uint8_t *ttl);
+
+// Sockets UDP. 'port' 0 en udp_bind elige uno libre a partir de 49152.
+int     udp_bind(uint16_t port);            // Socket, o -1
+void    udp_close(int s);
+uint16_t udp_port(int s);
+
+// Sin copias: udp_alloc() da un netbuf con la carga vacía en
+// NET_UDP_HEADROOM; se escribe en netbuf_payload() y se ajusta len.
+// udp_send() se queda con la referencia (también si falla) y retorna 0 si
+// no pudo enviarlo. udp_recv() da el siguiente datagrama con off en la
+// carga (o NULL si no hay); quien lo recibe lo libera, o lo reenvía tal
+// cual con udp_send().
+netbuf *udp_alloc(void);
+int     udp_send(int s, netbuf *b, uint32_t ip, uint16_t port);
+netbuf *udp_recv(int s, uint32_t *ip, uint16_t *port);
+
+// Con copia, para quien tiene los datos en su propio buffer. udp_recvfrom()
+// retorna los bytes copiados (el resto del datagrama se pierde) o -1 si no
+// hay ninguno.
+int udp_sendto(int s, const void *buf, uint32_t len, uint32_t ip, uint16_t port);
+int udp_recvfrom(int s, void *buf, uint32_t len, uint32_t *ip, uint16_t *port);
+
+#endif
@@ -0,0 +1,49 @@
+// netbuf.c: reserva fija de buffers de paquetes (ver netbuf.h)
+
+#include <stdint.h>
+#include "netbuf.h"
+
+static uint8_t  pool_data[NETBUF_COUNT][NETBUF_SIZE] __attribute__((aligned(NETBUF_SIZE)));
+static netbuf   pool[NETBUF_COUNT];
+static netbuf  *free_list;
+static uint32_t free_count;
+static int      pool_ready;
+
+static void pool_init(void) {
+    for (int i = NETBUF_COUNT - 1; i >= 0; i--) {
+        pool[i].data = pool_data[i];
+        pool[i].off = pool[i].len = 0;
+        pool[i].refs = 0;
+        pool[i].next = free_list;
+        free_list = &pool[i];
+    }
+    free_count = NETBUF_COUNT;
+    pool_ready = 1;
+}
+
+netbuf *netbuf_alloc(void) {
+    if (!pool_ready) pool_init();
+    netbuf *b = free_list;
+    if (!b) return 0;
+    free_list = b->next;
+    free_count--;
+    b->off = b->len = 0;
+    b->refs = 1;
+    return b;
+}
+
+void netbuf_ref(netbuf *b) {
+    b->refs++;
+}
+
+void netbuf_free(netbuf *b) {
+    if (--b->refs) return;
+    b->next = free_list;
+    free_list = b;
+    free_count++;
+}
+
+uint32_t netbuf_available(void) {
+    if (!pool_ready) pool_init();
+    return free_count;
+}
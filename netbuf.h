@@ -0,0 +1,45 @@
+// netbuf.h: buffers de paquetes de la red (netbuf.c)
+//
+// Un netbuf es un marco Ethernet entero. La tarjeta escribe y lee por DMA
+// directamente en su memoria, así que un paquete recibido llega a quien lo
+// procese sin copiarse y uno enviado sale de donde se construyó: el
+// controlador sólo pasa punteros. Como la memoria del kernel se mapea sobre
+// sí misma, la dirección virtual es la física que se da a la tarjeta.
+//
+// Cada capa mira su parte del marco a través de 'off' y 'len': al recibir,
+// se avanza tras cada cabecera; al enviar, la carga se escribe dejando sitio
+// delante (NET_UDP_HEADROOM en net.h) y cada capa antepone la suya. Un
+// netbuf puede estar a la vez en varios sitios (la cola de un socket, el
+// anillo de envío): cada uno tiene una referencia y el último lo libera.
+#ifndef NETBUF_H
+#define NETBUF_H
+
+#include <stdint.h>
+
+#define NETBUF_SIZE  2048   // Lo que pide RCTL.BSIZE; cabe un marco de 1518
+#define NETBUF_COUNT 96     // Los dos anillos llenos y margen para las capas de arriba
+
+typedef struct netbuf {
+    uint8_t       *data;     // NETBUF_SIZE bytes alineados a 2 KiB
+    uint16_t       off;      // Donde empieza lo que interesa a la capa actual
+    uint16_t       len;      // Bytes desde ahí
+    uint16_t       refs;
+    struct netbuf *next;     // Lista de libres
+} netbuf;
+
+netbuf  *netbuf_alloc(void);      // Con una referencia, off y len a 0; NULL si no quedan
+void     netbuf_ref(netbuf *b);
+void     netbuf_free(netbuf *b);  // Suelta una referencia
+uint32_t netbuf_available(void);
+
+static inline uint8_t *netbuf_payload(const netbuf *b) {
+    return b->data + b->off;
+}
+
+// Antepone (n > 0) o quita (n < 0) n bytes de cabecera
+static inline void netbuf_header(netbuf *b, int n) {
+    b->off -= n;
+    b->len += n;
+}
+
+#endif
@@ -0,0 +1,58 @@
+// pci.c: espacio de configuración PCI (ver pci.h)
+
+#include <stdint.h>
+#include "io.h"
+#include "pci.h"
+
+#define PCI_ADDR 0xCF8
+#define PCI_DATA 0xCFC
+
+static uint32_t pci_address(uint8_t bus, uint8_t dev, uint8_t func, uint8_t reg) {
+    return 0x80000000u | (bus << 16) | (dev << 11) | (func << 8) | (reg & 0xFC);
+}
+
+uint32_t pci_read(const pci_device *d, uint8_t reg) {
+    outl(PCI_ADDR, pci_address(d->bus, d->dev, d->func, reg));
+    return inl(PCI_DATA);
+}
+
+void pci_write(const pci_device *d, uint8_t reg, uint32_t value) {
+    outl(PCI_ADDR, pci_address(d->bus, d->dev, d->func, reg));
+    outl(PCI_DATA, value);
+}
+
+// Fuerza bruta: 256 buses de 32 dispositivos. Un hueco vacío lee 0xFFFF
+// como fabricante; sólo se miran las otras funciones si el dispositivo
+// dice ser multifunción (bit 7 del tipo de cabecera, registro 0x0C).
+int pci_find(uint16_t vendor, uint16_t device, pci_device *d) {
+    for (int bus = 0; bus < 256; bus++) {
+        for (int dev = 0; dev < 32; dev++) {
+            for (int func = 0; func < 8; func++) {
+                outl(PCI_ADDR, pci_address(bus, dev, func, PCI_ID));
+                uint32_t id = inl(PCI_DATA);
+                if ((id & 0xFFFF) == 0xFFFF) {
+                    if (!func) break;
+                    continue;
+                }
+                if ((id & 0xFFFF) == vendor && (id >> 16) == device) {
+                    d->bus = bus;
+                    d->dev = dev;
+                    d->func = func;
+                    d->vendor = vendor;
+                    d->device = device;
+                    return 1;
+                }
+                if (!func) {
+                    outl(PCI_ADDR, pci_address(bus, dev, 0, 0x0C));
+                    if (!(inl(PCI_DATA) & 0x00800000)) break;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+void pci_enable(const pci_device *d) {
+    uint32_t cmd = pci_read(d, PCI_COMMAND);
+    pci_write(d, PCI_COMMAND, (cmd & 0xFFFF) | PCI_CMD_MEMORY | PCI_CMD_MASTER);
+}
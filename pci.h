@@ -0,0 +1,35 @@
+// pci.h: búsqueda de dispositivos en el bus PCI (pci.c)
+//
+// Se usa el mecanismo de configuración 1: la dirección (bus, dispositivo,
+// función, registro) se escribe en el puerto 0xCF8 y el dato se lee o se
+// escribe en 0xCFC. Basta para encontrar una tarjeta, leer sus BARs y su
+// IRQ y activarle el acceso a memoria y el bus master (DMA).
+#ifndef PCI_H
+#define PCI_H
+
+#include <stdint.h>
+
+// Registros del espacio de configuración
+#define PCI_ID       0x00   // Fabricante (bits 0-15) y dispositivo (16-31)
+#define PCI_COMMAND  0x04
+#define PCI_BAR0     0x10
+#define PCI_IRQ_LINE 0x3C   // Bits 0-7: línea del PIC que asignó la BIOS
+
+#define PCI_CMD_MEMORY 0x0002
+#define PCI_CMD_MASTER 0x0004
+
+typedef struct {
+    uint8_t  bus, dev, func;
+    uint16_t vendor, device;
+} pci_device;
+
+uint32_t pci_read(const pci_device *d, uint8_t reg);
+void     pci_write(const pci_device *d, uint8_t reg, uint32_t value);
+
+// Busca el dispositivo vendor:device. Retorna 1 y lo deja en 'd' si está.
+int pci_find(uint16_t vendor, uint16_t device, pci_device *d);
+
+// Activa el acceso a sus registros en memoria y el DMA
+void pci_enable(const pci_device *d);
+
+#endif
@@ -0,0 +1,31 @@
+// platform.h: lo que fs.c, text.c y trace.c necesitan de la plataforma
+//
+// El sistema de archivos y los operadores de texto no tocan el hardware:
+// escriben con printf/putchar, trabajan sobre un disco en memoria y miden
+// el tiempo en ciclos.
+// - En el kernel, la consola es la pantalla VGA (kernel.c) y el disco es la
+//   zona reservada en boot.s.
+// - En el host (make host-bench), host/platform.c da sus propias versiones;
+//   el Makefile renombra printf y putchar al compilar fs.c y text.c para que
+//   no choquen con los de libc.
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stdint.h>
+
+// Consola: printf entiende %s %c %d %u %x y %%
+void putchar(char c);
+void printf(const char *fmt, ...);
+
+// Disco en RAM de DISK_SECTORS sectores (ver fat16.h)
+extern uint8_t disk_image_start[];
+
+// Contador de ciclos del procesador (marcas de tiempo de la traza). La
+// instrucción es la misma en i686 y en x86-64, así que sirve en el host.
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+#endif
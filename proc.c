@@ -0,0 +1,331 @@
+// proc.c: programas de usuario en ring 3 (ver proc.h y syscall.h)
+//
+// La paginación es mínima: un directorio de páginas de 4 MiB que mapea los
+// 4 GiB sobre sí mismos sólo para ring 0 (el kernel no cambia nada) más una
+// entrada accesible desde ring 3 en USER_BASE, que apunta a la memoria
+// física reservada. Como sólo hay un programa a la vez, no hace falta
+// cambiar de espacio de direcciones: se carga en la misma ventana cada vez.
+//
+// El kernel escribe en la ventana directamente (carga del ELF, read), así
+// que toda dirección que llega de ring 3 se comprueba antes de usarla.
+//
+// En el kernel de 64 bits las tablas son las de 4 niveles de boot64.s, con
+// páginas de 2 MiB, y los programas (los mismos ELF de 32 bits) corren en
+// modo compatibilidad.
+
+#include <stdint.h>
+#include "klib.h"
+#include "platform.h"
+#include "cpu.h"
+#include "idt.h"
+#include "fs.h"
+#include "syscall.h"
+#include "proc.h"
+
+#define PAGE_PRESENT 0x01
+#define PAGE_WRITE   0x02
+#define PAGE_USER    0x04
+#define PAGE_4M      0x80          // 2 MiB en las tablas de modo largo
+
+#define PROC_FILES     8             // Archivos abiertos por programa
+#define PROC_ARGS      16            // Argumentos como máximo
+#define PROC_STACK     0x10000       // Ventana reservada a la pila y argv
+#define PROC_PATH_MAX  128
+
+void     user_leave(int code) __attribute__((noreturn));   // isr.s
+int      user_enter(uint32_t eip, uint32_t esp);
+
+static int      proc_ready;
+
+static struct {
+    const char *name;
+    int       (*in)(void);
+    int       (*brk)(void);
+    int         files[PROC_FILES];   // Descriptor de fs.c, o -1
+    int         killed;              // 1 por una excepción, 2 por 'brk'
+} proc;
+
+static proc_stats stats;
+
+// =============================================================================
+// PAGINACIÓN
+// =============================================================================
+#ifdef __x86_64__
+extern uint64_t boot_pml4[512], boot_pdpt[512], boot_pd[4 * 512];   // boot64.s
+
+// La paginación ya está activa: la ventana son dos entradas de 2 MiB de los
+// directorios de boot64.s. El bit de usuario tiene que estar también en la
+// PML4 y la PDPT; lo que no es la ventana sigue siendo sólo de ring 0 porque
+// sus entradas de directorio no lo llevan.
+int proc_init(uint32_t phys) {
+    for (uint32_t off = 0; off < USER_SIZE; off += 0x200000) {
+        boot_pd[(USER_BASE + off) >> 21] = (phys + off) | PAGE_4M | PAGE_USER | PAGE_WRITE | PAGE_PRESENT;
+    }
+    boot_pdpt[USER_BASE >> 30] |= PAGE_USER;
+    boot_pml4[0] |= PAGE_USER;
+
+    uintptr_t cr;
+    asm volatile ("mov %%cr3, %0" : "=r"(cr));
+    asm volatile ("mov %0, %%cr3" : : "r"(cr) : "memory");   // Vacía la TLB
+    proc_ready = 1;
+    return 1;
+}
+#else
+static uint32_t page_dir[1024] __attribute__((aligned(4096)));
+
+int proc_init(uint32_t phys) {
+    if (!cpu_has(CPU_PSE)) return 0;   // Páginas de 4 MiB
+
+    for (uint32_t i = 0; i < 1024; i++) page_dir[i] = (i << 22) | PAGE_4M | PAGE_WRITE | PAGE_PRESENT;
+    page_dir[USER_BASE >> 22] = phys | PAGE_4M | PAGE_USER | PAGE_WRITE | PAGE_PRESENT;
+
+    uint32_t cr;
+    asm volatile ("mov %%cr4, %0" : "=r"(cr));
+    asm volatile ("mov %0, %%cr4" : : "r"(cr | 0x10));            // CR4.PSE
+    asm volatile ("mov %0, %%cr3" : : "r"((uint32_t)page_dir));
+    asm volatile ("mov %%cr0, %0" : "=r"(cr));
+    asm volatile ("mov %0, %%cr0" : : "r"(cr | 0x80000000));      // CR0.PG
+    proc_ready = 1;
+    return 1;
+}
+#endif
+
+// 1 si [p, p + len) cae dentro de la ventana de usuario
+static int user_range(uint32_t p, uint32_t len) {
+    return p >= USER_BASE && p <= USER_END && len <= USER_END - p;
+}
+
+// Copia una cadena de ring 3. Retorna 0 si se sale de la ventana o no cabe.
+static int user_string(uint32_t p, char *dst, uint32_t max) {
+    for (uint32_t i = 0; i < max; i++, p++) {
+        if (!user_range(p, 1)) return 0;
+        dst[i] = *(const char *)(uintptr_t)p;
+        if (!dst[i]) return 1;
+    }
+    return 0;
+}
+
+// =============================================================================
+// LLAMADAS AL SISTEMA
+// =============================================================================
+static int proc_fd(uint32_t fd) {
+    if (fd < FIRST_FD || fd >= FIRST_FD + PROC_FILES) return -1;
+    return proc.files[fd - FIRST_FD];
+}
+
+// La entrada se entrega por líneas, como una terminal: read vuelve tras '\n'
+static int stdin_read(uint8_t *buf, uint32_t len) {
+    uint32_t n = 0;
+    while (n < len) {
+        int c = proc.in();
+        if (c < 0) break;
+        buf[n++] = c;
+        if (c == '\n') break;
+    }
+    return n;
+}
+
+// Ctrl+C: se mira sólo al usar la consola, no en cada llamada (SYS_NOP
+// mide justo el coste de entrar y salir)
+static void proc_check_break(void) {
+    if (proc.brk && proc.brk()) {
+        proc.killed = 2;
+        user_leave(-1);
+    }
+}
+
+static int sys_open(uint32_t path, uint32_t flags) {
+    char name[PROC_PATH_MAX];
+    if (!user_string(path, name, sizeof(name))) return -1;
+    int slot = 0;
+    while (slot < PROC_FILES && proc.files[slot] >= 0) slot++;
+    if (slot == PROC_FILES) return -1;
+    int fd = fs_open(name, flags & (O_ACCMODE | O_CREAT | O_TRUNC | O_APPEND));
+    if (fd < 0) return -1;
+    proc.files[slot] = fd;
+    return FIRST_FD + slot;
+}
+
+static uint32_t proc_syscall(uint32_t num, uint32_t a, uint32_t b, uint32_t c) {
+    stats.syscalls++;
+    int fd;
+    switch (num) {
+    case SYS_EXIT:
+        user_leave(a);
+        return 0;
+    case SYS_READ:
+        if (!user_range(b, c)) return -1;
+        if (a == STDIN_FD) {
+            proc_check_break();
+            return stdin_read((uint8_t *)(uintptr_t)b, c);
+        }
+        if ((fd = proc_fd(a)) < 0) return -1;
+        return fs_fread(fd, (void *)(uintptr_t)b, c);
+    case SYS_WRITE:
+        if (!user_range(b, c)) return -1;
+        if (a == STDOUT_FD) {
+            proc_check_break();
+            for (uint32_t i = 0; i < c; i++) putchar(((const char *)(uintptr_t)b)[i]);
+            return c;
+        }
+        if ((fd = proc_fd(a)) < 0) return -1;
+        return fs_fwrite(fd, (const void *)(uintptr_t)b, c);
+    case SYS_OPEN:
+        return sys_open(a, b);
+    case SYS_CLOSE:
+        if ((fd = proc_fd(a)) < 0) return -1;
+        fs_close(fd);
+        proc.files[a - FIRST_FD] = -1;
+        return 0;
+    case SYS_LSEEK:
+        if ((fd = proc_fd(a)) < 0) return -1;
+        return fs_lseek(fd, b, c);
+    case SYS_UNLINK: {
+        char name[PROC_PATH_MAX];
+        if (!user_string(a, name, sizeof(name))) return -1;
+        return fs_unlink(name) ? -1 : 0;
+    }
+    case SYS_NOP:
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+// Una excepción en ring 3: se informa y el programa termina ahí mismo
+static void proc_fault(interrupt_frame *frame) {
+    printf("%s: excepcion %u (%s) en eip=0x%lx", proc.name, (uint32_t)frame->vector,
+           exception_name(frame->vector), (unsigned long)frame->eip);
+    if (frame->vector == 14) {
+        uintptr_t addr;
+        asm volatile ("mov %%cr2, %0" : "=r"(addr));
+        printf(", direccion 0x%lx", (unsigned long)addr);
+    }
+    printf("\n");
+    proc.killed = 1;
+    user_leave(-1);
+}
+
+// =============================================================================
+// CARGA DE ELF
+// =============================================================================
+typedef struct __attribute__((packed)) {
+    uint8_t  ident[16];
+    uint16_t type, machine;
+    uint32_t version, entry, phoff, shoff, flags;
+    uint16_t ehsize, phentsize, phnum, shentsize, shnum, shstrndx;
+} elf_header;
+
+typedef struct __attribute__((packed)) {
+    uint32_t type, offset, vaddr, paddr, filesz, memsz, flags, align;
+} elf_phdr;
+
+#define ELF_EXEC   2
+#define ELF_386    3
+#define PT_LOAD    1
+#define ELF_PHDRS  16
+
+// Copia los segmentos PT_LOAD a la ventana y pone a cero su bss. Retorna
+// el punto de entrada, o 0 si el archivo no es un programa para aquí.
+static uint32_t elf_load(int fd) {
+    elf_header eh;
+    elf_phdr ph[ELF_PHDRS];
+    if (fs_fread(fd, &eh, sizeof(eh)) != (int)sizeof(eh)) return 0;
+    if (memcmp(eh.ident, "\x7F" "ELF", 4) || eh.ident[4] != 1 || eh.ident[5] != 1 ||
+        eh.type != ELF_EXEC || eh.machine != ELF_386 || eh.phentsize != sizeof(elf_phdr) ||
+        eh.phnum > ELF_PHDRS) return 0;
+
+    uint32_t size = eh.phnum * sizeof(elf_phdr);
+    if (fs_lseek(fd, eh.phoff, SEEK_SET) != (int)eh.phoff || fs_fread(fd, ph, size) != (int)size) return 0;
+    for (int i = 0; i < eh.phnum; i++) {
+        if (ph[i].type != PT_LOAD) continue;
+        if (ph[i].filesz > ph[i].memsz || !user_range(ph[i].vaddr, ph[i].memsz) ||
+            ph[i].vaddr + ph[i].memsz > USER_END - PROC_STACK) return 0;
+        uint8_t *dst = (uint8_t *)(uintptr_t)ph[i].vaddr;
+        if (fs_lseek(fd, ph[i].offset, SEEK_SET) != (int)ph[i].offset ||
+            fs_fread(fd, dst, ph[i].filesz) != (int)ph[i].filesz) return 0;
+        memset(dst + ph[i].filesz, 0, ph[i].memsz - ph[i].filesz);
+    }
+    return user_range(eh.entry, 1) ? eh.entry : 0;
+}
+
+// Prepara la pila inicial de crt0: argc, argv y las capacidades de la CPU
+// encima, y las cadenas en lo más alto de la ventana. Retorna la ESP.
+static uint32_t push_args(const char *name, const char *args) {
+    char *sp = (char *)(uintptr_t)USER_END;
+    uint32_t argv[PROC_ARGS + 1];
+    int argc = 0;
+
+    const char *word = name;
+    uint32_t len = strlen(name);
+    for (;;) {
+        sp -= len + 1;
+        memcpy(sp, word, len);
+        sp[len] = '\0';
+        argv[argc++] = (uint32_t)(uintptr_t)sp;
+
+        while (args && *args == ' ') args++;
+        if (!args || !*args || argc == PROC_ARGS) break;
+        word = args;
+        while (*args && *args != ' ') args++;
+        len = args - word;
+    }
+
+    uint32_t *stack = (uint32_t *)((uintptr_t)sp & ~(uintptr_t)3);
+    *--stack = 0;
+    for (int i = argc - 1; i >= 0; i--) *--stack = argv[i];
+    uint32_t argv_user = (uint32_t)(uintptr_t)stack;
+    *--stack = sysenter_available() ? PROC_SYSENTER : 0;
+    *--stack = argv_user;
+    *--stack = argc;
+    return (uint32_t)(uintptr_t)stack;
+}
+
+// =============================================================================
+// EJECUCIÓN
+// =============================================================================
+int proc_exec(const char *path, const char *name, const char *args,
+              int (*in)(void), int (*brk)(void), int *status) {
+    if (!proc_ready) return -3;
+    int fd = fs_open(path, O_RDONLY);
+    if (fd < 0) return 0;
+
+    static int installed;
+    if (!installed) {
+        syscall_install(proc_syscall, proc_fault);
+        installed = 1;
+    }
+    uint64_t t0 = rdtsc();
+    uint32_t entry = elf_load(fd);
+    fs_close(fd);
+    stats.load_cycles = (uint32_t)(rdtsc() - t0);
+    if (!entry) return -1;
+
+    proc.name = name;
+    proc.in = in;
+    proc.brk = brk;
+    proc.killed = 0;
+    for (int i = 0; i < PROC_FILES; i++) proc.files[i] = -1;
+    stats.runs++;
+
+    int code = user_enter(entry, push_args(name, args));
+
+    // Lo que el programa dejó abierto se cierra aquí, haya salido o no
+    for (int i = 0; i < PROC_FILES; i++) {
+        if (proc.files[i] >= 0) fs_close(proc.files[i]);
+    }
+    if (proc.killed == 2) {
+        stats.interrupted++;
+        return -4;
+    }
+    if (proc.killed) {
+        stats.killed++;
+        return -2;
+    }
+    *status = code;
+    return 1;
+}
+
+void proc_get_stats(proc_stats *st) {
+    *st = stats;
+}
@@ -0,0 +1,37 @@
+// proc.h: programas de usuario en ring 3 (proc.c)
+//
+// Un programa es un ELF de 32 bits guardado en el disco (los de user/ van a
+// /bin en la imagen). Se carga cuando se usa, corre hasta que termina y el
+// shell sigue: no hay multitarea. Vive en una ventana de 4 MiB con
+// paginación (ver syscall.h), así que no puede tocar la memoria del kernel;
+// si falla, sólo muere él.
+#ifndef PROC_H
+#define PROC_H
+
+#include <stdint.h>
+
+// Activa la paginación y reserva la ventana de usuario en la dirección
+// física 'phys' (alineada a 4 MiB y libre). Retorna 0 si la CPU no admite
+// páginas de 4 MiB; en ese caso no se pueden ejecutar programas.
+int proc_init(uint32_t phys);
+
+// Ejecuta 'path' con la línea de argumentos 'args' (puede ser NULL); argv[0]
+// es 'name'. La entrada del programa sale de 'in', que retorna un byte o -1
+// al final; la salida va a putchar. 'brk' (puede ser NULL) se consulta en
+// cada read y write de la consola: si retorna 1, el programa termina ahí.
+// Retorna 1 y deja en 'status' el código de salida, 0 si no existe, -1 si
+// no es un ejecutable válido, -2 si lo terminó una excepción, -3 si no hay
+// ventana de usuario o -4 si lo interrumpió 'brk'.
+int proc_exec(const char *path, const char *name, const char *args,
+              int (*in)(void), int (*brk)(void), int *status);
+
+typedef struct {
+    uint32_t runs, killed;          // Programas ejecutados y terminados por un fallo
+    uint32_t interrupted;           // Terminados con Ctrl+C
+    uint32_t syscalls;              // Llamadas al sistema atendidas
+    uint32_t load_cycles;           // Ciclos cargando el último programa
+} proc_stats;
+
+void proc_get_stats(proc_stats *st);
+
+#endif
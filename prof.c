@@ -0,0 +1,221 @@
+// prof.c: perfilador estadístico por muestreo (ver prof.h)
+//
+// Cada muestra suma uno a la función interrumpida ("self") y a todas las
+// funciones distintas de su cadena de llamadas ("total"), y anota cada par
+// llamador -> llamado en una tabla hash para el grafo de llamadas. Todo se
+// resuelve a índices de ksyms en la propia interrupción (una bisección), así
+// que el informe no necesita guardar las muestras una a una.
+
+#include <stdint.h>
+#include "platform.h"
+#include "idt.h"
+#include "ksyms.h"
+#include "prof.h"
+
+#define PROF_MAX_SYMS 2048   // Funciones distintas que se pueden contar
+#define PROF_DEPTH    16     // Marcos de pila que se recorren por muestra
+#define PROF_EDGES    1024   // Pares llamador -> llamado (potencia de 2)
+
+typedef struct {
+    uint16_t caller, callee;
+    uint32_t count;          // 0 = hueco libre
+} prof_edge;
+
+static uint32_t  prof_self[PROF_MAX_SYMS];
+static uint32_t  prof_total[PROF_MAX_SYMS];
+static prof_edge prof_edges[PROF_EDGES];
+static uint32_t  prof_samples, prof_idle_samples, prof_unknown, prof_edges_lost;
+static uint32_t  prof_hz;
+static int       prof_on;
+
+volatile int prof_idle;
+
+extern uint8_t stack_bottom[], stack_top[];   // boot.s
+extern uint8_t _etext[];                      // linker.ld
+
+// Índice de la función que contiene 'addr', o -1 si cae fuera del código
+static int ksym_find(uintptr_t addr) {
+    if (!ksyms_count || addr < ksyms[0].addr || addr >= (uintptr_t)_etext) return -1;
+    uint32_t lo = 0, hi = ksyms_count;   // ksyms[lo].addr <= addr < ksyms[hi].addr
+    while (hi - lo > 1) {
+        uint32_t mid = (lo + hi) / 2;
+        if (ksyms[mid].addr <= addr) lo = mid;
+        else hi = mid;
+    }
+    return lo < PROF_MAX_SYMS ? (int)lo : -1;
+}
+
+static void prof_add_edge(int caller, int callee) {
+    uint32_t key = (uint32_t)caller * PROF_MAX_SYMS + callee;
+    uint32_t h = (key * 2654435761u) >> 22;   // 10 bits: PROF_EDGES
+    for (int probe = 0; probe < PROF_EDGES; probe++) {
+        prof_edge *e = &prof_edges[(h + probe) & (PROF_EDGES - 1)];
+        if (!e->count) {
+            e->caller = caller;
+            e->callee = callee;
+        } else if (e->caller != caller || e->callee != callee) {
+            continue;
+        }
+        e->count++;
+        return;
+    }
+    prof_edges_lost++;
+}
+
+// Manejador de la IRQ del temporizador. Si la función interrumpida todavía
+// no ha creado su marco (prólogo, o una hoja sin marco), el primer llamador
+// que se ve es el de su llamador: es ruido estadístico, no un error.
+static void prof_tick(interrupt_frame *frame) {
+    if (prof_idle) {
+        prof_idle_samples++;
+        return;
+    }
+    prof_samples++;
+    int callee = ksym_find(frame->eip);
+    if (callee < 0) {
+        prof_unknown++;
+        return;
+    }
+    prof_self[callee]++;
+    prof_total[callee]++;
+
+    int seen[PROF_DEPTH + 1], nseen = 0;
+    seen[nseen++] = callee;
+    const uintptr_t *ebp = (const uintptr_t *)frame->ebp;
+    for (int depth = 0; depth < PROF_DEPTH; depth++) {
+        // Cada marco es [EBP anterior][dirección de retorno], dentro de la pila
+        if ((uintptr_t)ebp < (uintptr_t)stack_bottom || (uintptr_t)(ebp + 2) > (uintptr_t)stack_top ||
+            ((uintptr_t)ebp & (sizeof(*ebp) - 1))) break;
+        int caller = ksym_find(ebp[1] - 1);   // -1: la instrucción call, no la siguiente
+        if (caller < 0) break;
+        prof_add_edge(caller, callee);
+
+        int i = 0;
+        while (i < nseen && seen[i] != caller) i++;
+        if (i == nseen) {   // La recursión no cuenta dos veces en "total"
+            seen[nseen++] = caller;
+            prof_total[caller]++;
+        }
+
+        // La pila crece hacia abajo: el marco anterior está más arriba
+        const uintptr_t *next = (const uintptr_t *)ebp[0];
+        if (next <= ebp) break;
+        ebp = next;
+        callee = caller;
+    }
+}
+
+int prof_start(uint32_t hz) {
+    if (hz < PIT_HZ / 0xFFFF + 1 || hz > PROF_MAX_HZ) return 0;
+    prof_stop();
+    for (int i = 0; i < PROF_MAX_SYMS; i++) prof_self[i] = prof_total[i] = 0;
+    for (int i = 0; i < PROF_EDGES; i++) prof_edges[i].count = 0;
+    prof_samples = prof_idle_samples = prof_unknown = prof_edges_lost = 0;
+    prof_hz = hz;
+    pit_set_rate(hz);
+    irq_install(IRQ_TIMER, prof_tick);
+    prof_on = 1;
+    return 1;
+}
+
+void prof_stop(void) {
+    if (!prof_on) return;
+    irq_install(IRQ_TIMER, 0);
+    prof_on = 0;
+}
+
+int prof_running(void) {
+    return prof_on;
+}
+
+// =============================================================================
+// INFORME
+// =============================================================================
+// printf no entiende anchos de campo: las columnas se alinean a mano
+static void print_col(uint32_t n, int width) {
+    int digits = 1;
+    for (uint32_t v = n; v >= 10; v /= 10) digits++;
+    while (digits++ < width) putchar(' ');
+    printf("%u", n);
+}
+
+// Porcentaje con un decimal, sin coma flotante ni divisiones de 64 bits
+static void print_pct(uint32_t part, uint32_t whole) {
+    while (part > 4000000) {
+        part >>= 1;
+        whole >>= 1;
+    }
+    uint32_t tenths = part * 1000 / whole;
+    print_col(tenths / 10, 3);
+    printf(".%u%%", tenths % 10);
+}
+
+static const char *sym_name(int idx) {
+    return ksyms[idx].name;
+}
+
+// Imprime en una línea hasta 4 vecinos de 'fn' en el grafo: sus llamadores
+// o sus llamados, de más a menos muestras
+static void print_neighbours(int fn, int callers) {
+    uint8_t shown[PROF_EDGES] = { 0 };
+    int n;
+    for (n = 0; n < 4; n++) {
+        int best = -1;
+        for (int i = 0; i < PROF_EDGES; i++) {
+            const prof_edge *e = &prof_edges[i];
+            if (!e->count || shown[i] || (callers ? e->callee : e->caller) != fn) continue;
+            if (best < 0 || e->count > prof_edges[best].count) best = i;
+        }
+        if (best < 0) break;
+        shown[best] = 1;
+        printf("%s %u %s", n ? "," : (callers ? "      llamada por:" : "      llama a:    "),
+               prof_edges[best].count,
+               sym_name(callers ? prof_edges[best].caller : prof_edges[best].callee));
+    }
+    if (n) putchar('\n');
+}
+
+void prof_report(int top) {
+    printf("prof: %u muestras a %u Hz", prof_samples, prof_hz);
+    printf(" (%u en espera de teclado, %u fuera del kernel)\n", prof_idle_samples, prof_unknown);
+    if (!ksyms_count) {
+        printf("prof: el kernel se enlazo sin tabla de simbolos\n");
+        return;
+    }
+    if (!prof_samples) return;
+    if (prof_edges_lost) printf("prof: %u aristas del grafo descartadas (tabla llena)\n", prof_edges_lost);
+
+    // Perfil plano: por muestras propias y, a igualdad, por totales (así
+    // también aparecen las funciones que sólo acumulan tiempo de sus llamadas)
+    static uint8_t shown[PROF_MAX_SYMS];
+    static int order[PROF_MAX_SYMS];
+    int nsyms = ksyms_count < PROF_MAX_SYMS ? (int)ksyms_count : PROF_MAX_SYMS;
+    int count = 0;
+    for (int i = 0; i < nsyms; i++) shown[i] = 0;
+    printf("  %%self   self  total  funcion\n");
+    while (count < top) {
+        int best = -1;
+        for (int i = 0; i < nsyms; i++) {
+            if (shown[i] || !prof_total[i]) continue;
+            if (best < 0 || prof_self[i] > prof_self[best] ||
+                (prof_self[i] == prof_self[best] && prof_total[i] > prof_total[best])) best = i;
+        }
+        if (best < 0) break;
+        shown[best] = 1;
+        order[count++] = best;
+        print_pct(prof_self[best], prof_samples);
+        print_col(prof_self[best], 7);
+        print_col(prof_total[best], 7);
+        printf("  %s\n", sym_name(best));
+    }
+
+    // Grafo de llamadas de las primeras funciones del perfil plano
+    if (count > 5) count = 5;
+    if (count) printf("Grafo de llamadas (muestras por arista):\n");
+    for (int k = 0; k < count; k++) {
+        int fn = order[k];
+        printf("  %s\n", sym_name(fn));
+        print_neighbours(fn, 1);
+        print_neighbours(fn, 0);
+    }
+}
@@ -0,0 +1,24 @@
+// prof.h: perfilador estadístico por muestreo (prof.c)
+//
+// La IRQ del PIT interrumpe al kernel PROF_DEFAULT_HZ veces por segundo; en
+// cada muestra se anota la función interrumpida (EIP) y, siguiendo la
+// cadena de EBP, las funciones que la llamaron. El informe simboliza las
+// direcciones con la tabla de ksyms.h.
+#ifndef PROF_H
+#define PROF_H
+
+#include <stdint.h>
+
+#define PROF_DEFAULT_HZ 1000
+#define PROF_MAX_HZ     10000
+
+// El bucle de espera del teclado lo pone a 1 mientras sondea: esas
+// muestras cuentan como inactividad y no entran en los porcentajes
+extern volatile int prof_idle;
+
+int  prof_start(uint32_t hz);   // 0 si la frecuencia no es válida
+void prof_stop(void);
+void prof_report(int top);
+int  prof_running(void);
+
+#endif
@@ -0,0 +1,37 @@
+// syscall.h: interfaz entre los programas de usuario y el kernel
+//
+// La comparten proc.c (kernel) y la libc de user/. Un programa es un ELF de
+// 32 bits enlazado en USER_BASE (user/user.ld) que corre en ring 3 dentro de
+// una ventana de USER_SIZE bytes; la pila crece hacia abajo desde USER_END.
+//
+// Llamadas al sistema: número en EAX y hasta tres argumentos en EBX, ESI y
+// EDI; el resultado vuelve en EAX (-1 si falla). Hay dos entradas:
+// - sysenter: la rápida. La libc deja además en ECX su ESP y en EDX la
+//   dirección de retorno, que sysexit necesita; ambos se pierden.
+// - int 0x80: la de siempre, para CPUs sin sysenter. Conserva todo salvo EAX.
+// Los descriptores 0 y 1 son la entrada y la salida del shell (teclado,
+// script, '<', '>' o un pipe); los archivos abiertos empiezan en el 3.
+#ifndef SYSCALL_H
+#define SYSCALL_H
+
+#define USER_BASE  0x40000000
+#define USER_SIZE  0x00400000   // Una página de 4 MiB
+#define USER_END   (USER_BASE + USER_SIZE)
+
+#define SYS_EXIT   0   // (código)
+#define SYS_READ   1   // (fd, buf, len) -> bytes leídos, 0 al final
+#define SYS_WRITE  2   // (fd, buf, len) -> bytes escritos
+#define SYS_OPEN   3   // (ruta, flags de fs.h) -> fd
+#define SYS_CLOSE  4   // (fd)
+#define SYS_LSEEK  5   // (fd, desplazamiento, SEEK_*) -> posición
+#define SYS_NOP    6   // No hace nada: mide el coste de ida y vuelta
+#define SYS_UNLINK 7   // (ruta)
+
+#define STDIN_FD   0
+#define STDOUT_FD  1
+#define FIRST_FD   3
+
+// Tercer argumento de arranque (ver user/crt0.s): lo que sabe hacer la CPU
+#define PROC_SYSENTER 0x1
+
+#endif
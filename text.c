@@ -0,0 +1,409 @@
+// text.c: operadores de texto de los pipes (grep, wc, head, tail, rev,
+// sort, uniq, cut y cat)
+//
+// Son corrutinas sin pila (coro.h): lo que tiene que sobrevivir a una espera
+// vive en text_stage. El pipe de kernel.c las encadena con anillos; las
+// funciones text_grep() y compañía hacen lo mismo con una cadena de entrada.
+
+#include <stdint.h>
+#include "klib.h"
+#include "platform.h"
+#include "coro.h"
+#include "text.h"
+
+// Añade el byte leído a la línea en curso. Retorna 1 cuando hay una línea
+// completa en s->line: al llegar '\n', o al final si quedaba algo.
+static int line_feed(text_stage *s, int ch) {
+    if (ch >= 0 && ch != '\n') {
+        if (s->len < TEXT_LINE - 1) s->line[s->len++] = ch;
+        return 0;
+    }
+    s->line[s->len] = '\0';
+    return ch == '\n' || s->len;
+}
+
+// Escribe 'v' en decimal en 'dst' y retorna cuántos caracteres ocupa
+static uint32_t format_num(char *dst, uint32_t v) {
+    char tmp[10];
+    uint32_t n = 0;
+    do { tmp[n++] = '0' + v % 10; v /= 10; } while (v);
+    for (uint32_t i = 0; i < n; i++) dst[i] = tmp[n - 1 - i];
+    return n;
+}
+
+// =============================================================================
+// FUENTE Y CAT
+// =============================================================================
+static int source_step(coro *c) {
+    text_stage *s = (text_stage *)c;
+    CORO_BEGIN(c);
+    for (s->i = 0; s->i < s->buf_len; s->i++) {
+        CORO_PUT(c, s->src[s->i]);
+    }
+    CORO_END(c);
+}
+
+static int cat_step(coro *c) {
+    text_stage *s = (text_stage *)c;
+    CORO_BEGIN(c);
+    for (;;) {
+        CORO_GET(c, s->ch);
+        if (s->ch < 0) break;
+        CORO_PUT(c, s->ch);
+    }
+    CORO_END(c);
+}
+
+// =============================================================================
+// OPERADORES POR LÍNEAS: grep, head, uniq, cut
+// =============================================================================
+// grep palabra: las líneas que contienen el patrón
+static int grep_step(coro *c) {
+    text_stage *s = (text_stage *)c;
+    CORO_BEGIN(c);
+    if (!c->out) printf("Buscando '%s' en la salida:\n", s->pattern);
+    for (;;) {
+        CORO_GET(c, s->ch);
+        if (line_feed(s, s->ch) && strstr(s->line, s->pattern)) {
+            for (s->i = 0; s->i < s->len; s->i++) {
+                CORO_PUT(c, s->line[s->i]);
+            }
+            CORO_PUT(c, '\n');
+        }
+        if (s->ch < 0) break;
+        if (s->ch == '\n') s->len = 0;
+    }
+    CORO_END(c);
+}
+
+// Las primeras n líneas. Al terminar, el planificador cancela lo anterior:
+// 'yes | head 3' acaba.
+static int head_step(coro *c) {
+    text_stage *s = (text_stage *)c;
+    CORO_BEGIN(c);
+    s->lines = 0;
+    s->len = 0;   // Caracteres de la línea en curso ya escritos
+    while ((int)s->lines < s->n) {
+        CORO_GET(c, s->ch);
+        if (s->ch < 0) {
+            if (s->len) CORO_PUT(c, '\n');
+            break;
+        }
+        CORO_PUT(c, s->ch);
+        if (s->ch == '\n') {
+            s->lines++;
+            s->len = 0;
+        } else {
+            s->len++;
+        }
+    }
+    CORO_END(c);
+}
+
+// Quita las líneas repetidas seguidas; s->buf guarda la anterior
+static int uniq_step(coro *c) {
+    text_stage *s = (text_stage *)c;
+    CORO_BEGIN(c);
+    s->buf_len = 0;   // 1 cuando ya hay línea anterior
+    for (;;) {
+        CORO_GET(c, s->ch);
+        if (line_feed(s, s->ch) && (!s->buf_len || strcmp(s->line, s->buf))) {
+            memcpy(s->buf, s->line, s->len + 1);
+            s->buf_len = 1;
+            for (s->i = 0; s->i < s->len; s->i++) {
+                CORO_PUT(c, s->line[s->i]);
+            }
+            CORO_PUT(c, '\n');
+        }
+        if (s->ch < 0) break;
+        if (s->ch == '\n') s->len = 0;
+    }
+    CORO_END(c);
+}
+
+// Deja en [s->i, s->j) el campo s->n de la línea. Con el espacio como
+// separador, varios seguidos cuentan como uno (la salida de ls o ps).
+// Una línea sin separadores sale entera, como en Unix.
+static void cut_field(text_stage *s) {
+    if (!strchr(s->line, s->delim)) {
+        s->i = 0;
+        s->j = s->len;
+        return;
+    }
+    uint32_t p = 0;
+    if (s->delim == ' ') while (p < s->len && s->line[p] == ' ') p++;
+    for (int field = 1; ; field++) {
+        uint32_t end = p;
+        while (end < s->len && s->line[end] != s->delim) end++;
+        if (field == s->n || end == s->len) {
+            s->i = p;
+            s->j = field == s->n ? end : p;
+            return;
+        }
+        p = end + 1;
+        if (s->delim == ' ') while (p < s->len && s->line[p] == ' ') p++;
+    }
+}
+
+static int cut_step(coro *c) {
+    text_stage *s = (text_stage *)c;
+    CORO_BEGIN(c);
+    for (;;) {
+        CORO_GET(c, s->ch);
+        if (line_feed(s, s->ch)) {
+            cut_field(s);
+            for (; s->i < s->j; s->i++) {
+                CORO_PUT(c, s->line[s->i]);
+            }
+            CORO_PUT(c, '\n');
+        }
+        if (s->ch < 0) break;
+        if (s->ch == '\n') s->len = 0;
+    }
+    CORO_END(c);
+}
+
+// =============================================================================
+// OPERADORES QUE ESPERAN AL FINAL: wc, tail, rev, sort
+// =============================================================================
+// Contar líneas, palabras, caracteres
+static int wc_step(coro *c) {
+    text_stage *s = (text_stage *)c;
+    CORO_BEGIN(c);
+    s->lines = s->words = s->chars = 0;
+    s->in_word = 0;
+    for (;;) {
+        CORO_GET(c, s->ch);
+        if (s->ch < 0) break;
+        s->chars++;
+        if (s->ch == '\n') s->lines++;
+        if (s->ch == ' ' || s->ch == '\n' || s->ch == '\t') {
+            s->in_word = 0;
+        } else if (!s->in_word) {
+            s->in_word = 1;
+            s->words++;
+        }
+    }
+
+    // "  %d  %d  %d\n", armado aquí porque puede ir a otra etapa
+    s->len = 0;
+    uint32_t v[3] = { s->lines, s->words, s->chars };
+    for (int k = 0; k < 3; k++) {
+        s->line[s->len++] = ' ';
+        s->line[s->len++] = ' ';
+        s->len += format_num(s->line + s->len, v[k]);
+    }
+    s->line[s->len++] = '\n';
+    for (s->i = 0; s->i < s->len; s->i++) {
+        CORO_PUT(c, s->line[s->i]);
+    }
+    CORO_END(c);
+}
+
+// Las últimas n líneas. s->buf es circular con los últimos TEXT_BUF bytes;
+// s->chars cuenta todos los leídos.
+static int tail_step(coro *c) {
+    text_stage *s = (text_stage *)c;
+    CORO_BEGIN(c);
+    s->chars = 0;
+    for (;;) {
+        CORO_GET(c, s->ch);
+        if (s->ch < 0) break;
+        s->buf[s->chars++ % TEXT_BUF] = s->ch;
+    }
+
+    // Hacia atrás desde el final, sin contar el '\n' de la última línea
+    s->j = s->chars;
+    s->i = s->chars > TEXT_BUF ? s->chars - TEXT_BUF : 0;
+    if (s->j > s->i && s->buf[(s->j - 1) % TEXT_BUF] == '\n') s->j--;
+    s->lines = 0;
+    for (uint32_t p = s->j; p > s->i; p--) {
+        if (s->buf[(p - 1) % TEXT_BUF] == '\n' && ++s->lines == (uint32_t)s->n) {
+            s->i = p;
+            break;
+        }
+    }
+    if (!s->n) s->i = s->j = s->chars;
+    for (; s->i < s->chars; s->i++) {
+        CORO_PUT(c, s->buf[s->i % TEXT_BUF]);
+    }
+    if (s->j == s->chars && s->i > 0 && s->n) CORO_PUT(c, '\n');
+    CORO_END(c);
+}
+
+// Invertir toda la entrada (los primeros TEXT_BUF bytes)
+static int rev_step(coro *c) {
+    text_stage *s = (text_stage *)c;
+    CORO_BEGIN(c);
+    s->buf_len = 0;
+    for (;;) {
+        CORO_GET(c, s->ch);
+        if (s->ch < 0) break;
+        if (s->buf_len < TEXT_BUF) s->buf[s->buf_len++] = s->ch;
+    }
+    if (!c->out) printf("Texto invertido:\n");
+    for (s->i = s->buf_len; s->i > 0; s->i--) {
+        CORO_PUT(c, s->buf[s->i - 1]);
+    }
+    CORO_PUT(c, '\n');
+    CORO_END(c);
+}
+
+// Ordena las líneas que quepan en s->buf (inserción: son pocas)
+static void sort_lines(text_stage *s) {
+    s->lines = 0;
+    uint32_t p = 0;
+    while (p < s->buf_len && s->lines < TEXT_LINES) {
+        s->starts[s->lines++] = p;
+        while (s->buf[p] != '\n') p++;
+        s->buf[p++] = '\0';
+    }
+    for (uint32_t i = 1; i < s->lines; i++) {
+        uint16_t key = s->starts[i];
+        uint32_t j = i;
+        while (j > 0 && strcmp(s->buf + s->starts[j - 1], s->buf + key) > 0) {
+            s->starts[j] = s->starts[j - 1];
+            j--;
+        }
+        s->starts[j] = key;
+    }
+}
+
+static int sort_step(coro *c) {
+    text_stage *s = (text_stage *)c;
+    CORO_BEGIN(c);
+    s->buf_len = 0;
+    for (;;) {
+        CORO_GET(c, s->ch);
+        if (s->ch < 0) break;
+        if (s->buf_len < TEXT_BUF - 1) s->buf[s->buf_len++] = s->ch;
+    }
+    if (s->buf_len && s->buf[s->buf_len - 1] != '\n') s->buf[s->buf_len++] = '\n';
+    sort_lines(s);
+
+    for (s->j = 0; s->j < s->lines; s->j++) {
+        for (s->i = s->starts[s->j]; s->buf[s->i]; s->i++) {
+            CORO_PUT(c, s->buf[s->i]);
+        }
+        CORO_PUT(c, '\n');
+    }
+    CORO_END(c);
+}
+
+// =============================================================================
+// CONSTRUCCIÓN DE ETAPAS
+// =============================================================================
+// Si 'cmd' es 'name' (solo o con argumentos) retorna sus argumentos
+static const char *command_args(const char *cmd, const char *name) {
+    uint32_t len = strlen(name);
+    if (strncmp(cmd, name, len) || (cmd[len] && cmd[len] != ' ')) return 0;
+    cmd += len;
+    while (*cmd == ' ') cmd++;
+    return cmd;
+}
+
+// "n", "-n", "-n n" o nada
+static int line_count(const char *args) {
+    if (*args == '-') args++;
+    if (*args == 'n') args++;
+    while (*args == ' ') args++;
+    return *args >= '0' && *args <= '9' ? atoi(args) : 10;
+}
+
+static void cut_args(text_stage *s, const char *args) {
+    s->delim = ' ';
+    s->n = 1;
+    while (*args) {
+        if (args[0] == '-' && args[1] == 'd') {
+            args += 2;
+            while (*args == ' ') args++;
+            if (*args) s->delim = *args++;
+        } else if (args[0] == '-' && args[1] == 'f') {
+            args += 2;
+        } else if (*args >= '0' && *args <= '9') {
+            s->n = atoi(args);
+            while (*args >= '0' && *args <= '9') args++;
+        } else {
+            args++;
+        }
+        while (*args == ' ') args++;
+    }
+}
+
+int text_stage_init(text_stage *s, const char *cmd, ring *in, ring *out) {
+    static const struct {
+        const char *name;
+        int       (*step)(coro *c);
+    } ops[] = {
+        { "grep", grep_step }, { "wc",   wc_step },   { "head", head_step },
+        { "tail", tail_step }, { "rev",  rev_step },  { "sort", sort_step },
+        { "uniq", uniq_step }, { "cut",  cut_step },  { "cat",  cat_step },
+    };
+    const char *args = 0;
+    uint32_t k;
+    for (k = 0; k < sizeof(ops) / sizeof(ops[0]); k++) {
+        if ((args = command_args(cmd, ops[k].name))) break;
+    }
+    if (!args) return 0;
+    // 'rev texto' y 'cat archivo' no leen del pipe: son de kernel.c
+    if ((ops[k].step == rev_step || ops[k].step == cat_step) && *args) return 0;
+    if (ops[k].step == grep_step && !*args) return 0;
+
+    coro_init(&s->c, ops[k].step, in, out);
+    s->len = 0;
+    s->n = line_count(args);
+    if (ops[k].step == grep_step) {
+        uint32_t len = strlen(args);
+        if (len >= sizeof(s->pattern)) len = sizeof(s->pattern) - 1;
+        memcpy(s->pattern, args, len);
+        s->pattern[len] = '\0';
+    } else if (ops[k].step == cut_step) {
+        cut_args(s, args);
+    }
+    return 1;
+}
+
+void text_source_init(text_stage *s, const char *text, uint32_t len, ring *out) {
+    coro_init(&s->c, source_step, 0, out);
+    s->src = text;
+    s->buf_len = len;
+}
+
+// =============================================================================
+// SOBRE UNA CADENA
+// =============================================================================
+static text_stage str_source, str_op;
+static ring       str_ring;
+
+static void text_run(const char *buf) {
+    ring_init(&str_ring);
+    text_source_init(&str_source, buf, strlen(buf), &str_ring);
+    coro *v[2] = { &str_source.c, &str_op.c };
+    coro_run(v, 2, 0);
+}
+
+void text_grep(const char *buf, const char *pattern) {
+    coro_init(&str_op.c, grep_step, &str_ring, 0);
+    str_op.len = 0;
+    uint32_t len = strlen(pattern);
+    if (len >= sizeof(str_op.pattern)) len = sizeof(str_op.pattern) - 1;
+    memcpy(str_op.pattern, pattern, len);
+    str_op.pattern[len] = '\0';
+    text_run(buf);
+}
+
+void text_wc(const char *buf) {
+    coro_init(&str_op.c, wc_step, &str_ring, 0);
+    text_run(buf);
+}
+
+void text_head(const char *buf, int max_lines) {
+    coro_init(&str_op.c, head_step, &str_ring, 0);
+    str_op.n = max_lines;
+    text_run(buf);
+}
+
+void text_rev(const char *buf) {
+    coro_init(&str_op.c, rev_step, &str_ring, 0);
+    text_run(buf);
+}
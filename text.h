@@ -0,0 +1,48 @@
+// text.h: operadores de texto de los pipes (text.c)
+//
+// Cada operador es una etapa de pipe (ver coro.h): lee de su anillo de
+// entrada y escribe en el de salida, o con putchar si es la última. Los que
+// trabajan por líneas sólo guardan la línea en curso; rev, sort y tail
+// necesitan ver más y se quedan con TEXT_BUF bytes como mucho. Igual que
+// fs.c, sólo dependen de platform.h.
+#ifndef TEXT_H
+#define TEXT_H
+
+#include <stdint.h>
+#include "coro.h"
+
+#define TEXT_LINE  256    // Las líneas más largas se cortan
+#define TEXT_BUF   4096   // Lo que guardan rev, sort y tail
+#define TEXT_LINES 256    // Líneas que ordena sort
+
+typedef struct {
+    coro        c;                  // Primero: la etapa se usa como coro *
+    int         ch;                 // Último byte leído
+    int         n;                  // head y tail: líneas; cut: campo
+    char        delim;              // cut
+    char        pattern[64];        // grep
+    uint32_t    lines, words, chars;
+    int         in_word;            // wc
+    uint32_t    len, i, j;          // Línea en curso y posiciones al escribir
+    char        line[TEXT_LINE];
+    const char *src;                // Fuente: el texto, que no se copia
+    uint32_t    buf_len;
+    char        buf[TEXT_BUF];      // rev, sort, tail y la línea anterior de uniq
+    uint16_t    starts[TEXT_LINES]; // sort
+} text_stage;
+
+// Prepara 's' como el operador de 'cmd': "grep <patrón>", "wc", "head [n]",
+// "tail [n]", "rev", "sort", "uniq", "cut [-d c] [-f] <campo>" o "cat".
+// Retorna 0 si 'cmd' no es ninguno de ellos.
+int text_stage_init(text_stage *s, const char *cmd, ring *in, ring *out);
+
+// Etapa que escribe los 'len' bytes de 'text' (deben seguir ahí mientras corre)
+void text_source_init(text_stage *s, const char *text, uint32_t len, ring *out);
+
+// Pasan una cadena terminada en '\0' por un operador e imprimen el resultado
+void text_grep(const char *buf, const char *pattern);
+void text_wc(const char *buf);
+void text_head(const char *buf, int max_lines);
+void text_rev(const char *buf);
+
+#endif
@@ -0,0 +1,263 @@
+// timer.c: temporizadores en un montículo y timer one-shot del APIC local
+// (ver timer.h)
+//
+// El montículo guarda punteros a temporizadores de quien los usa, así que
+// no hay memoria que reservar: arrancar y cancelar cuesta O(log n) y el
+// plazo más cercano está siempre en heap[0], que es lo único que necesita
+// el APIC. Nada de esto se toca desde una interrupción: el manejador del
+// timer sólo da el EOI, y la CPU ya ha salido de hlt.
+
+#include <stdint.h>
+#include "klib.h"
+#include "platform.h"
+#include "cpu.h"
+#include "idt.h"
+#include "timer.h"
+
+#define TIMER_VECTOR    LOCAL_BASE
+#define SPURIOUS_VECTOR 63
+
+#define MSR_APIC_BASE    0x1B
+#define MSR_TSC_DEADLINE 0x6E0
+#define APIC_BASE_ENABLE (1 << 11)
+
+// Registros del APIC local (desplazamientos en bytes)
+#define APIC_TPR      0x080
+#define APIC_EOI      0x0B0
+#define APIC_SVR      0x0F0
+#define APIC_LVT_TIMER 0x320
+#define APIC_LVT_LINT0 0x350
+#define APIC_LVT_LINT1 0x360
+#define APIC_INITIAL  0x380
+#define APIC_CURRENT  0x390
+#define APIC_DIVIDE   0x3E0
+
+#define APIC_SVR_ENABLE  0x100
+#define APIC_LVT_MASKED  (1 << 16)
+#define APIC_LVT_DEADLINE (2 << 17)
+#define APIC_DM_NMI      0x400
+#define APIC_DM_EXTINT   0x700
+
+enum { MODE_POLL, MODE_ONESHOT, MODE_DEADLINE };
+
+static timer          *heap[TIMER_MAX];
+static int             heap_n;
+static timer_stats     stats;
+static volatile uint32_t *lapic;
+static int             mode = MODE_POLL;
+static uint32_t        khz = 1;          // Ciclos del TSC por ms
+static uint32_t        apic_khz;         // Cuentas del timer del APIC por ms (one-shot)
+static int             armed;
+
+static uint64_t rdmsr(uint32_t msr) {
+    uint32_t lo, hi;
+    asm volatile ("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static void wrmsr(uint32_t msr, uint64_t value) {
+    asm volatile ("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+static uint32_t lapic_read(uint32_t reg) {
+    return lapic[reg / 4];
+}
+
+static void lapic_write(uint32_t reg, uint32_t value) {
+    lapic[reg / 4] = value;
+}
+
+// =============================================================================
+// MONTÍCULO
+// =============================================================================
+static void heap_place(timer *t, int i) {
+    heap[i] = t;
+    t->slot = i;
+}
+
+static void sift_up(int i) {
+    timer *t = heap[i];
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (heap[parent]->deadline <= t->deadline) break;
+        heap_place(heap[parent], i);
+        i = parent;
+    }
+    heap_place(t, i);
+}
+
+static void sift_down(int i) {
+    timer *t = heap[i];
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= heap_n) break;
+        if (child + 1 < heap_n && heap[child + 1]->deadline < heap[child]->deadline) child++;
+        if (t->deadline <= heap[child]->deadline) break;
+        heap_place(heap[child], i);
+        i = child;
+    }
+    heap_place(t, i);
+}
+
+static void heap_remove(int i) {
+    heap[i]->slot = -1;
+    if (i == --heap_n) return;
+    timer *moved = heap[heap_n];   // El último ocupa el hueco
+    heap_place(moved, i);
+    sift_up(i);
+    sift_down(moved->slot);
+}
+
+void timer_setup(timer *t, timer_fn fn) {
+    t->deadline = 0;
+    t->fn = fn;
+    t->slot = -1;
+}
+
+int timer_pending(const timer *t) {
+    return t->slot >= 0;
+}
+
+// Un temporizador pendiente cambia de plazo sin salir del montículo
+int timer_start(timer *t, uint64_t deadline) {
+    if (t->slot >= 0) {
+        t->deadline = deadline;
+        sift_up(t->slot);
+        sift_down(t->slot);
+        return 1;
+    }
+    if (heap_n == TIMER_MAX) return 0;
+    t->deadline = deadline;
+    heap_place(t, heap_n++);
+    sift_up(t->slot);
+    return 1;
+}
+
+void timer_cancel(timer *t) {
+    if (t->slot >= 0) heap_remove(t->slot);
+}
+
+uint64_t timer_us(uint32_t us) {
+    return udiv64((uint64_t)us * khz, 1000);
+}
+
+// La función puede volver a arrancar su temporizador (uno periódico), así
+// que se saca del montículo antes de llamarla
+void timer_run(void) {
+    uint64_t now;
+    while (heap_n && heap[0]->deadline <= (now = rdtsc())) {
+        timer *t = heap[0];
+        uint64_t late = now - t->deadline;
+        heap_remove(0);
+        stats.fired++;
+        stats.late_cycles += late;
+        if (late > stats.late_max) stats.late_max = late;
+        t->fn(t);
+    }
+}
+
+// =============================================================================
+// APIC LOCAL
+// =============================================================================
+static void timer_irq(interrupt_frame *frame) {
+    (void)frame;
+    stats.timer_irqs++;
+    armed = 0;
+    lapic_write(APIC_EOI, 0);
+}
+
+// En one-shot la cuenta es relativa: el plazo se pasa a cuentas del APIC.
+// Más de un segundo no hace falta; si sigue faltando, timer_idle vuelve a
+// armarlo al despertar.
+static void lapic_arm(uint64_t deadline) {
+    armed = 1;
+    if (mode == MODE_DEADLINE) {
+        wrmsr(MSR_TSC_DEADLINE, deadline);
+        return;
+    }
+    uint64_t now = rdtsc(), delta = deadline > now ? deadline - now : 1;
+    if (delta > (uint64_t)khz * 1000) delta = (uint64_t)khz * 1000;
+    uint64_t count = udiv64(delta * apic_khz, khz);
+    lapic_write(APIC_INITIAL, count ? (uint32_t)count : 1);
+}
+
+static void lapic_disarm(void) {
+    armed = 0;
+    if (mode == MODE_DEADLINE) wrmsr(MSR_TSC_DEADLINE, 0);
+    else lapic_write(APIC_INITIAL, 0);
+}
+
+// Cuentas del timer del APIC (divisor 16) en 10 ms del TSC
+static uint32_t lapic_calibrate(void) {
+    lapic_write(APIC_DIVIDE, 0x3);
+    lapic_write(APIC_LVT_TIMER, APIC_LVT_MASKED | TIMER_VECTOR);
+    uint64_t end = rdtsc() + (uint64_t)khz * 10;
+    lapic_write(APIC_INITIAL, 0xFFFFFFFF);
+    while (rdtsc() < end);
+    uint32_t elapsed = 0xFFFFFFFF - lapic_read(APIC_CURRENT);
+    lapic_write(APIC_INITIAL, 0);
+    return elapsed / 10;
+}
+
+// El APIC queda en modo "virtual wire": las IRQs del PIC siguen llegando
+// por LINT0 como ExtINT, igual que con el APIC apagado
+void timer_init(uint32_t tsc_khz) {
+    khz = tsc_khz ? tsc_khz : 1;
+    if (!cpu_has(CPU_APIC | CPU_TSC)) return;
+    uint64_t base = rdmsr(MSR_APIC_BASE);
+    if (base >> 32) return;   // Fuera de los 4 GiB mapeados
+    wrmsr(MSR_APIC_BASE, base | APIC_BASE_ENABLE);
+    lapic = (volatile uint32_t *)(uintptr_t)(base & 0xFFFFF000);
+    lapic_write(APIC_SVR, (lapic_read(APIC_SVR) & ~0xFF) | APIC_SVR_ENABLE | SPURIOUS_VECTOR);
+    lapic_write(APIC_LVT_LINT0, APIC_DM_EXTINT);
+    lapic_write(APIC_LVT_LINT1, APIC_DM_NMI);
+    lapic_write(APIC_TPR, 0);
+
+    local_install(TIMER_VECTOR, timer_irq);
+    if (cpu_has(CPU_TSC_DEADLINE)) {
+        lapic_write(APIC_LVT_TIMER, APIC_LVT_DEADLINE | TIMER_VECTOR);
+        asm volatile ("mfence" ::: "memory");   // La escritura del LVT antes que el MSR
+        mode = MODE_DEADLINE;
+        return;
+    }
+    apic_khz = lapic_calibrate();
+    if (!apic_khz) return;
+    lapic_write(APIC_LVT_TIMER, TIMER_VECTOR);   // One-shot
+    mode = MODE_ONESHOT;
+}
+
+const char *timer_mode(void) {
+    return mode == MODE_DEADLINE ? "tsc-deadline" : mode == MODE_ONESHOT ? "one-shot" : "sondeo";
+}
+
+// =============================================================================
+// ESPERA
+// =============================================================================
+// La comprobación de irq_arrived y el hlt van con las interrupciones
+// desactivadas: sti retrasa una instrucción la entrada de la siguiente, así
+// que una IRQ que llegue entre medias despierta el hlt en vez de perderse.
+void timer_idle(uint64_t until) {
+    timer_run();
+    uint64_t next = heap_n ? heap[0]->deadline : 0;
+    if (until && (!next || until < next)) next = until;
+
+    asm volatile ("cli");
+    if (irq_arrived || (next && (mode == MODE_POLL || next <= rdtsc()))) {
+        // Ya hay algo que mirar, o un plazo que sin APIC sólo se ve sondeando
+        irq_arrived = 0;
+        asm volatile ("sti");
+        return;
+    }
+    if (next) lapic_arm(next);
+    else if (armed) lapic_disarm();
+    stats.halts++;
+    uint64_t t0 = rdtsc();
+    asm volatile ("sti; hlt");
+    stats.idle_cycles += rdtsc() - t0;
+    irq_arrived = 0;
+    timer_run();
+}
+
+void timer_get_stats(timer_stats *st) {
+    *st = stats;
+}
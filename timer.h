@@ -0,0 +1,64 @@
+// timer.h: temporizadores del kernel sin tick periódico (timer.c)
+//
+// No hay una interrupción cada pocos milisegundos para ver si algo venció.
+// Los temporizadores pendientes esperan en un montículo ordenado por su
+// plazo, en ciclos del TSC, y el timer del APIC local se programa una sola
+// vez para el más cercano: en modo TSC-deadline si la CPU lo tiene (el
+// plazo se escribe tal cual en un MSR) o en modo one-shot, con una cuenta
+// atrás calibrada contra el TSC al arrancar.
+//
+// timer_idle() detiene la CPU con hlt hasta la siguiente interrupción (el
+// teclado, el puerto serie, la red o ese plazo), así que una máquina
+// virtual que espera una tecla no gasta CPU del anfitrión. Las funciones de
+// los temporizadores no corren dentro de la interrupción: las llama
+// timer_run(), desde el bucle que espera, y pueden usar el sistema de
+// archivos o la red como cualquier comando.
+//
+// Sin APIC local se sigue sondeando como antes: timer_idle() sólo detiene
+// la CPU si no hay ningún plazo que vigilar.
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+
+#define TIMER_MAX 32          // Temporizadores pendientes a la vez
+
+typedef struct timer timer;
+typedef void (*timer_fn)(timer *t);
+
+struct timer {
+    uint64_t deadline;        // Ciclos del TSC
+    timer_fn fn;
+    int      slot;            // Posición en el montículo (-1 = no pendiente)
+};
+
+typedef struct {
+    uint32_t halts;           // Veces que la CPU se detuvo
+    uint32_t timer_irqs;      // Interrupciones del timer del APIC
+    uint32_t fired;           // Temporizadores vencidos
+    uint64_t idle_cycles;     // Ciclos con la CPU detenida
+    uint64_t late_cycles;     // Retraso acumulado entre el plazo y su función
+    uint64_t late_max;
+} timer_stats;
+
+// Detecta el APIC local y elige el modo. 'tsc_khz' es la frecuencia del TSC.
+void timer_init(uint32_t tsc_khz);
+const char *timer_mode(void);        // "tsc-deadline", "one-shot" o "sondeo"
+
+void     timer_setup(timer *t, timer_fn fn);
+int      timer_start(timer *t, uint64_t deadline);   // 0 si no caben más
+void     timer_cancel(timer *t);
+int      timer_pending(const timer *t);
+uint64_t timer_us(uint32_t us);                      // Microsegundos en ciclos
+
+// Llama a las funciones de los temporizadores vencidos
+void timer_run(void);
+
+// Detiene la CPU hasta la siguiente interrupción o hasta 'until' (ciclos
+// del TSC; 0 = sólo los temporizadores), y después llama a timer_run().
+// Puede volver antes: quien espera vuelve a mirar lo suyo y la llama otra vez.
+void timer_idle(uint64_t until);
+
+void timer_get_stats(timer_stats *st);
+
+#endif
@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+# benchcmp.py: compara dos ejecuciones del banco de pruebas del kernel
+#
+# Cada archivo tiene una línea JSON por prueba, tal como las escribe
+# "bench json" por el puerto serie (ver 'make bench'). Se comparan las
+# medianas en ciclos; si alguna prueba empeora más que el umbral, el script
+# termina con código 1 para que un script de integración lo detecte.
+#
+# Uso: benchcmp.py [-t PORCENTAJE] <base.jsonl> <nuevo.jsonl>
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    results = {}
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if not line.startswith("{"):
+                continue  # Ignorar cualquier otra salida del puerto serie
+            rec = json.loads(line)
+            results[rec["bench"]] = rec
+    return results
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Compara resultados de 'bench json'")
+    ap.add_argument("-t", "--threshold", type=float, default=10.0,
+                    help="empeoramiento máximo de la mediana, en %% (por defecto 10)")
+    ap.add_argument("base")
+    ap.add_argument("new")
+    args = ap.parse_args()
+
+    base, new = load(args.base), load(args.new)
+    regressions = 0
+    print("%-20s %12s %12s %8s" % ("prueba", "base", "nuevo", "cambio"))
+    for name, rec in new.items():
+        if name not in base:
+            print("%-20s %12s %12d %8s" % (name, "-", rec["median"], "nueva"))
+            continue
+        old = base[name]["median"]
+        cur = rec["median"]
+        change = (cur - old) * 100.0 / old if old else 0.0
+        mark = ""
+        if change > args.threshold:
+            mark = "  REGRESION"
+            regressions += 1
+        print("%-20s %12d %12d %+7.1f%%%s" % (name, old, cur, change, mark))
+
+    if regressions:
+        print("%d prueba(s) empeoran más de un %.1f%%" % (regressions, args.threshold))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
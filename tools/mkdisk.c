@@ -0,0 +1,195 @@
+// mkdisk.c: empaqueta un directorio del host en una imagen FAT16 para r2os
+//
+// La imagen resultante se pasa al kernel como módulo Multiboot:
+//     qemu-system-i386 -kernel myos.elf -initrd disk.img
+// y el kernel la monta en el sitio, sin formatear ni copiar nada.
+//
+// Uso: mkdisk <directorio> <imagen>
+//
+// La geometría sale de fat16.h con el mismo DISK_SECTORS con el que se
+// compila el kernel, así que la imagen siempre coincide con él.
+//
+// Los subdirectorios se copian recursivamente como directorios FAT16 (con
+// "." y ".."). Como el kernel compara los nombres byte a byte, cada nombre
+// se guarda tal cual (hasta 11 caracteres) rellenado con espacios, igual
+// que hace fs_find().
+// Se compila con el compilador del host (ver target 'image' del Makefile).
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "fat16.h"
+
+static uint8_t *image;
+static uint32_t next_cluster = 2;
+
+static void fat_set(uint16_t cluster, uint16_t value) {
+    uint8_t *fat = image + SECTOR_SIZE;
+    fat[cluster * 2] = value & 0xFF;
+    fat[cluster * 2 + 1] = value >> 8;
+}
+
+static void set_name(fat16_dir_entry *e, const char *name) {
+    memset(e, 0, sizeof(*e));
+    memset(e->name, ' ', 11);
+    memcpy(e->name, name, strlen(name));
+}
+
+// Reserva 'count' clusters consecutivos encadenados. Retorna el primero, o 0
+static uint16_t alloc_chain(uint32_t count) {
+    if (next_cluster + count > CLUSTER_LIMIT) return 0;
+    uint16_t first = next_cluster;
+    for (uint32_t i = 0; i < count; i++) fat_set(first + i, i + 1 < count ? first + i + 1 : 0xFFFF);
+    next_cluster += count;
+    return first;
+}
+
+static uint8_t *cluster_data(uint16_t cluster) {
+    return image + (DATA_SECTOR + cluster - 2) * SECTOR_SIZE;
+}
+
+// Añade un archivo en clusters consecutivos. Retorna 0 si no cabe.
+static int add_file(fat16_dir_entry *e, const char *name, const uint8_t *data, uint32_t size) {
+    uint32_t clusters = size ? (size + SECTOR_SIZE - 1) / SECTOR_SIZE : 1;
+    uint16_t first = alloc_chain(clusters);
+    if (!first) return 0;
+    set_name(e, name);
+    e->first_cluster = first;
+    e->size = size;
+    if (size) memcpy(cluster_data(first), data, size);
+    return 1;
+}
+
+static uint8_t *load_file(const char *path, uint32_t *size) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *buf = malloc(len ? len : 1);
+    if (buf && fread(buf, 1, len, f) != (size_t)len) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    *size = (uint32_t)len;
+    return buf;
+}
+
+static int skip_hidden(const struct dirent *d) {
+    return d->d_name[0] != '.';
+}
+
+static int files = 0, dirs = 0;
+
+// Copia el contenido de 'path' en las 'capacity' entradas de 'entries'
+// (el raíz o los clusters de un subdirectorio, que son consecutivos).
+// 'self' es el cluster del directorio, 0 para el raíz.
+static void pack_dir(const char *path, fat16_dir_entry *entries, uint32_t capacity, uint16_t self) {
+    struct dirent **list;
+    int n = scandir(path, &list, skip_hidden, alphasort);
+    if (n < 0) {
+        perror(path);
+        return;
+    }
+
+    uint32_t slot = self ? 2 : 0;   // Tras "." y ".."
+    for (int i = 0; i < n; i++) {
+        const char *name = list[i]->d_name;
+        char child[4096];
+        struct stat st;
+        snprintf(child, sizeof(child), "%s/%s", path, name);
+        if (stat(child, &st) || (!S_ISREG(st.st_mode) && !S_ISDIR(st.st_mode))) continue;
+
+        if (strlen(name) > 11) {
+            fprintf(stderr, "mkdisk: nombre demasiado largo, se omite: %s\n", child);
+            continue;
+        }
+        if (slot >= capacity) {
+            fprintf(stderr, "mkdisk: directorio lleno, se omite: %s\n", child);
+            continue;
+        }
+
+        fat16_dir_entry *e = &entries[slot];
+        if (S_ISDIR(st.st_mode)) {
+            // El directorio ocupa los clusters justos para sus entradas
+            struct dirent **sub;
+            int m = scandir(child, &sub, skip_hidden, alphasort);
+            if (m < 0) {
+                perror(child);
+                continue;
+            }
+            for (int k = 0; k < m; k++) free(sub[k]);
+            free(sub);
+            uint32_t per_cluster = SECTOR_SIZE / DIR_ENTRY_SIZE;
+            uint32_t clusters = (2 + m + per_cluster - 1) / per_cluster;
+            uint16_t first = alloc_chain(clusters);
+            if (!first) {
+                fprintf(stderr, "mkdisk: sin espacio para el directorio %s\n", child);
+                continue;
+            }
+            set_name(e, name);
+            e->attr = FAT_ATTR_DIRECTORY;
+            e->first_cluster = first;
+
+            fat16_dir_entry *sub_entries = (fat16_dir_entry *)cluster_data(first);
+            set_name(&sub_entries[0], ".");
+            sub_entries[0].attr = FAT_ATTR_DIRECTORY;
+            sub_entries[0].first_cluster = first;
+            set_name(&sub_entries[1], "..");
+            sub_entries[1].attr = FAT_ATTR_DIRECTORY;
+            sub_entries[1].first_cluster = self;
+            slot++;
+            dirs++;
+            pack_dir(child, sub_entries, clusters * per_cluster, first);
+            continue;
+        }
+
+        uint32_t size;
+        uint8_t *data = load_file(child, &size);
+        if (!data) {
+            perror(child);
+            continue;
+        }
+        if (!add_file(e, name, data, size)) {
+            fprintf(stderr, "mkdisk: sin espacio para %s (%u bytes)\n", child, size);
+        } else {
+            slot++;
+            files++;
+        }
+        free(data);
+    }
+    for (int i = 0; i < n; i++) free(list[i]);
+    free(list);
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "Uso: %s <directorio> <imagen>\n", argv[0]);
+        return 1;
+    }
+    const char *dir = argv[1], *out = argv[2];
+
+    image = calloc(DISK_SECTORS, SECTOR_SIZE);
+    if (!image) {
+        perror("mkdisk");
+        return 1;
+    }
+    fat16_format(image);
+
+    pack_dir(dir, (fat16_dir_entry *)(image + ROOT_SECTOR * SECTOR_SIZE), ROOT_ENTRIES, 0);
+
+    FILE *f = fopen(out, "wb");
+    if (!f || fwrite(image, SECTOR_SIZE, DISK_SECTORS, f) != DISK_SECTORS) {
+        perror(out);
+        return 1;
+    }
+    fclose(f);
+
+    printf("%s: %d archivos en %d directorios, %u sectores (FAT de %u sectores, %u clusters usados de %u)\n",
+           out, files, dirs + 1, DISK_SECTORS, FAT_SECTORS, next_cluster - 2, DATA_CLUSTERS);
+    return 0;
+}
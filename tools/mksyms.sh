@@ -0,0 +1,24 @@
+#!/bin/sh
+# mksyms.sh: genera ksyms.c a partir de la salida de 'nm -n'
+#
+# Sólo se guardan los símbolos de código (t/T/W), que nm ya entrega
+# ordenados por dirección: el perfilador busca en la tabla por bisección.
+# Sin entrada genera una tabla vacía, que es la del primer enlace.
+#
+# Uso: nm -n myos.elf | tools/mksyms.sh > ksyms.c
+
+awk '
+BEGIN {
+    print "// ksyms.c: generado por tools/mksyms.sh a partir de nm, no editar"
+    print "#include \"ksyms.h\""
+    print ""
+    print "const ksym ksyms[] = {"
+}
+NF == 3 && $2 ~ /^[tTW]$/ {
+    printf "    { 0x%s, \"%s\" },\n", $1, $3
+    n++
+}
+END {
+    print "};"
+    printf "const uint32_t ksyms_count = %d;\n", n
+}'
@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+# trace2json.py: convierte el volcado de 'trace dump' al formato de Chrome
+#
+# El kernel escribe la traza por el puerto serie (ver 'make run-trace'), una
+# línea por evento entre la cabecera "# r2os-trace" y la línea "# fin". El
+# resultado se abre en chrome://tracing o en https://ui.perfetto.dev:
+# - cmd_begin/cmd_end forman un intervalo por comando, con su nombre
+# - el resto son eventos instantáneos con sus argumentos
+# Si el archivo contiene varios volcados se usa el último.
+#
+# Uso: trace2json.py <trace.log> [salida.json]
+
+import json
+import sys
+
+# Nombres de los argumentos a y b de cada evento (ver trace.h)
+ARGS = {
+    "sector_read": ("lba", "sectores"),
+    "sector_write": ("lba", "sectores"),
+    "cluster_alloc": ("cluster", None),
+    "lookup": ("entrada", "cache"),
+    "key": ("codigo", None),
+    "pipe_stage": ("etapa", "bytes"),
+}
+
+
+def command_name(tag):
+    chars = [chr((tag >> (8 * i)) & 0xFF) for i in range(4)]
+    return "".join(c for c in chars if c != "\0") or "?"
+
+
+def signed(value):
+    return value - (1 << 32) if value >= 1 << 31 else value
+
+
+def parse(path):
+    dumps, current, khz = [], None, 1
+    with open(path, errors="replace") as f:
+        for line in f:
+            line = line.strip()
+            if line.startswith("# r2os-trace"):
+                fields = dict(kv.split("=", 1) for kv in line.split()[3:] if "=" in kv)
+                khz = int(fields.get("tsc_khz", "1")) or 1
+                current = []
+            elif line.startswith("# fin") and current is not None:
+                dumps.append((khz, current))
+                current = None
+            elif current is not None and line:
+                parts = line.split()
+                if len(parts) != 6:
+                    continue  # Otra salida intercalada en el puerto serie
+                cpu, hi, lo, name, a, b = parts
+                tsc = (int(hi, 16) << 32) | int(lo, 16)
+                current.append((tsc, int(cpu), name, int(a), int(b)))
+    if not dumps:
+        sys.exit("%s: no contiene ningún volcado de 'trace dump'" % path)
+    return dumps[-1]
+
+
+def convert(khz, events):
+    start = min(ev[0] for ev in events) if events else 0
+    out = []
+    for tsc, cpu, name, a, b in events:
+        ts = (tsc - start) * 1000.0 / khz   # Microsegundos
+        rec = {"pid": 1, "tid": cpu, "ts": ts}
+        if name in ("cmd_begin", "cmd_end"):
+            rec.update(name=command_name(b), cat="cmd",
+                       ph="B" if name == "cmd_begin" else "E", args={"n": a})
+        else:
+            keys = ARGS.get(name, ("a", "b"))
+            args = {}
+            if keys[0]:
+                args[keys[0]] = signed(a) if name == "lookup" else a
+            if keys[1]:
+                args[keys[1]] = b
+            rec.update(name=name, cat=name.split("_")[0], ph="i", s="t", args=args)
+        out.append(rec)
+    return {"traceEvents": out, "displayTimeUnit": "ns",
+            "otherData": {"tsc_khz": khz}}
+
+
+def main():
+    if len(sys.argv) not in (2, 3):
+        sys.exit("Uso: trace2json.py <trace.log> [salida.json]")
+    khz, events = parse(sys.argv[1])
+    trace = convert(khz, events)
+    if len(sys.argv) == 3:
+        with open(sys.argv[2], "w") as f:
+            json.dump(trace, f)
+    else:
+        json.dump(trace, sys.stdout)
+    print("%d eventos convertidos" % len(events), file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,65 @@
+// trace.c: buffer circular de eventos de traza (ver trace.h)
+//
+// Cada CPU escribe sólo en su propio buffer, así que registrar un evento no
+// necesita cerrojos. Cuando el buffer se llena se sobrescriben los eventos
+// más antiguos: siempre queda la historia más reciente.
+
+#include <stdint.h>
+#include "platform.h"
+#include "trace.h"
+
+int trace_enabled = 0;
+
+static trace_event trace_buf[TRACE_CPUS][TRACE_ENTRIES];
+static uint32_t    trace_head[TRACE_CPUS];   // Eventos escritos desde trace_start
+
+static const char *const trace_names[TRACE_EVENT_COUNT] = {
+    [TRACE_SECTOR_READ]   = "sector_read",
+    [TRACE_SECTOR_WRITE]  = "sector_write",
+    [TRACE_CLUSTER_ALLOC] = "cluster_alloc",
+    [TRACE_LOOKUP]        = "lookup",
+    [TRACE_CMD_BEGIN]     = "cmd_begin",
+    [TRACE_CMD_END]       = "cmd_end",
+    [TRACE_KEY]           = "key",
+    [TRACE_PIPE_STAGE]    = "pipe_stage",
+};
+
+// Con un solo procesador siempre es la CPU 0; con SMP sería el ID del LAPIC
+static inline int trace_cpu(void) {
+    return 0;
+}
+
+void trace_record(uint16_t id, uint32_t a, uint32_t b) {
+    int cpu = trace_cpu();
+    trace_event *ev = &trace_buf[cpu][trace_head[cpu]++ & (TRACE_ENTRIES - 1)];
+    ev->tsc = rdtsc();
+    ev->a = a;
+    ev->b = b;
+    ev->id = id;
+    ev->cpu = cpu;
+}
+
+void trace_start(void) {
+    for (int cpu = 0; cpu < TRACE_CPUS; cpu++) trace_head[cpu] = 0;
+    trace_enabled = 1;
+}
+
+void trace_stop(void) {
+    trace_enabled = 0;
+}
+
+uint32_t trace_count(int cpu) {
+    return trace_head[cpu] < TRACE_ENTRIES ? trace_head[cpu] : TRACE_ENTRIES;
+}
+
+uint32_t trace_lost(int cpu) {
+    return trace_head[cpu] - trace_count(cpu);
+}
+
+const trace_event *trace_get(int cpu, uint32_t i) {
+    return &trace_buf[cpu][(trace_lost(cpu) + i) & (TRACE_ENTRIES - 1)];
+}
+
+const char *trace_event_name(uint16_t id) {
+    return id < TRACE_EVENT_COUNT ? trace_names[id] : "?";
+}
@@ -0,0 +1,52 @@
+// trace.h: puntos de traza estáticos del kernel (trace.c)
+//
+// Cada TRACE() guarda {tsc, cpu, evento, dos argumentos} en un buffer
+// circular binario por CPU. Con el trazado desactivado el coste es una
+// comparación con una variable global que casi nunca se cumple: no hay
+// llamada ni acceso al buffer. El comando 'trace' del shell lo activa y
+// vuelca el contenido por el puerto serie (ver tools/trace2json.py).
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+// Identificadores de evento. trace_event_name() da su nombre en el volcado.
+enum {
+    TRACE_SECTOR_READ,    // a = LBA, b = sectores
+    TRACE_SECTOR_WRITE,   // a = LBA, b = sectores
+    TRACE_CLUSTER_ALLOC,  // a = cluster
+    TRACE_LOOKUP,         // a = dirección de la entrada (-1 = no existe), b = 1 si acertó la caché
+    TRACE_CMD_BEGIN,      // a = número de comando, b = primeros 4 caracteres
+    TRACE_CMD_END,        // a = número de comando, b = primeros 4 caracteres
+    TRACE_KEY,            // a = carácter o código de tecla especial
+    TRACE_PIPE_STAGE,     // a = etapa que termina (0 = la primera), b = bytes que escribió
+    TRACE_EVENT_COUNT
+};
+
+typedef struct {
+    uint64_t tsc;
+    uint32_t a, b;
+    uint16_t id;
+    uint16_t cpu;
+} trace_event;
+
+#define TRACE_CPUS    1      // El kernel todavía no arranca más procesadores
+#define TRACE_ENTRIES 4096   // Eventos por CPU (potencia de 2)
+
+extern int trace_enabled;
+
+void trace_record(uint16_t id, uint32_t a, uint32_t b);
+
+#define TRACE(id, a, b) do { \
+        if (__builtin_expect(trace_enabled, 0)) trace_record((id), (a), (b)); \
+    } while (0)
+
+// Control y lectura del buffer
+void trace_start(void);
+void trace_stop(void);
+uint32_t trace_count(int cpu);                 // Eventos guardados
+uint32_t trace_lost(int cpu);                  // Eventos sobrescritos
+const trace_event *trace_get(int cpu, uint32_t i);   // i = 0 es el más antiguo
+const char *trace_event_name(uint16_t id);
+
+#endif
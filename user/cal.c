@@ -0,0 +1,52 @@
+// cal.c: calendario de un mes (antes era un comando interno del shell)
+//
+// Uso: cal [mes [año]]. Sin argumentos muestra el mes de 'date', que es
+// fijo porque el sistema no tiene reloj de tiempo real.
+
+#include "libc.h"
+
+static const char *const months[12] = {
+    "Enero", "Febrero", "Marzo", "Abril", "Mayo", "Junio", "Julio",
+    "Agosto", "Septiembre", "Octubre", "Noviembre", "Diciembre",
+};
+
+static int leap(int year) {
+    return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+// Día de la semana (0 = domingo) por el método de Sakamoto
+static int weekday(int day, int month, int year) {
+    static const int t[12] = { 0, 3, 2, 5, 0, 3, 5, 1, 4, 6, 2, 4 };
+    if (month < 3) year--;
+    return (year + year / 4 - year / 100 + year / 400 + t[month - 1] + day) % 7;
+}
+
+int main(int argc, char **argv) {
+    int month = 12, year = 2024;
+    if (argc > 1) month = atoi(argv[1]);
+    if (argc > 2) year = atoi(argv[2]);
+    if (month < 1 || month > 12 || year < 1) {
+        printf("Uso: cal [mes [anio]]\n");
+        return 1;
+    }
+
+    static const int days_in[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    int days = days_in[month - 1] + (month == 2 && leap(year));
+    int title = strlen(months[month - 1]) + 5;
+    for (int i = (20 - title) / 2; i > 0; i--) putchar(' ');
+    printf("%s %d\n", months[month - 1], year);
+    printf("Do Lu Ma Mi Ju Vi Sa\n");
+
+    int col = weekday(1, month, year);
+    for (int i = 0; i < col; i++) printf("   ");
+    for (int d = 1; d <= days; d++) {
+        printf("%2d", d);
+        if (++col == 7 || d == days) {
+            putchar('\n');
+            col = 0;
+        } else {
+            putchar(' ');
+        }
+    }
+    return 0;
+}
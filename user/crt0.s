@@ -0,0 +1,13 @@
+# crt0.s: punto de entrada de los programas de usuario
+#
+# El kernel (proc.c) deja en la pila argc, argv y las capacidades de la CPU
+# (syscall.h), en ese orden desde ESP. Con el 'call' quedan como los tres
+# argumentos de __libc_start, que llama a main y termina con su resultado.
+.section .text
+.global _start
+.type _start, @function
+_start:
+    xor %ebp, %ebp              # Fin de la cadena de marcos
+    call __libc_start
+    ud2                         # __libc_start no retorna
+.size _start, . - _start
@@ -0,0 +1,177 @@
+// libc.c: biblioteca mínima de los programas de usuario (ver libc.h)
+
+#include <stdarg.h>
+#include "libc.h"
+
+static int sysenter_ok;
+
+// =============================================================================
+// ARRANQUE Y LLAMADAS AL SISTEMA
+// =============================================================================
+void __libc_start(int argc, char **argv, uint32_t features) __attribute__((noreturn));
+
+void __libc_start(int argc, char **argv, uint32_t features) {
+    sysenter_ok = features & PROC_SYSENTER;
+    exit(main(argc, argv));
+}
+
+// sysexit vuelve a la dirección de EDX con la pila de ECX: justo después
+// de la instrucción y con la ESP de ahora
+int syscall_sysenter(int num, int a, int b, int c) {
+    int r;
+    asm volatile ("mov %%esp, %%ecx\n\t"
+                  "mov $1f, %%edx\n\t"
+                  "sysenter\n"
+                  "1:"
+                  : "=a"(r) : "a"(num), "b"(a), "S"(b), "D"(c) : "ecx", "edx", "memory");
+    return r;
+}
+
+int syscall_int80(int num, int a, int b, int c) {
+    int r;
+    asm volatile ("int $0x80" : "=a"(r) : "a"(num), "b"(a), "S"(b), "D"(c) : "memory");
+    return r;
+}
+
+int syscall(int num, int a, int b, int c) {
+    return sysenter_ok ? syscall_sysenter(num, a, b, c) : syscall_int80(num, a, b, c);
+}
+
+int have_sysenter(void) {
+    return sysenter_ok;
+}
+
+void exit(int code) {
+    fflush();
+    syscall(SYS_EXIT, code, 0, 0);
+    for (;;);
+}
+
+int read(int fd, void *buf, uint32_t len) { return syscall(SYS_READ, fd, (int)buf, len); }
+int write(int fd, const void *buf, uint32_t len) { return syscall(SYS_WRITE, fd, (int)buf, len); }
+int open(const char *path, int flags) { return syscall(SYS_OPEN, (int)path, flags, 0); }
+int close(int fd) { return syscall(SYS_CLOSE, fd, 0, 0); }
+int lseek(int fd, int offset, int whence) { return syscall(SYS_LSEEK, fd, offset, whence); }
+int unlink(const char *path) { return syscall(SYS_UNLINK, (int)path, 0, 0); }
+
+// =============================================================================
+// CADENAS Y MEMORIA
+// =============================================================================
+uint32_t strlen(const char *s) {
+    uint32_t n = 0;
+    while (s[n]) n++;
+    return n;
+}
+
+int strcmp(const char *a, const char *b) {
+    while (*a && *a == *b) { a++; b++; }
+    return (unsigned char)*a - (unsigned char)*b;
+}
+
+void *memcpy(void *dst, const void *src, uint32_t n) {
+    uint8_t *d = dst;
+    const uint8_t *s = src;
+    while (n--) *d++ = *s++;
+    return dst;
+}
+
+void *memset(void *dst, int c, uint32_t n) {
+    uint8_t *d = dst;
+    while (n--) *d++ = c;
+    return dst;
+}
+
+int atoi(const char *s) {
+    int sign = 1, n = 0;
+    if (*s == '-') { sign = -1; s++; }
+    while (*s >= '0' && *s <= '9') n = n * 10 + *s++ - '0';
+    return sign * n;
+}
+
+// =============================================================================
+// CONSOLA
+// =============================================================================
+static char     out_buf[256];
+static uint32_t out_len;
+static uint8_t  in_buf[128];
+static uint32_t in_len, in_pos;
+
+void fflush(void) {
+    if (out_len) write(STDOUT_FD, out_buf, out_len);
+    out_len = 0;
+}
+
+void putchar(char c) {
+    out_buf[out_len++] = c;
+    if (c == '\n' || out_len == sizeof(out_buf)) fflush();
+}
+
+void puts(const char *s) {
+    while (*s) putchar(*s++);
+    putchar('\n');
+}
+
+int getchar(void) {
+    if (in_pos == in_len) {
+        fflush();   // Lo pendiente (un prompt) sale antes de esperar
+        int n = read(STDIN_FD, in_buf, sizeof(in_buf));
+        if (n <= 0) return EOF;
+        in_len = n;
+        in_pos = 0;
+    }
+    return in_buf[in_pos++];
+}
+
+static void print_num(uint32_t n, int base, int width, char pad, int negative) {
+    char buf[12];
+    int i = 0;
+    do {
+        int d = n % base;
+        buf[i++] = d < 10 ? '0' + d : 'a' + d - 10;
+        n /= base;
+    } while (n);
+    if (negative) {
+        if (pad == '0') putchar('-');
+        width--;
+    }
+    for (int w = i; w < width; w++) putchar(pad);
+    if (negative && pad != '0') putchar('-');
+    while (i--) putchar(buf[i]);
+}
+
+void printf(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    for (; *fmt; fmt++) {
+        if (*fmt != '%') {
+            putchar(*fmt);
+            continue;
+        }
+        fmt++;
+        char pad = ' ';
+        int width = 0;
+        if (*fmt == '0') pad = *fmt++;
+        while (*fmt >= '0' && *fmt <= '9') width = width * 10 + *fmt++ - '0';
+        switch (*fmt) {
+        case 'd': {
+            int v = va_arg(args, int);
+            print_num(v < 0 ? -(uint32_t)v : (uint32_t)v, 10, width, pad, v < 0);
+            break;
+        }
+        case 'u': print_num(va_arg(args, uint32_t), 10, width, pad, 0); break;
+        case 'x': print_num(va_arg(args, uint32_t), 16, width, pad, 0); break;
+        case 'c': putchar(va_arg(args, int)); break;
+        case 's': {
+            const char *s = va_arg(args, const char *);
+            int len = strlen(s);
+            for (int w = len; w < width; w++) putchar(' ');
+            while (*s) putchar(*s++);
+            break;
+        }
+        case '%': putchar('%'); break;
+        case '\0': fmt--; break;
+        default: putchar('%'); putchar(*fmt); break;
+        }
+    }
+    va_end(args);
+}
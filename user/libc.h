@@ -0,0 +1,65 @@
+// libc.h: biblioteca mínima de los programas de usuario (libc.c)
+//
+// Lo justo para escribir utilidades: las llamadas al sistema de syscall.h,
+// cadenas, printf y getchar. La salida de printf se acumula y se escribe
+// con una sola llamada por línea (o cuando se llena el buffer).
+#ifndef LIBC_H
+#define LIBC_H
+
+#include <stdint.h>
+#include "../syscall.h"
+
+#define NULL ((void *)0)
+
+// Los mismos valores que fs.h
+#define O_RDONLY  0x0
+#define O_WRONLY  0x1
+#define O_RDWR    0x2
+#define O_CREAT   0x40
+#define O_TRUNC   0x200
+#define O_APPEND  0x400
+
+#define SEEK_SET 0
+#define SEEK_CUR 1
+#define SEEK_END 2
+
+#define EOF (-1)
+
+int main(int argc, char **argv);
+
+// Llamadas al sistema. syscall usa sysenter si la CPU lo tiene; las otras
+// dos fuerzan una entrada concreta (para medirlas, ver sysbench.c).
+int  syscall(int num, int a, int b, int c);
+int  syscall_sysenter(int num, int a, int b, int c);
+int  syscall_int80(int num, int a, int b, int c);
+int  have_sysenter(void);
+
+void exit(int code) __attribute__((noreturn));
+int  read(int fd, void *buf, uint32_t len);
+int  write(int fd, const void *buf, uint32_t len);
+int  open(const char *path, int flags);
+int  close(int fd);
+int  lseek(int fd, int offset, int whence);
+int  unlink(const char *path);
+
+// Cadenas y memoria
+uint32_t strlen(const char *s);
+int      strcmp(const char *a, const char *b);
+void    *memcpy(void *dst, const void *src, uint32_t n);
+void    *memset(void *dst, int c, uint32_t n);
+int      atoi(const char *s);
+
+// Consola: printf entiende %s %c %d %u %x y %%, con ancho ("%3d", "%08x")
+int  getchar(void);   // EOF al final de la entrada
+void putchar(char c);
+void puts(const char *s);
+void printf(const char *fmt, ...);
+void fflush(void);
+
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+#endif
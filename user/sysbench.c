@@ -0,0 +1,60 @@
+// sysbench.c: coste de ida y vuelta de una llamada al sistema
+//
+// Uso: sysbench [n]. Repite n veces (100000 por defecto) SYS_NOP, que no
+// hace nada en el kernel, por sysenter/sysexit y por int 0x80/iret, y
+// también una escritura de un byte a un archivo. Muestra ciclos por
+// llamada (mínimo de 5 rondas, para quitar el ruido de las interrupciones).
+
+#include "libc.h"
+
+#define ROUNDS 5
+
+typedef int (*entry_fn)(int num, int a, int b, int c);
+
+static uint32_t per_call(uint64_t cycles, uint32_t n) {
+    // Sin libgcc no hay división de 64 bits: basta con 32 si n es grande
+    while (cycles >> 32) {
+        cycles >>= 1;
+        n >>= 1;
+    }
+    return n ? (uint32_t)cycles / n : 0;
+}
+
+static uint32_t measure(entry_fn entry, int num, int a, int b, int c, uint32_t n) {
+    uint32_t best = 0xFFFFFFFF;
+    for (int r = 0; r < ROUNDS; r++) {
+        uint64_t t0 = rdtsc();
+        for (uint32_t i = 0; i < n; i++) entry(num, a, b, c);
+        uint32_t cycles = per_call(rdtsc() - t0, n);
+        if (cycles < best) best = cycles;
+    }
+    return best;
+}
+
+int main(int argc, char **argv) {
+    uint32_t n = argc > 1 ? (uint32_t)atoi(argv[1]) : 100000;
+    if (!n) n = 1;
+    printf("sysbench: %u llamadas por ronda, minimo de %d rondas\n", n, ROUNDS);
+
+    uint32_t fast = 0;
+    if (have_sysenter()) {
+        fast = measure(syscall_sysenter, SYS_NOP, 0, 0, 0, n);
+        printf("nop  sysenter/sysexit  %6u ciclos\n", fast);
+    } else {
+        printf("nop  sysenter/sysexit  (la CPU no lo tiene)\n");
+    }
+    uint32_t slow = measure(syscall_int80, SYS_NOP, 0, 0, 0, n);
+    printf("nop  int 0x80/iret     %6u ciclos\n", slow);
+    if (fast) printf("sysenter es %u.%u veces mas rapido\n", slow / fast, slow * 10 / fast % 10);
+
+    // Una llamada con trabajo de verdad: escribir un byte en un archivo
+    int fd = open("sysbench.tmp", O_WRONLY | O_CREAT | O_TRUNC);
+    if (fd >= 0) {
+        static const char byte = 'x';
+        uint32_t w = measure(syscall, SYS_WRITE, fd, (int)&byte, 1, n < 2000 ? n : 2000);
+        printf("write de 1 byte        %6u ciclos\n", w);
+        close(fd);
+        unlink("sysbench.tmp");
+    }
+    return 0;
+}
@@ -0,0 +1,17 @@
+// upper.c: copia la entrada a la salida en mayúsculas
+//
+// Lee del teclado, de '<' o de un pipe (ls | upper) hasta el final de la
+// entrada; sirve de ejemplo de programa que usa read y write.
+
+#include "libc.h"
+
+int main(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    int c;
+    while ((c = getchar()) != EOF) {
+        if (c >= 'a' && c <= 'z') c -= 'a' - 'A';
+        putchar(c);
+    }
+    return 0;
+}